@@ -40,6 +40,29 @@ class plugin_driver_name(dlite.DLiteStorageBase):
             inst: Instance to save.
         """
 
+    def load_many(self, ids):
+        """Load several instances from storage and return them.  Optional.
+
+        Used when loading a collection or a whole storage.  If not
+        defined, load() is called for each id.
+
+        Arguments:
+            ids: List of IDs of the instances to load.
+
+        Returns:
+            Sequence of new instances in the same order as `ids`.
+        """
+
+    def save_many(self, instances):
+        """Save several instances to storage.  Optional.
+
+        Used when saving a collection or a whole store.  If not
+        defined, save() is called for each instance.
+
+        Arguments:
+            instances: List of instances to save.
+        """
+
     def delete(self, uuid):
         """Delete instance with given `uuid` from storage.  Optional.
 
@@ -0,0 +1,112 @@
+/* bench.c -- minimal benchmark harness
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+
+#if defined(_WIN32)
+# include <windows.h>
+# include <psapi.h>
+#elif defined(UNIX)
+# include <sys/time.h>
+# include <sys/resource.h>
+#endif
+
+#include "utils/err.h"
+#include "bench.h"
+
+
+/* Returns a monotonic wall time in seconds. */
+double bench_time(void)
+{
+#if defined(_WIN32)
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER t;
+  if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Returns peak resident set size of this process in kB or 0 if
+   not available. */
+long bench_peak_rss(void)
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+  return (long)(pmc.PeakWorkingSetSize / 1024);
+#elif defined(UNIX)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) return 0;
+# if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;  /* bytes on macOS */
+# else
+  return usage.ru_maxrss;
+# endif
+#else
+  return 0;
+#endif
+}
+
+
+/*
+  Runs benchmark `b` with configuration `cfg` and writes the result
+  as a line of JSON to `cfg->out`.
+
+  The run function is called once untimed before the measurement to
+  warm up caches and lazily initialised global state.
+*/
+int bench_run(const Benchmark *b, const BenchConfig *cfg)
+{
+  void *state=NULL;
+  size_t iter=0, nbytes=0, totbytes=0;
+  double t0, elapsed=0.0, ops, bps;
+  int retval=1;
+
+  if (b->setup && !(state = b->setup(cfg)))
+    return errx(1, "cannot setup benchmark: %s", b->name);
+
+  if (b->run(state, &nbytes)) {
+    errx(1, "error running benchmark: %s", b->name);
+    goto fail;
+  }
+
+  t0 = bench_time();
+  while (iter < cfg->min_iter || elapsed < cfg->min_time) {
+    nbytes = 0;
+    if (b->run(state, &nbytes)) {
+      errx(1, "error running benchmark: %s", b->name);
+      goto fail;
+    }
+    totbytes += nbytes;
+    iter++;
+    elapsed = bench_time() - t0;
+  }
+
+  ops = (elapsed > 0) ? iter / elapsed : 0.0;
+  bps = (elapsed > 0) ? totbytes / elapsed : 0.0;
+  fprintf(cfg->out,
+          "{\"name\": \"%s\", \"size\": %lu, \"ndims\": %d, "
+          "\"iterations\": %lu, \"seconds\": %.6g, \"ops_per_sec\": %.6g, "
+          "\"bytes_per_sec\": %.6g, \"peak_rss_kb\": %ld}\n",
+          b->name, (unsigned long)cfg->size, cfg->ndims,
+          (unsigned long)iter, elapsed, ops, bps, bench_peak_rss());
+  fflush(cfg->out);
+  retval = 0;
+ fail:
+  if (b->teardown && state) b->teardown(state);
+  return retval;
+}
@@ -0,0 +1,86 @@
+/* bench.h -- minimal benchmark harness
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/**
+  @file
+  @brief Minimal benchmark harness.
+
+  A benchmark is described by a Benchmark struct with optional
+  `setup` and `teardown` functions and a `run` function that
+  performs one operation.  bench_run() calls `run` repeatedly until
+  both a minimum number of iterations and a minimum wall time have
+  been reached and writes the result as a single line of JSON to the
+  output stream.  Each line has the fields:
+
+    - name: Name of the benchmark.
+    - size: Number of array elements of the synthetic data.
+    - ndims: Number of dimensions of the synthetic data.
+    - iterations: Number of timed calls to `run`.
+    - seconds: Total wall time of the timed calls.
+    - ops_per_sec: Operations per second.
+    - bytes_per_sec: Bytes processed per second (0 if not relevant).
+    - peak_rss_kb: Peak resident set size of the process in kB after
+      running the benchmark (0 if not available on this platform).
+*/
+
+#include <stdio.h>
+
+
+/** Benchmark configuration. */
+typedef struct {
+  size_t size;        /*!< Number of elements in synthetic arrays */
+  int ndims;          /*!< Number of dimensions of synthetic arrays */
+  unsigned long seed; /*!< Seed for generating synthetic data */
+  size_t min_iter;    /*!< Minimum number of timed iterations */
+  double min_time;    /*!< Minimum wall time of timed iterations [s] */
+  FILE *out;          /*!< Output stream for results */
+} BenchConfig;
+
+
+/**
+  Runs one operation.  `state` is the pointer returned by `setup`.
+  Should assign `*nbytes` to the number of bytes processed (it is
+  initialised to zero).  Returns non-zero on error.
+*/
+typedef int (*BenchRun)(void *state, size_t *nbytes);
+
+/** Returns a new state for the benchmark or NULL on error. */
+typedef void *(*BenchSetup)(const BenchConfig *cfg);
+
+/** Releases state returned by the setup function. */
+typedef void (*BenchTeardown)(void *state);
+
+
+/** Describes a benchmark. */
+typedef struct {
+  const char *name;        /*!< Name of benchmark */
+  const char *descr;       /*!< Short description */
+  BenchSetup setup;        /*!< Optional setup function */
+  BenchRun run;            /*!< Function to benchmark */
+  BenchTeardown teardown;  /*!< Optional teardown function */
+} Benchmark;
+
+
+/** Returns a monotonic wall time in seconds. */
+double bench_time(void);
+
+/** Returns peak resident set size of this process in kB or 0 if
+    not available. */
+long bench_peak_rss(void);
+
+/**
+  Runs benchmark `b` with configuration `cfg` and writes the result
+  as a line of JSON to `cfg->out`.
+
+  Returns non-zero on error.
+*/
+int bench_run(const Benchmark *b, const BenchConfig *cfg);
+
+
+#endif  /* _BENCH_H */
@@ -0,0 +1,778 @@
+/* dlite-bench.c -- micro- and macro-benchmarks of core DLite code paths
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "config.h"
+
+#include "utils/compat-src/getopt.h"
+#include "utils/err.h"
+#include "utils/globmatch.h"
+#include "utils/rng.h"
+#include "dlite.h"
+#include "dlite-json.h"
+#include "dlite-bson.h"
+#include "triplestore.h"
+#include "bench.h"
+
+#define BENCH_MAXDIMS 8
+#define BENCH_URI "http://onto-ns.com/meta/dlite/0.1/BenchEntity"
+#define BENCH_ID "bench-instance"
+
+
+/* Synthetic metadata and its dimension sizes.  Shared by all
+   benchmarks. */
+static DLiteMeta *bench_meta=NULL;
+static size_t bench_dims[BENCH_MAXDIMS];
+
+/* Benchmark state. */
+typedef struct {
+  const BenchConfig *cfg;
+  DLiteInstance *inst;   /* synthetic instance */
+  char *str;             /* serialised instance */
+  unsigned char *doc;    /* bson document */
+  size_t len;            /* length of `str` or `doc` */
+  void *buf;             /* scratch buffer */
+  TripleStore *ts;       /* triplestore */
+  size_t ntriples;       /* number of triples in benchmarks on `ts` */
+  size_t count;          /* counter */
+  const char *driver;    /* storage driver */
+  char path[64];         /* storage path */
+} State;
+
+
+/* Creates metadata with `ndims` dimensions whose array properties have
+   approximately `size` elements.  Updates `cfg->size` to the actual
+   number of elements. */
+static DLiteMeta *create_meta(BenchConfig *cfg)
+{
+  char names[BENCH_MAXDIMS][8], *shape[BENCH_MAXDIMS];
+  DLiteDimension dims[BENCH_MAXDIMS];
+  size_t i, n=1, d;
+  d = (size_t)floor(pow((double)cfg->size, 1.0/cfg->ndims) + 0.5);
+  if (d < 1) d = 1;
+  for (i=0; i<(size_t)cfg->ndims; i++) {
+    snprintf(names[i], sizeof(names[i]), "D%d", (int)i);
+    dims[i].name = names[i];
+    dims[i].description = "Synthetic dimension.";
+    shape[i] = names[i];
+    bench_dims[i] = d;
+    n *= d;
+  }
+  cfg->size = n;
+  {
+    DLiteProperty props[] = {
+      /* name    type            size             ref   ndims  shape  unit descr */
+      {"label",  dliteStringPtr, sizeof(char *),  NULL, 0,     NULL,  "",  "Label."},
+      {"weight", dliteFloat,     sizeof(double),  NULL, 0,     NULL,  "kg","Weight."},
+      {"f64",    dliteFloat,     sizeof(double),  NULL, 0,     shape, "m", "Floats."},
+      {"i32",    dliteInt,       sizeof(int32_t), NULL, 0,     shape, "",  "Integers."},
+      {"mask",   dliteBool,      sizeof(bool),    NULL, 1,     shape, "",  "Flags."},
+      {"names",  dliteStringPtr, sizeof(char *),  NULL, 1,     shape, "",  "Names."},
+    };
+    props[2].ndims = cfg->ndims;
+    props[3].ndims = cfg->ndims;
+    return dlite_meta_create(BENCH_URI, "Synthetic entity for benchmarks.",
+                             cfg->ndims, dims,
+                             sizeof(props) / sizeof(props[0]), props);
+  }
+}
+
+/* Returns a new instance of `bench_meta` filled with reproducible
+   pseudo-random data. */
+static DLiteInstance *create_instance(const BenchConfig *cfg, const char *id)
+{
+  DLiteInstance *inst;
+  MSWS64State rng;
+  double *f64;
+  int32_t *i32;
+  bool *mask;
+  char **names, buf[32];
+  size_t i, n=cfg->size, d0=bench_dims[0];
+
+  if (!(inst = dlite_instance_create(bench_meta, bench_dims, id)))
+    return NULL;
+  srand_msws64_r(&rng, cfg->seed);
+  *(char **)dlite_instance_get_property(inst, "label") =
+    strdup("synthetic instance");
+  *(double *)dlite_instance_get_property(inst, "weight") = 42.5;
+  f64 = dlite_instance_get_property(inst, "f64");
+  i32 = dlite_instance_get_property(inst, "i32");
+  mask = dlite_instance_get_property(inst, "mask");
+  names = dlite_instance_get_property(inst, "names");
+  for (i=0; i<n; i++) {
+    f64[i] = (drand_msws64_r(&rng) - 0.5) * 1e4;
+    i32[i] = (int32_t)(rand_msws64_r(&rng) % 2000000) - 1000000;
+  }
+  for (i=0; i<d0; i++) {
+    mask[i] = rand_msws64_r(&rng) & 1;
+    snprintf(buf, sizeof(buf), "name-%lu", (unsigned long)i);
+    names[i] = strdup(buf);
+  }
+  return inst;
+}
+
+/* Returns the number of bytes of array data in an instance. */
+static size_t payload(const BenchConfig *cfg)
+{
+  return cfg->size * (sizeof(double) + sizeof(int32_t));
+}
+
+
+/* Generic setup/teardown */
+
+/* Returns a new empty state. */
+static void *setup_state(const BenchConfig *cfg)
+{
+  State *s = calloc(1, sizeof(State));
+  if (!s) return err(1, "allocation failure"), NULL;
+  s->cfg = cfg;
+  return s;
+}
+
+/* Returns a new state with a synthetic instance. */
+static void *setup(const BenchConfig *cfg)
+{
+  State *s = setup_state(cfg);
+  if (!s) return NULL;
+  if (!(s->inst = create_instance(cfg, NULL))) {
+    free(s);
+    return NULL;
+  }
+  return s;
+}
+
+static void teardown(void *state)
+{
+  State *s = state;
+  if (s->inst) dlite_instance_decref(s->inst);
+  if (s->ts) triplestore_free(s->ts);
+  if (s->path[0]) remove(s->path);
+  free(s->str);
+  free(s->doc);
+  free(s->buf);
+  free(s);
+}
+
+
+/* Instances */
+
+static int run_instance_create(void *state, size_t *nbytes)
+{
+  DLiteInstance *inst = dlite_instance_create(bench_meta, bench_dims, NULL);
+  (void)state;
+  (void)nbytes;
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  return 0;
+}
+
+static int run_instance_copy(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteInstance *inst = dlite_instance_copy(s->inst, NULL);
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+/* Snapshots the instance and modifies a scalar property, like a
+   simulation step.  The arrays are shared with the snapshot. */
+static int run_instance_snapshot(void *state, size_t *nbytes)
+{
+  State *s = state;
+  double weight = (double)s->count++;
+  if (dlite_instance_snapshot(s->inst)) return 1;
+  if (dlite_instance_set_property(s->inst, "weight", &weight)) return 1;
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+/* Fills a new instance one row at a time along the first dimension,
+   either with dlite_instance_append_rows_by_index() or by resizing. */
+static int instance_fill_rows(State *s, size_t *nbytes, int append)
+{
+  size_t dims[BENCH_MAXDIMS], i, j, nrows=bench_dims[0], rowsize;
+  DLiteInstance *inst;
+  double *f64;
+  int retval=1;
+  memcpy(dims, bench_dims, sizeof(dims));
+  dims[0] = 0;
+  rowsize = s->cfg->size / nrows;
+  if (!(inst = dlite_instance_create(bench_meta, dims, NULL))) return 1;
+  for (i=0; i<nrows; i++) {
+    if (append) {
+      if (dlite_instance_append_rows_by_index(inst, 0, 1)) goto fail;
+    } else {
+      if (dlite_instance_set_dimension_size_by_index(inst, 0, i+1)) goto fail;
+    }
+    f64 = dlite_instance_get_property(inst, "f64");
+    for (j=0; j<rowsize; j++) f64[i*rowsize + j] = (double)j;
+  }
+  *nbytes = payload(s->cfg);
+  retval = 0;
+ fail:
+  dlite_instance_decref(inst);
+  return retval;
+}
+
+static int run_instance_resize_rows(void *state, size_t *nbytes)
+{
+  return instance_fill_rows(state, nbytes, 0);
+}
+
+static int run_instance_append_rows(void *state, size_t *nbytes)
+{
+  return instance_fill_rows(state, nbytes, 1);
+}
+
+static int run_uuid_from_uri(void *state, size_t *nbytes)
+{
+  char uuid[DLITE_UUID_LENGTH+1];
+  (void)state;
+  (void)nbytes;
+  return (dlite_get_uuid(uuid, bench_meta->uri) < 0) ? 1 : 0;
+}
+
+/* Returns a new state with a hash cached synthetic instance.  The
+   instance returned by create_instance() is filled through writable
+   pointers and its properties would always be rehashed, so a copy of
+   it is used instead. */
+static void *setup_hash(const BenchConfig *cfg)
+{
+  State *s = setup(cfg);
+  DLiteInstance *copy;
+  if (!s) return NULL;
+  if (!(copy = dlite_instance_copy(s->inst, NULL))) {
+    teardown(s);
+    return NULL;
+  }
+  dlite_instance_decref(s->inst);
+  s->inst = copy;
+  if (dlite_instance_set_hash_cache(s->inst, 1)) {
+    teardown(s);
+    return NULL;
+  }
+  return s;
+}
+
+/* Like setup_hash(), but lets snapshots share the instance arrays. */
+static void *setup_snapshot(const BenchConfig *cfg)
+{
+  State *s = setup_hash(cfg);
+  if (s && dlite_instance_set_shared_snapshots(s->inst, 1)) {
+    teardown(s);
+    return NULL;
+  }
+  return s;
+}
+
+/* Hashes an unmodified instance, which is served from the hash cache
+   after the first call. */
+static int run_instance_hash(void *state, size_t *nbytes)
+{
+  State *s = state;
+  uint8_t hash[DLITE_HASH_SIZE];
+  if (dlite_instance_get_hash(s->inst, hash, sizeof(hash))) return 1;
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+/* Modifies one property and rehashes the instance with algorithm `alg`. */
+static int instance_rehash(State *s, size_t *nbytes, DLiteHashAlgorithm alg)
+{
+  uint8_t hash[DLITE_HASH_SIZE];
+  double weight = (double)s->count++;
+  if (dlite_instance_set_property(s->inst, "weight", &weight)) return 1;
+  if (dlite_instance_get_hash_alg(s->inst, hash, sizeof(hash), alg)) return 1;
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+/* Hashes all properties of the instance with algorithm `alg`. */
+static int instance_hash_full(State *s, size_t *nbytes, DLiteHashAlgorithm alg)
+{
+  uint8_t hash[DLITE_HASH_SIZE];
+  dlite_instance_mark_modified(s->inst, -1);
+  if (dlite_instance_get_hash_alg(s->inst, hash, sizeof(hash), alg)) return 1;
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+static int run_instance_rehash(void *state, size_t *nbytes)
+{
+  return instance_rehash(state, nbytes, dliteHashSha3);
+}
+
+static int run_instance_rehash_fast(void *state, size_t *nbytes)
+{
+  return instance_rehash(state, nbytes, dliteHashFast);
+}
+
+static int run_instance_rehash_tree(void *state, size_t *nbytes)
+{
+  return instance_rehash(state, nbytes, dliteHashSha3Tree);
+}
+
+static int run_instance_hash_full(void *state, size_t *nbytes)
+{
+  return instance_hash_full(state, nbytes, dliteHashSha3);
+}
+
+static int run_instance_hash_full_fast(void *state, size_t *nbytes)
+{
+  return instance_hash_full(state, nbytes, dliteHashFast);
+}
+
+static int run_instance_hash_full_tree(void *state, size_t *nbytes)
+{
+  return instance_hash_full(state, nbytes, dliteHashSha3Tree);
+}
+
+
+/* JSON */
+
+static int run_json_print(void *state, size_t *nbytes)
+{
+  State *s = state;
+  char *str = dlite_json_aprint(s->inst, 0, 0);
+  if (!str) return 1;
+  *nbytes = strlen(str);
+  free(str);
+  return 0;
+}
+
+/* The source instance is released, since the parser otherwise would
+   return a new reference to it. */
+static void *setup_json_scan(const BenchConfig *cfg)
+{
+  State *s = setup(cfg);
+  if (!s) return NULL;
+  if (!(s->str = dlite_json_aprint(s->inst, 0, 0))) {
+    teardown(s);
+    return NULL;
+  }
+  s->len = strlen(s->str);
+  dlite_instance_decref(s->inst);
+  s->inst = NULL;
+  return s;
+}
+
+static int run_json_scan(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteInstance *inst = dlite_json_sscan(s->str, NULL, NULL);
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  *nbytes = s->len;
+  return 0;
+}
+
+
+/* BSON */
+
+static int run_bson_from_instance(void *state, size_t *nbytes)
+{
+  State *s = state;
+  unsigned char *doc = dlite_bson_from_instance(s->inst, nbytes);
+  if (!doc) return 1;
+  free(doc);
+  return 0;
+}
+
+static void *setup_bson_load(const BenchConfig *cfg)
+{
+  State *s = setup(cfg);
+  if (!s) return NULL;
+  if (!(s->doc = dlite_bson_from_instance(s->inst, &s->len))) {
+    teardown(s);
+    return NULL;
+  }
+  dlite_instance_decref(s->inst);
+  s->inst = NULL;
+  return s;
+}
+
+static int run_bson_load(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteInstance *inst = dlite_bson_load_instance(s->doc);
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  *nbytes = s->len;
+  return 0;
+}
+
+static int run_bson_load_borrowed(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteInstance *inst = dlite_bson_load_instance_borrowed(s->doc, NULL);
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  *nbytes = s->len;
+  return 0;
+}
+
+
+/* Type casting */
+
+static void *setup_ndcast(const BenchConfig *cfg)
+{
+  State *s = setup(cfg);
+  if (!s) return NULL;
+  if (!(s->buf = malloc(cfg->size * sizeof(double)))) {
+    teardown(s);
+    return err(1, "allocation failure"), NULL;
+  }
+  return s;
+}
+
+static int run_ndcast_float(void *state, size_t *nbytes)
+{
+  State *s = state;
+  void *src = dlite_instance_get_property(s->inst, "f64");
+  if (dlite_type_ndcast(s->cfg->ndims,
+                        s->buf, dliteFloat, sizeof(float), bench_dims, NULL,
+                        src, dliteFloat, sizeof(double), bench_dims, NULL,
+                        NULL)) return 1;
+  *nbytes = s->cfg->size * sizeof(double);
+  return 0;
+}
+
+/* Copies to Fortran order. */
+static int run_ndcast_transpose(void *state, size_t *nbytes)
+{
+  State *s = state;
+  void *src = dlite_instance_get_property(s->inst, "f64");
+  int i, strides[BENCH_MAXDIMS];
+  for (i=0; i<s->cfg->ndims; i++)
+    strides[i] = (i) ? strides[i-1] * (int)bench_dims[i-1] : (int)sizeof(double);
+  if (dlite_type_ndcast(s->cfg->ndims,
+                        s->buf, dliteFloat, sizeof(double), bench_dims, strides,
+                        src, dliteFloat, sizeof(double), bench_dims, NULL,
+                        NULL)) return 1;
+  *nbytes = s->cfg->size * sizeof(double);
+  return 0;
+}
+
+
+/* Triplestore */
+
+/* Number of triples in triplestore benchmarks. */
+static size_t ntriples(const BenchConfig *cfg)
+{
+  size_t n = cfg->size / 10;
+  return (n) ? n : 1;
+}
+
+static int add_triples(TripleStore *ts, size_t n)
+{
+  char sub[32], pred[32], obj[32];
+  size_t i;
+  for (i=0; i<n; i++) {
+    snprintf(sub, sizeof(sub), ":s%lu", (unsigned long)i);
+    snprintf(pred, sizeof(pred), ":p%lu", (unsigned long)(i % 16));
+    snprintf(obj, sizeof(obj), ":o%lu", (unsigned long)(i / 2));
+    if (triplestore_add(ts, sub, pred, obj, NULL)) return 1;
+  }
+  return 0;
+}
+
+static int run_triplestore_add(void *state, size_t *nbytes)
+{
+  State *s = state;
+  TripleStore *ts = triplestore_create();
+  int stat;
+  (void)nbytes;
+  if (!ts) return 1;
+  stat = add_triples(ts, ntriples(s->cfg));
+  triplestore_free(ts);
+  return stat;
+}
+
+static void *setup_triplestore_find(const BenchConfig *cfg)
+{
+  State *s = setup_state(cfg);
+  if (!s) return NULL;
+  s->ntriples = ntriples(cfg);
+  if (!(s->ts = triplestore_create()) || add_triples(s->ts, s->ntriples)) {
+    teardown(s);
+    return NULL;
+  }
+  return s;
+}
+
+/* Looks up one triple by subject. */
+static int run_triplestore_find(void *state, size_t *nbytes)
+{
+  State *s = state;
+  char sub[32];
+  (void)nbytes;
+  snprintf(sub, sizeof(sub), ":s%lu",
+           (unsigned long)((s->count++ * 7919) % s->ntriples));
+  return (triplestore_find_first(s->ts, sub, NULL, NULL, NULL)) ? 0 : 1;
+}
+
+
+/* Storages */
+
+static void *setup_storage(const BenchConfig *cfg, const char *driver,
+                           const char *ext, int load)
+{
+  State *s = setup_state(cfg);
+  DLiteStorage *st;
+  if (!s) return NULL;
+  s->driver = driver;
+  snprintf(s->path, sizeof(s->path), "dlite-bench-data.%s", ext);
+  if (!(s->inst = create_instance(cfg, BENCH_ID))) goto fail;
+  if (load) {
+    if (!(st = dlite_storage_open(driver, s->path, "mode=w"))) goto fail;
+    if (dlite_instance_save(st, s->inst)) {
+      dlite_storage_close(st);
+      goto fail;
+    }
+    if (dlite_storage_close(st)) goto fail;
+    dlite_instance_decref(s->inst);
+    s->inst = NULL;
+  }
+  return s;
+ fail:
+  teardown(s);
+  return NULL;
+}
+
+static int run_storage_save(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteStorage *st = dlite_storage_open(s->driver, s->path, "mode=w");
+  int stat;
+  if (!st) return 1;
+  stat = dlite_instance_save(st, s->inst);
+  if (dlite_storage_close(st)) stat = 1;
+  *nbytes = payload(s->cfg);
+  return stat;
+}
+
+static int run_storage_load(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteStorage *st = dlite_storage_open(s->driver, s->path, "mode=r");
+  DLiteInstance *inst;
+  if (!st) return 1;
+  inst = dlite_instance_load(st, BENCH_ID);
+  dlite_storage_close(st);
+  if (!inst) return 1;
+  dlite_instance_decref(inst);
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+/* Loads an instance with dlite_instance_load_loc(), which reuses a
+   pooled storage handle. */
+static int run_storage_load_loc(void *state, size_t *nbytes)
+{
+  State *s = state;
+  DLiteInstance *inst;
+  if (!(inst = dlite_instance_load_loc(s->driver, s->path, NULL, BENCH_ID)))
+    return 1;
+  dlite_instance_decref(inst);
+  *nbytes = payload(s->cfg);
+  return 0;
+}
+
+static void *setup_json_save(const BenchConfig *cfg)
+{
+  return setup_storage(cfg, "json", "json", 0);
+}
+
+static void *setup_json_load(const BenchConfig *cfg)
+{
+  return setup_storage(cfg, "json", "json", 1);
+}
+
+#ifdef WITH_HDF5
+static void *setup_hdf5_save(const BenchConfig *cfg)
+{
+  return setup_storage(cfg, "hdf5", "h5", 0);
+}
+
+static void *setup_hdf5_load(const BenchConfig *cfg)
+{
+  return setup_storage(cfg, "hdf5", "h5", 1);
+}
+#endif
+
+
+static Benchmark benchmarks[] = {
+  {"instance_create", "Create and free an instance",
+   setup, run_instance_create, teardown},
+  {"instance_copy", "Copy an instance",
+   setup, run_instance_copy, teardown},
+  {"instance_snapshot", "Snapshot an instance and modify a scalar property",
+   setup_snapshot, run_instance_snapshot, teardown},
+  {"instance_resize_rows", "Fill an instance row by row, resizing it",
+   setup_state, run_instance_resize_rows, teardown},
+  {"instance_append_rows", "Fill an instance row by row, appending rows",
+   setup_state, run_instance_append_rows, teardown},
+  {"uuid_from_uri", "Derive the UUID of a metadata URI",
+   setup_state, run_uuid_from_uri, teardown},
+  {"instance_hash", "Hash an unmodified instance",
+   setup_hash, run_instance_hash, teardown},
+  {"instance_rehash", "Modify a scalar property and rehash an instance",
+   setup_hash, run_instance_rehash, teardown},
+  {"instance_rehash_fast",
+   "Modify a scalar property and rehash an instance with the fast hash",
+   setup_hash, run_instance_rehash_fast, teardown},
+  {"instance_rehash_tree",
+   "Modify a scalar property and rehash an instance with the sha3 tree hash",
+   setup_hash, run_instance_rehash_tree, teardown},
+  {"instance_hash_full", "Hash all properties of an instance",
+   setup_hash, run_instance_hash_full, teardown},
+  {"instance_hash_full_fast",
+   "Hash all properties of an instance with the fast hash",
+   setup_hash, run_instance_hash_full_fast, teardown},
+  {"instance_hash_full_tree",
+   "Hash all properties of an instance with the sha3 tree hash",
+   setup_hash, run_instance_hash_full_tree, teardown},
+  {"json_print", "Serialise an instance to JSON",
+   setup, run_json_print, teardown},
+  {"json_scan", "Parse an instance from JSON",
+   setup_json_scan, run_json_scan, teardown},
+  {"bson_from_instance", "Serialise an instance to BSON",
+   setup, run_bson_from_instance, teardown},
+  {"bson_load", "Parse an instance from BSON",
+   setup_bson_load, run_bson_load, teardown},
+  {"bson_load_borrowed", "Parse an instance from BSON without copying arrays",
+   setup_bson_load, run_bson_load_borrowed, teardown},
+  {"ndcast_float", "Cast float64 array to float32",
+   setup_ndcast, run_ndcast_float, teardown},
+  {"ndcast_transpose", "Copy float64 array to Fortran order",
+   setup_ndcast, run_ndcast_transpose, teardown},
+  {"triplestore_add", "Populate a triplestore with size/10 triples",
+   setup_state, run_triplestore_add, teardown},
+  {"triplestore_find", "Look up a triple by subject",
+   setup_triplestore_find, run_triplestore_find, teardown},
+  {"storage_json_save", "Save an instance to JSON storage",
+   setup_json_save, run_storage_save, teardown},
+  {"storage_json_load", "Load an instance from JSON storage",
+   setup_json_load, run_storage_load, teardown},
+  {"storage_json_load_loc",
+   "Load an instance from JSON storage with dlite_instance_load_loc()",
+   setup_json_load, run_storage_load_loc, teardown},
+#ifdef WITH_HDF5
+  {"storage_hdf5_save", "Save an instance to HDF5 storage",
+   setup_hdf5_save, run_storage_save, teardown},
+  {"storage_hdf5_load", "Load an instance from HDF5 storage",
+   setup_hdf5_load, run_storage_load, teardown},
+#endif
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+
+static void help(void)
+{
+  char **p, *msg[] = {
+    "Usage: dlite-bench [OPTIONS] [PATTERN...]",
+    "Runs benchmarks of core DLite code paths on synthetic data.",
+    "  -d, --ndims=N       Number of dimensions of synthetic arrays (1-8).",
+    "                      Default: 2.",
+    "  -h, --help          Prints this help and exit.",
+    "  -i, --iterations=N  Minimum number of timed iterations. Default: 5.",
+    "  -l, --list          List available benchmarks and exit.",
+    "  -n, --size=N        Approximate number of elements in synthetic",
+    "                      arrays. Default: 100000.",
+    "  -o, --output=FILE   Write results to FILE instead of stdout.",
+    "  -s, --seed=N        Seed for synthetic data. Default: 1.",
+    "  -t, --time=SEC      Minimum time to run each benchmark. Default: 0.5.",
+    "",
+    "If PATTERN is given, only benchmarks whose name match any of the",
+    "glob patterns are run.",
+    "",
+    "The results are written as one line of JSON per benchmark with the",
+    "fields: name, size, ndims, iterations, seconds, ops_per_sec,",
+    "bytes_per_sec and peak_rss_kb.",
+    NULL
+  };
+  for (p=msg; *p; p++) printf("%s\n", *p);
+}
+
+
+int main(int argc, char *argv[])
+{
+  BenchConfig cfg = {100000, 2, 1, 5, 0.5, NULL};
+  Benchmark *b;
+  char *output=NULL;
+  int i, list=0, retval=0;
+
+  err_set_prefix("dlite-bench");
+
+  /* Parse options and arguments */
+  while (1) {
+    int longindex = 0;
+    struct option longopts[] = {
+      {"ndims",            1, NULL, 'd'},
+      {"help",             0, NULL, 'h'},
+      {"iterations",       1, NULL, 'i'},
+      {"list",             0, NULL, 'l'},
+      {"size",             1, NULL, 'n'},
+      {"output",           1, NULL, 'o'},
+      {"seed",             1, NULL, 's'},
+      {"time",             1, NULL, 't'},
+      {NULL, 0, NULL, 0}
+    };
+    int c = getopt_long(argc, argv, "d:hi:ln:o:s:t:", longopts, &longindex);
+    if (c == -1) break;
+    switch (c) {
+    case 'd':  cfg.ndims = atoi(optarg); break;
+    case 'h':  help(); exit(0);
+    case 'i':  cfg.min_iter = strtoul(optarg, NULL, 0); break;
+    case 'l':  list = 1; break;
+    case 'n':  cfg.size = strtoul(optarg, NULL, 0); break;
+    case 'o':  output = optarg; break;
+    case 's':  cfg.seed = strtoul(optarg, NULL, 0); break;
+    case 't':  cfg.min_time = atof(optarg); break;
+    case '?':  exit(1);
+    default:   abort();
+    }
+  }
+  if (cfg.ndims < 1 || cfg.ndims > BENCH_MAXDIMS)
+    return errx(1, "--ndims must be in range [1, %d]", BENCH_MAXDIMS);
+  if (cfg.size < 1)
+    return errx(1, "--size must be positive");
+
+  if (list) {
+    for (b=benchmarks; b->name; b++) printf("%-20s %s\n", b->name, b->descr);
+    return 0;
+  }
+
+  if (!output)
+    cfg.out = stdout;
+  else if (!(cfg.out = fopen(output, "w")))
+    return err(1, "cannot open output file: %s", output);
+
+  if (!(bench_meta = create_meta(&cfg))) {
+    retval = 1;
+    goto done;
+  }
+
+  for (b=benchmarks; b->name; b++) {
+    if (optind < argc) {
+      for (i=optind; i<argc; i++)
+        if (globmatch(argv[i], b->name) == 0) break;
+      if (i == argc) continue;
+    }
+    if (bench_run(b, &cfg)) retval = 1;
+  }
+
+ done:
+  if (bench_meta) dlite_meta_decref(bench_meta);
+  if (cfg.out != stdout) fclose(cfg.out);
+  return retval;
+}
@@ -15,32 +15,10 @@
 
 
 
-#define APPEND(buf, type, ename, size, data)                            \
+#define WRITE(call)                                                     \
   do {                                                                  \
-    int m = bson_append(buf, bufsize-n, type, ename, size, data);       \
-    if (m < 0) return m;                                                \
-    n += m;                                                             \
-  } while (0)
-
-#define APPEND_PROPERTY(buf, p, shape, ptr)                              \
-  do {                                                                  \
-    int m = append_property(buf, bufsize-n, p, shape, ptr);              \
-    if (m < 0) return m;                                                \
-    n += m;                                                             \
-  } while (0)
-
-#define BEGIN_SUBDOC(buf, ename, subdoc)                                \
-  do {                                                                  \
-    int m = bson_begin_subdoc(buf, bufsize-n, ename, subdoc);           \
-    if (m < 0) return m;                                                \
-    n += m;                                                             \
-  } while (0)
-
-#define END_SUBDOC(buf, type)                                           \
-  do {                                                                  \
-    int m = bson_end_subdoc(buf, bufsize-n, type);                      \
-    if (m < 0) return m;                                                \
-    n += m;                                                             \
+    int stat = (call);                                                  \
+    if (stat) return stat;                                              \
   } while (0)
 
 
@@ -77,27 +55,21 @@ static BsonType bsontype(DLiteType dtype, size_t size)
 
 
 /*
-  Append DLite property to BSON document.
+  Write DLite property to the current document of `w`.
 
   Arrays are serialised as binary blobs in host byte order.
 
   Arguments:
-    - buf: Pointer to a BSON document to append data to.  The memory pointed
-        to must have been initialised with bson_init_document().
-    - bufsize: Size of memory segment pointed to by `buf`.  No more than
-        `bufsize` bytes will be written.
-    - p: Property to append.
+    - w: BSON writer.
+    - p: Property to write.
     - shape: Values of property dimensions.
     - ptr: Pointer to data to serialise.
 
-  Returns:
-    Number of bytes appended (or would have been appended) to `buf`.
-    A negative error code is returned on error.
+  Returns non-zero on error.
  */
-static int append_property(unsigned char *buf, int bufsize,
-                           DLiteProperty *p, size_t *shape, void *ptr)
+static int write_property(BsonWriter *w, DLiteProperty *p, size_t *shape,
+                          const void *ptr)
 {
-  int n=0;
   int32_t i32;
   int64_t i64;
   uint64_t u64;
@@ -109,8 +81,8 @@ static int append_property(unsigned char *buf, int bufsize,
   if (p->shape) {
 
     /* Array - treated as binary using host byte order */
-    int i, nmemb=1;
-    for (i=0; i < p->ndims; i++) nmemb *= shape[i];
+    size_t i, nmemb=1;
+    for (i=0; i < (size_t)p->ndims; i++) nmemb *= shape[i];
     switch (p->type) {
     case dliteBlob:
     case dliteBool:
@@ -118,41 +90,25 @@ static int append_property(unsigned char *buf, int bufsize,
     case dliteUInt:
     case dliteFloat:
     case dliteFixString:
-      APPEND(buf, bsonBinary, p->name, p->size*nmemb, ptr);
+      WRITE(bson_writer_append(w, bsonBinary, p->name, p->size*nmemb, ptr));
       break;
 
     case dliteStringPtr:
-      {
-        unsigned char *subdoc;
-        int m;
-        if ((m = bson_begin_binary(buf, bufsize-n, p->name, &subdoc)) < 0)
-          return m;
-        n += m;
-        for (i=0; i<nmemb; i++) {
-          char *s = ((char **)ptr)[i];
-          if ((m = bson_append_binary(subdoc, bufsize-n, strlen(s)+1, s)) < 0)
-            return m;
-          n += m;
-        }
-        if ((m = bson_end_binary(buf, bufsize-n)) < 0) return m;
+      WRITE(bson_writer_begin_binary(w, p->name));
+      for (i=0; i<nmemb; i++) {
+        char *s = ((char **)ptr)[i];
+        WRITE(bson_writer_append_binary(w, strlen(s)+1, s));
       }
+      WRITE(bson_writer_end_binary(w));
       break;
 
     case dliteRef:
-      {
-        unsigned char *subdoc;
-        int m;
-        if ((m = bson_begin_binary(buf, bufsize-n, p->name, &subdoc)) < 0)
-          return m;
-        n += m;
-        for (i=0; i<nmemb; i++) {
-          char *uuid = ((DLiteInstance **)ptr)[i]->uuid;
-          if ((m = bson_append_binary(subdoc, bufsize-n, DLITE_UUID_LENGTH+1,
-                                      uuid)) < 0) return m;
-          n += m;
-        }
-        if ((m = bson_end_binary(buf, bufsize-n)) < 0) return m;
+      WRITE(bson_writer_begin_binary(w, p->name));
+      for (i=0; i<nmemb; i++) {
+        char *uuid = ((DLiteInstance **)ptr)[i]->uuid;
+        WRITE(bson_writer_append_binary(w, DLITE_UUID_LENGTH+1, uuid));
       }
+      WRITE(bson_writer_end_binary(w));
       break;
 
     case dliteDimension:
@@ -162,13 +118,12 @@ static int append_property(unsigned char *buf, int bufsize,
 
     case dliteRelation:
       for (i=0; i<nmemb; i++) {
-        unsigned char *subdoc;
         DLiteRelation rel = *((DLiteRelation *)ptr + i);
-        BEGIN_SUBDOC(buf, p->name, &subdoc);
-        APPEND(subdoc, bsonString, "s", -1, rel.s);
-        APPEND(subdoc, bsonString, "p", -1, rel.p);
-        APPEND(subdoc, bsonString, "o", -1, rel.o);
-        END_SUBDOC(buf, bsonDocument);
+        WRITE(bson_writer_begin_subdoc(w, p->name, bsonDocument));
+        WRITE(bson_writer_append(w, bsonString, "s", -1, rel.s));
+        WRITE(bson_writer_append(w, bsonString, "p", -1, rel.p));
+        WRITE(bson_writer_append(w, bsonString, "o", -1, rel.o));
+        WRITE(bson_writer_end_subdoc(w));
       }
       break;
     }
@@ -178,11 +133,11 @@ static int append_property(unsigned char *buf, int bufsize,
     switch (p->type) {
 
     case dliteBlob:
-      APPEND(buf, bsonBinary, p->name, p->size, ptr);
+      WRITE(bson_writer_append(w, bsonBinary, p->name, p->size, ptr));
       break;
 
     case dliteBool:
-      APPEND(buf, bsonBool, p->name, p->size, ptr);
+      WRITE(bson_writer_append(w, bsonBool, p->name, p->size, ptr));
       break;
 
     case dliteInt:
@@ -195,9 +150,9 @@ static int append_property(unsigned char *buf, int bufsize,
         return errx(dliteValueError, "invalid integer size: %d", (int)p->size);
       }
       if (p->size <= 4)
-        APPEND(buf, bsonInt32, p->name, -1, &i32);
+        WRITE(bson_writer_append(w, bsonInt32, p->name, -1, &i32));
       else
-        APPEND(buf, bsonInt64, p->name, -1, &i64);
+        WRITE(bson_writer_append(w, bsonInt64, p->name, -1, &i64));
       break;
 
     case dliteUInt:
@@ -210,9 +165,9 @@ static int append_property(unsigned char *buf, int bufsize,
         return errx(dliteValueError, "invalid integer size: %d", (int)p->size);
       }
       if (p->size < 4)
-        APPEND(buf, bsonInt32, p->name, -1, &i32);
+        WRITE(bson_writer_append(w, bsonInt32, p->name, -1, &i32));
       else
-        APPEND(buf, bsonUInt64, p->name, -1, &u64);
+        WRITE(bson_writer_append(w, bsonUInt64, p->name, -1, &u64));
       break;
 
     case dliteFloat:
@@ -232,25 +187,25 @@ static int append_property(unsigned char *buf, int bufsize,
         return errx(dliteValueError, "invalid float size: %d", (int)p->size);
       }
       if (p->size <= 8)
-        APPEND(buf, bsonDouble, p->name, -1, &f64);
+        WRITE(bson_writer_append(w, bsonDouble, p->name, -1, &f64));
 #ifdef HAVE_FLOAT128
       else
-        APPEND(buf, bsonDecimal128, p->name, -1, &f128);
+        WRITE(bson_writer_append(w, bsonDecimal128, p->name, -1, &f128));
 #endif
       break;
 
     case dliteFixString:
-      APPEND(buf, bsonString, p->name, p->size, ptr);
+      WRITE(bson_writer_append(w, bsonString, p->name, p->size, ptr));
       break;
 
     case dliteStringPtr:
-      APPEND(buf, bsonString, p->name,
-             strlen(*((char **)ptr)), *((char **)ptr));
+      WRITE(bson_writer_append(w, bsonString, p->name,
+                               strlen(*((char **)ptr)), *((char **)ptr)));
       break;
 
     case dliteRef:
-      APPEND(buf, bsonString, p->name, p->size,
-             (*((DLiteInstance **)ptr))->uuid);
+      WRITE(bson_writer_append(w, bsonString, p->name, p->size,
+                               (*((DLiteInstance **)ptr))->uuid));
       break;
 
     case dliteDimension:
@@ -260,126 +215,198 @@ static int append_property(unsigned char *buf, int bufsize,
 
     case dliteRelation:
       {
-        unsigned char *subdoc;
         DLiteRelation rel = *((DLiteRelation *)ptr);
-        BEGIN_SUBDOC(buf, p->name, &subdoc);
-        APPEND(subdoc, bsonString, "s", -1, rel.s);
-        APPEND(subdoc, bsonString, "p", -1, rel.p);
-        APPEND(subdoc, bsonString, "o", -1, rel.o);
-        END_SUBDOC(buf, bsonDocument);
+        WRITE(bson_writer_begin_subdoc(w, p->name, bsonDocument));
+        WRITE(bson_writer_append(w, bsonString, "s", -1, rel.s));
+        WRITE(bson_writer_append(w, bsonString, "p", -1, rel.p));
+        WRITE(bson_writer_append(w, bsonString, "o", -1, rel.o));
+        WRITE(bson_writer_end_subdoc(w));
       }
     }
   }
-  return n;
+  return 0;
 }
 
 
 /*
-  Append instance to BSON document.
-
-  Arguments:
-    - buf: Pointer to a BSON document to append data to.  The memory pointed
-        to must have been initialised with bson_init_document().
-    - bufsize: Size of memory segment pointed to by `buf`.  No more than
-        `bufsize` bytes will be written.
-    - inst: DLite instance to append to BSON document.
+  Write the elements of instance `inst` to the current document of
+  BSON writer `w`.
 
-  Returns:
-    Number of bytes appended (or would have been appended) to `buf`.
-    A negative error code is returned on error.
+  Returns non-zero on error.
  */
-int dlite_bson_append_instance(unsigned char *buf, int bufsize,
-                               const DLiteInstance *inst)
+int dlite_bson_write_instance(BsonWriter *w, const DLiteInstance *inst)
 {
   size_t i;
-  int n=0, ismeta=dlite_instance_is_meta(inst);
-  unsigned char *subdoc, byteordering[]="\x01\x02\x03\x04";
+  int ismeta=dlite_instance_is_meta(inst);
+  unsigned char byteordering[]="\x01\x02\x03\x04";
 
-  APPEND(buf, bsonString, "uuid", DLITE_UUID_LENGTH, inst->uuid);
+  WRITE(bson_writer_append(w, bsonString, "uuid", DLITE_UUID_LENGTH,
+                           inst->uuid));
   if (inst->uri)
-    APPEND(buf, bsonString, "uri", -1, inst->uri);
-  APPEND(buf, bsonString, "meta", -1, inst->meta->uri);
+    WRITE(bson_writer_append(w, bsonString, "uri", -1, inst->uri));
+  WRITE(bson_writer_append(w, bsonString, "meta", -1, inst->meta->uri));
   if (inst->_parent) {
-    BEGIN_SUBDOC(buf, "parent", &subdoc);
-    APPEND(subdoc, bsonString, "uuid", DLITE_UUID_LENGTH, inst->_parent->uuid);
-    APPEND(subdoc, bsonBinary, "hash", DLITE_HASH_SIZE, inst->_parent->hash);
-    END_SUBDOC(buf, bsonDocument);
+    WRITE(bson_writer_begin_subdoc(w, "parent", bsonDocument));
+    WRITE(bson_writer_append(w, bsonString, "uuid", DLITE_UUID_LENGTH,
+                             inst->_parent->uuid));
+    WRITE(bson_writer_append(w, bsonBinary, "hash", DLITE_HASH_SIZE,
+                             inst->_parent->hash));
+    if (inst->_parent->hashalg != dliteHashSha3)
+      WRITE(bson_writer_append(w, bsonString, "hashalg", -1,
+                               dlite_hash_algorithm_name(
+                                 inst->_parent->hashalg)));
+    WRITE(bson_writer_end_subdoc(w));
   }
 
   /* Include host byte order. Since arrays are serialised in host byte order,
      this makes it possible for the reader to determine whether to byteswap
      array data. */
-  APPEND(buf, bsonString, "byteorder", -1,
-         (*((uint32_t *)&byteordering) == 0x04030201) ? "LE" : "BE");
+  WRITE(bson_writer_append(w, bsonString, "byteorder", -1,
+                           (*((uint32_t *)&byteordering) == 0x04030201) ?
+                           "LE" : "BE"));
 
   if (ismeta) {
     /* metadata */
     DLiteMeta *meta = (DLiteMeta *)inst;
-    char *descr = *((char **)dlite_instance_get_property(inst, "description"));
-    if (descr) APPEND(buf, bsonString, "description", -1, descr);
+    char *descr =
+      *((char *const *)dlite_instance_get_property_const(inst, "description"));
+    if (descr)
+      WRITE(bson_writer_append(w, bsonString, "description", -1, descr));
 
-    BEGIN_SUBDOC(buf, "dimension_values", &subdoc);
+    WRITE(bson_writer_begin_subdoc(w, "dimension_values", bsonDocument));
     for (i=0; i < inst->meta->_ndimensions; i++) {
       int32_t v = DLITE_DIM(inst, i);
-      APPEND(subdoc, bsonInt32, inst->meta->_dimensions[i].name, 4, &v);
+      WRITE(bson_writer_append(w, bsonInt32, inst->meta->_dimensions[i].name,
+                               4, &v));
     }
-    END_SUBDOC(buf, bsonDocument);
+    WRITE(bson_writer_end_subdoc(w));
 
-    BEGIN_SUBDOC(buf, "dimensions", &subdoc);
+    WRITE(bson_writer_begin_subdoc(w, "dimensions", bsonDocument));
     for (i=0; i < meta->_ndimensions; i++) {
       DLiteDimension *d = meta->_dimensions + i;
-      APPEND(subdoc, bsonString, d->name, -1, d->description);
+      WRITE(bson_writer_append(w, bsonString, d->name, -1, d->description));
     }
-    END_SUBDOC(buf, bsonDocument);
+    WRITE(bson_writer_end_subdoc(w));
 
-    BEGIN_SUBDOC(buf, "properties", &subdoc);
+    WRITE(bson_writer_begin_subdoc(w, "properties", bsonDocument));
     for (i=0; i < meta->_nproperties; i++) {
-      unsigned char *prop;
       DLiteProperty *p = meta->_properties + i;
       char typename[32];
       dlite_type_set_typename(p->type, p->size, typename, sizeof(typename));
-      BEGIN_SUBDOC(subdoc, p->name, &prop);
-      APPEND(prop, bsonString, "type", -1, typename);
+      WRITE(bson_writer_begin_subdoc(w, p->name, bsonDocument));
+      WRITE(bson_writer_append(w, bsonString, "type", -1, typename));
       if (p->ref)
-        APPEND(prop, bsonString, "$ref", -1, p->ref);
+        WRITE(bson_writer_append(w, bsonString, "$ref", -1, p->ref));
       if (p->ndims) {
-        unsigned char *arr;
-        BEGIN_SUBDOC(prop, "shape", &arr);
         int j;
+        WRITE(bson_writer_begin_subdoc(w, "shape", bsonArray));
         for (j=0; j < p->ndims; j++) {
           char index[20];
           snprintf(index, sizeof(index), "%d", j);
-          APPEND(arr, bsonString, index, -1, p->shape[j]);
+          WRITE(bson_writer_append(w, bsonString, index, -1, p->shape[j]));
         }
-        END_SUBDOC(prop, bsonArray);
+        WRITE(bson_writer_end_subdoc(w));
       }
       if (p->unit && *p->unit)
-        APPEND(prop, bsonString, "unit", -1, p->unit);
+        WRITE(bson_writer_append(w, bsonString, "unit", -1, p->unit));
       if (p->description && *p->description)
-        APPEND(prop, bsonString, "description", -1, p->description);
-      END_SUBDOC(subdoc, bsonDocument);
+        WRITE(bson_writer_append(w, bsonString, "description", -1,
+                                 p->description));
+      WRITE(bson_writer_end_subdoc(w));
     }
-    END_SUBDOC(buf, bsonDocument);
+    WRITE(bson_writer_end_subdoc(w));
 
   } else {
     /* data */
-    BEGIN_SUBDOC(buf, "dimensions", &subdoc);
+    WRITE(bson_writer_begin_subdoc(w, "dimensions", bsonDocument));
     for (i=0; i < inst->meta->_ndimensions; i++) {
       int32_t v = DLITE_DIM(inst, i);
-      APPEND(subdoc, bsonInt32, inst->meta->_dimensions[i].name, 4, &v);
+      WRITE(bson_writer_append(w, bsonInt32, inst->meta->_dimensions[i].name,
+                               4, &v));
     }
-    END_SUBDOC(buf, bsonDocument);
+    WRITE(bson_writer_end_subdoc(w));
 
-    BEGIN_SUBDOC(buf, "properties", &subdoc);
+    WRITE(bson_writer_begin_subdoc(w, "properties", bsonDocument));
     for (i=0; i < inst->meta->_nproperties; i++) {
       DLiteProperty *p = inst->meta->_properties + i;
       size_t *shape = DLITE_PROP_DIMS(inst, i);
-      void *ptr = dlite_instance_get_property_by_index(inst, i);
-      APPEND_PROPERTY(subdoc, p, shape, ptr);
+      const void *ptr = dlite_instance_get_property_const_by_index(inst, i);
+      WRITE(write_property(w, p, shape, ptr));
+    }
+    WRITE(bson_writer_end_subdoc(w));
+  }
+  return 0;
+}
+
+
+/*
+  Append instance to BSON document.
+
+  This function is kept for backward compatibility.  It serialises
+  `inst` with a BsonWriter and copies the result to `buf`.
+
+  Arguments:
+    - buf: Pointer to a BSON document to append data to.  The memory pointed
+        to must have been initialised with bson_init_document().
+    - bufsize: Size of memory segment pointed to by `buf`.  No more than
+        `bufsize` bytes will be written.
+    - inst: DLite instance to append to BSON document.
+
+  Returns:
+    Number of bytes appended (or would have been appended) to `buf`.
+    A negative error code is returned on error.
+ */
+int dlite_bson_append_instance(unsigned char *buf, int bufsize,
+                               const DLiteInstance *inst)
+{
+  BsonWriter w;
+  const unsigned char *doc;
+  size_t size;
+  int docsize, n, stat;
+
+  bson_writer_init(&w);
+  if ((stat = bson_writer_begin_document(&w)) ||
+      (stat = dlite_bson_write_instance(&w, inst)) ||
+      (stat = bson_writer_end_document(&w))) {
+    bson_writer_deinit(&w);
+    return stat;
+  }
+  doc = bson_writer_get(&w, &size);
+
+  /* Number of bytes appended: the elements, excluding the header and
+     the terminating NUL of the document */
+  n = (int)size - 5;
+  if (bufsize >= n) {
+    if ((docsize = bson_docsize(buf)) < 0) {
+      bson_writer_deinit(&w);
+      return docsize;
     }
-    END_SUBDOC(buf, bsonDocument);
+    memcpy(buf + docsize - 1, doc + 4, n + 1);
+    *((int32_t *)buf) = htole32(docsize + n);
   }
+  bson_writer_deinit(&w);
+  return n;
+}
 
+
+/*
+  Returns an estimate of the size of the BSON representation of
+  `inst`.  Exact for fixed-size array data, which normally dominates.
+ */
+static size_t bson_size_hint(const DLiteInstance *inst)
+{
+  size_t i, j, n=256;
+  if (dlite_instance_is_meta(inst)) return 1024;
+  for (i=0; i < inst->meta->_nproperties; i++) {
+    DLiteProperty *p = inst->meta->_properties + i;
+    size_t nmemb=1, size=p->size;
+    if (p->ndims) {
+      size_t *shape = DLITE_PROP_DIMS(inst, i);
+      for (j=0; j < (size_t)p->ndims; j++) nmemb *= shape[j];
+    }
+    if (p->type == dliteStringPtr || p->type == dliteRelation) size = 16;
+    n += strlen(p->name) + 16 + nmemb * size;
+  }
   return n;
 }
 
@@ -395,20 +422,34 @@ int dlite_bson_append_instance(unsigned char *buf, int bufsize,
 unsigned char *dlite_bson_from_instance(const DLiteInstance *inst,
                                         size_t *size)
 {
-  unsigned char *doc=NULL;
-  int n, m, bufsize=0;
-  if ((n = bson_init_document(doc, bufsize)) < 0) goto fail;
-  if ((m = dlite_bson_append_instance(doc, bufsize, inst)) < 0) goto fail;
-  bufsize = n + m;
-  if (!(doc = malloc(bufsize)))
-    FAILCODE(dliteMemoryError, "allocation failure");
-  if (bson_init_document(doc, bufsize) < 0) goto fail;
-  if (dlite_bson_append_instance(doc, bufsize, inst) < 0) goto fail;
-  if (size) *size = bufsize;
-  return doc;
- fail:
-  if (doc) free(doc);
-  return NULL;
+  BsonWriter w;
+  bson_writer_init(&w);
+  if (bson_writer_reserve(&w, bson_size_hint(inst)) ||
+      bson_writer_begin_document(&w) ||
+      dlite_bson_write_instance(&w, inst) ||
+      bson_writer_end_document(&w)) {
+    bson_writer_deinit(&w);
+    return NULL;
+  }
+  return bson_writer_steal(&w, size);
+}
+
+
+/*
+  Serialise instance to BSON and write it to stream `fp`.
+
+  Returns non-zero on error.
+*/
+int dlite_bson_fwrite_instance(FILE *fp, const DLiteInstance *inst)
+{
+  BsonWriter w;
+  int stat;
+  bson_writer_init_stream(&w, fp);
+  if (!(stat = bson_writer_begin_document(&w)) &&
+      !(stat = dlite_bson_write_instance(&w, inst)))
+    stat = bson_writer_end_document(&w);
+  bson_writer_deinit(&w);
+  return stat;
 }
 
 
@@ -526,6 +567,42 @@ static int set_meta_dimensions(DLiteMeta *meta, unsigned char *subdoc)
 }
 
 
+/*
+  Returns non-zero if array property `idx` of `inst` can be a view
+  into the `datasize` bytes long binary data pointed to by `data`.
+  That is the case for types that don't allocate memory, when the
+  data has the expected size and is suitable aligned and when no
+  byteswapping is needed.
+ */
+static int can_borrow(DLiteInstance *inst, int idx, void *data,
+                      int datasize, int byteswap)
+{
+  DLiteProperty *p = DLITE_PROP_DESCR(inst, idx);
+  size_t *shape = DLITE_PROP_DIMS(inst, idx);
+  size_t align, nmemb=1;
+  int i;
+  for (i=0; i < p->ndims; i++) nmemb *= shape[i];
+  switch (p->type) {
+  case dliteInt:
+  case dliteUInt:
+  case dliteFloat:
+    if (byteswap && p->size > 1) return 0;
+    /* fallthrough */
+  case dliteBlob:
+  case dliteBool:
+  case dliteFixString:
+    break;
+  default:
+    return 0;
+  }
+  if (!nmemb || datasize < 0 || (size_t)datasize != nmemb * p->size)
+    return 0;
+  align = dlite_type_get_alignment(p->type, p->size);
+  if (align && (uintptr_t)data % align) return 0;
+  return 1;
+}
+
+
 /*
   Set array property `idx` of `inst` from `data`.
   If `byteswap` is non-zero, the data will by byteswapped.
@@ -536,7 +613,7 @@ static int set_array_property(DLiteInstance *inst, int idx, void *data,
                               int byteswap)
 {
    int i, stat, nmemb=1;
-  void *ptr = dlite_instance_get_property_by_index(inst, idx);
+  void *ptr = *(void **)DLITE_PROP(inst, idx);
   DLiteProperty *p = DLITE_PROP_DESCR(inst, idx);
   assert(p->ndims);
  size_t *shape = DLITE_PROP_DIMS(inst, idx);
@@ -575,7 +652,7 @@ static int set_array_property(DLiteInstance *inst, int idx, void *data,
   case dliteStringPtr:
     {
       char **v = ptr;
-      char *s = *((char **)data);
+      char *s = data;
       for (i=0; i < nmemb; i++) {
         int n = strlen(s);
         v[i] = strdup(s);
@@ -614,7 +691,7 @@ static int set_scalar_property(DLiteInstance *inst, int idx, void *data)
 #ifdef HAVE_FLOAT128
   float128_t f128;
 #endif
-  void *ptr = dlite_instance_get_property_by_index(inst, idx);
+  void *ptr = DLITE_PROP(inst, idx);
   DLiteProperty *p = DLITE_PROP_DESCR(inst, idx);
   int btype = bsontype(p->type, p->size);
   switch (p->type) {
@@ -701,13 +778,19 @@ static int set_scalar_property(DLiteInstance *inst, int idx, void *data)
 
 
 /*
-  Create a new instance from bson document and return it.
-  Returns NULL on error.
+  Help function for dlite_bson_load_instance() and
+  dlite_bson_load_instance_borrowed().
+
+  If `borrow` is non-zero, the created instance borrows `doc` and
+  array properties are views into it, when possible.  `freedoc` is
+  passed to dlite_instance_borrow_buffer().  On error, `doc` is
+  released with `freedoc` (if given).
 */
-DLiteInstance *dlite_bson_load_instance(const unsigned char *doc)
+static DLiteInstance *load_instance(const unsigned char *doc, int borrow,
+                                    DLiteBufferFree freedoc)
 {
   const char *metaid, *uuid, *uri, *id, *byteorder;
-  int i, type, idx, ndims, datasize, byteswap=0;
+  int i, type, idx, ndims, datasize, docsize, byteswap=0, borrowed=0;
   unsigned char *subdoc, *endptr;
   char *ename;
   void *data;
@@ -755,6 +838,12 @@ DLiteInstance *dlite_bson_load_instance(const unsigned char *doc)
   if (!(id = (uri) ? uri : (uuid) ? uuid : NULL))
     FAILCODE(dliteKeyError, "bson data is missing uri and/or uuid");
   if (!(inst = dlite_instance_create_from_id(metaid, dims, id))) goto fail;
+  if (borrow && dlite_instance_is_data(inst)) {
+    if ((docsize = bson_docsize(doc)) < 0) goto fail;
+    if (dlite_instance_borrow_buffer(inst, (void *)doc, docsize, freedoc))
+      goto fail;
+    borrowed = 1;
+  }
 
   if (dlite_instance_is_meta(inst)) {
     /* Metadata */
@@ -778,7 +867,11 @@ DLiteInstance *dlite_bson_load_instance(const unsigned char *doc)
       DLiteProperty *p = DLITE_PROP_DESCR(inst, idx);
       int btype = bsontype(p->type, p->size);
       if (p->ndims) {
-        if (set_array_property(inst, idx, data, byteswap)) goto fail;
+        if (borrowed && type == bsonBinary &&
+            can_borrow(inst, idx, data, datasize, byteswap)) {
+          if (dlite_instance_borrow_property_by_index(inst, idx, data))
+            goto fail;
+        } else if (set_array_property(inst, idx, data, byteswap)) goto fail;
       } else {
         if (type != btype)
           FAILCODE3(dliteInconsistentDataError, "expected bson type '%s', "
@@ -790,9 +883,44 @@ DLiteInstance *dlite_bson_load_instance(const unsigned char *doc)
   }
 
   if (dims) free(dims);
+  if (borrow && !borrowed && freedoc) freedoc((void *)doc);
   return inst;
  fail:
   if (inst) dlite_instance_decref(inst);
   if (dims) free(dims);
+  if (borrow && !borrowed && freedoc) freedoc((void *)doc);
   return NULL;
 }
+
+
+/*
+  Create a new instance from bson document and return it.
+  Returns NULL on error.
+*/
+DLiteInstance *dlite_bson_load_instance(const unsigned char *doc)
+{
+  return load_instance(doc, 0, NULL);
+}
+
+
+/*
+  Like dlite_bson_load_instance(), but instead of copying, array
+  properties of the returned instance are views directly into `doc`
+  when the type, size, alignment and byte order allow it.  This saves
+  both time and memory when loading large arrays.
+
+  If `freedoc` is not NULL, the returned instance takes over the
+  ownership of `doc` and releases it by calling `freedoc` when the
+  instance is free'ed.  `doc` is also released on error.  If
+  `freedoc` is NULL, the caller must keep `doc` alive as long as the
+  returned instance exists.
+
+  The views are copied on write, see dlite_instance_borrow_buffer().
+
+  Returns NULL on error.
+*/
+DLiteInstance *dlite_bson_load_instance_borrowed(unsigned char *doc,
+                                                 DLiteBufferFree freedoc)
+{
+  return load_instance(doc, 1, freedoc);
+}
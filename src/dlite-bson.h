@@ -9,9 +9,34 @@
 #include "utils/bson.h"
 
 
+/**
+  Write the elements of instance `inst` to the current document of
+  BSON writer `w`.  The document must have been started with
+  bson_writer_begin_document().
+
+  This makes it possible to serialise an instance in a single pass to
+  a growable buffer, a stream or a callback, depending on how `w` was
+  initialised.
+
+  Returns non-zero on error.
+ */
+int dlite_bson_write_instance(BsonWriter *w, const DLiteInstance *inst);
+
+
+/**
+  Serialise instance to BSON and write it to stream `fp`.
+
+  Returns non-zero on error.
+*/
+int dlite_bson_fwrite_instance(FILE *fp, const DLiteInstance *inst);
+
+
 /**
   Append instance to BSON document.
 
+  Prefer dlite_bson_write_instance(), which builds the document in a
+  single pass.
+
   Arguments:
     - buf: Pointer to a BSON document to append data to.  The memory pointed
         to must have been initialised with bson_init_document().
@@ -46,5 +71,24 @@ unsigned char *dlite_bson_from_instance(const DLiteInstance *inst,
  */
 DLiteInstance *dlite_bson_load_instance(const unsigned char *doc);
 
+/**
+  Like dlite_bson_load_instance(), but instead of copying, array
+  properties of the returned instance are views directly into `doc`
+  when the type, size, alignment and byte order allow it.  This saves
+  both time and memory when loading large arrays.
+
+  If `freedoc` is not NULL, the returned instance takes over the
+  ownership of `doc` and releases it by calling `freedoc` when the
+  instance is free'ed.  `doc` is also released on error.  If
+  `freedoc` is NULL, the caller must keep `doc` alive as long as the
+  returned instance exists.
+
+  The views are copied on write, see dlite_instance_borrow_buffer().
+
+  Returns NULL on error.
+ */
+DLiteInstance *dlite_bson_load_instance_borrowed(unsigned char *doc,
+                                                 DLiteBufferFree freedoc);
+
 
 #endif  /* _DLITE_BSON_H */
@@ -241,8 +241,8 @@ static int list_properties_helper(TGenBuf *s, const char *template, int len,
 
     if (metameta) {
       if (p->ndims == 0 && p->type == dliteStringPtr) {
-        char **ptr = dlite_instance_get_property((DLiteInstance *)meta,
-                                                 p->name);
+        char *const *ptr =
+          dlite_instance_get_property_const((DLiteInstance *)meta, p->name);
         tgen_subs_set_fmt(&psubs, "prop.value",  NULL, "%s", *ptr);
         tgen_subs_set_fmt(&psubs, "prop.cvalue", NULL, "\"%s\"", *ptr);
       } else {
@@ -343,7 +343,8 @@ static int list_meta_relations(TGenBuf *s, const char *template, int len,
 */
 int dlite_instance_subs(TGenSubs *subs, const DLiteInstance *inst)
 {
-  char *name=NULL, *version=NULL, *namespace=NULL, **descr;
+  char *name=NULL, *version=NULL, *namespace=NULL;
+  char *const *descr;
   const DLiteMeta *meta = inst->meta;
   int isdata=0, ismeta=0, ismetameta=0;
 
@@ -372,7 +373,8 @@ int dlite_instance_subs(TGenSubs *subs, const DLiteInstance *inst)
 
   /* About metadata */
   dlite_split_meta_uri(meta->uri, &name, &version, &namespace);
-  descr = dlite_instance_get_property((DLiteInstance *)meta, "description");
+  descr = dlite_instance_get_property_const((DLiteInstance *)meta,
+                                            "description");
   tgen_subs_set(subs, "meta.uuid",       meta->uuid, NULL);
   tgen_subs_set(subs, "meta.uri",        meta->uri,  NULL);
   tgen_subs_set(subs, "meta.name",       name,       NULL);
@@ -399,7 +401,8 @@ int dlite_instance_subs(TGenSubs *subs, const DLiteInstance *inst)
   if (dlite_meta_is_metameta(inst->meta)) {
     DLiteMeta *meta = (DLiteMeta *)inst;
     dlite_split_meta_uri(inst->uri, &name, &version, &namespace);
-    descr = dlite_instance_get_property((DLiteInstance *)meta, "description");
+    descr = dlite_instance_get_property_const((DLiteInstance *)meta,
+                                            "description");
 
     tgen_subs_set(subs, "name",       name,       NULL);
     tgen_subs_set(subs, "version",    version,    NULL);
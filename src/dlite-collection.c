@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "utils/err.h"
+#include "utils/map.h"
 #include "utils/sha3.h"
 #include "utils/strutils.h"
 #include "dlite-macros.h"
@@ -17,6 +18,187 @@
 
 
 
+/**************************************************************
+ * Members
+ *
+ * A collection holds a reference to each of its members that has
+ * been added or loaded.  Members are identified by their label, since
+ * the same instance may be added with several labels.
+ *
+ * Members of a collection loaded from storage are first loaded when
+ * they are accessed.  Such members are kept in a list ordered from
+ * most to least recently used, such that the collection can release
+ * the least recently used members when the number of them exceeds
+ * the limit set with dlite_collection_set_cache_size().  Members that
+ * have been added to the collection are never released, since they
+ * may not be possible to load again.
+ **************************************************************/
+
+/* A member held by a collection. */
+typedef struct _CollectionMember {
+  char *label;                     /* Label of the member */
+  DLiteInstance *inst;             /* Reference held by the collection */
+  int evictable;                   /* Whether the member can be released */
+  struct _CollectionMember *prev;  /* More recently used member */
+  struct _CollectionMember *next;  /* Less recently used member */
+} CollectionMember;
+
+typedef map_t(CollectionMember *) member_map_t;
+
+/* Members held by a collection. */
+typedef struct _DLiteCollectionMembers {
+  member_map_t map;         /* Maps labels to members */
+  CollectionMember *head;   /* Most recently used evictable member */
+  CollectionMember *tail;   /* Least recently used evictable member */
+  size_t nevictable;        /* Number of evictable members */
+  size_t maxsize;           /* Max number of evictable members, 0: no limit */
+} DLiteCollectionMembers;
+
+/* Removes evictable member `m` from the list of recently used members. */
+static void _member_unlink(DLiteCollectionMembers *members,
+                           CollectionMember *m)
+{
+  if (m->prev) m->prev->next = m->next; else members->head = m->next;
+  if (m->next) m->next->prev = m->prev; else members->tail = m->prev;
+  m->prev = m->next = NULL;
+}
+
+/* Inserts evictable member `m` first in the list of recently used
+   members. */
+static void _member_push(DLiteCollectionMembers *members,
+                         CollectionMember *m)
+{
+  m->prev = NULL;
+  m->next = members->head;
+  if (members->head) members->head->prev = m;
+  members->head = m;
+  if (!members->tail) members->tail = m;
+}
+
+/* Removes member `m` and releases the reference to its instance. */
+static void _member_free(DLiteCollectionMembers *members,
+                         CollectionMember *m)
+{
+  if (m->evictable) {
+    _member_unlink(members, m);
+    members->nevictable--;
+  }
+  map_remove(&members->map, m->label);
+  dlite_instance_decref(m->inst);
+  free(m->label);
+  free(m);
+}
+
+/* Releases the least recently used evictable members until the size
+   limit is satisfied. */
+static void _members_evict(DLiteCollectionMembers *members)
+{
+  if (!members->maxsize) return;
+  while (members->nevictable > members->maxsize)
+    _member_free(members, members->tail);
+}
+
+/* Returns the member with the given label or NULL if the collection
+   doesn't hold a reference to it. */
+static CollectionMember *_member_get(DLiteCollectionMembers *members,
+                                     const char *label)
+{
+  CollectionMember **mp = map_get(&members->map, label);
+  return (mp) ? *mp : NULL;
+}
+
+/*
+  Adds instance `inst` as member with given label.  The collection
+  steals the reference to `inst`.  If the label is already a member,
+  the reference is released.
+
+  Returns non-zero on error, in which case the reference to `inst` is
+  left to the caller.
+ */
+static int _member_add(DLiteCollectionMembers *members, const char *label,
+                       DLiteInstance *inst, int evictable)
+{
+  CollectionMember *m;
+  if (_member_get(members, label)) {
+    dlite_instance_decref(inst);
+    return 0;
+  }
+  if (!(m = calloc(1, sizeof(CollectionMember))) ||
+      !(m->label = strdup(label))) {
+    if (m) free(m);
+    return err(dliteMemoryError, "allocation failure");
+  }
+  m->inst = inst;
+  m->evictable = evictable;
+  map_set(&members->map, label, m);
+  if (evictable) {
+    _member_push(members, m);
+    members->nevictable++;
+    _members_evict(members);
+  }
+  return 0;
+}
+
+/*
+  Returns a borrowed reference to the member with the given label and
+  UUID.  If the collection doesn't hold it, it is loaded, from the
+  source storage if the collection has one and otherwise from the
+  storage search path.
+
+  Returns NULL on error.
+ */
+static DLiteInstance *_collection_member(const DLiteCollection *coll,
+                                         const char *label, const char *uuid)
+{
+  DLiteCollectionMembers *members = coll->members;
+  CollectionMember *m;
+  DLiteInstance *inst=NULL;
+
+  if ((m = _member_get(members, label))) {
+    if (m->evictable && m != members->head) {
+      _member_unlink(members, m);
+      _member_push(members, m);
+    }
+    return m->inst;
+  }
+
+  if (coll->source) {
+    const DLiteRelation *r =
+      dlite_collection_find_first(coll, label, "_has-meta", NULL, NULL);
+   ErrTry:  // fall back to the storage search path
+    if (r && strcmp(r->o, DLITE_COLLECTION_ENTITY) == 0)
+      inst = (DLiteInstance *)dlite_collection_load(coll->source, uuid, 1);
+    else
+      inst = dlite_instance_load(coll->source, uuid);
+   ErrOther:
+    break;
+   ErrEnd;
+  }
+  if (!inst && !(inst = dlite_instance_get(uuid))) return NULL;
+
+  /* The member may be released by _member_add(), so get the pointer
+     to return first */
+  if (_member_add(members, label, inst, 1)) {
+    dlite_instance_decref(inst);
+    return NULL;
+  }
+  if (!(m = _member_get(members, label))) return NULL;
+  return m->inst;
+}
+
+
+/*
+  Sets the maximum number of members loaded on demand that are held
+  by collection `coll`.  Zero means no limit.
+ */
+void dlite_collection_set_cache_size(DLiteCollection *coll, size_t maxsize)
+{
+  coll->members->maxsize = maxsize;
+  _members_evict(coll->members);
+}
+
+
+
 /**************************************************************
  * Collection
  **************************************************************/
@@ -27,6 +209,9 @@ int dlite_collection_init(DLiteInstance *inst)
   DLiteCollection *coll = (DLiteCollection *)inst;
   if (coll->rstore) return errx(dliteSystemError,
                                 "triplestore already initialised");
+  if (!(coll->members = calloc(1, sizeof(DLiteCollectionMembers))))
+    return err(dliteMemoryError, "allocation failure");
+  map_init(&coll->members->map);
   if (!(coll->rstore = triplestore_create())) return 1;
   return 0;
 }
@@ -36,22 +221,27 @@ int dlite_collection_init(DLiteInstance *inst)
 int dlite_collection_deinit(DLiteInstance *inst)
 {
   DLiteCollection *coll = (DLiteCollection *)inst;
-  DLiteCollectionState state;
-  DLiteInstance *inst2;
-  const DLiteRelation *r;
-
-  /* Release references to all instances. */
-  dlite_collection_init_state(coll, &state);
-  while ((r=dlite_collection_find(coll,&state, NULL, "_has-uuid", NULL,
-                                  NULL))) {
-    if ((inst2 = dlite_instance_get(r->o))) {
-      dlite_instance_decref(inst2);  // remove ref from collection
-      dlite_instance_decref(inst2);  // remove local ref to inst2
-    } else {
-      warnx("cannot remove missing instance: %s", r->o);
+  DLiteCollectionMembers *members = coll->members;
+
+  /* Release references to all members. */
+  if (members) {
+    const char *label;
+    map_iter_t iter = map_iter(&members->map);
+    while ((label = map_next(&members->map, &iter))) {
+      CollectionMember **mp = map_get(&members->map, label);
+      assert(mp && *mp);
+      dlite_instance_decref((*mp)->inst);
+      free((*mp)->label);
+      free(*mp);
     }
+    map_deinit(&members->map);
+    free(members);
+    coll->members = NULL;
+  }
+  if (coll->source) {
+    dlite_storage_close(coll->source);
+    coll->source = NULL;
   }
-  dlite_collection_deinit_state(&state);
 
   triplestore_free(coll->rstore);
   return 0;
@@ -124,7 +314,8 @@ int dlite_collection_gethash(const DLiteInstance *inst, uint8_t *hash,
         uint8_t hash[DLITE_HASH_SIZE];
         DLiteInstance * inst;
         char hex[2*DLITE_HASH_SIZE+1];
-        if (!(inst = dlite_instance_get(triples[i]->o))) goto fail;
+        if (!(inst = _collection_member(coll, triples[i]->s, triples[i]->o)))
+          goto fail;
         if (dlite_instance_get_hash(inst, hash, DLITE_HASH_SIZE))
           FAILCODE1(dliteValueError,
                     "error calculating hash of instance '%s'", triples[i]->o);
@@ -157,33 +348,19 @@ int dlite_collection_getdim(const DLiteInstance *inst, size_t i)
   return triplestore_length(coll->rstore);
 }
 
-/* Loads instance relations to triplestore.  Returns -1 on error. */
+/* Loads instance relations to triplestore.  Returns -1 on error.
+
+   The instances referred to by the relations are not loaded here, but
+   on demand when they are accessed. */
 int dlite_collection_loadprop(const DLiteInstance *inst, size_t i)
 {
-  int retval = 0;
   DLiteCollection *coll = (DLiteCollection *)inst;
-  TripleState state;
-  const Triple *t;
   if (i != 0) return errx(dliteIndexError,
                          "index out of range: %lu", (unsigned long)i);
   triplestore_clear(coll->rstore);
   if (triplestore_add_triples(coll->rstore, coll->relations, coll->nrelations))
     return -1;
-
-  /* Iterate over all newly added triples and load instances corresponding
-     to "_has-uuid" relations. */
-  triplestore_init_state(coll->rstore, &state);
-  while ((t = triplestore_find(&state, NULL, "_has-uuid", NULL, NULL))) {
-    DLiteInstance *inst2 = dlite_instance_get(t->o);
-    if (!inst2) retval = errx(dliteStorageLoadError,
-                              "cannot get instance \"%s\" labeled \"%s\" "
-                              "from collection \"%s\".  "
-                              "Is DLITE_STORAGES properly set?",
-                              t->o, t->s, coll->uuid);
-  }
-  triplestore_deinit_state(&state);
-
-  return retval;
+  return 0;
 }
 
 /* Saves triplestore to instance relations. Returns non-zero on error. */
@@ -269,7 +446,7 @@ DLiteInstance *dlite_collection_to_instance(DLiteCollection *coll)
 /*
   Loads collection with given id from storage `s`.  If `lazy` is zero,
   all its instances are also loaded.  Otherwise, instances are loaded
-  on demand.
+  from `s` on demand.
 
   Returns a new reference to the collection or NULL on error.
  */
@@ -277,17 +454,42 @@ DLiteCollection *dlite_collection_load(DLiteStorage *s, const char *id,
                                        int lazy)
 {
   DLiteCollection *coll;
-  DLiteCollectionState state;
-  const Triple *t, *t2;
 
+  if (!lazy) return dlite_collection_load_parallel(s, id, 1);
   if (!(coll = (DLiteCollection *)dlite_instance_load(s, id)))
     return NULL;
 
-  if (lazy) {
-    //dlite_storage_paths_append(s->location);
-    return coll;
+  /* Keep a reference to `s`, such that members can be loaded from it */
+  if (!coll->source) {
+    s->refcount++;
+    coll->source = s;
   }
+  return coll;
+}
 
+/*
+  Loads collection with given id and all its instances from storage
+  `s`, using up to `nworkers` threads for loading the instances.  If
+  `nworkers` is zero or negative, the number of processors is used.
+
+  Returns a new reference to the collection or NULL on error.
+ */
+DLiteCollection *dlite_collection_load_parallel(DLiteStorage *s,
+                                                const char *id, int nworkers)
+{
+  DLiteCollection *coll;
+  DLiteCollectionState state;
+  const Triple *t, *t2;
+  const char **ids=NULL, **labels=NULL, **metas=NULL;
+  DLiteInstance *inst, **instances=NULL;
+  DLiteMeta *meta;
+  size_t i, n=0, size=0;
+
+  if (!(coll = (DLiteCollection *)dlite_instance_load(s, id)))
+    return NULL;
+
+  /* Load sub-collections recursively and collect the ids of the other
+     instances, such that they can be loaded in one go */
   dlite_collection_init_state(coll, &state);
   while ((t = dlite_collection_find(coll, &state, NULL, "_has-uuid", NULL,
                                     NULL))) {
@@ -296,16 +498,72 @@ DLiteCollection *dlite_collection_load(DLiteStorage *s, const char *id,
       FAILCODE1(dliteInconsistentDataError,
                 "collection inconsistency - no \"_has-meta\" relation for "
                 "instance: %s", t->s);
+    if (_member_get(coll->members, t->s)) continue;  /* already loaded */
     if (strcmp(t2->o, DLITE_COLLECTION_ENTITY) == 0) {
-      if (!dlite_collection_load(s, t->o, 0)) goto fail;
+      if (!(inst = (DLiteInstance *)
+            dlite_collection_load_parallel(s, t->o, nworkers)))
+        goto fail;
+      if (_member_add(coll->members, t->s, inst, 0)) {
+        dlite_instance_decref(inst);
+        goto fail;
+      }
     } else {
-      if (!dlite_instance_load(s, t->o)) goto fail;
+      if (n >= size) {
+        const char **q, **l;
+        size = (size) ? 2*size : 16;
+        if (!(q = realloc(ids, size*sizeof(char *))))
+          FAILCODE(dliteMemoryError, "allocation failure");
+        ids = q;
+        if (!(l = realloc(labels, size*sizeof(char *))))
+          FAILCODE(dliteMemoryError, "allocation failure");
+        labels = l;
+        if (!(q = realloc(metas, size*sizeof(char *))))
+          FAILCODE(dliteMemoryError, "allocation failure");
+        metas = q;
+      }
+      ids[n] = t->o;
+      metas[n] = t2->o;
+      labels[n++] = t->s;
     }
   }
   dlite_collection_deinit_state(&state);
+
+  /* Resolve the metadata of the members before starting the workers,
+     such that they don't have to search the storages for it
+     concurrently.  The metadata is kept in the instance store. */
+  for (i=0; i<n; i++) {
+    if (i > 0 && strcmp(metas[i], metas[i-1]) == 0) continue;
+    if (!(meta = dlite_meta_get(metas[i]))) goto fail2;
+    dlite_meta_decref(meta);
+  }
+
+  /* The collection holds the references to the loaded instances */
+  if (n) {
+    if (!(instances = calloc(n, sizeof(DLiteInstance *)))) {
+      err(dliteMemoryError, "allocation failure");
+      goto fail2;  /* the iterator state is already deinitialised */
+    }
+    if (dlite_instance_load_parallel(s, ids, n, instances, nworkers))
+      goto fail2;
+    for (i=0; i<n; i++) {
+      if (_member_add(coll->members, labels[i], instances[i], 0)) {
+        for (; i<n; i++) dlite_instance_decref(instances[i]);
+        goto fail2;
+      }
+    }
+  }
+  free(instances);
+  free(labels);
+  free(metas);
+  free(ids);
   return coll;
  fail:
   dlite_collection_deinit_state(&state);
+ fail2:
+  if (instances) free(instances);
+  if (labels) free(labels);
+  if (metas) free(metas);
+  if (ids) free(ids);
   if (coll) dlite_collection_decref(coll);
   return NULL;
 }
@@ -341,20 +599,54 @@ DLiteCollection *dlite_collection_load_url(const char *url, int lazy)
   Returns non-zero on error.
  */
 int dlite_collection_save(DLiteCollection *coll, DLiteStorage *s)
+{
+  return dlite_collection_save_parallel(coll, s, 1);
+}
+
+/*
+  Saves collection and all its instances to storage `s`, using up to
+  `nworkers` threads for saving the instances.  If `nworkers` is zero
+  or negative, the number of processors is used.
+
+  Returns non-zero on error.
+ */
+int dlite_collection_save_parallel(DLiteCollection *coll, DLiteStorage *s,
+                                   int nworkers)
 {
   DLiteCollectionState state;
   DLiteInstance *inst;
   const DLiteMeta *e = dlite_get_collection_entity();
+  const DLiteInstance **instances=NULL;
+  size_t i, n=0, size=0;
   int stat=0;
   if ((stat = dlite_instance_save(s, (DLiteInstance *)coll))) return stat;
+
+  /* Collect new references, since members loaded on demand may be
+     released by the collection while iterating */
   dlite_collection_init_state(coll, &state);
-  while ((inst = dlite_collection_next(coll, &state))) {
-    if (inst->meta == e)
-      stat |= dlite_collection_save((DLiteCollection *)inst, s);
-    else
-      stat |= dlite_instance_save(s, inst);
+  while ((inst = dlite_collection_next_new(coll, &state))) {
+    if (inst->meta == e) {
+      stat |= dlite_collection_save_parallel((DLiteCollection *)inst, s,
+                                             nworkers);
+      dlite_instance_decref(inst);
+    } else {
+      if (n >= size) {
+        const DLiteInstance **q;
+        size = (size) ? 2*size : 16;
+        if (!(q = realloc(instances, size*sizeof(DLiteInstance *)))) {
+          stat |= err(dliteMemoryError, "allocation failure");
+          dlite_instance_decref(inst);
+          break;
+        }
+        instances = q;
+      }
+      instances[n++] = inst;
+    }
   }
   dlite_collection_deinit_state(&state);
+  stat |= dlite_instance_save_parallel(s, instances, n, nworkers);
+  for (i=0; i<n; i++) dlite_instance_decref((DLiteInstance *)instances[i]);
+  if (instances) free(instances);
   return stat;
 }
 
@@ -479,16 +771,22 @@ const DLiteRelation *dlite_collection_find_first(const DLiteCollection *coll,
   Adds instance `inst` to collection, making `coll` the owner of the instance.
   Hence `coll` "steals" the reference to `inst`.
 
-  Returns non-zero on error.
+  Returns non-zero on error, in which case the reference is not stolen.
  */
 int dlite_collection_add_new(DLiteCollection *coll, const char *label,
                              DLiteInstance *inst)
 {
+  CollectionMember *m;
   if (dlite_collection_find(coll, NULL, label, "_is-a", "Instance", NULL))
     return errx(dliteValueError,
                 "instance with label '%s' is already in the collection",
                 label);
 
+  /* Release stale member left by dlite_collection_remove_relations() */
+  if ((m = _member_get(coll->members, label)))
+    _member_free(coll->members, m);
+
+  if (_member_add(coll->members, label, inst, 0)) return 1;
   dlite_collection_add_relation(coll, label, "_is-a", "Instance", NULL);
   dlite_collection_add_relation(coll, label, "_has-uuid", inst->uuid,
                                 "xsd:anyURI");
@@ -516,21 +814,13 @@ int dlite_collection_add(DLiteCollection *coll, const char *label,
 int dlite_collection_remove(DLiteCollection *coll, const char *label)
 {
   DLiteCollectionState state;
-  DLiteInstance *inst;
-  const DLiteRelation *r;
+  CollectionMember *m;
   if (dlite_collection_remove_relations(coll, label, "_is-a", "Instance", NULL) > 0) {
-    r = dlite_collection_find(coll, NULL, label, "_has-uuid", NULL, NULL);
-    assert(r);
 
-    /* Removes reference hold by collection to the instance. We have
-     to call dlite_instance_decref() twice, since dlite_instance_get()
-     returns a new reference. */
-    if ((inst = dlite_instance_get(r->o))) {
-      dlite_instance_decref(inst);
-      dlite_instance_decref(inst);
-    } else {
-      warn("cannot remove missing instance: %s", r->o);
-    }
+    /* Removes reference hold by collection to the instance, if it is
+       loaded. */
+    if ((m = _member_get(coll->members, label)))
+      _member_free(coll->members, m);
 
     /* FIXME - there is something wrong here... */
     //dlite_collection_init_state(coll, &state);
@@ -550,6 +840,7 @@ int dlite_collection_remove(DLiteCollection *coll, const char *label)
 
 /*
   Returns borrowed reference to instance with given label or NULL on error.
+  The instance is loaded if the collection doesn't hold it.
  */
 const DLiteInstance *dlite_collection_get(const DLiteCollection *coll,
                                           const char *label)
@@ -557,16 +848,10 @@ const DLiteInstance *dlite_collection_get(const DLiteCollection *coll,
   const DLiteRelation *r;
   if ((r = dlite_collection_find(coll, NULL, label, "_has-uuid", NULL,
                                  NULL))) {
-    DLiteInstance *inst = dlite_instance_get(r->o);
+    DLiteInstance *inst = _collection_member(coll, label, r->o);
     if (!inst) FAILCODE2(dliteKeyError,
                          "no such instance '%s' in collection '%s'",
                          r->o, coll->uuid);
-
-    //assert(inst->_refcount >= 2);
-    //dlite_instance_decref(inst);
-
-    /* FIXME - this looks like a hack, should be solved properly... */
-    if (inst->_refcount >= 2) dlite_instance_decref(inst);
     return inst;
   }
   errx(dliteValueError, "cannot load instance '%s' from collection", label);
@@ -643,12 +928,10 @@ int dlite_collection_has_id(const DLiteCollection *coll, const char *id)
 DLiteInstance *dlite_collection_next(DLiteCollection *coll,
 				     DLiteCollectionState *state)
 {
-  DLiteInstance *inst = dlite_collection_next_new(coll, state);
-  if (inst) {
-    assert(inst->_refcount >= 2);
-    dlite_instance_decref(inst);
-  }
-  return inst;
+  const Triple *t;
+  if ((t = triplestore_find(state, NULL, "_has-uuid", NULL, NULL)))
+    return _collection_member(coll, t->s, t->o);
+  return NULL;
 }
 
 /*
@@ -660,11 +943,9 @@ DLiteInstance *dlite_collection_next(DLiteCollection *coll,
 DLiteInstance *dlite_collection_next_new(DLiteCollection *coll,
                                          DLiteCollectionState *state)
 {
-  UNUSED(coll);
-  const Triple *t;
-  while ((t = triplestore_find(state, NULL, "_has-uuid", NULL, NULL)))
-    return dlite_instance_get(t->o);
-  return NULL;
+  DLiteInstance *inst = dlite_collection_next(coll, state);
+  if (inst) dlite_instance_incref(inst);
+  return inst;
 }
 
 
@@ -42,6 +42,10 @@ typedef struct _DLiteCollection {
   /* -- extended header */
   DLiteInstance_HEAD
   TripleStore *rstore;       /*!< TripleStore managing the relations. */
+  DLiteStorage *source;      /*!< Storage that members are loaded from on
+                                  demand or NULL. */
+  struct _DLiteCollectionMembers *members;
+                             /*!< Members held by the collection. */
 
   /* -- dimensions */
   size_t nrelations;         /*!< Number of relations. */
@@ -144,11 +148,26 @@ DLiteInstance *dlite_collection_to_instance(DLiteCollection *coll);
 /**
   Loads collection with given id from storage `s`.  If `lazy` is zero,
   all its instances are loaded immediately.  Otherwise, instances are
-  first loaded on demand.  Returns non-zero on error.
+  first loaded on demand by dlite_collection_get() and
+  dlite_collection_next().  They are then looked up in `s` before
+  the storage search path is searched.  Returns non-zero on error.
  */
 DLiteCollection *dlite_collection_load(DLiteStorage *s, const char *id,
                                        int lazy);
 
+/**
+  Loads collection with given id and all its instances from storage
+  `s`.  The instances are loaded concurrently using up to `nworkers`
+  threads.  If `nworkers` is zero or negative, the number of
+  processors is used.
+
+  The members are added to the collection in the same order as by
+  dlite_collection_load().  Errors are reported per member.  See
+  dlite_instance_load_parallel() for details.  Returns NULL on error.
+ */
+DLiteCollection *dlite_collection_load_parallel(DLiteStorage *s,
+                                                const char *id, int nworkers);
+
 /**
   Convinient function that loads a collection from `url`, which should
   be of the form "driver://location?options#id".
@@ -158,12 +177,44 @@ DLiteCollection *dlite_collection_load(DLiteStorage *s, const char *id,
 DLiteCollection *dlite_collection_load_url(const char *url, int lazy);
 
 
+/**
+  Sets the maximum number of members loaded on demand that are held
+  by collection `coll`.  When it is exceeded, the collection releases
+  its reference to the least recently used member loaded on demand.
+  Zero, which is the default, means no limit.
+
+  This allows to iterate over a lazily loaded collection without
+  keeping all its members in memory.  Members that are added to the
+  collection or loaded by a non-lazy dlite_collection_load() are never
+  released.
+
+  @note
+  A borrowed reference returned by dlite_collection_get() or
+  dlite_collection_next() may become invalid when the member is
+  released.  Modifications of released members are lost.  Use
+  dlite_collection_get_new() or dlite_collection_next_new() to keep
+  members alive.
+ */
+void dlite_collection_set_cache_size(DLiteCollection *coll, size_t maxsize);
+
+
 /**
   Saves collection and all its instances to storage `s`.
   Returns non-zero on error.
  */
 int dlite_collection_save(DLiteCollection *coll, DLiteStorage *s);
 
+/**
+  Like dlite_collection_save(), but serialises and writes the instances
+  concurrently using up to `nworkers` threads.  If `nworkers` is zero
+  or negative, the number of processors is used.  Errors are reported
+  per member.  See dlite_instance_save_parallel() for details.
+
+  Returns non-zero on error.
+ */
+int dlite_collection_save_parallel(DLiteCollection *coll, DLiteStorage *s,
+                                   int nworkers);
+
 /**
   A convinient function that saves instance `inst` to the storage specified
   by `url`, which should be of the form "driver://path?options".
@@ -236,7 +287,7 @@ const DLiteRelation *dlite_collection_find_first(const DLiteCollection *coll,
 /**
   Adds instance `inst` to collection, making `coll` the owner of the instance.
 
-  Returns non-zero on error.
+  Returns non-zero on error, in which case the reference is not stolen.
  */
 int dlite_collection_add_new(DLiteCollection *coll, const char *label,
                              DLiteInstance *inst);
@@ -258,6 +309,7 @@ int dlite_collection_remove(DLiteCollection *coll, const char *label);
 
 /**
   Returns borrowed reference to instance with given label or NULL on error.
+  The instance is loaded if the collection doesn't hold it.
  */
 const DLiteInstance *dlite_collection_get(const DLiteCollection *coll,
                                           const char *label);
@@ -4,13 +4,19 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "config.h"
+
 #include "utils/compat.h"
 #include "utils/err.h"
 #include "utils/map.h"
+#include "utils/sync.h"
 #include "utils/fileutils.h"
 #include "utils/strutils.h"
+#include "utils/strtob.h"
+#include "utils/numscan.h"
 #include "utils/infixcalc.h"
 #include "utils/sha3.h"
+#include "utils/fasthash.h"
 #include "utils/rng.h"
 
 #include "dlite.h"
@@ -51,40 +57,110 @@ DLiteInstance *_instance_load_casted(const DLiteStorage *s, const char *id,
  *
  *  It is still possible to remove metadata by explicitly decreasing
  *  the refcount hold by the instance store.
+ *
+ *  The store is safe to access from several threads.  It is split
+ *  into ISTORE_NSHARDS shards selected from the UUID, each protected
+ *  by its own read-write lock.  Lookups only take a read lock, so
+ *  concurrent lookups of already loaded metadata do not serialise.
+ *  Note that the map_get() macro writes to the map, so map_get_() is
+ *  called directly when only a read lock is held.
+ *
+ *  Since data instances are weakly referenced, an instance found in
+ *  the store may concurrently be in the process of being free'ed
+ *  (refcount reached zero).  Such instances are treated as missing
+ *  by _instance_store_getref() and may be replaced in the store by a
+ *  new instance with the same UUID.
+ *
+ *  Each shard also keeps a marker for every instance that is being
+ *  searched for by dlite_instance_get(), such that concurrent lookups
+ *  of the same id wait for a single load instead of loading it more
+ *  than once.
  ********************************************************************/
 
+/* Number of shards in the instance store.  Must be a power of two. */
+#define ISTORE_NSHARDS 16
+
 typedef map_t(DLiteInstance *) instance_map_t;
 
+/* Marker for an instance that is being loaded by dlite_instance_get(). */
+typedef struct {
+  Mutex lock;           /* Held by the loading thread until it is done */
+  const int *owner;     /* Identifies the loading thread */
+  int refs;             /* Number of threads referring to the marker */
+} LoadMarker;
+
+typedef map_t(LoadMarker *) marker_map_t;
+
+/* A shard of the instance store. */
+typedef struct {
+  RWLock lock;          /* Protects `map` and `loading` */
+  instance_map_t map;   /* Maps UUIDs to instances */
+  marker_map_t loading; /* Maps UUIDs to markers of instances being loaded */
+} IStoreShard;
+
+/* Global instance store. */
+typedef struct {
+  IStoreShard shards[ISTORE_NSHARDS];
+} InstanceStore;
+
 /* Forward declarations */
-static instance_map_t *_instance_store(void);
+static InstanceStore *_instance_store(void);
 static void _instance_store_free(void *instance_store);
 static int _instance_store_add(const DLiteInstance *inst);
-static int _instance_store_remove(const char *id);
+static int _instance_store_remove(const DLiteInstance *inst);
 static DLiteInstance *_instance_store_get(const char *id);
+static DLiteInstance *_instance_store_getref(const char *id);
+
+/* Lock serialising lazy creation of the instance store. */
+static Mutex _istore_init_lock = MUTEX_INITIALIZER;
+
+/* Lock serialising lazy initialisation of shared metadata. */
+static Mutex _meta_init_lock = MUTEX_INITIALIZER;
+
 
+/* Returns the shard holding `uuid`. */
+static IStoreShard *_instance_store_shard(InstanceStore *istore,
+                                          const char *uuid)
+{
+  unsigned int i, h=0;
+  for (i=0; i<8 && uuid[i]; i++) h = h*31 + (unsigned char)uuid[i];
+  return istore->shards + (h & (ISTORE_NSHARDS-1));
+}
 
 /* Help function for adding metadata */
-static void _instance_store_addmeta(instance_map_t *istore,
+static void _instance_store_addmeta(InstanceStore *istore,
                                     const DLiteMeta *meta)
 {
-  int stat = map_set(istore, meta->uuid, (DLiteInstance *)meta);
+  IStoreShard *shard = _instance_store_shard(istore, meta->uuid);
+  int stat = map_set(&shard->map, meta->uuid, (DLiteInstance *)meta);
   assert(stat == 0);
   dlite_instance_incref((DLiteInstance *)meta);
 }
 
 /* Returns pointer to instance store. */
-static instance_map_t *_instance_store(void)
+static InstanceStore *_instance_store(void)
 {
-  instance_map_t *istore = dlite_globals_get_state("dlite-instance-store");
+  InstanceStore *istore = dlite_globals_get_state("dlite-instance-store");
   if (!istore) {
-    if (!(istore = malloc(sizeof(instance_map_t))))
-      return err(dliteMemoryError, "allocation failure"), NULL;
-    map_init(istore);
-    _instance_store_addmeta(istore, dlite_get_basic_metadata_schema());
-    _instance_store_addmeta(istore, dlite_get_entity_schema());
-    _instance_store_addmeta(istore, dlite_get_collection_entity());
-    dlite_globals_add_state("dlite-instance-store", istore,
-                            _instance_store_free);
+    mutex_lock(&_istore_init_lock);
+    if (!(istore = dlite_globals_get_state("dlite-instance-store"))) {
+      int i;
+      if (!(istore = malloc(sizeof(InstanceStore)))) {
+        mutex_unlock(&_istore_init_lock);
+        return err(dliteMemoryError, "allocation failure"), NULL;
+      }
+      for (i=0; i<ISTORE_NSHARDS; i++) {
+        rwlock_init(&istore->shards[i].lock);
+        map_init(&istore->shards[i].map);
+        map_init(&istore->shards[i].loading);
+      }
+      _instance_store_addmeta(istore, dlite_get_basic_metadata_schema());
+      _instance_store_addmeta(istore, dlite_get_entity_schema());
+      _instance_store_addmeta(istore, dlite_get_collection_entity());
+      dlite_globals_add_state("dlite-instance-store", istore,
+                              _instance_store_free);
+    }
+    mutex_unlock(&_istore_init_lock);
   }
   return istore;
 }
@@ -93,35 +169,47 @@ static instance_map_t *_instance_store(void)
    but can be called at any time. */
 static void _instance_store_free(void *instance_store)
 {
-  instance_map_t *istore = instance_store;
+  InstanceStore *istore = instance_store;
   const char *uuid;
   map_iter_t iter;
   DLiteInstance **del=NULL;
-  int i, ndel=0, delsize=0;
+  int i, n, ndel=0, delsize=0;
   assert(istore);
 
-  /* Remove all instances (to decrease the reference count for metadata) */
-  iter = map_iter(istore);
-  while ((uuid = map_next(istore, &iter))) {
-    DLiteInstance *inst, **q;
-    if ((q = map_get(istore, uuid)) && (inst = *q) &&
-        dlite_instance_is_meta(inst) && inst->_refcount > 0) {
-      if (delsize <= ndel) {
-        void *ptr;
-        delsize += 64;
-        if (!(ptr = realloc(del, delsize*sizeof(DLiteInstance *))))
-          free(del);
-        del = ptr;
+  /* Collect all metadata kept in the store.  Since decreasing the
+     refcount may remove the instance from the store, we must not
+     hold any lock when calling dlite_instance_decref(). */
+  for (n=0; n<ISTORE_NSHARDS; n++) {
+    IStoreShard *shard = istore->shards + n;
+    rwlock_rdlock(&shard->lock);
+    iter = map_iter(&shard->map);
+    while ((uuid = map_next(&shard->map, &iter))) {
+      DLiteInstance *inst, **q;
+      if ((q = map_get_(&shard->map.base, uuid)) && (inst = *q) &&
+          dlite_instance_is_meta(inst) && inst->_refcount > 0) {
+        if (delsize <= ndel) {
+          void *ptr;
+          delsize += 64;
+          if (!(ptr = realloc(del, delsize*sizeof(DLiteInstance *))))
+            free(del);
+          del = ptr;
+        }
+        if (del) del[ndel++] = inst;
       }
-      if (del) del[ndel++] = inst;
     }
+    rwlock_rdunlock(&shard->lock);
   }
 
+  /* Remove all instances (to decrease the reference count for metadata) */
   if (del) {
     for (i=0; i<ndel; i++) dlite_instance_decref(del[i]);
     free(del);
   }
-  map_deinit(istore);
+  for (n=0; n<ISTORE_NSHARDS; n++) {
+    map_deinit(&istore->shards[n].map);
+    map_deinit(&istore->shards[n].loading);
+    rwlock_destroy(&istore->shards[n].lock);
+  }
   free(istore);
 }
 
@@ -130,49 +218,222 @@ static void _instance_store_free(void *instance_store)
 */
 static int _instance_store_add(const DLiteInstance *inst)
 {
-  instance_map_t *istore = _instance_store();
-  assert(istore);
+  InstanceStore *istore = _instance_store();
+  IStoreShard *shard;
+  DLiteInstance **q;
+  int found;
+  if (!istore) return -1;
   assert(inst);
-  if (map_get(istore, inst->uuid)) return 1;
-  map_set(istore, inst->uuid, (DLiteInstance *)inst);
+  shard = _instance_store_shard(istore, inst->uuid);
+
+  /* Fast path: metadata is added on every instance creation and is
+     normally already in the store.  Check that with a read lock. */
+  rwlock_rdlock(&shard->lock);
+  found = ((q = map_get_(&shard->map.base, inst->uuid)) && *q == inst);
+  rwlock_rdunlock(&shard->lock);
+  if (found) return 1;
+
+  rwlock_wrlock(&shard->lock);
+  /* An existing instance with zero refcount is about to be free'ed.
+     It is replaced. */
+  if ((q = map_get(&shard->map, inst->uuid)) &&
+      sync_load_int(&(*q)->_refcount) > 0) {
+    rwlock_wrunlock(&shard->lock);
+    return 1;
+  }
+  if (map_set(&shard->map, inst->uuid, (DLiteInstance *)inst)) {
+    rwlock_wrunlock(&shard->lock);
+    return err(dliteMemoryError, "cannot add instance to store: %s",
+               inst->uuid);
+  }
 
   /* Increase reference  count for metadata that is kept in the store */
   if (dlite_instance_is_meta(inst))
     dlite_instance_incref((DLiteInstance *)inst);
+  rwlock_wrunlock(&shard->lock);
 
   return 0;
 }
 
-/* Removes instance `uuid` from global instance store.  Returns non-zero
+/* Removes instance `inst` from global instance store.  Returns non-zero
    on error.*/
-static int _instance_store_remove(const char *uuid)
-{
-  instance_map_t *istore = _instance_store();
-  DLiteInstance *inst, **q;
-  assert(istore);
-  if (!(q = map_get(istore, uuid)))
-    return errx(dliteMissingInstanceError, "cannot remove %s since it is not in store", uuid);
-  inst = *q;
-  map_remove(istore, uuid);
+static int _instance_store_remove(const DLiteInstance *inst)
+{
+  InstanceStore *istore = _instance_store();
+  IStoreShard *shard;
+  DLiteInstance **q;
+  if (!istore) return -1;
+  shard = _instance_store_shard(istore, inst->uuid);
+  rwlock_wrlock(&shard->lock);
+  if (!(q = map_get(&shard->map, inst->uuid))) {
+    rwlock_wrunlock(&shard->lock);
+    return errx(dliteMissingInstanceError,
+                "cannot remove %s since it is not in store", inst->uuid);
+  }
+
+  /* Leave the store untouched if `inst` has already been replaced by a
+     new instance with the same UUID. */
+  if (*q != inst) {
+    rwlock_wrunlock(&shard->lock);
+    return 0;
+  }
+  map_remove(&shard->map, inst->uuid);
+  rwlock_wrunlock(&shard->lock);
 
   if (dlite_instance_is_meta(inst) && inst->_refcount > 0)
-    dlite_instance_decref(inst);
+    dlite_instance_decref((DLiteInstance *)inst);
   return 0;
 }
 
-/* Returns pointer to instance for id `id` or NULL if `id` cannot be found. */
-static DLiteInstance *_instance_store_get(const char *id)
+/* Help function for _instance_store_get() and _instance_store_getref().
+   If `incref` is true, the reference count of the returned instance is
+   increased while the shard is locked. */
+static DLiteInstance *_instance_store_lookup(const char *id, int incref)
 {
-  instance_map_t *istore = _instance_store();
+  InstanceStore *istore = _instance_store();
+  IStoreShard *shard;
   DLiteIdType idtype;
   char uuid[DLITE_UUID_LENGTH+1];
-  DLiteInstance **instp;
+  DLiteInstance *inst=NULL, **instp;
+  if (!istore) return NULL;
   if ((idtype = dlite_get_uuid(uuid, id)) < 0 || idtype == dliteIdRandom)
     return errx(dliteValueError,
                 "id '%s' is neither a valid UUID or a convertable string",
                 id), NULL;
-  if (!(instp = map_get(istore, uuid))) return NULL;
-  return *instp;
+  shard = _instance_store_shard(istore, uuid);
+  rwlock_rdlock(&shard->lock);
+  if ((instp = map_get_(&shard->map.base, uuid))) {
+    inst = *instp;
+    if (incref) {
+      /* Only take a new reference if the instance is still alive */
+      int count;
+      do {
+        if ((count = sync_load_int(&inst->_refcount)) <= 0) {
+          inst = NULL;
+          break;
+        }
+      } while (!sync_cas_int(&inst->_refcount, count, count+1));
+    }
+  }
+  rwlock_rdunlock(&shard->lock);
+  return inst;
+}
+
+/* Returns pointer to instance for id `id` or NULL if `id` cannot be found.
+   A borrowed reference is returned. */
+static DLiteInstance *_instance_store_get(const char *id)
+{
+  return _instance_store_lookup(id, 0);
+}
+
+/* Like _instance_store_get(), but returns a new reference.  Use this
+   when the instance may be accessed concurrently by other threads. */
+static DLiteInstance *_instance_store_getref(const char *id)
+{
+  return _instance_store_lookup(id, 1);
+}
+
+/* Address identifying the current thread as owner of a load marker. */
+static _thread_local int _instance_load_owner = 0;
+
+/* Releases a reference to load marker `marker`. */
+static void _load_marker_release(LoadMarker *marker)
+{
+  if (sync_add_int(&marker->refs, -1) == 0) {
+    mutex_destroy(&marker->lock);
+    free(marker);
+  }
+}
+
+/* Marks the instance with UUID `uuid` as being loaded by the current
+   thread.
+
+   Returns:
+     - a new locked marker owned by the current thread, which must be
+       passed to _instance_store_end_load() when the load is done.
+       `*wait` is set to zero.
+     - the marker of another thread loading the same instance, with
+       `*wait` set to one.  The caller should wait for the other
+       thread with _instance_store_wait_load() and check the store
+       again.
+     - NULL if the instance is already being loaded by the current
+       thread (recursive load) or on error.  The caller should load
+       the instance without a marker.
+ */
+static LoadMarker *_instance_store_begin_load(const char *uuid, int *wait)
+{
+  InstanceStore *istore = _instance_store();
+  IStoreShard *shard;
+  LoadMarker **q, *marker=NULL, *new;
+  *wait = 0;
+  if (!istore) return NULL;
+  shard = _instance_store_shard(istore, uuid);
+
+  /* The new marker is locked before the shard, such that the marker is
+     never locked while holding the shard lock */
+  if (!(new = calloc(1, sizeof(LoadMarker)))) return NULL;
+  mutex_init(&new->lock);
+  mutex_lock(&new->lock);
+  new->owner = &_instance_load_owner;
+  new->refs = 1;
+
+  rwlock_wrlock(&shard->lock);
+  if ((q = map_get(&shard->loading, uuid))) {
+    if ((*q)->owner != &_instance_load_owner) {
+      marker = *q;
+      sync_add_int(&marker->refs, 1);
+      *wait = 1;
+    }
+  } else if (!map_set(&shard->loading, uuid, new)) {
+    marker = new;
+    new = NULL;
+  }
+  rwlock_wrunlock(&shard->lock);
+
+  if (new) {
+    mutex_unlock(&new->lock);
+    _load_marker_release(new);
+  }
+  return marker;
+}
+
+/* Removes the marker `marker` returned by _instance_store_begin_load()
+   and wakes up threads waiting for it. */
+static void _instance_store_end_load(const char *uuid, LoadMarker *marker)
+{
+  IStoreShard *shard = _instance_store_shard(_instance_store(), uuid);
+  rwlock_wrlock(&shard->lock);
+  map_remove(&shard->loading, uuid);
+  rwlock_wrunlock(&shard->lock);
+  mutex_unlock(&marker->lock);
+  _load_marker_release(marker);
+}
+
+/* Waits until the thread owning `marker` has finished loading and
+   releases the reference to `marker`. */
+static void _instance_store_wait_load(LoadMarker *marker)
+{
+  mutex_lock(&marker->lock);
+  mutex_unlock(&marker->lock);
+  _load_marker_release(marker);
+}
+
+/*
+  Initialises metadata `meta` unless it already is initialised.
+
+  Unlike dlite_meta_init(), it is safe to call this function on
+  metadata shared between threads.
+
+  Returns non-zero on error.
+ */
+static int _meta_ensure_init(DLiteMeta *meta)
+{
+  int retval=0;
+  if (sync_load_ptr((void *const *)&meta->_propoffsets)) return 0;
+  mutex_lock(&_meta_init_lock);
+  if (!meta->_propoffsets) retval = dlite_meta_init(meta);
+  mutex_unlock(&_meta_init_lock);
+  return retval;
 }
 
 
@@ -328,83 +589,1169 @@ size_t dlite_instance_size(const DLiteMeta *meta, const size_t *dims)
   return size;
 }
 
-/* Return of newly allocated NULL-terminated array of string pointers
-   with uuids available in the internal storage (istore) */
-char** dlite_istore_get_uuids(int* nuuids)
-{
-  instance_map_t* istore = _instance_store();
-  assert(istore);
-  const char* uuid;
-  map_iter_t iter;
+/* Return of newly allocated NULL-terminated array of string pointers
+   with uuids available in the internal storage (istore) */
+char** dlite_istore_get_uuids(int* nuuids)
+{
+  InstanceStore *istore = _instance_store();
+  const char* uuid;
+  map_iter_t iter;
+  char** uuids=NULL;
+  int i=0, n;
+  assert(istore);
+
+  /* Lock all shards to get a consistent snapshot */
+  for (n=0; n<ISTORE_NSHARDS; n++)
+    rwlock_rdlock(&istore->shards[n].lock);
+
+  *nuuids = 0;
+  for (n=0; n<ISTORE_NSHARDS; n++) {
+    instance_map_t *map = &istore->shards[n].map;
+    iter = map_iter(map);
+    while ((uuid = map_next(map, &iter))) (*nuuids)++;
+  }
+
+  if (!(uuids = calloc((*nuuids + 1), sizeof(char*))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+
+  for (n=0; n<ISTORE_NSHARDS; n++) {
+    instance_map_t *map = &istore->shards[n].map;
+    iter = map_iter(map);
+    while ((uuid = map_next(map, &iter))) {
+      if (!(uuids[i] = malloc(DLITE_UUID_LENGTH + 1)))
+        FAILCODE(dliteMemoryError, "allocation failure");
+      strcpy(uuids[i], uuid);
+      i++;
+    }
+  }
+  uuids[i] = NULL;
+  for (n=0; n<ISTORE_NSHARDS; n++)
+    rwlock_rdunlock(&istore->shards[n].lock);
+  return uuids;
+
+ fail:
+  for (n=0; n<ISTORE_NSHARDS; n++)
+    rwlock_rdunlock(&istore->shards[n].lock);
+  if (uuids) {
+    for (i=0; uuids[i]; i++) free(uuids[i]);
+    free(uuids);
+  }
+  return NULL;
+}
+
+/********************************************************************
+ *  Instances
+ ********************************************************************/
+
+/*
+  Number of dimensions and property dimensions that are evaluated
+  using buffers on the stack.  Metadata with more falls back to heap
+  allocated buffers.
+ */
+#define NSTACK 32
+
+/*
+  Whether new data instances are allocated as a single memory arena.
+  A negative value means that it is not yet initialised from the
+  DLITE_INSTANCE_ARENA environment variable.
+ */
+static int use_arena = -1;
+
+/*
+  Hash algorithm used by dlite_instance_get_hash().  A negative value
+  means that it is not yet initialised from the DLITE_HASH_ALGORITHM
+  environment variable.
+ */
+static int hash_algorithm = -1;
+
+
+/*
+  Help function that evaluates the property dimension values of
+  metadata `meta` for the instance dimensions `dims` and writes them
+  to `propdims`, which must have space for `meta->_npropdims` elements.
+
+  Returns non-zero in error.
+ */
+static int _propdims_eval(const DLiteMeta *meta, const size_t *dims,
+                          size_t *propdims)
+{
+  int retval = 1;
+  size_t i, n=0;
+  InfixCalcVariable buf[NSTACK], *vars=buf;
+
+  if (meta->_ndimensions > NSTACK &&
+      !(vars = calloc(meta->_ndimensions, sizeof(InfixCalcVariable))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+  for (i=0; i < meta->_ndimensions; i++) {
+    vars[i].name = meta->_dimensions[i].name;
+    vars[i].value = dims[i];
+  }
+
+  if (meta->_propdimexprs) {
+    char errmsg[256] = "";
+    for (n=0; n < meta->_npropdims; n++) {
+      propdims[n] = infixcalc_eval(meta->_propdimexprs[n], vars,
+                                   meta->_ndimensions,
+                                   errmsg, sizeof(errmsg));
+      if (errmsg[0]) FAILCODE1(dliteSyntaxError, "invalid property dimension expression: %s", errmsg);
+    }
+  } else {
+    for (i=0; i < meta->_nproperties; i++) {
+      DLiteProperty *p = meta->_properties + i;
+      int j;
+      char errmsg[256] = "";
+      for (j=0; j < p->ndims; j++)
+        propdims[n++] = infixcalc(p->shape[j], vars, meta->_ndimensions,
+                                  errmsg, sizeof(errmsg));
+      if (errmsg[0]) FAILCODE1(dliteSyntaxError, "invalid property dimension expression: %s", errmsg);
+    }
+  }
+  assert(n == meta->_npropdims);
+
+  retval = 0;
+ fail:
+  if (vars != buf) free(vars);
+  return retval;
+}
+
+/*
+  Help function that evaluates array of instance property dimension
+  values, where `dims` is the instance dimensions.  It assigns the
+  `propdims` memory section of `inst`.
+
+  Returns non-zero in error.
+ */
+static int _instance_propdims_eval(DLiteInstance *inst, const size_t *dims)
+{
+  size_t *propdims = (size_t *)((char *)inst + inst->meta->_propdimsoffset);
+  return _propdims_eval(inst->meta, dims, propdims);
+}
+
+/*
+  Frees the compiled property dimension expressions of `meta`.
+ */
+static void _propdimexprs_free(DLiteMeta *meta)
+{
+  size_t i;
+  if (!meta->_propdimexprs) return;
+  for (i=0; i < meta->_npropdims; i++)
+    if (meta->_propdimexprs[i]) infixcalc_free(meta->_propdimexprs[i]);
+  free(meta->_propdimexprs);
+  meta->_propdimexprs = NULL;
+}
+
+/*
+  Frees the compiled property dimension expressions of metadata that
+  is never freed, like the static schemas.  Instances of `meta` that
+  are created afterwards parse the expressions instead.
+ */
+void dlite_meta_free_propdimexprs(DLiteMeta *meta)
+{
+  _propdimexprs_free(meta);
+}
+
+/*
+  Compiles the property dimension expressions of `meta`, such that
+  they don't have to be parsed every time an instance is created or
+  resized.
+
+  Invalid expressions are not an error here.  In that case
+  `meta->_propdimexprs` is left NULL and the error is reported when
+  instances are created.
+ */
+static void _propdimexprs_compile(DLiteMeta *meta)
+{
+  size_t i, n=0;
+  InfixCalcVariable buf[NSTACK], *vars=buf;
+
+  _propdimexprs_free(meta);
+  if (!meta->_npropdims) return;
+  if (meta->_ndimensions > NSTACK &&
+      !(vars = calloc(meta->_ndimensions, sizeof(InfixCalcVariable))))
+    return;
+  for (i=0; i < meta->_ndimensions; i++) {
+    vars[i].name = meta->_dimensions[i].name;
+    vars[i].value = 0;
+  }
+  if (!(meta->_propdimexprs = calloc(meta->_npropdims,
+                                     sizeof(InfixCalcExpr *))))
+    goto fail;
+  for (i=0; i < meta->_nproperties; i++) {
+    DLiteProperty *p = meta->_properties + i;
+    int j;
+    for (j=0; j < p->ndims; j++, n++)
+      if (!(meta->_propdimexprs[n] =
+            infixcalc_compile(p->shape[j], vars, meta->_ndimensions,
+                              NULL, 0)))
+        goto fail;
+  }
+  assert(n == meta->_npropdims);
+  if (vars != buf) free(vars);
+  return;
+ fail:
+  _propdimexprs_free(meta);
+  if (vars != buf) free(vars);
+}
+
+/*
+  Help function that calculates the layout of the property arrays of
+  an arena allocated instance with metadata `meta` and property
+  dimensions `propdims`.  The arrays are placed after `offset`.
+
+  If `offsets` is not NULL, it is assigned the offset of each property
+  array (zero for properties that are not arrays or have no elements).
+
+  Returns the total size of the arena.
+ */
+static size_t _arena_layout(const DLiteMeta *meta, const size_t *propdims,
+                            size_t offset, size_t *offsets)
+{
+  size_t i, n=0;
+  for (i=0; i < meta->_nproperties; i++) {
+    DLiteProperty *p = meta->_properties + i;
+    size_t nmemb=1;
+    int j;
+    if (offsets) offsets[i] = 0;
+    if (p->ndims <= 0 || !p->shape) continue;
+    for (j=0; j < p->ndims; j++) nmemb *= propdims[n++];
+    if (!nmemb) continue;
+    offset += dlite_type_padding_at(p->type, p->size, offset);
+    if (offsets) offsets[i] = offset;
+    offset += nmemb * p->size;
+  }
+  return offset + padding_at(DLiteInstance, offset);
+}
+
+/*
+  Returns non-zero if `ptr` points into the memory arena of `inst`.
+
+  The size of the arena is stored in a size_t right after the header
+  of arena allocated instances.
+ */
+static int _instance_in_arena(const DLiteInstance *inst, const void *ptr)
+{
+  const char *start = (const char *)inst;
+  size_t hsize;
+  if (!(inst->_flags & dliteArena) || !ptr) return 0;
+  hsize = dlite_instance_size(inst->meta, DLITE_DIMS(inst));
+  return ((const char *)ptr >= start + hsize &&
+          (const char *)ptr < start + *(const size_t *)(start + hsize));
+}
+
+/*
+  Returns non-zero if new data instances are allocated as a single
+  memory arena holding the header, dimensions, property dimensions
+  and all property arrays.
+ */
+int dlite_instance_use_arena(void)
+{
+  if (use_arena == -1) {
+    char *endptr, *p = getenv("DLITE_INSTANCE_ARENA");
+    use_arena = 0;
+    if (p) {
+      if (!*p) {
+        use_arena = 1;
+      } else {
+        int v = strtob(p, &endptr);
+        if (v >= 0)
+          use_arena = (v) ? 1 : 0;
+        else
+          warn("environment variable DLITE_INSTANCE_ARENA must have a "
+               "valid boolean value: %s", p);
+      }
+    }
+  }
+  return use_arena;
+}
+
+/*
+  Sets whether new data instances should be allocated as a single
+  memory arena.  Default is separate allocations, unless the
+  environment variable DLITE_INSTANCE_ARENA is set and is not false.
+ */
+void dlite_instance_set_use_arena(int v)
+{
+  use_arena = (v) ? 1 : 0;
+}
+
+/*
+  Returns the hash algorithm used by dlite_instance_get_hash() and
+  when creating transactions.
+ */
+DLiteHashAlgorithm dlite_instance_hash_algorithm(void)
+{
+  if (hash_algorithm == -1) {
+    char *p = getenv("DLITE_HASH_ALGORITHM");
+    hash_algorithm = dliteHashSha3;
+    if (p && *p) {
+      int alg = dlite_hash_algorithm_from_name(p);
+      if (alg >= 0)
+        hash_algorithm = alg;
+      else
+        warn("environment variable DLITE_HASH_ALGORITHM must be the name "
+             "of a hash algorithm: %s", p);
+    }
+  }
+  return hash_algorithm;
+}
+
+/*
+  Sets the hash algorithm used by dlite_instance_get_hash() and when
+  creating transactions.  Default is `dliteHashSha3`, unless the
+  environment variable DLITE_HASH_ALGORITHM is set.
+ */
+void dlite_instance_set_hash_algorithm(DLiteHashAlgorithm alg)
+{
+  hash_algorithm = alg;
+}
+
+/*
+  Returns the name of hash algorithm `alg` or NULL if `alg` is invalid.
+ */
+const char *dlite_hash_algorithm_name(DLiteHashAlgorithm alg)
+{
+  switch (alg) {
+  case dliteHashSha3: return "sha3";
+  case dliteHashFast: return "fast";
+  case dliteHashSha3Tree: return "sha3-tree";
+  }
+  return NULL;
+}
+
+/*
+  Returns the hash algorithm with the given name or -1 on error.
+ */
+int dlite_hash_algorithm_from_name(const char *name)
+{
+  if (!name) return errx(-1, "missing name of hash algorithm");
+  if (strcmp(name, "sha3") == 0) return dliteHashSha3;
+  if (strcmp(name, "fast") == 0) return dliteHashFast;
+  if (strcmp(name, "sha3-tree") == 0) return dliteHashSha3Tree;
+  return errx(-1, "unknown hash algorithm: %s", name);
+}
+
+
+/********************************************************************
+ *  Hash cache
+ *
+ *  To avoid rehashing large unchanged properties, the hash state
+ *  before each property (sha3) or the digest of each property (fast
+ *  and sha3-tree) is cached together with per-property flags telling
+ *  whether the property may have changed since it was hashed.
+ *  Like borrowed buffers, the caches are kept in a global table
+ *  mapping UUIDs to caches.  Only instances with the dliteHashCached
+ *  flag set are looked up.
+ *
+ *  Since properties may be modified without notice through pointers
+ *  to their data, caching must be enabled explicitly for each
+ *  instance with dlite_instance_set_hash_cache().  Exposed properties
+ *  (see below) are always rehashed.
+ ********************************************************************/
+
+/* Per-property flags of a hash cache. */
+typedef enum {
+  hashDirty=1     /* Property has been modified since it was hashed */
+} HashFlag;
+
+/* Cached hash state of an instance. */
+typedef struct {
+  Mutex lock;             /* Protects the content of the cache */
+  int valid;              /* Whether `states` and `hash` are valid */
+  DLiteHashAlgorithm alg; /* Algorithm of cached hash */
+  unsigned bitsize;       /* Size of cached hash in bits */
+  size_t nprops;          /* Number of properties */
+  size_t ndims;           /* Number of dimensions */
+  uint64_t *dims;         /* Dimension sizes when hashed */
+  int has_parent;         /* Whether the instance had a parent when hashed */
+  DLiteParent parent;     /* Copy of parent when hashed */
+  sha3_context *states;   /* Hash state before each property and after the
+                             last property.  Length: nprops+1.  Only
+                             allocated for the sha3 algorithm. */
+  uint8_t *digests;       /* Digest of each property.  Allocated with
+                             room for nprops*SHA3_TREE_DIGEST_SIZE bytes.
+                             Only allocated for the tree algorithms. */
+  uint8_t *flags;         /* HashFlag for each property */
+  uint8_t hash[64];       /* Cached hash */
+} HashCache;
+
+typedef map_t(HashCache *) hashcache_map_t;
+
+/* Global table of hash caches. */
+typedef struct {
+  Mutex lock;             /* Protects `map` */
+  hashcache_map_t map;    /* Maps UUIDs to hash caches */
+} HashStore;
+
+/* Lock serialising lazy creation of the hash store. */
+static Mutex _hstore_init_lock = MUTEX_INITIALIZER;
+
+/* Frees hash cache `cache`. */
+static void _hashcache_free(HashCache *cache)
+{
+  mutex_destroy(&cache->lock);
+  if (cache->dims) free(cache->dims);
+  if (cache->states) free(cache->states);
+  if (cache->digests) free(cache->digests);
+  if (cache->flags) free(cache->flags);
+  free(cache);
+}
+
+/* Frees the hash store. */
+static void _hash_store_free(void *hash_store)
+{
+  HashStore *hstore = hash_store;
+  const char *uuid;
+  map_iter_t iter = map_iter(&hstore->map);
+  while ((uuid = map_next(&hstore->map, &iter)))
+    _hashcache_free(*map_get(&hstore->map, uuid));
+  map_deinit(&hstore->map);
+  mutex_destroy(&hstore->lock);
+  free(hstore);
+}
+
+/* Returns pointer to the hash store or NULL on error. */
+static HashStore *_hash_store(void)
+{
+  HashStore *hstore = dlite_globals_get_state("dlite-hash-store");
+  if (!hstore) {
+    mutex_lock(&_hstore_init_lock);
+    if (!(hstore = dlite_globals_get_state("dlite-hash-store"))) {
+      if (!(hstore = malloc(sizeof(HashStore)))) {
+        mutex_unlock(&_hstore_init_lock);
+        return err(dliteMemoryError, "allocation failure"), NULL;
+      }
+      mutex_init(&hstore->lock);
+      map_init(&hstore->map);
+      dlite_globals_add_state("dlite-hash-store", hstore, _hash_store_free);
+    }
+    mutex_unlock(&_hstore_init_lock);
+  }
+  return hstore;
+}
+
+/*
+  Returns the hash cache of `inst` or NULL if it has no cache.  If
+  `create` is non-zero, a new cache is created if `inst` has none.
+ */
+static HashCache *_instance_hashcache(const DLiteInstance *inst, int create)
+{
+  HashStore *hstore;
+  HashCache **v, *cache=NULL;
+  if (!(inst->_flags & dliteHashCached) && !create) return NULL;
+  if (!(hstore = _hash_store())) return NULL;
+  mutex_lock(&hstore->lock);
+  if ((v = map_get(&hstore->map, inst->uuid))) {
+    cache = *v;
+  } else if (create && (cache = calloc(1, sizeof(HashCache)))) {
+    size_t n = inst->meta->_nproperties;
+    mutex_init(&cache->lock);
+    cache->nprops = n;
+    cache->ndims = inst->meta->_ndimensions;
+    if (!(cache->dims = calloc(cache->ndims + 1, sizeof(uint64_t))) ||
+        !(cache->flags = calloc(n + 1, sizeof(uint8_t))) ||
+        map_set(&hstore->map, inst->uuid, cache)) {
+      _hashcache_free(cache);
+      cache = NULL;
+    }
+  }
+  mutex_unlock(&hstore->lock);
+  if (create && !cache) return err(dliteMemoryError, "allocation failure"),
+                          NULL;
+  if (cache) ((DLiteInstance *)inst)->_flags |= dliteHashCached;
+  return cache;
+}
+
+/*
+  Marks property `i` of `inst` with `flag`.  If `i` is negative, all
+  properties are marked.  Does nothing if `inst` has no hash cache.
+ */
+static void _instance_hash_mark(const DLiteInstance *inst, int i,
+                                HashFlag flag)
+{
+  HashCache *cache;
+  size_t n;
+  if (!(inst->_flags & dliteHashCached)) return;
+  if (!(cache = _instance_hashcache(inst, 0))) return;
+  mutex_lock(&cache->lock);
+  if (i < 0)
+    for (n=0; n < cache->nprops; n++) cache->flags[n] |= flag;
+  else if ((size_t)i < cache->nprops)
+    cache->flags[i] |= flag;
+  mutex_unlock(&cache->lock);
+}
+
+/* Removes the hash cache of `inst` from the hash store and frees it. */
+static void _instance_release_hashcache(DLiteInstance *inst)
+{
+  HashStore *hstore;
+  HashCache **v, *cache=NULL;
+  if (!(inst->_flags & dliteHashCached)) return;
+  if (!(hstore = _hash_store())) return;
+  mutex_lock(&hstore->lock);
+  if ((v = map_get(&hstore->map, inst->uuid))) {
+    cache = *v;
+    map_remove(&hstore->map, inst->uuid);
+  }
+  mutex_unlock(&hstore->lock);
+  inst->_flags &= ~dliteHashCached;
+  if (cache) _hashcache_free(cache);
+}
+
+/*
+  Returns a pointer to the data of property `i` without marking it as
+  exposed.  Only for internal read-only use, after the properties have
+  been synchronised with dlite_instance_sync_to_properties().
+ */
+static void *_instance_property_data(const DLiteInstance *inst, size_t i)
+{
+  void *ptr = DLITE_PROP(inst, i);
+  if (inst->meta->_properties[i].ndims > 0) ptr = *(void **)ptr;
+  return ptr;
+}
+
+
+/********************************************************************
+ *  Reserved capacity
+ *
+ *  Arrays grown by dlite_instance_append_rows() and related functions
+ *  may be allocated larger than needed.  Their capacities are kept in
+ *  a table mapping the UUID of the instance to the capacities of its
+ *  properties.  Only instances with the dliteReserved flag set are
+ *  looked up.  A recorded capacity is only valid for the array it was
+ *  recorded for and must be cleared when the array is reallocated.
+ *
+ *  Like the table of shared arrays below, the table is not a part of
+ *  the global state.
+ ********************************************************************/
+
+/* Capacity of a property array. */
+typedef struct {
+  const void *ptr;  /* Array that the capacity is recorded for */
+  size_t nmemb;     /* Number of members that fits into `ptr` */
+} Capacity;
+
+typedef map_t(Capacity *) capacity_map_t;
+
+/* Table of capacities and the lock protecting it. */
+static capacity_map_t _capacities;
+static Mutex _capacity_lock = MUTEX_INITIALIZER;
+
+/*
+  Returns the recorded capacities of the properties of `inst` or NULL
+  if no capacities are recorded.  The returned array is valid until
+  the capacities are cleared with _instance_clear_capacity().
+ */
+static Capacity *_instance_capacities(const DLiteInstance *inst)
+{
+  Capacity **v;
+  if (!(inst->_flags & dliteReserved)) return NULL;
+  mutex_lock(&_capacity_lock);
+  v = map_get(&_capacities, inst->uuid);
+  mutex_unlock(&_capacity_lock);
+  return (v) ? *v : NULL;
+}
+
+/*
+  Records that array property `i` of `inst` has room for `nmemb` members.
+
+  Returns non-zero on error.
+ */
+static int _instance_set_capacity(DLiteInstance *inst, size_t i, size_t nmemb)
+{
+  Capacity **v, *c=NULL;
+  int stat=0;
+  mutex_lock(&_capacity_lock);
+  if (!(v = map_get(&_capacities, inst->uuid))) {
+    if (!(c = calloc(inst->meta->_nproperties, sizeof(Capacity))) ||
+        map_set(&_capacities, inst->uuid, c)) {
+      stat = 1;
+    } else {
+      v = &c;
+    }
+  }
+  if (v) {
+    (*v)[i].ptr = *(void **)DLITE_PROP(inst, i);
+    (*v)[i].nmemb = nmemb;
+  }
+  mutex_unlock(&_capacity_lock);
+  if (stat) {
+    if (c) free(c);
+    return err(dliteMemoryError, "allocation failure");
+  }
+  inst->_flags |= dliteReserved;
+  return 0;
+}
+
+/*
+  Clears the recorded capacity of array property `i` of `inst`.  If `i`
+  is negative, the capacities of all properties are cleared.
+ */
+static void _instance_clear_capacity(DLiteInstance *inst, int i)
+{
+  Capacity **v;
+  if (!(inst->_flags & dliteReserved)) return;
+  mutex_lock(&_capacity_lock);
+  if ((v = map_get(&_capacities, inst->uuid))) {
+    if (i >= 0) {
+      (*v)[i].ptr = NULL;
+    } else {
+      free(*v);
+      map_remove(&_capacities, inst->uuid);
+      if (_capacities.base.nnodes == 0) {
+        map_deinit(&_capacities);
+        map_init(&_capacities);
+      }
+    }
+  }
+  mutex_unlock(&_capacity_lock);
+  if (i < 0) inst->_flags &= ~dliteReserved;
+}
+
+
+/********************************************************************
+ *  Exposed properties
+ *
+ *  A property is exposed once a writable pointer to it has been
+ *  returned by dlite_instance_get_property() or related functions,
+ *  since it may be modified through that pointer at any time.
+ *  Exposed properties are therefore always rehashed and never shared
+ *  with snapshots.  They are kept in a table mapping the UUID of the
+ *  instance to a flag for each property.
+ *
+ *  Recording an exposure never writes to the instance itself, such
+ *  that instances may be accessed concurrently.  Instead, the table
+ *  is only looked up when it is non-empty and each thread remembers
+ *  the properties of the last instance it has exposed, such that
+ *  repeated calls to the writable accessors do not lock the table.
+ *
+ *  Like the table of capacities, the table is not a part of the
+ *  global state.
+ ********************************************************************/
+
+typedef map_t(uint8_t *) exposed_map_t;
+
+/* Table of exposed properties and the lock protecting it. */
+static exposed_map_t _exposed;
+static Mutex _exposed_lock = MUTEX_INITIALIZER;
+
+/* Number of instances in the table of exposed properties. */
+static int _nexposed = 0;
+
+/* Incremented each time an instance is removed from the table of
+   exposed properties.  Invalidates the per-thread records, since a
+   new instance may be allocated at the address of a removed one. */
+static int _exposed_generation = 0;
+
+/* Number of properties that are recorded per thread. */
+#define EXPOSED_NBITS 256
+
+/* Per-thread record of the properties of `inst` that are exposed. */
+typedef struct {
+  const DLiteInstance *inst;
+  int generation;
+  uint64_t bits[EXPOSED_NBITS / 64];
+} ExposedRecord;
+
+static _thread_local ExposedRecord _exposed_record;
+
+/*
+  Returns an array with a non-zero value for each exposed property of
+  `inst` or NULL if no property is exposed.  The returned array is
+  valid until it is released with _instance_clear_exposed().
+ */
+static const uint8_t *_instance_exposed(const DLiteInstance *inst)
+{
+  uint8_t **v;
+  if (!sync_load_int(&_nexposed)) return NULL;
+  mutex_lock(&_exposed_lock);
+  v = map_get(&_exposed, inst->uuid);
+  mutex_unlock(&_exposed_lock);
+  return (v) ? *v : NULL;
+}
+
+/*
+  Records that property `i` of `inst` is exposed.
+
+  Returns non-zero on error.
+ */
+static int _instance_set_exposed(const DLiteInstance *inst, size_t i)
+{
+  ExposedRecord *r = &_exposed_record;
+  uint8_t **v, *e=NULL;
+  int stat=0, generation = sync_load_int(&_exposed_generation);
+
+  if (r->inst == inst && r->generation == generation &&
+      i < EXPOSED_NBITS && r->bits[i / 64] & ((uint64_t)1 << (i % 64)))
+    return 0;
+
+  mutex_lock(&_exposed_lock);
+  if (!(v = map_get(&_exposed, inst->uuid))) {
+    if (!(e = calloc(inst->meta->_nproperties, sizeof(uint8_t))) ||
+        map_set(&_exposed, inst->uuid, e)) {
+      stat = 1;
+    } else {
+      sync_add_int(&_nexposed, 1);
+      v = &e;
+    }
+  }
+  if (v) (*v)[i] = 1;
+  mutex_unlock(&_exposed_lock);
+  if (stat) {
+    if (e) free(e);
+    return err(dliteMemoryError, "allocation failure");
+  }
+
+  if (r->inst != inst || r->generation != generation) {
+    memset(r, 0, sizeof(ExposedRecord));
+    r->inst = inst;
+    r->generation = generation;
+  }
+  if (i < EXPOSED_NBITS) r->bits[i / 64] |= (uint64_t)1 << (i % 64);
+  return 0;
+}
+
+/* Removes `inst` from the table of exposed properties. */
+static void _instance_clear_exposed(DLiteInstance *inst)
+{
+  uint8_t **v;
+  if (!sync_load_int(&_nexposed)) return;
+  mutex_lock(&_exposed_lock);
+  if ((v = map_get(&_exposed, inst->uuid))) {
+    free(*v);
+    map_remove(&_exposed, inst->uuid);
+    sync_add_int(&_nexposed, -1);
+    sync_add_int(&_exposed_generation, 1);
+    if (_exposed.base.nnodes == 0) {
+      map_deinit(&_exposed);
+      map_init(&_exposed);
+    }
+  }
+  mutex_unlock(&_exposed_lock);
+}
+
+
+/********************************************************************
+ *  Shared arrays
+ *
+ *  Snapshots share arrays of non-allocated types with the instance
+ *  they are made from until one of them modifies the array
+ *  (copy-on-write).  Shared arrays are reference counted in a table
+ *  mapping the address of the array to the number of instances
+ *  referring to it.  Only instances with the dliteShared flag set are
+ *  looked up, so other instances are unaffected.
+ *
+ *  The table is not a part of the global state, since shared arrays
+ *  may be released when instances are freed, which may happen after
+ *  the global state has been freed.
+ ********************************************************************/
+
+/* Table of shared arrays and the lock protecting it. */
+static map_int_t _shared;
+static Mutex _shared_lock = MUTEX_INITIALIZER;
+
+/* Writes key for array `ptr` in the table of shared arrays to `key`. */
+static void _shared_key(char *key, size_t size, const void *ptr)
+{
+  snprintf(key, size, "%p", ptr);
+}
+
+/*
+  Returns non-zero if array `ptr` of `inst` is shared with other
+  instances.
+ */
+static int _instance_in_shared(const DLiteInstance *inst, const void *ptr)
+{
+  char key[32];
+  int *v;
+  if (!ptr || !(inst->_flags & dliteShared)) return 0;
+  _shared_key(key, sizeof(key), ptr);
+  mutex_lock(&_shared_lock);
+  v = map_get(&_shared, key);
+  mutex_unlock(&_shared_lock);
+  return (v) ? 1 : 0;
+}
+
+/*
+  Adds a reference to array `ptr`.  An array that is not already
+  shared gets two references, one for its owner and one for the new
+  instance referring to it.
+
+  Returns non-zero on error.
+ */
+static int _shared_add(const void *ptr)
+{
+  char key[32];
+  int *v, stat=0;
+  _shared_key(key, sizeof(key), ptr);
+  mutex_lock(&_shared_lock);
+  if ((v = map_get(&_shared, key)))
+    (*v)++;
+  else
+    stat = map_set(&_shared, key, 2);
+  mutex_unlock(&_shared_lock);
+  if (stat) return err(dliteMemoryError, "allocation failure");
+  return 0;
+}
+
+/*
+  Releases the reference of `inst` to array `ptr`.
+
+  Returns non-zero if `ptr` is shared, in which case it is still
+  referred to by another instance and must not be freed by `inst`.
+ */
+static int _instance_release_shared(const DLiteInstance *inst,
+                                    const void *ptr)
+{
+  char key[32];
+  int *v;
+  if (!ptr || !(inst->_flags & dliteShared)) return 0;
+  _shared_key(key, sizeof(key), ptr);
+  mutex_lock(&_shared_lock);
+  if ((v = map_get(&_shared, key)) && --(*v) <= 1)
+    map_remove(&_shared, key);
+  if (_shared.base.nnodes == 0) {
+    map_deinit(&_shared);
+    map_init(&_shared);
+  }
+  mutex_unlock(&_shared_lock);
+  return (v) ? 1 : 0;
+}
+
+/*
+  If array property `i` of `inst` is shared with other instances,
+  replace it with a newly allocated private array of `nbytes` bytes.
+  The content is copied if `copy` is non-zero.
+
+  Returns non-zero on error.
+ */
+static int _instance_unshare_array(DLiteInstance *inst, size_t i,
+                                   size_t nbytes, int copy)
+{
+  void **ptr = DLITE_PROP(inst, i);
+  void *q;
+  if (!_instance_in_shared(inst, *ptr)) return 0;
+  _instance_clear_capacity(inst, i);
+  if (!(q = malloc((nbytes) ? nbytes : 1)))
+    return err(dliteMemoryError, "allocation failure");
+  if (copy) memcpy(q, *ptr, nbytes);
+
+  /* The other instances may have released the array meanwhile */
+  if (!_instance_release_shared(inst, *ptr)) free(*ptr);
+  *ptr = q;
+  return 0;
+}
+
+
+/********************************************************************
+ *  Borrowed buffers
+ *
+ *  An instance may borrow a buffer (like a loaded BSON document) and
+ *  let its array properties point directly into it.  The buffers are
+ *  kept in a global table mapping the UUID of the borrowing instance
+ *  to the buffer.  Only instances with the dliteBorrowed flag set are
+ *  looked up, so instances not borrowing any buffer are unaffected.
+ ********************************************************************/
+
+/* A buffer borrowed by an instance. */
+typedef struct {
+  void *buf;                /* Start of buffer */
+  size_t size;              /* Size of buffer in bytes */
+  DLiteBufferFree freefun;  /* Function releasing the buffer. May be NULL. */
+} BorrowedBuffer;
+
+typedef map_t(BorrowedBuffer) borrowed_map_t;
+
+/* Global table of borrowed buffers. */
+typedef struct {
+  Mutex lock;           /* Protects `map` */
+  borrowed_map_t map;   /* Maps UUIDs to borrowed buffers */
+} BorrowStore;
+
+/* Lock serialising lazy creation of the borrow store. */
+static Mutex _bstore_init_lock = MUTEX_INITIALIZER;
+
+/* Frees the borrow store.  Remaining buffers are released. */
+static void _borrow_store_free(void *borrow_store)
+{
+  BorrowStore *bstore = borrow_store;
+  const char *uuid;
+  map_iter_t iter = map_iter(&bstore->map);
+  while ((uuid = map_next(&bstore->map, &iter))) {
+    BorrowedBuffer *b = map_get(&bstore->map, uuid);
+    if (b->freefun) b->freefun(b->buf);
+  }
+  map_deinit(&bstore->map);
+  mutex_destroy(&bstore->lock);
+  free(bstore);
+}
+
+/* Returns pointer to the borrow store or NULL on error. */
+static BorrowStore *_borrow_store(void)
+{
+  BorrowStore *bstore = dlite_globals_get_state("dlite-borrow-store");
+  if (!bstore) {
+    mutex_lock(&_bstore_init_lock);
+    if (!(bstore = dlite_globals_get_state("dlite-borrow-store"))) {
+      if (!(bstore = malloc(sizeof(BorrowStore)))) {
+        mutex_unlock(&_bstore_init_lock);
+        return err(dliteMemoryError, "allocation failure"), NULL;
+      }
+      mutex_init(&bstore->lock);
+      map_init(&bstore->map);
+      dlite_globals_add_state("dlite-borrow-store", bstore,
+                              _borrow_store_free);
+    }
+    mutex_unlock(&_bstore_init_lock);
+  }
+  return bstore;
+}
+
+/*
+  Copies the buffer borrowed by `inst` to `b`.
+  Returns non-zero if `inst` is not borrowing any buffer.
+ */
+static int _instance_get_borrowed(const DLiteInstance *inst,
+                                  BorrowedBuffer *b)
+{
+  BorrowStore *bstore;
+  BorrowedBuffer *v;
+  if (!(inst->_flags & dliteBorrowed)) return 1;
+  if (!(bstore = _borrow_store())) return 1;
+  mutex_lock(&bstore->lock);
+  if ((v = map_get(&bstore->map, inst->uuid))) *b = *v;
+  mutex_unlock(&bstore->lock);
+  return (v) ? 0 : 1;
+}
+
+/*
+  Returns non-zero if `ptr` points into the buffer borrowed by `inst`.
+ */
+static int _instance_in_borrowed(const DLiteInstance *inst, const void *ptr)
+{
+  BorrowedBuffer b;
+  if (!ptr || _instance_get_borrowed(inst, &b)) return 0;
+  return ((const char *)ptr >= (const char *)b.buf &&
+          (const char *)ptr < (const char *)b.buf + b.size);
+}
+
+/*
+  Returns non-zero if the array pointed to by `ptr` is not owned by
+  `inst`, i.e. it is located in the arena or in a borrowed buffer.
+ */
+static int _instance_not_owned(const DLiteInstance *inst, const void *ptr)
+{
+  return _instance_in_arena(inst, ptr) || _instance_in_borrowed(inst, ptr);
+}
+
+/*
+  Frees array `ptr` of `inst`, unless it is not owned by `inst` or
+  still shared with other instances.
+ */
+static void _instance_free_array(DLiteInstance *inst, void *ptr)
+{
+  if (!_instance_not_owned(inst, ptr) && !_instance_release_shared(inst, ptr))
+    free(ptr);
+}
+
+/*
+  If array property `i` of `inst` is a view into a borrowed buffer or
+  shared with other instances, replace it with a newly allocated copy
+  of its first `nbytes` bytes.
+
+  Returns non-zero on error.
+ */
+static int _instance_own_array(DLiteInstance *inst, size_t i, size_t nbytes)
+{
+  void **ptr = DLITE_PROP(inst, i);
+  void *q;
+  if (_instance_unshare_array(inst, i, nbytes, 1)) return -1;
+  if (!_instance_in_borrowed(inst, *ptr)) return 0;
+  _instance_clear_capacity(inst, i);
+  if (!(q = malloc((nbytes) ? nbytes : 1)))
+    return err(dliteMemoryError, "allocation failure");
+  memcpy(q, *ptr, nbytes);
+  *ptr = q;
+  return 0;
+}
+
+/*
+  Copy-on-write.  Like _instance_own_array(), but copies the whole
+  array of property `i`.  Does nothing for scalar properties.
+
+  Returns non-zero on error.
+ */
+static int _instance_cow(DLiteInstance *inst, size_t i)
+{
+  DLiteProperty *p = inst->meta->_properties + i;
+  size_t nmemb=1;
+  int j;
+  if (p->ndims <= 0 || !(inst->_flags & (dliteBorrowed | dliteShared)))
+    return 0;
+  for (j=0; j < p->ndims; j++) nmemb *= DLITE_PROP_DIM(inst, i, j);
+  return _instance_own_array(inst, i, nmemb * p->size);
+}
+
+/*
+  Returns a pointer to data for property `i` or NULL on error.
+
+  If `writable` is non-zero, the caller may write through the returned
+  pointer.  A mutable instance can then no longer share the property
+  with its snapshots or a borrowed buffer and the property is recorded
+  as exposed.
+ */
+static void *_instance_get_property(const DLiteInstance *inst, size_t i,
+                                    int writable)
+{
+  void *ptr;
+  if (!inst->meta)
+    return errx(dliteMissingMetadataError, "no metadata available"), NULL;
+  if (i >= inst->meta->_nproperties)
+    return errx(dliteIndexError, "index %d exceeds number of properties (%d) in %s",
+		(int)i, (int)inst->meta->_nproperties, inst->meta->uri), NULL;
+  if (dlite_instance_sync_to_dimension_sizes((DLiteInstance *)inst))
+    return NULL;
+  if (inst->meta->_saveprop &&
+      inst->meta->_saveprop((DLiteInstance *)inst, i)) return NULL;
+  if (writable) {
+    if (!(inst->_flags & dliteImmutable) &&
+        _instance_cow((DLiteInstance *)inst, i)) return NULL;
+    if (_instance_set_exposed(inst, i)) return NULL;
+  }
+  ptr = DLITE_PROP(inst, i);
+  if (inst->meta->_properties[i].ndims > 0)
+    ptr = *(void **)ptr;
+  return ptr;
+}
+
+/*
+  Removes the buffer borrowed by `inst` from the borrow store and
+  releases it.  Should only be called when no properties point into
+  the buffer.
+ */
+static void _instance_release_borrowed(DLiteInstance *inst)
+{
+  BorrowStore *bstore;
+  BorrowedBuffer *v, b;
+  if (!(inst->_flags & dliteBorrowed)) return;
+  if (!(bstore = _borrow_store())) return;
+  mutex_lock(&bstore->lock);
+  if ((v = map_get(&bstore->map, inst->uuid))) {
+    b = *v;
+    map_remove(&bstore->map, inst->uuid);
+  }
+  mutex_unlock(&bstore->lock);
+  inst->_flags &= ~dliteBorrowed;
+  if (v && b.freefun) b.freefun(b.buf);
+}
 
-  iter = map_iter(istore);
-  *nuuids = 0;
-  while ((uuid = map_next(istore, &iter))) (*nuuids)++;
+/*
+  Lets `inst` borrow the `size` bytes long buffer `buf`.  Array
+  properties may then be turned into views into the buffer with
+  dlite_instance_borrow_property_by_index().
 
-  char** uuids;
-  if (!(uuids = calloc((*nuuids + 1), sizeof(char*))))
-    FAILCODE(dliteMemoryError, "allocation failure");
+  If `freefun` is not NULL, `inst` takes over the ownership of `buf`
+  and calls `freefun` on it when the instance is free'ed.  Otherwise
+  the caller must keep `buf` alive as long as `inst` exists.
 
-  int i = 0;
-  iter = map_iter(istore);
-  while ((uuid = map_next(istore, &iter))) {
-    if (!(uuids[i] = malloc(DLITE_UUID_LENGTH + 1)))
-      FAILCODE(dliteMemoryError, "allocation failure");
-    strcpy(uuids[i], uuid);
-    i++;
-  }
-  uuids[i] = NULL;
-  return uuids;
+  An instance can only borrow one buffer at a time.
 
- fail:
-  if (uuids) {
-    for (i=0; uuid[i]; i++) free(uuids[i]);
-    free(uuids);
-  }
-  return NULL;
+  Returns non-zero on error.
+ */
+int dlite_instance_borrow_buffer(DLiteInstance *inst, void *buf, size_t size,
+                                 DLiteBufferFree freefun)
+{
+  BorrowStore *bstore;
+  BorrowedBuffer b;
+  int stat=0;
+  if (inst->_flags & dliteBorrowed)
+    return errx(dliteValueError, "instance is already borrowing a buffer: %s",
+                (inst->uri) ? inst->uri : inst->uuid);
+  if (!(bstore = _borrow_store())) return -1;
+  b.buf = buf;
+  b.size = size;
+  b.freefun = freefun;
+  mutex_lock(&bstore->lock);
+  if (map_set(&bstore->map, inst->uuid, b)) stat = 1;
+  mutex_unlock(&bstore->lock);
+  if (stat) return err(dliteMemoryError, "allocation failure");
+  inst->_flags |= dliteBorrowed;
+  return 0;
 }
 
-/********************************************************************
- *  Instances
- ********************************************************************/
-
 /*
-  Help function that evaluates array of instance property dimension
-  values, where `dims` is the instance dimensions.  It assigns the
-  `propdims` memory section of `inst`.
+  Lets array property `i` of `inst` be a view into the buffer borrowed
+  by `inst`, starting at `ptr`.  The whole array must be within the
+  borrowed buffer and `ptr` must be suitably aligned.  Only properties
+  whos type does not allocate additional memory can be borrowed.
 
-  Returns non-zero in error.
+  The previous array of property `i` is free'ed.  Its content is not
+  copied.
+
+  Returns non-zero on error.
  */
-static int _instance_propdims_eval(DLiteInstance *inst, const size_t *dims)
+int dlite_instance_borrow_property_by_index(DLiteInstance *inst, size_t i,
+                                            void *ptr)
 {
-  int retval = 1;
-  const DLiteMeta *meta = inst->meta;
-  size_t *propdims = (size_t *)((char *)inst + meta->_propdimsoffset);
-  size_t i, n=0;
-  InfixCalcVariable *vars=NULL;
+  DLiteProperty *p;
+  BorrowedBuffer b;
+  size_t nmemb=1, align;
+  void **q;
+  int j;
+  if (i >= inst->meta->_nproperties)
+    return errx(dliteIndexError, "property index %d out of range: %s",
+                (int)i, inst->meta->uri);
+  p = inst->meta->_properties + i;
+  if (p->ndims <= 0)
+    return errx(dliteValueError, "cannot borrow scalar property: %s",
+                p->name);
+  if (dlite_type_is_allocated(p->type))
+    return errx(dliteTypeError, "cannot borrow property '%s' of type %s",
+                p->name, dlite_type_get_enum_name(p->type));
+  if (_instance_get_borrowed(inst, &b))
+    return errx(dliteValueError, "instance is not borrowing a buffer: %s",
+                (inst->uri) ? inst->uri : inst->uuid);
+  for (j=0; j < p->ndims; j++) nmemb *= DLITE_PROP_DIM(inst, i, j);
+  if ((char *)ptr < (char *)b.buf ||
+      (char *)ptr + nmemb * p->size > (char *)b.buf + b.size)
+    return errx(dliteIndexError, "property '%s' is not within the borrowed "
+                "buffer", p->name);
+  align = dlite_type_get_alignment(p->type, p->size);
+  if (align && (uintptr_t)ptr % align)
+    return errx(dliteValueError, "borrowed data for property '%s' is not "
+                "aligned", p->name);
+  q = DLITE_PROP(inst, i);
+  _instance_free_array(inst, *q);
+  _instance_clear_capacity(inst, i);
+  *q = ptr;
+  _instance_hash_mark(inst, i, hashDirty);
+  return 0;
+}
 
-  if (!(vars = calloc(meta->_ndimensions, sizeof(InfixCalcVariable))))
-    FAILCODE(dliteMemoryError, "allocation failure");
-  for (i=0; i < meta->_ndimensions; i++) {
-    vars[i].name = meta->_dimensions[i].name;
-    vars[i].value = dims[i];
-  }
+/*
+  Returns non-zero if array property `i` of `inst` is a view into a
+  borrowed buffer.
+ */
+int dlite_instance_is_borrowed(const DLiteInstance *inst, size_t i)
+{
+  if (i >= inst->meta->_nproperties || inst->meta->_properties[i].ndims <= 0)
+    return 0;
+  return _instance_in_borrowed(inst, *(void **)DLITE_PROP(inst, i));
+}
 
-  for (i=0; i < meta->_nproperties; i++) {
-    DLiteProperty *p = meta->_properties + i;
-    int j;
-    char errmsg[256] = "";
-    for (j=0; j < p->ndims; j++)
-      propdims[n++] = infixcalc(p->shape[j], vars, meta->_ndimensions,
-                                errmsg, sizeof(errmsg));
-    if (errmsg[0]) FAILCODE1(dliteSyntaxError, "invalid property dimension expression: %s", errmsg);
-  }
-  assert(n == meta->_npropdims);
+/*
+  Replaces all views into the buffer borrowed by `inst` with copies
+  owned by the instance and releases the buffer.
 
-  retval = 0;
- fail:
-  if (vars) free(vars);
-  return retval;
+  Returns non-zero on error.
+ */
+int dlite_instance_unborrow(DLiteInstance *inst)
+{
+  size_t i;
+  if (!(inst->_flags & dliteBorrowed)) return 0;
+  for (i=0; i < inst->meta->_nproperties; i++)
+    if (_instance_cow(inst, i)) return -1;
+  _instance_release_borrowed(inst);
+  return 0;
 }
 
 
@@ -417,16 +1764,18 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
                                        const char *id, int lookup)
 {
   char uuid[DLITE_UUID_LENGTH+1];
-  size_t i, size;
-  DLiteInstance *inst=NULL;
-  int j, idtype;
+  size_t i, size, arenasize=0;
+  size_t propdimsbuf[NSTACK], *propdims=propdimsbuf;
+  size_t offsetsbuf[NSTACK], *offsets=offsetsbuf;
+  DLiteInstance *inst=NULL, *existing=NULL;
+  int j, idtype, stat;
 
   /* Check if we are trying to create an instance with an already
      existing id. */
-  if (lookup && id && *id && (inst = _instance_store_get(id))) {
-    dlite_instance_incref(inst);
+  if (lookup && id && *id && (inst = _instance_store_getref(id))) {
     warn("trying to create new instance with id '%s' - creates a new "
-        "reference instead (refcount=%d)", id, inst->_refcount);
+        "reference instead (refcount=%d)", id,
+        sync_load_int(&inst->_refcount));
 
     /* Check that `dims` corresponds to the dims of the existing instance. */
     for (i=0; i < meta->_ndimensions; i++) {
@@ -439,13 +1788,29 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
   }
 
   /* Make sure that metadata is initialised */
-  if (!meta->_propoffsets && dlite_meta_init((DLiteMeta *)meta)) goto fail;
+  if (_meta_ensure_init((DLiteMeta *)meta)) goto fail;
   if (_instance_store_add((DLiteInstance *)meta) < 0) goto fail;
 
-  /* Allocate instance */
+  /* Allocate instance.  In arena mode, the property dimensions must be
+     evaluated first, since they determine the size of the arena. */
   if (!(size = dlite_instance_size(meta, dims))) goto fail;
-  if (!(inst = calloc(1, size))) FAILCODE(dliteMemoryError, "allocation failure");
+  if (dlite_instance_use_arena() && !dlite_meta_is_metameta(meta)) {
+    if (meta->_npropdims > NSTACK &&
+        !(propdims = malloc(meta->_npropdims * sizeof(size_t))))
+      FAILCODE(dliteMemoryError, "allocation failure");
+    if (_propdims_eval(meta, dims, propdims)) goto fail;
+    if (meta->_nproperties > NSTACK &&
+        !(offsets = malloc(meta->_nproperties * sizeof(size_t))))
+      FAILCODE(dliteMemoryError, "allocation failure");
+    arenasize = _arena_layout(meta, propdims, size + sizeof(size_t), offsets);
+  }
+  if (!(inst = calloc(1, (arenasize) ? arenasize : size)))
+    FAILCODE(dliteMemoryError, "allocation failure");
   dlite_instance_incref(inst);  /* increase refcount of the new instance */
+  if (arenasize) {
+    inst->_flags |= dliteArena;
+    *(size_t *)((char *)inst + size) = arenasize;
+  }
 
   /* Initialise header */
   if ((idtype = dlite_get_uuid(uuid, id)) < 0) goto fail;
@@ -460,7 +1825,11 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
   }
 
   /* Evaluate property dimensions */
-  if (_instance_propdims_eval(inst, dims)) goto fail;
+  if (arenasize)
+    memcpy(DLITE_PROP_DIMS(inst, 0), propdims,
+           meta->_npropdims * sizeof(size_t));
+  else if (_instance_propdims_eval(inst, dims))
+    goto fail;
 
   /* Allocate arrays for dimensional properties */
   for (i=0; i<meta->_nproperties; i++) {
@@ -470,13 +1839,18 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
       size_t nmemb=1, size=p->size;
       for (j=0; j<p->ndims; j++)
         nmemb *= DLITE_PROP_DIM(inst, i, j);
-      if (nmemb > 0) {
+      if (nmemb > 0 && arenasize) {
+        *ptr = (char *)inst + offsets[i];
+      } else if (nmemb > 0) {
         if (!(*ptr = calloc(nmemb, size))) goto fail;
       } else {
         *ptr = NULL;
       }
     }
   }
+  if (propdims != propdimsbuf) free(propdims);
+  if (offsets != offsetsbuf) free(offsets);
+  propdims = offsets = NULL;
 
   /* Further initialisation if metadata..,  */
   if (dlite_meta_is_metameta(meta) && dlite_meta_init((DLiteMeta *)inst))
@@ -487,14 +1861,24 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
      needed, they should be called by _init(). */
   if (meta->_init && meta->_init(inst)) goto fail;
 
-  /* Add to instance cache */
-  if (_instance_store_add(inst)) goto fail;
+  /* Add to instance cache.  If another thread has created an instance
+     with the same id since the lookup above, a new reference to it is
+     returned instead, just like if the lookup had found it. */
+  if ((stat = _instance_store_add(inst))) {
+    if (stat == 1 && lookup) existing = _instance_store_getref(inst->uuid);
+    if (!existing && stat == 1)
+      errx(dliteValueError, "instance with id '%s' already exists",
+           inst->uuid);
+    goto fail;
+  }
 
   /* Increase reference count of metadata */
   dlite_meta_incref((DLiteMeta *)meta);
 
   return inst;
  fail:
+  if (propdims && propdims != propdimsbuf) free(propdims);
+  if (offsets && offsets != offsetsbuf) free(offsets);
   if (inst) {
     /* `dlite_instance_decref(inst)` will decrease the reference count
        to the metadata, but on failure we haven't increased it yet, so
@@ -502,7 +1886,7 @@ static DLiteInstance *_instance_create(const DLiteMeta *meta,
     if (inst->meta) dlite_meta_incref((DLiteMeta *)inst->meta);
     dlite_instance_decref(inst);
   }
-  return NULL;
+  return existing;
 }
 
 /*
@@ -565,7 +1949,7 @@ static int dlite_instance_free(DLiteInstance *inst)
   if (meta->_deinit) meta->_deinit(inst);
 
   /* Remove from instance cache */
-  stat = _instance_store_remove(inst->uuid);
+  stat = _instance_store_remove(inst);
 
   /* For transactions, decrease refcount of parent */
   if (inst->_parent) {
@@ -574,6 +1958,9 @@ static int dlite_instance_free(DLiteInstance *inst)
     free(inst->_parent);
   }
 
+  /* Free compiled property dimension expressions of metadata */
+  if (dlite_instance_is_meta(inst)) _propdimexprs_free((DLiteMeta *)inst);
+
   /* Standard free */
   nprops = meta->_nproperties;
   if (inst->uri) free((char *)inst->uri);
@@ -592,12 +1979,16 @@ static int dlite_instance_free(DLiteInstance *inst)
             for (n=0; n<nmemb; n++)
               dlite_type_clear(memptr + n*p->size, p->type, p->size);
         }
-        free(*(void **)ptr);
+        _instance_free_array(inst, *(void **)ptr);
       } else {
         dlite_type_clear(ptr, p->type, p->size);
       }
     }
   }
+  _instance_release_borrowed(inst);
+  _instance_release_hashcache(inst);
+  _instance_clear_capacity(inst, -1);
+  _instance_clear_exposed(inst);
   free(inst);
 
   dlite_meta_decref((DLiteMeta *)meta);  /* decrease metadata refcount */
@@ -615,7 +2006,7 @@ int dlite_instance_incref(DLiteInstance *inst)
   DEBUG_LOG("+++ incref: %2d -> %2d : %s\n",
             inst->_refcount, inst->_refcount+1,
             (inst->uri) ? inst->uri : inst->uuid);
-  return ++inst->_refcount;
+  return sync_add_int(&inst->_refcount, 1);
 }
 
 /*
@@ -630,8 +2021,9 @@ int dlite_instance_decref(DLiteInstance *inst)
   DEBUG_LOG("--- decref: %2d -> %2d : %s\n",
             inst->_refcount, inst->_refcount-1,
             (inst->uri) ? inst->uri : inst->uuid);
-  assert(inst->_refcount > 0);
-  if ((count = --inst->_refcount) == 0) {
+  count = sync_add_int(&inst->_refcount, -1);
+  assert(count >= 0);
+  if (count == 0) {
       if (dlite_instance_free(inst) == -1) return -1;
   }
   return count;
@@ -667,32 +2059,23 @@ DLiteInstance *dlite_instance_has(const char *id, bool check_storages)
 }
 
 
-/*
-  Returns a new reference to instance with given `id` or NULL if no such
-  instance can be found.
-
-  If the instance exists in the in-memory store it is returned (with
-  its refcount increased by one).  Otherwise it is searched for in the
-  storage plugin path (initiated from the DLITE_STORAGES environment
-  variable).
+/* Loader passed to dlite_storage_paths_load(). */
+static DLiteInstance *_instance_load_from_paths(const DLiteStorage *s,
+                                                const char *id)
+{
+  return _instance_load_casted(s, id, NULL, 0);
+}
 
-  It is an error message if the instance cannot be found.
-*/
-DLiteInstance *dlite_instance_get(const char *id)
+/* Help function for dlite_instance_get() that searches for instance
+   `id` in the hotlisted storages, the storage path and online.
+   Returns a new reference or NULL if it cannot be found. */
+static DLiteInstance *_instance_search(const char *id)
 {
   DLiteInstance *inst=NULL;
   DLiteStorageHotlistIter hiter;
   const DLiteStorage *hs;
-  DLiteStoragePathIter *iter;
-  const char *url;
 
-  /* check if instance `id` is already instantiated... */
-  if ((inst = _instance_store_get(id))) {
-    dlite_instance_incref(inst);
-    return inst;
-  }
-
-  /* ...otherwise look it up in hotlisted storages */
+  /* Look it up in hotlisted storages */
   dlite_storage_hotlist_iter_init(&hiter);
   while ((hs = dlite_storage_hotlist_iter_next(&hiter))) {
     DLiteInstance *inst;
@@ -709,88 +2092,15 @@ DLiteInstance *dlite_instance_get(const char *id)
   dlite_storage_hotlist_iter_deinit(&hiter);
 
   /* ...otherwise look it up in storages */
-  if (!(iter = dlite_storage_paths_iter_start())) return NULL;
-
-  assert(iter);
-  while ((url = dlite_storage_paths_iter_next(iter))) {
-    DLiteStorage *s;
-    char *copy, *driver, *location, *options;
-
-    if (!(copy = strdup(url))) {
-      err(dliteMemoryError, "allocation failure");
-      break;
-    }
-#ifdef _WIN32
-    /* Hack: on Window, don't interpreat the "C" in urls starting with
-       "C:\" or "C:/" as a driver, but rather as a part of the location...
-
-       The concequence of this is that we cannot have a driver named
-       "C" on Windows.
-    */
-    dlite_split_url_winpath(copy, &driver, &location, &options, NULL, 1);
-#else
-    dlite_split_url(copy, &driver, &location, &options, NULL);
-#endif
-
-    /* If driver is not given, infer it from file extension */
-    if (!driver || !*driver) driver = (char *)fu_fileext(location);
-
-    /* Set read-only as default mode (all drivers should support this) */
-    if (!options) options = "mode=r";
-    ErrTry:
-      s = dlite_storage_open(driver, location, options);
-    ErrCatch(dliteStorageOpenError):  // suppressed error
-    ErrCatch(dliteStorageLoadError):  // suppressed error
-      break;
-    ErrEnd;
-    if (s) {
-
-      /* url is a storage we can open... */
-      ErrTry:
-        inst = _instance_load_casted(s, id, NULL, 0);
-      ErrCatch(dliteStorageLoadError):  // suppressed error
-        break;
-      ErrEnd;
-
-      dlite_storage_close(s);
-    } else {
-      /* ...otherwise it may be a glob pattern */
-      FUIter *fiter;
-      if ((fiter = fu_glob(location, "|"))) {
-        const char *path;
-        while (!inst && (path = fu_globnext(fiter))) {
-	  driver = (char *)fu_fileext(path);
-          ErrTry:
-            s = dlite_storage_open(driver, path, options);
-          ErrCatch(dliteStorageOpenError):  // suppressed error
-            break;
-          ErrEnd;
-          if (s) {
-            ErrTry:
-              inst = _instance_load_casted(s, id, NULL, 0);
-            ErrCatch(dliteStorageLoadError):  // suppressed error
-              break;
-            ErrEnd;
-	    dlite_storage_close(s);
-	  }
-        }
-        fu_globend(fiter);
-      }
-    }
-    free(copy);
-    if (inst) {
-      dlite_storage_paths_iter_stop(iter);
-      return inst;
-    }
-  }
-  dlite_storage_paths_iter_stop(iter);
+  if ((inst = dlite_storage_paths_load(id, _instance_load_from_paths)))
+    return inst;
 
   /* Try to fetch the instance from http://onto-ns.com/ */
   if (strncmp(id, "http://", 7) == 0 || strncmp(id, "https://", 8) == 0) {
-    static const char *saved_id = NULL;
+    /* Guard against infinite recursion.  Thread local, since other
+       threads may concurrently fetch the same id. */
+    static _thread_local const char *saved_id = NULL;
     if (!(saved_id && strcmp(saved_id, id) == 0)) {
-      /* FIXME: There is a small chance for a race-condition when used
-         in a multi-threaded environment. Add thread synchronisation here! */
       saved_id = id;
       ErrTry:
         inst = dlite_instance_load_loc("http", id, NULL, NULL);
@@ -805,6 +2115,41 @@ DLiteInstance *dlite_instance_get(const char *id)
   return NULL;
 }
 
+/*
+  Returns a new reference to instance with given `id` or NULL if no such
+  instance can be found.
+
+  If the instance exists in the in-memory store it is returned (with
+  its refcount increased by one).  Otherwise it is searched for in the
+  storage plugin path (initiated from the DLITE_STORAGES environment
+  variable).
+
+  It is an error message if the instance cannot be found.
+*/
+DLiteInstance *dlite_instance_get(const char *id)
+{
+  DLiteInstance *inst;
+  LoadMarker *marker=NULL;
+  char uuid[DLITE_UUID_LENGTH+1];
+  int wait;
+
+  /* check if instance `id` is already instantiated... */
+  if ((inst = _instance_store_getref(id))) return inst;
+
+  /* ...otherwise search for it.  Concurrent searches for the same id
+     would load it more than once, so if another thread already is
+     loading it, wait for it and check the store again. */
+  if (dlite_get_uuid(uuid, id) >= 0) {
+    while ((marker = _instance_store_begin_load(uuid, &wait)) && wait) {
+      _instance_store_wait_load(marker);
+      if ((inst = _instance_store_getref(id))) return inst;
+    }
+  }
+  inst = _instance_search(id);
+  if (marker) _instance_store_end_load(uuid, marker);
+  return inst;
+}
+
 /*
   Like dlite_instance_get(), but maps the instance with the given id
   to an instance of `metaid`.  If `metaid` is NULL, it falls back to
@@ -846,6 +2191,9 @@ DLiteInstance *dlite_instance_load(const DLiteStorage *s, const char *id)
 
   The `id` argument may be NULL if the storage contains only one instance.
 
+  The storage is obtained from the storage pool, such that loading
+  several instances from the same location only opens it once.
+
   Returns the instance or NULL on error.
  */
 DLiteInstance *dlite_instance_load_loc(const char *driver, const char *location,
@@ -854,19 +2202,17 @@ DLiteInstance *dlite_instance_load_loc(const char *driver, const char *location,
   DLiteStorage *s=NULL;
   DLiteInstance *inst=NULL;
  ErrTry:
-  if (id && *id) inst = _instance_store_get(id);
+  if (id && *id) inst = _instance_store_getref(id);
  ErrOther:
   err_clear();
  ErrEnd;
 
- if (inst) {
-   dlite_instance_incref(inst);
-  } else {
-    if (!(s = dlite_storage_open(driver, location, options))) goto fail;
+  if (!inst) {
+    if (!(s = dlite_storage_pool_open(driver, location, options))) goto fail;
     if (!(inst = dlite_instance_load(s, id))) goto fail;
   }
  fail:
-  if (s) dlite_storage_close(s);
+  if (s) dlite_storage_pool_release(s);
   return inst;
 }
 
@@ -917,8 +2263,7 @@ DLiteInstance *_instance_load_casted(const DLiteStorage *s, const char *id,
                    "invalid storage, see previous errors");
 
   /* check if id is already loaded */
-  if (lookup && id && *id && (inst = _instance_store_get(id))) {
-    dlite_instance_incref(inst);
+  if (lookup && id && *id && (inst = _instance_store_getref(id))) {
     //warn("trying to load existing instance from storage \"%s\": %s"
     //     " - create a new reference", s->location, id);
     return inst;
@@ -954,7 +2299,7 @@ DLiteInstance *_instance_load_casted(const DLiteStorage *s, const char *id,
                        "cannot load metadata: %s", uri);
 
   /* Make sure that metadata is initialised */
-  if (dlite_meta_init(meta)) goto fail;
+  if (_meta_ensure_init(meta)) goto fail;
 
   /* check metadata uri */
   if (strcmp(uri, meta->uri) != 0)
@@ -983,8 +2328,11 @@ DLiteInstance *_instance_load_casted(const DLiteStorage *s, const char *id,
   /* assign properties */
   for (i=0; i<meta->_nproperties; i++) {
     DLiteProperty *p = (DLiteProperty *)meta->_properties + i;
-    void *ptr = (void *)dlite_instance_get_property_by_index(inst, i);
+    void *ptr;
     size_t *pdims = DLITE_PROP_DIMS(inst, i);
+    if (_instance_cow(inst, i)) goto fail;
+    ptr = _instance_get_property(inst, i, 0);
+    _instance_hash_mark(inst, i, hashDirty);
     if (dlite_datamodel_get_property(d, p->name, ptr, p->type, p->size,
 				     p->ndims, pdims)) {
       dlite_type_clear(ptr, p->type, p->size);
@@ -998,9 +2346,10 @@ DLiteInstance *_instance_load_casted(const DLiteStorage *s, const char *id,
 
   if (!inst->uri) {
     if (dlite_meta_is_metameta(inst->meta)) {
-      char **name = dlite_instance_get_property(inst, "name");
-      char **version = dlite_instance_get_property(inst, "version");
-      char **namespace = dlite_instance_get_property(inst, "namespace");
+      char *const *name = dlite_instance_get_property_const(inst, "name");
+      char *const *version = dlite_instance_get_property_const(inst, "version");
+      char *const *namespace =
+        dlite_instance_get_property_const(inst, "namespace");
       if (name && version && namespace) {
         inst->uri = dlite_join_meta_uri(*name, *version, *namespace);
         dlite_get_uuid(inst->uuid, inst->uri);
@@ -1047,6 +2396,80 @@ DLiteInstance *dlite_instance_load_casted(const DLiteStorage *s,
   return _instance_load_casted(s, id, metaid, 1);
 }
 
+/*
+  Loads the `n` instances with the given `ids` from storage `s` and
+  stores new references to them in `instances`, which must have space
+  for `n` pointers.
+
+  Instances that already are in memory are not reloaded.  The rest are
+  loaded with a single call to the loadInstances() plugin function if
+  the storage provides it and otherwise one by one.
+
+  Returns non-zero on error, in which case no references are left in
+  `instances`.
+ */
+int dlite_instance_load_many(const DLiteStorage *s, const char **ids,
+                             size_t n, DLiteInstance **instances)
+{
+  int retval=1;
+  size_t i, m=0, *idx=NULL;
+  const char **missing=NULL;
+  DLiteInstance **loaded=NULL;
+
+  if (!s) return errx(dliteStorageLoadError,
+                      "invalid storage, see previous errors");
+  memset(instances, 0, n*sizeof(DLiteInstance *));
+  if (!n) return 0;
+
+  if (!(idx = calloc(n, sizeof(size_t))) ||
+      !(missing = calloc(n, sizeof(char *))) ||
+      !(loaded = calloc(n, sizeof(DLiteInstance *))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+
+  /* pick instances that already are in memory */
+  for (i=0; i<n; i++) {
+    if (ids[i] && *ids[i] && (instances[i] = _instance_store_getref(ids[i])))
+      continue;
+    idx[m] = i;
+    missing[m++] = ids[i];
+  }
+
+  if (m && dlite_storage_plugin_api_version(s->api) >= 2 &&
+      s->api->loadInstances) {
+    if (dlite_storage_load_many(s, missing, m, loaded)) goto fail;
+    for (i=0; i<m; i++) instances[idx[i]] = loaded[i];
+  } else {
+    for (i=0; i<m; i++)
+      if (!(instances[idx[i]] = dlite_instance_load(s, missing[i])))
+        goto fail;
+  }
+  retval = 0;
+ fail:
+  if (retval) {
+    for (i=0; i<n; i++) {
+      if (instances[i]) dlite_instance_decref(instances[i]);
+      instances[i] = NULL;
+    }
+  }
+  if (idx) free(idx);
+  if (missing) free(missing);
+  if (loaded) free(loaded);
+  return retval;
+}
+
+/*
+  Checks that `inst` can be saved to storage `s` and synchronises its
+  properties.  Returns non-zero on error.
+ */
+static int _instance_save_prepare(DLiteStorage *s, const DLiteInstance *inst)
+{
+  if (!s) return errx(dliteStorageSaveError,
+                      "invalid storage, see previous errors");
+  if (!inst->meta)
+    return errx(dliteMissingMetadataError, "no metadata available");
+  return dlite_instance_sync_to_properties((DLiteInstance *)inst);
+}
+
 /*
   Saves instance `inst` to storage `s`.  Returns non-zero on error.
  */
@@ -1054,11 +2477,10 @@ int dlite_instance_save(DLiteStorage *s, const DLiteInstance *inst)
 {
   int retval=1;
   DLiteDataModel *d=NULL;
-  const DLiteMeta *meta;
+  const DLiteMeta *meta = inst->meta;
   size_t i, *dims;
 
-  if (!(meta = inst->meta)) return errx(dliteMissingMetadataError, "no metadata available");
-  if (dlite_instance_sync_to_properties((DLiteInstance *)inst)) goto fail;
+  if (_instance_save_prepare(s, inst)) return 1;
 
   /* check if storage implements the instance api */
   if (s->api->saveInstance)
@@ -1076,14 +2498,275 @@ int dlite_instance_save(DLiteStorage *s, const DLiteInstance *inst)
 
   for (i=0; i<meta->_nproperties; i++) {
     DLiteProperty *p = (DLiteProperty *)inst->meta->_properties + i;
-    const void *ptr = dlite_instance_get_property_by_index(inst, i);
+    const void *ptr = _instance_get_property(inst, i, 0);
     size_t *pdims = DLITE_PROP_DIMS(inst, i);
     if (dlite_datamodel_set_property(d, p->name, ptr, p->type, p->size,
 				     p->ndims, pdims)) goto fail;
   }
-  retval = 0;
+  retval = 0;
+ fail:
+  if (d) dlite_datamodel_free(d);
+  return retval;
+}
+
+/*
+  Saves the `n` instances in `instances` to storage `s`.
+
+  If the storage provides the saveInstances() plugin function, all
+  instances are passed to it in one call.  Otherwise they are saved
+  one by one with dlite_instance_save().
+
+  Returns non-zero on error.
+ */
+int dlite_instance_save_many(DLiteStorage *s, const DLiteInstance **instances,
+                             size_t n)
+{
+  int stat=0;
+  size_t i;
+
+  if (!s) return errx(dliteStorageSaveError,
+                      "invalid storage, see previous errors");
+  if (dlite_storage_plugin_api_version(s->api) < 2 ||
+      !s->api->saveInstances) {
+    for (i=0; i<n; i++) stat |= dlite_instance_save(s, instances[i]);
+    return stat;
+  }
+  for (i=0; i<n; i++)
+    if (_instance_save_prepare(s, instances[i])) return 1;
+  return (n) ? s->api->saveInstances(s, instances, n) : 0;
+}
+
+/* Shared state of the workers in dlite_instance_load_parallel() and
+   dlite_instance_save_parallel().  Only used with thread-safe storages. */
+typedef struct {
+  DLiteStorage *s;
+  const char **ids;               /* ids to load */
+  DLiteInstance **loaded;         /* loaded instances */
+  const DLiteInstance **saved;    /* instances to save */
+  int *evals;                     /* error value of each task */
+  char **msgs;                    /* error message of each task */
+} ParallelIO;
+
+/* Records the error in the current ErrTry block for task `i`, unless
+   it already has been recorded. */
+static void parallel_seterr(ParallelIO *io, size_t i, int defaulteval)
+{
+  if (io->msgs[i]) return;
+  io->evals[i] = (err_geteval()) ? err_geteval() : defaulteval;
+  io->msgs[i] = strdup(err_getmsg());
+}
+
+/* Loads instance `i`.  Errors are recorded in the thread-local error
+   record and stored in `io`, such that they can be reported in order
+   by the calling thread. */
+static void parallel_load(size_t i, void *data)
+{
+  ParallelIO *io = data;
+  ErrTry:
+    io->loaded[i] = io->s->api->loadInstance(io->s, io->ids[i]);
+    if (!io->loaded[i]) parallel_seterr(io, i, dliteStorageLoadError);
+  ErrOther:
+    parallel_seterr(io, i, dliteStorageLoadError);
+  ErrEnd;
+}
+
+/* Saves instance `i`. */
+static void parallel_save(size_t i, void *data)
+{
+  ParallelIO *io = data;
+  ErrTry:
+    if (io->s->api->saveInstance(io->s, io->saved[i]))
+      parallel_seterr(io, i, dliteStorageSaveError);
+  ErrOther:
+    parallel_seterr(io, i, dliteStorageSaveError);
+  ErrEnd;
+}
+
+/* Reports the errors of the `n` tasks in order.  Returns the error
+   value of the first failing task or zero if all succeeded. */
+static int parallel_report(ParallelIO *io, size_t n, const char *action,
+                           const char **ids)
+{
+  int retval=0;
+  size_t i;
+  for (i=0; i<n; i++) {
+    const char *msg = io->msgs[i], *name = dlite_errname(io->evals[i]);
+    size_t len = strlen(name);
+    if (!io->evals[i]) continue;
+    if (!msg || !*msg) msg = "unknown error";
+    if (strncmp(msg, name, len) == 0 && strncmp(msg+len, ": ", 2) == 0)
+      msg += len + 2;  /* strip error name, since errx() adds it */
+    errx(io->evals[i], "cannot %s '%s' %s storage '%s': %s", action,
+         (ids[i]) ? ids[i] : "", (io->loaded) ? "from" : "to",
+         io->s->location, msg);
+    if (!retval) retval = io->evals[i];
+  }
+  return retval;
+}
+
+/* Allocates per-task arrays of `io`.  Returns non-zero on error. */
+static int parallel_init(ParallelIO *io, DLiteStorage *s, size_t n)
+{
+  memset(io, 0, sizeof(ParallelIO));
+  io->s = s;
+  if (!(io->evals = calloc(n, sizeof(int))) ||
+      !(io->msgs = calloc(n, sizeof(char *))))
+    return err(dliteMemoryError, "allocation failure");
+  return 0;
+}
+
+/* Releases resources held by `io`. */
+static void parallel_deinit(ParallelIO *io, size_t n)
+{
+  size_t i;
+  if (io->msgs) {
+    for (i=0; i<n; i++) if (io->msgs[i]) free(io->msgs[i]);
+    free(io->msgs);
+  }
+  if (io->evals) free(io->evals);
+}
+
+/*
+  Like dlite_instance_load_many(), but loads the instances concurrently
+  using up to `nworkers` threads.  If `nworkers` is zero or negative,
+  the number of processors is used.  If it is one, this function is
+  equivalent to dlite_instance_load_many().
+
+  Returns non-zero on error, in which case no references are left in
+  `instances`.
+ */
+int dlite_instance_load_parallel(const DLiteStorage *s, const char **ids,
+                                 size_t n, DLiteInstance **instances,
+                                 int nworkers)
+{
+  int retval=1, *dups=NULL;
+  size_t i, m=0, *idx=NULL;
+  const char **missing=NULL;
+  char uuid[DLITE_UUID_LENGTH+1];
+  map_int_t first;  /* maps uuids to index in `missing` */
+  ParallelIO io;
+
+  /* Storages that are not thread safe, like the Python plugins that
+     must be called with the GIL held, are only called from the
+     calling thread */
+  if (nworkers == 1 || !s || !(s->flags & dliteThreadSafe) ||
+      !s->api->loadInstance)
+    return dlite_instance_load_many(s, ids, n, instances);
+  memset(instances, 0, n*sizeof(DLiteInstance *));
+  if (!n) return 0;
+
+  map_init(&first);
+  if (parallel_init(&io, (DLiteStorage *)s, n)) goto fail;
+  if (!(idx = calloc(n, sizeof(size_t))) ||
+      !(dups = calloc(n, sizeof(int))) ||
+      !(missing = calloc(n, sizeof(char *))) ||
+      !(io.loaded = calloc(n, sizeof(DLiteInstance *))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+
+  /* Pick instances that already are in memory.  Instances requested
+     more than once are only loaded once, since concurrent loads would
+     create separate instances with the same uuid. */
+  for (i=0; i<n; i++) {
+    int *j;
+    dups[i] = -1;
+    if (!ids[i] || !*ids[i] || dlite_get_uuid(uuid, ids[i]) < 0) {
+      err_clear();
+      idx[m] = i;
+      missing[m++] = ids[i];
+      continue;
+    }
+    if ((instances[i] = _instance_store_getref(ids[i]))) continue;
+    if ((j = map_get(&first, uuid))) {
+      dups[i] = *j;
+      continue;
+    }
+    if (map_set(&first, uuid, (int)m))
+      FAILCODE(dliteMemoryError, "allocation failure");
+    idx[m] = i;
+    missing[m++] = ids[i];
+  }
+
+  io.ids = missing;
+  sync_parallel_for(nworkers, m, parallel_load, &io);
+  if ((retval = parallel_report(&io, m, "load", missing))) goto fail;
+
+  for (i=0; i<m; i++) {
+    instances[idx[i]] = io.loaded[i];
+    io.loaded[i] = NULL;
+    /* Like dlite_storage_load(), add weak references to the storage
+       cache */
+    map_set(&(((DLiteStorage *)s)->cache), instances[idx[i]]->uuid,
+            instances[idx[i]]);
+  }
+  for (i=0; i<n; i++) {
+    if (dups[i] < 0) continue;
+    instances[i] = instances[idx[dups[i]]];
+    dlite_instance_incref(instances[i]);
+  }
+  retval = 0;
+ fail:
+  if (retval) {
+    for (i=0; i<n; i++) {
+      if (instances[i]) dlite_instance_decref(instances[i]);
+      instances[i] = NULL;
+    }
+    if (io.loaded)
+      for (i=0; i<m; i++)
+        if (io.loaded[i]) dlite_instance_decref(io.loaded[i]);
+  }
+  if (io.loaded) free(io.loaded);
+  parallel_deinit(&io, n);
+  map_deinit(&first);
+  if (idx) free(idx);
+  if (dups) free(dups);
+  if (missing) free(missing);
+  return retval;
+}
+
+/*
+  Like dlite_instance_save_many(), but saves the instances concurrently
+  using up to `nworkers` threads.  If `nworkers` is zero or negative,
+  the number of processors is used.  If it is one, this function is
+  equivalent to dlite_instance_save_many().
+
+  Returns non-zero on error.
+ */
+int dlite_instance_save_parallel(DLiteStorage *s,
+                                 const DLiteInstance **instances, size_t n,
+                                 int nworkers)
+{
+  int retval=1;
+  size_t i;
+  const char **ids=NULL;
+  ParallelIO io;
+
+  /* Storages that are not thread safe are only called from the
+     calling thread */
+  if (nworkers == 1 || !s || !(s->flags & dliteThreadSafe) ||
+      !s->api->saveInstance)
+    return dlite_instance_save_many(s, instances, n);
+  if (!n) return 0;
+
+  if (parallel_init(&io, s, n)) goto fail;
+  if (!(ids = calloc(n, sizeof(char *))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+
+  /* Synchronise properties before starting the workers, since it may
+     modify the instances */
+  for (i=0; i<n; i++) {
+    if (!instances[i]->meta)
+      FAILCODE(dliteMissingMetadataError, "no metadata available");
+    if (dlite_instance_sync_to_properties((DLiteInstance *)instances[i]))
+      goto fail;
+    ids[i] = (instances[i]->uri) ? instances[i]->uri : instances[i]->uuid;
+  }
+
+  io.saved = instances;
+  sync_parallel_for(nworkers, n, parallel_save, &io);
+  retval = parallel_report(&io, n, "save", ids);
  fail:
-  if (d) dlite_datamodel_free(d);
+  parallel_deinit(&io, n);
+  if (ids) free(ids);
   return retval;
 }
 
@@ -1292,20 +2975,22 @@ size_t dlite_instance_get_dimension_size_by_index(const DLiteInstance *inst,
  */
 void *dlite_instance_get_property_by_index(const DLiteInstance *inst, size_t i)
 {
-  void *ptr;
-  if (!inst->meta)
-    return errx(dliteMissingMetadataError, "no metadata available"), NULL;
-  if (i >= inst->meta->_nproperties)
-    return errx(dliteIndexError, "index %d exceeds number of properties (%d) in %s",
-		(int)i, (int)inst->meta->_nproperties, inst->meta->uri), NULL;
-  if (dlite_instance_sync_to_dimension_sizes((DLiteInstance *)inst))
-    return NULL;
-  if (inst->meta->_saveprop &&
-      inst->meta->_saveprop((DLiteInstance *)inst, i)) return NULL;
-  ptr = DLITE_PROP(inst, i);
-  if (inst->meta->_properties[i].ndims > 0)
-    ptr = *(void **)ptr;
-  return ptr;
+  return _instance_get_property(inst, i, 1);
+}
+
+/*
+  Like dlite_instance_get_property_by_index(), but returns a pointer
+  that must only be used for reading.
+
+  Unlike the writable accessor, this function neither unshares the
+  property from snapshots nor records it as exposed.  It should be
+  used by serialisers, storage plugins and other code that only reads
+  the instance.
+ */
+const void *dlite_instance_get_property_const_by_index(const DLiteInstance *inst,
+                                                       size_t i)
+{
+  return _instance_get_property(inst, i, 0);
 }
 
 
@@ -1325,6 +3010,7 @@ int dlite_instance_set_property_by_index(DLiteInstance *inst, size_t i,
   if (inst->_flags & dliteImmutable)
     return err(1, "cannot set property on immutable instance: %s",
                (inst->uri) ? inst->uri : inst->uuid);
+  _instance_hash_mark(inst, i, hashDirty);
 
   /* Count members */
   if (p->ndims)
@@ -1352,6 +3038,8 @@ int dlite_instance_set_property_by_index(DLiteInstance *inst, size_t i,
   /* Copy */
   if (p->ndims > 0) {
     size_t n;
+    if (_instance_unshare_array(inst, i, nmemb*p->size, 0)) return -1;
+    if (_instance_cow(inst, i)) return -1;
     dest = *((void **)DLITE_PROP(inst, i));
     if (dlite_type_is_allocated(p->type)) {
       for (n=0; n<nmemb; n++) {
@@ -1452,6 +3140,21 @@ void *dlite_instance_get_property(const DLiteInstance *inst, const char *name)
   return dlite_instance_get_property_by_index(inst, i);
 }
 
+/*
+  Like dlite_instance_get_property(), but returns a pointer that must
+  only be used for reading.  See
+  dlite_instance_get_property_const_by_index().
+ */
+const void *dlite_instance_get_property_const(const DLiteInstance *inst,
+                                              const char *name)
+{
+  int i;
+  if (!inst->meta)
+    return errx(dliteMissingMetadataError, "no metadata available"), NULL;
+  if ((i = dlite_meta_get_property_index(inst->meta, name)) < 0) return NULL;
+  return dlite_instance_get_property_const_by_index(inst, i);
+}
+
 /*
   Copies memory pointed to by `ptr` to property `name`.
   Returns non-zero on error.
@@ -1586,7 +3289,7 @@ int dlite_instance_print_property_by_index(char *dest, size_t n,
   if (i >= inst->meta->_nproperties)
     return errx(dliteIndexError, "index %d exceeds number of properties (%d) in %s",
                 (int)i, (int)inst->meta->_nproperties, inst->meta->uri);
-  if (!(ptr = dlite_instance_get_property_by_index(inst, i))) return -1;
+  if (!(ptr = _instance_get_property(inst, i, 0))) return -1;
   if (!(p = dlite_meta_get_property_by_index(inst->meta, i))) return -1;
   shape = DLITE_PROP_DIMS(inst, i);
   assert(shape);
@@ -1629,7 +3332,7 @@ int dlite_instance_aprint_property_by_index(char **dest, size_t *n,
   if (i >= inst->meta->_nproperties)
     return errx(dliteIndexError, "index %d exceeds number of properties (%d) in %s",
                 (int)i, (int)inst->meta->_nproperties, inst->meta->uri);
-  if (!(ptr = dlite_instance_get_property_by_index(inst, i))) return -1;
+  if (!(ptr = _instance_get_property(inst, i, 0))) return -1;
   if (!(p = dlite_meta_get_property_by_index(inst->meta, i))) return -1;
   shape = DLITE_PROP_DIMS(inst, i);
   assert(shape);
@@ -1668,8 +3371,10 @@ int dlite_instance_scan_property_by_index(const char *src,
   if (i >= inst->meta->_nproperties)
     return errx(dliteIndexError, "index %d exceeds number of properties (%d) in %s",
                 (int)i, (int)inst->meta->_nproperties, inst->meta->uri);
-  if (!(ptr = dlite_instance_get_property_by_index(inst, i))) return -1;
+  if (_instance_cow((DLiteInstance *)inst, i)) return -1;
+  if (!(ptr = _instance_get_property(inst, i, 0))) return -1;
   if (!(p = dlite_meta_get_property_by_index(inst->meta, i))) return -1;
+  _instance_hash_mark(inst, i, hashDirty);
   shape = DLITE_PROP_DIMS(inst, i);
   assert(shape);
   return dlite_property_scan(src, ptr, p, shape, flags);
@@ -1780,6 +3485,7 @@ int dlite_instance_set_dimension_sizes(DLiteInstance *inst, const int *dims)
 
   if (!dlite_instance_is_data(inst))
     return err(dliteIndexError, "it is not possible to change dimensions of metadata");
+  _instance_hash_mark(inst, -1, hashDirty);
 
   if (inst->meta->_setdim)
     for (n=0; n < inst->meta->_ndimensions; n++)
@@ -1808,6 +3514,9 @@ int dlite_instance_set_dimension_sizes(DLiteInstance *inst, const int *dims)
   /* evaluate new propdims */
   if (_instance_propdims_eval(inst, xdims)) goto fail;
 
+  /* the arrays are reallocated to their exact size */
+  _instance_clear_capacity(inst, -1);
+
   /* reallocate properties */
   for (n=0; n < inst->meta->_nproperties; n++) {
     DLiteProperty *p = inst->meta->_properties + n;
@@ -1821,6 +3530,23 @@ int dlite_instance_set_dimension_sizes(DLiteInstance *inst, const int *dims)
     newsize = newmembs * p->size;
     if (newmembs == oldmembs[n]) {
       continue;
+    } else if (_instance_own_array(inst, n, oldsize)) {
+      goto fail;
+    } else if (newmembs > 0 && _instance_in_arena(inst, *ptr)) {
+      /* Arrays in the arena are shrunk in place, but moved to a
+         separate buffer when they grow */
+      void *q;
+      if (newmembs < oldmembs[n]) {
+        for (i=newmembs; i < oldmembs[n]; i++)
+          dlite_type_clear((char *)(*ptr) + i*p->size, p->type, p->size);
+      } else {
+        if (!(q = malloc(newsize)))
+          FAILCODE2(dliteMemoryError, "error allocating '%s' of size %d",
+                    p->name, newsize);
+        memcpy(q, *ptr, oldsize);
+        memset((char *)q + oldsize, 0, newsize - oldsize);
+        *ptr = q;
+      }
     } else if (newmembs > 0) {
       void **q;
       if (newmembs < oldmembs[n])
@@ -1837,7 +3563,7 @@ int dlite_instance_set_dimension_sizes(DLiteInstance *inst, const int *dims)
     } else if (*ptr) {
       for (i=0; i < oldmembs[n]; i++)
         dlite_type_clear((char *)(*ptr) + i*p->size, p->type, p->size);
-      free(*ptr);
+      if (!_instance_in_arena(inst, *ptr)) free(*ptr);
       *ptr = NULL;
     } else {
       assert(oldsize == 0);
@@ -1893,19 +3619,268 @@ int dlite_instance_set_dimension_size(DLiteInstance *inst, const char *name,
 
 
 /*
-  Copies instance `inst` to a newly created instance.
+  Makes sure that array property `i` of `inst`, which currently has
+  `oldmemb` members, is owned by `inst` and has room for `nmemb`
+  members.  If `exact` is zero, the capacity is increased
+  geometrically.  The layout of the array is not changed.
 
-  If `newid` is NULL, the new instance will have no URI and a random UUID.
-  If `newid` is a valid UUID, the new instance will have the given
-  UUID and no URI.
-  Otherwise, the URI of the new instance will be `newid` and the UUID
-  assigned accordingly.
+  `caps` are the recorded capacities of `inst` or NULL.
 
-  Returns NULL on error.
+  Returns non-zero on error.
  */
-DLiteInstance *dlite_instance_copy(const DLiteInstance *inst, const char *newid)
+static int _instance_reserve_array(DLiteInstance *inst, size_t i,
+                                   const Capacity *caps, size_t oldmemb,
+                                   size_t nmemb, int exact)
+{
+  DLiteProperty *p = inst->meta->_properties + i;
+  void **ptr = DLITE_PROP(inst, i);
+  size_t cap = oldmemb;
+  int owned = !_instance_not_owned(inst, *ptr) &&
+    !_instance_in_shared(inst, *ptr);
+  void *q;
+  if (caps && caps[i].ptr == *ptr && caps[i].nmemb > cap) cap = caps[i].nmemb;
+  if (owned && cap >= nmemb) return 0;
+  if (cap < nmemb) cap = (exact || 2*cap < nmemb) ? nmemb : 2*cap;
+  if (owned) {
+    if (!(q = realloc(*ptr, cap * p->size)))
+      return err(dliteMemoryError, "error reallocating '%s' to %lu members",
+                 p->name, (unsigned long)cap);
+  } else {
+    /* Arrays in the arena, borrowed or shared arrays are copied */
+    if (!(q = malloc(cap * p->size)))
+      return err(dliteMemoryError, "error allocating '%s' of %lu members",
+                 p->name, (unsigned long)cap);
+    if (oldmemb) memcpy(q, *ptr, oldmemb * p->size);
+    _instance_free_array(inst, *ptr);
+  }
+  *ptr = q;
+  return _instance_set_capacity(inst, i, cap);
+}
+
+/*
+  Changes the layout of the `ndims`-dimensional array `ptr` with
+  elements of `size` bytes from shape `oldshape` to the larger shape
+  `newshape` in place.  `ptr` must have room for the new shape.  The
+  existing elements keep their indices and new elements are zeroed.
+ */
+static void _array_relayout(char *ptr, size_t size, int ndims,
+                            const size_t *oldshape, const size_t *newshape)
+{
+  size_t oldn=1, newn=1, block=size, nblocks=1, n;
+  int j, k;
+
+  /* Elements along the dimensions after the last one that grows are
+     contiguous in both layouts and can be moved as blocks */
+  for (k=ndims-1; k > 0 && oldshape[k] == newshape[k]; k--)
+    block *= oldshape[k];
+  for (j=0; j < ndims; j++) {
+    oldn *= oldshape[j];
+    newn *= newshape[j];
+  }
+  if (k == 0) {  /* only the leading dimension grows */
+    memset(ptr + oldn*size, 0, (newn - oldn)*size);
+    return;
+  }
+  for (j=0; j <= k; j++) nblocks *= oldshape[j];
+
+  /* Move the blocks starting from the end, such that no block is
+     overwritten before it is moved, and zero the gaps between them */
+  n = newn*size;  /* start of the previously moved block */
+  while (nblocks--) {
+    size_t rem=nblocks, newoff=0, stride=block;
+    for (j=k; j >= 0; j--) {
+      newoff += (rem % oldshape[j]) * stride;
+      rem /= oldshape[j];
+      stride *= newshape[j];
+    }
+    memmove(ptr + newoff, ptr + nblocks*block, block);
+    memset(ptr + newoff + block, 0, n - newoff - block);
+    n = newoff;
+  }
+  if (n) memset(ptr, 0, n);
+}
+
+/*
+  Help function for dlite_instance_reserve_rows_by_index() and
+  dlite_instance_append_rows_by_index().  If `append` is true, `n`
+  rows are appended to dimension `d` of `inst`.  Otherwise room is
+  reserved for `n` rows along dimension `d`.
+
+  Returns non-zero on error.
+ */
+static int _instance_grow(DLiteInstance *inst, size_t d, size_t n, int append)
+{
+  const DLiteMeta *meta = inst->meta;
+  size_t dimsbuf[NSTACK], *dims=dimsbuf;
+  size_t propdimsbuf[NSTACK], *propdims=propdimsbuf;
+  size_t i, size;
+  Capacity *caps = _instance_capacities(inst);
+  int retval=1, j;
+
+  if (inst->_flags & dliteImmutable)
+    return err(1, "cannot set property on immutable instance: %s",
+               (inst->uri) ? inst->uri : inst->uuid);
+  if (!dlite_instance_is_data(inst))
+    return err(dliteIndexError, "it is not possible to change dimensions of metadata");
+  if (d >= meta->_ndimensions)
+    return errx(dliteIndexError, "dimension index %d out of range: %s",
+                (int)d, meta->uri);
+  size = DLITE_DIM(inst, d);
+  if (append) size += n;
+  else if (n <= size) return 0;
+  else size = n;
+
+  if (meta->_ndimensions > NSTACK &&
+      !(dims = malloc(meta->_ndimensions * sizeof(size_t))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+  if (meta->_npropdims > NSTACK &&
+      !(propdims = malloc(meta->_npropdims * sizeof(size_t))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+  memcpy(dims, DLITE_DIMS(inst), meta->_ndimensions * sizeof(size_t));
+  dims[d] = size;
+  if (_propdims_eval(meta, dims, propdims)) goto fail;
+
+  /* Make room for the new shape of all properties before changing
+     anything, such that `inst` is left unchanged on error */
+  for (i=0; i < meta->_nproperties; i++) {
+    DLiteProperty *p = meta->_properties + i;
+    const size_t *oldshape = DLITE_PROP_DIMS(inst, i);
+    const size_t *newshape = propdims + meta->_propdiminds[i];
+    size_t oldmemb=1, newmemb=1;
+    for (j=0; j < p->ndims; j++) {
+      if (newshape[j] < oldshape[j])
+        FAILCODE3(dliteIndexError, "growing dimension '%s' of %s would "
+                  "shrink property '%s'", meta->_dimensions[d].name,
+                  meta->uri, p->name);
+      oldmemb *= oldshape[j];
+      newmemb *= newshape[j];
+    }
+    if (newmemb > oldmemb &&
+        _instance_reserve_array(inst, i, caps, oldmemb, newmemb, !append))
+      goto fail;
+  }
+
+  if (append) {
+    _instance_hash_mark(inst, -1, hashDirty);
+    if (meta->_setdim && meta->_setdim(inst, d, size) < 0) goto fail;
+    for (i=0; i < meta->_nproperties; i++) {
+      DLiteProperty *p = meta->_properties + i;
+      size_t *oldshape = DLITE_PROP_DIMS(inst, i);
+      const size_t *newshape = propdims + meta->_propdiminds[i];
+      if (p->ndims <= 0 || !*(char **)DLITE_PROP(inst, i) ||
+          !memcmp(oldshape, newshape, p->ndims * sizeof(size_t))) continue;
+      _array_relayout(*(char **)DLITE_PROP(inst, i), p->size, p->ndims,
+                      oldshape, newshape);
+    }
+    memcpy(DLITE_PROP_DIMS(inst, 0), propdims,
+           meta->_npropdims * sizeof(size_t));
+    DLITE_DIM(inst, d) = size;
+    if (dlite_instance_sync_from_dimension_sizes(inst)) goto fail;
+  }
+
+  retval = 0;
+ fail:
+  if (dims != dimsbuf) free(dims);
+  if (propdims != propdimsbuf) free(propdims);
+  return retval;
+}
+
+/*
+  Reserves room for `capacity` rows along dimension `i` of `inst`, such
+  that rows can be appended with dlite_instance_append_rows_by_index()
+  until dimension `i` has size `capacity` without reallocating any
+  arrays.  Does nothing if dimension `i` is already at least
+  `capacity` long.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_reserve_rows_by_index(DLiteInstance *inst, size_t i,
+                                         size_t capacity)
+{
+  return _instance_grow(inst, i, capacity, 0);
+}
+
+/*
+  Like dlite_instance_reserve_rows_by_index(), but dimension is
+  specified by name.
+ */
+int dlite_instance_reserve_rows(DLiteInstance *inst, const char *name,
+                                size_t capacity)
+{
+  int i;
+  if ((i = dlite_meta_get_dimension_index(inst->meta, name)) < 0) return -1;
+  return dlite_instance_reserve_rows_by_index(inst, i, capacity);
+}
+
+/*
+  Increases the size of dimension `i` of `inst` by `n` and zero the
+  new rows of all properties depending on it.
+
+  In contrast to dlite_instance_set_dimension_sizes(), the arrays
+  grow geometrically, such that appending rows one by one is amortised
+  linear in the number of rows.  Properties where dimension `i` is
+  not the first dimension are laid out again, such that all existing
+  elements keep their indices.  This is linear in the size of the
+  property, so streamed data should preferably be appended along the
+  first dimension.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_append_rows_by_index(DLiteInstance *inst, size_t i,
+                                        size_t n)
+{
+  return _instance_grow(inst, i, n, 1);
+}
+
+/*
+  Like dlite_instance_append_rows_by_index(), but dimension is
+  specified by name.
+ */
+int dlite_instance_append_rows(DLiteInstance *inst, const char *name,
+                               size_t n)
+{
+  int i;
+  if ((i = dlite_meta_get_dimension_index(inst->meta, name)) < 0) return -1;
+  return dlite_instance_append_rows_by_index(inst, i, n);
+}
+
+
+/*
+  Lets array property `i` of `dest` share the array of `src`, which must
+  have the same metadata and dimensions.  Only arrays of non-allocated
+  types owned by a data instance `src` can be shared.
+
+  Returns 1 if the array is shared, 0 if it cannot be shared and a
+  negative number on error.
+ */
+static int _instance_share_array(DLiteInstance *dest, DLiteInstance *src,
+                                 size_t i)
+{
+  DLiteProperty *p = src->meta->_properties + i;
+  void **q = DLITE_PROP(dest, i);
+  void *ptr = *(void **)DLITE_PROP(src, i);
+  if (p->ndims <= 0 || dlite_type_is_allocated(p->type) || !ptr ||
+      !dlite_instance_is_data(src) || _instance_not_owned(src, ptr))
+    return 0;
+  if (_shared_add(ptr)) return -1;
+  src->_flags |= dliteShared;
+  dest->_flags |= dliteShared;
+  _instance_free_array(dest, *q);
+  *q = ptr;
+  _instance_hash_mark(dest, i, hashDirty);
+  return 1;
+}
+
+/*
+  Help function for dlite_instance_copy().  If `share` is true, the new
+  instance shares the arrays of `inst` whenever possible.  Exposed
+  properties are always copied.
+ */
+static DLiteInstance *_instance_copy(const DLiteInstance *inst,
+                                     const char *newid, int share)
 {
   DLiteInstance *new=NULL;
+  const uint8_t *exposed = (share) ? _instance_exposed(inst) : NULL;
   size_t i;
   if (dlite_instance_sync_to_properties((DLiteInstance *)inst)) return NULL;
   if (!(new = dlite_instance_create(inst->meta, DLITE_DIMS(inst), newid)))
@@ -1918,9 +3893,12 @@ DLiteInstance *dlite_instance_copy(const DLiteInstance *inst, const char *newid)
       dlite_instance_incref((DLiteInstance *)new->_parent->parent);
   }
   for (i=0; i < inst->meta->_nproperties; i++) {
-    void *src = dlite_instance_get_property_by_index(inst, i);
-    assert(src);
-    if (dlite_instance_set_property_by_index(new, i, src)) goto fail;
+    void *src = _instance_property_data(inst, i);
+    int stat = (share && !(exposed && exposed[i])) ?
+      _instance_share_array(new, (DLiteInstance *)inst, i) : 0;
+    if (stat < 0) goto fail;
+    if (!stat && dlite_instance_set_property_by_index(new, i, src))
+      goto fail;
   }
   return new;
  fail:
@@ -1928,6 +3906,22 @@ DLiteInstance *dlite_instance_copy(const DLiteInstance *inst, const char *newid)
   return NULL;
 }
 
+/*
+  Copies instance `inst` to a newly created instance.
+
+  If `newid` is NULL, the new instance will have no URI and a random UUID.
+  If `newid` is a valid UUID, the new instance will have the given
+  UUID and no URI.
+  Otherwise, the URI of the new instance will be `newid` and the UUID
+  assigned accordingly.
+
+  Returns NULL on error.
+ */
+DLiteInstance *dlite_instance_copy(const DLiteInstance *inst, const char *newid)
+{
+  return _instance_copy(inst, newid, 0);
+}
+
 
 /*
   Returns a new DLiteArray object for property number `i` in instance `inst`.
@@ -2044,7 +4038,7 @@ int dlite_instance_cast_property_by_index(const DLiteInstance *inst,
                                           void *dest,
                                           DLiteTypeCast castfun)
 {
-  void *src = dlite_instance_get_property_by_index(inst, i);
+  void *src = _instance_get_property(inst, i, 0);
   DLiteProperty *p = inst->meta->_properties + i;
   size_t *sdims = DLITE_PROP_DIMS(inst, i);
   return dlite_type_ndcast(p->ndims,
@@ -2060,88 +4054,369 @@ int dlite_instance_cast_property_by_index(const DLiteInstance *inst,
     'C':  row-major (C-style) order, no reordering.
     'F':  coloumn-major (Fortran-style) order, transposed order.
 
-  Return non-zero on error.
- */
-int dlite_instance_assign_property(const DLiteInstance *inst, const char *name,
-                                   int order, const void *src)
+  Return non-zero on error.
+ */
+int dlite_instance_assign_property(const DLiteInstance *inst, const char *name,
+                                   int order, const void *src)
+{
+  int i, retval=1;
+  DLiteProperty *p;
+  DLiteArray *arr;
+  if ((i = dlite_meta_get_property_index(inst->meta, name)) < 0) return 1;
+  p = inst->meta->_properties + i;
+  if (!(arr = dlite_instance_get_property_array(inst, p->name, order)))
+    return 1;
+  retval =
+    dlite_instance_assign_casted_property_by_index(inst, i, p->type, p->size,
+                                                   arr->shape, arr->strides,
+                                                   src, NULL);
+  dlite_array_free(arr);
+  return retval;
+}
+
+
+/*
+  Assigns property `i` by copying and possible type-cast memory
+  pointed to by `src` using `castfun`.  The memory pointed to by `src`
+  is described by arguments `type`, `size` `shape` and `strides`.
+
+  If `castfun` is NULL, it defaults to dlite_type_copy_cast().
+
+  Return non-zero on error.
+ */
+int dlite_instance_assign_casted_property_by_index(const DLiteInstance *inst,
+                                                   int i,
+                                                   DLiteType type,
+                                                   size_t size,
+                                                   const size_t *shape,
+                                                   const int *strides,
+                                                   const void *src,
+                                                   DLiteTypeCast castfun)
+{
+  void *dest;
+  DLiteProperty *p = inst->meta->_properties + i;
+  size_t *dims = DLITE_PROP_DIMS(inst, i);
+  if (_instance_cow((DLiteInstance *)inst, i)) return -1;
+  dest = _instance_get_property(inst, i, 0);
+  _instance_hash_mark(inst, i, hashDirty);
+  return dlite_type_ndcast(p->ndims,
+                           dest, p->type, p->size, dims, NULL,
+                           src, type, size, shape, strides,
+                           castfun);
+}
+
+
+/*
+  Return a newly allocated default instance URI constructed from
+  the metadata URI and the UUID of the instance, as `<meta_uri>/<uuid>`.
+
+  Returns NULL on error.
+ */
+char *dlite_instance_default_uri(const DLiteInstance *inst)
+{
+  int n = strlen(inst->meta->uri);
+  char *buf = malloc(n + DLITE_UUID_LENGTH + 2);
+  if (!buf) return err(dliteMemoryError, "allocation failure"), NULL;
+  memcpy(buf, inst->meta->uri, n);
+  buf[n] = '/';
+  memcpy(buf+n+1, inst->uuid, DLITE_UUID_LENGTH);
+  buf[n+DLITE_UUID_LENGTH+1] = '\0';
+  return buf;
+}
+
+
+/* Callback for dlite_type_update_hash() updating a sha3 context. */
+static void _sha3_update(void *state, const void *data, size_t len)
+{
+  sha3_Update(state, data, len);
+}
+
+/* Callback for dlite_type_update_hash() updating a fast hash state. */
+static void _fasthash_update(void *state, const void *data, size_t len)
+{
+  fasthash_update(state, data, len);
+}
+
+/* Updates the hash state `c` with the header of `inst`, i.e. its
+   parent, metadata uri and dimensions.  The hash algorithm of the
+   parent is only included for non-default algorithms, such that sha3
+   hashes are unchanged. */
+static void _hash_header(DLiteHashUpdate update, void *c,
+                         const DLiteInstance *inst, DLiteHashAlgorithm alg)
+{
+  size_t i;
+  if (inst->_parent) {
+    update(c, inst->_parent->uuid, DLITE_UUID_LENGTH);
+    update(c, inst->_parent->hash, DLITE_HASH_SIZE);
+    if (alg != dliteHashSha3) {
+      uint8_t parentalg = (uint8_t)inst->_parent->hashalg;
+      update(c, &parentalg, 1);
+    }
+  }
+  update(c, inst->meta->uri, strlen(inst->meta->uri));
+  for (i=0; i<DLITE_NDIM(inst); i++) {
+    uint64_t n = DLITE_DIM(inst, i);
+    update(c, &n, sizeof(uint64_t));
+  }
+}
+
+/* Updates the hash state `c` with the value of property `i` of `inst`,
+   whos data is pointed to by `ptr`.  Returns non-zero on error. */
+static int _hash_property(DLiteHashUpdate update, void *c,
+                          const DLiteInstance *inst, size_t i, const void *ptr)
+{
+  DLiteProperty *p = DLITE_PROP_DESCR(inst, i);
+  size_t j, len = 1;
+  for (j=0; (int)j<p->ndims; j++) len *= DLITE_PROP_DIM(inst, i, j);
+  if (dlite_type_is_allocated(p->type)) {
+    const char *v = ptr;
+    for (j=0; j<len; j++, v+=p->size)
+      if (dlite_type_update_hash(update, c, v, p->type, p->size))
+        return err(1, "error updating hash for property \"%s\" of "
+                   "instance \"%s\"",
+                   p->name, (inst->uri) ? inst->uri : inst->uuid);
+  } else {
+    update(c, ptr, len*p->size);
+  }
+  return 0;
+}
+
+/* Size in bytes of the property digests combined by the sha3-tree
+   algorithm. */
+#define SHA3_TREE_DIGEST_SIZE 32
+
+/* Returns the size in bytes of the property digests combined by tree
+   algorithm `alg`, i.e. dliteHashFast or dliteHashSha3Tree. */
+static size_t _hash_digest_size(DLiteHashAlgorithm alg)
+{
+  return (alg == dliteHashFast) ? FASTHASH_SIZE : SHA3_TREE_DIGEST_SIZE;
+}
+
+/* Writes the digest of property `i` of `inst`, whos data is pointed
+   to by `ptr`, to `digest` using tree algorithm `alg`.  Returns
+   non-zero on error. */
+static int _digest_property(const DLiteInstance *inst, size_t i,
+                            const void *ptr, uint8_t *digest,
+                            DLiteHashAlgorithm alg)
+{
+  if (alg == dliteHashFast) {
+    FastHash h;
+    fasthash_init(&h, 0);
+    if (_hash_property(_fasthash_update, &h, inst, i, ptr)) return 1;
+    fasthash_final(&h, digest, FASTHASH_SIZE);
+  } else {
+    sha3_context c;
+    sha3_Init(&c, SHA3_TREE_DIGEST_SIZE * 8);
+    sha3_SetFlags(&c, SHA3_FLAGS_KECCAK);
+    if (_hash_property(_sha3_update, &c, inst, i, ptr)) return 1;
+    memcpy(digest, sha3_Finalize(&c), SHA3_TREE_DIGEST_SIZE);
+  }
+  return 0;
+}
+
+/* Writes the hash of `inst` combined from the header and the digests
+   of all properties, `digests`, using tree algorithm `alg` to `hash`. */
+static void _hash_combine(const DLiteInstance *inst, const uint8_t *digests,
+                          DLiteHashAlgorithm alg, uint8_t *hash, int hashsize)
+{
+  size_t n = DLITE_NPROP(inst) * _hash_digest_size(alg);
+  if (alg == dliteHashFast) {
+    FastHash h;
+    fasthash_init(&h, 0);
+    _hash_header(_fasthash_update, &h, inst, alg);
+    fasthash_update(&h, digests, n);
+    fasthash_final(&h, hash, hashsize);
+  } else {
+    sha3_context c;
+    sha3_Init(&c, hashsize * 8);
+    sha3_SetFlags(&c, SHA3_FLAGS_KECCAK);
+    _hash_header(_sha3_update, &c, inst, alg);
+    sha3_Update(&c, digests, n);
+    memcpy(hash, sha3_Finalize(&c), hashsize);
+  }
+}
+
+/* Returns non-zero if the header of `inst` has changed since the hash
+   in `cache` was calculated. */
+static int _hashcache_header_changed(const HashCache *cache,
+                                     const DLiteInstance *inst)
 {
-  int i, retval=1;
-  DLiteProperty *p;
-  DLiteArray *arr;
-  if ((i = dlite_meta_get_property_index(inst->meta, name)) < 0) return 1;
-  p = inst->meta->_properties + i;
-  if (!(arr = dlite_instance_get_property_array(inst, p->name, order)))
+  size_t i;
+  if (!cache->valid || cache->has_parent != (inst->_parent != NULL))
     return 1;
-  retval =
-    dlite_instance_assign_casted_property_by_index(inst, i, p->type, p->size,
-                                                   arr->shape, arr->strides,
-                                                   src, NULL);
-  dlite_array_free(arr);
-  return retval;
+  if (inst->_parent &&
+      (strcmp(cache->parent.uuid, inst->_parent->uuid) ||
+       memcmp(cache->parent.hash, inst->_parent->hash, DLITE_HASH_SIZE) ||
+       cache->parent.hashalg != inst->_parent->hashalg))
+    return 1;
+  for (i=0; i<cache->ndims; i++)
+    if (cache->dims[i] != (uint64_t)DLITE_DIM(inst, i)) return 1;
+  return 0;
 }
 
+/* Returns non-zero if the dimensions of `inst` have changed since the
+   hash in `cache` was calculated. */
+static int _hashcache_dims_changed(const HashCache *cache,
+                                   const DLiteInstance *inst)
+{
+  size_t i;
+  for (i=0; i<cache->ndims; i++)
+    if (cache->dims[i] != (uint64_t)DLITE_DIM(inst, i)) return 1;
+  return 0;
+}
 
-/*
-  Assigns property `i` by copying and possible type-cast memory
-  pointed to by `src` using `castfun`.  The memory pointed to by `src`
-  is described by arguments `type`, `size` `shape` and `strides`.
-
-  If `castfun` is NULL, it defaults to dlite_type_copy_cast().
+/* Records the current header of `inst` in `cache`. */
+static void _hashcache_set_header(HashCache *cache, const DLiteInstance *inst)
+{
+  size_t i;
+  cache->has_parent = (inst->_parent) ? 1 : 0;
+  if (inst->_parent) cache->parent = *inst->_parent;
+  for (i=0; i<cache->ndims; i++) cache->dims[i] = DLITE_DIM(inst, i);
+}
 
-  Return non-zero on error.
+/*
+  Calculates the sha3 hash of `inst` using its hash cache.  Only
+  properties from the first property that may have changed since the
+  last call are rehashed.  Returns non-zero on error.
  */
-int dlite_instance_assign_casted_property_by_index(const DLiteInstance *inst,
-                                                   int i,
-                                                   DLiteType type,
-                                                   size_t size,
-                                                   const size_t *shape,
-                                                   const int *strides,
-                                                   const void *src,
-                                                   DLiteTypeCast castfun)
+static int _instance_get_cached_sha3(const DLiteInstance *inst,
+                                     HashCache *cache, uint8_t *hash,
+                                     int hashsize)
 {
-  void *dest = dlite_instance_get_property_by_index(inst, i);
-  DLiteProperty *p = inst->meta->_properties + i;
-  size_t *dims = DLITE_PROP_DIMS(inst, i);
-  return dlite_type_ndcast(p->ndims,
-                           dest, p->type, p->size, dims, NULL,
-                           src, type, size, shape, strides,
-                           castfun);
-}
+  const uint8_t *exposed = _instance_exposed(inst);
+  unsigned bitsize = hashsize * 8;
+  size_t i, start=0;
+  sha3_context c;
+  int retval=0;
 
+  mutex_lock(&cache->lock);
+  if (!cache->states &&
+      !(cache->states = calloc(cache->nprops + 1, sizeof(sha3_context)))) {
+    retval = err(dliteMemoryError, "allocation failure");
+    goto fail;
+  }
+  if (cache->alg != dliteHashSha3 || cache->bitsize != bitsize ||
+      _hashcache_header_changed(cache, inst)) {
+    cache->valid = 0;
+    sha3_Init(&c, bitsize);
+    sha3_SetFlags(&c, SHA3_FLAGS_KECCAK);
+    _hash_header(_sha3_update, &c, inst, dliteHashSha3);
+    cache->states[0] = c;
+    cache->alg = dliteHashSha3;
+    cache->bitsize = bitsize;
+    _hashcache_set_header(cache, inst);
+  } else {
+    for (start=0; start < cache->nprops; start++)
+      if (cache->flags[start] || (exposed && exposed[start])) break;
+  }
 
-/*
-  Return a newly allocated default instance URI constructed from
-  the metadata URI and the UUID of the instance, as `<meta_uri>/<uuid>`.
+  if (!cache->valid || start < cache->nprops) {
+    cache->valid = 0;
+    c = cache->states[start];
+    for (i=start; i < cache->nprops; i++) {
+      cache->states[i] = c;
+      cache->flags[i] &= ~hashDirty;
+      if ((retval = _hash_property(_sha3_update, &c, inst, i,
+                                   _instance_property_data(inst, i))))
+        goto fail;
+    }
+    cache->states[cache->nprops] = c;
+    memcpy(cache->hash, sha3_Finalize(&c), hashsize);
+    cache->valid = 1;
+  }
+  memcpy(hash, cache->hash, hashsize);
+ fail:
+  mutex_unlock(&cache->lock);
+  return retval;
+}
 
-  Returns NULL on error.
+/*
+  Calculates the hash of `inst` with tree algorithm `alg` using its
+  hash cache.  Only the digests of properties that may have changed
+  since the last call are recalculated.  A new parent only requires
+  that the digests are combined again.  Returns non-zero on error.
  */
-char *dlite_instance_default_uri(const DLiteInstance *inst)
+static int _instance_get_cached_tree(const DLiteInstance *inst,
+                                     HashCache *cache, uint8_t *hash,
+                                     int hashsize, DLiteHashAlgorithm alg)
 {
-  int n = strlen(inst->meta->uri);
-  char *buf = malloc(n + DLITE_UUID_LENGTH + 2);
-  if (!buf) return err(dliteMemoryError, "allocation failure"), NULL;
-  memcpy(buf, inst->meta->uri, n);
-  buf[n] = '/';
-  memcpy(buf+n+1, inst->uuid, DLITE_UUID_LENGTH);
-  buf[n+DLITE_UUID_LENGTH+1] = '\0';
-  return buf;
-}
+  const uint8_t *exposed = _instance_exposed(inst);
+  size_t i, digestsize = _hash_digest_size(alg);
+  unsigned bitsize = hashsize * 8;
+  int retval=0, all=0, changed=0;
+
+  mutex_lock(&cache->lock);
+  if (!cache->digests &&
+      !(cache->digests = calloc(cache->nprops, SHA3_TREE_DIGEST_SIZE))) {
+    retval = err(dliteMemoryError, "allocation failure");
+    goto fail;
+  }
+  if (cache->alg != alg || !cache->valid ||
+      _hashcache_dims_changed(cache, inst)) {
+    cache->valid = 0;
+    cache->alg = alg;
+    all = 1;
+  }
+  if (_hashcache_header_changed(cache, inst)) {
+    _hashcache_set_header(cache, inst);
+    changed = 1;
+  }
+  for (i=0; i < cache->nprops; i++) {
+    if (all || cache->flags[i] || (exposed && exposed[i])) {
+      cache->flags[i] &= ~hashDirty;
+      if ((retval = _digest_property(inst, i,
+                                     _instance_property_data(inst, i),
+                                     cache->digests + i*digestsize, alg)))
+        goto fail;
+      changed = 1;
+    }
+  }
 
+  if (!cache->valid || changed || cache->bitsize != bitsize) {
+    cache->valid = 0;
+    _hash_combine(inst, cache->digests, alg, cache->hash, hashsize);
+    cache->bitsize = bitsize;
+    cache->valid = 1;
+  }
+  memcpy(hash, cache->hash, hashsize);
+ fail:
+  mutex_unlock(&cache->lock);
+  return retval;
+}
 
 /*
   Calculates a hash of instance `inst`.  The calculated hash is stored
   in `hash`, where `hashsize` is the size of `hash` in bytes.  It should
   be 32, 48 or 64.
 
+  If the hash cache is enabled with dlite_instance_set_hash_cache(),
+  properties that have not been modified since the last call are not
+  rehashed.
+
   Return non-zero on error.
  */
 int dlite_instance_get_hash(const DLiteInstance *inst,
                             uint8_t *hash, int hashsize)
+{
+  return dlite_instance_get_hash_alg(inst, hash, hashsize,
+                                     dlite_instance_hash_algorithm());
+}
+
+/*
+  Like dlite_instance_get_hash(), but calculates the hash with
+  algorithm `alg`.
+
+  The fast and sha3-tree hashes are digests of the header and the
+  128-bit fast or 256-bit sha3 digests of all properties.
+
+  Return non-zero on error.
+ */
+int dlite_instance_get_hash_alg(const DLiteInstance *inst,
+                                uint8_t *hash, int hashsize,
+                                DLiteHashAlgorithm alg)
 {
   size_t i;
-  sha3_context c;
-  const uint8_t *buf;
-  unsigned bitsize = hashsize * 8;
+  HashCache *cache;
   int retval = 0;
 
   /* If metadata defines a custom hash function, use that instead of
@@ -2149,41 +4424,89 @@ int dlite_instance_get_hash(const DLiteInstance *inst,
   if (inst->meta->_gethash)
     return inst->meta->_gethash(inst, hash, hashsize);
 
-  sha3_Init(&c, bitsize);
-  sha3_SetFlags(&c, SHA3_FLAGS_KECCAK);
-
-  if (inst->_parent) {
-    sha3_Update(&c, inst->_parent->uuid, DLITE_UUID_LENGTH);
-    sha3_Update(&c, inst->_parent->hash, DLITE_HASH_SIZE);
-  }
-  sha3_Update(&c, inst->meta->uri, strlen(inst->meta->uri));
-  for (i=0; i<DLITE_NDIM(inst); i++) {
-    uint64_t n = DLITE_DIM(inst, i);
-    sha3_Update(&c, &n, sizeof(uint64_t));
-  }
-  for (i=0; i<DLITE_NPROP(inst); i++) {
-    void *ptr = dlite_instance_get_property_by_index(inst, i);
-    DLiteProperty *p = DLITE_PROP_DESCR(inst, i);
-    size_t j, len = 1;
-    for (j=0; (int)j<p->ndims; j++) len *= DLITE_PROP_DIM(inst, i, j);
-    if (dlite_type_is_allocated(p->type)) {
-      char *v = ptr;
-      for (j=0; j<len; j++, v+=p->size)
-        if ((retval = dlite_type_update_sha3(&c, v, p->type, p->size))) {
-          err(1, "error updating hash for property \"%s\" of instance \"%s\"",
-              p->name, (inst->uri) ? inst->uri : inst->uuid);
-          break;
-        }
-    } else {
-      sha3_Update(&c, ptr, len*p->size);
+  if (!dlite_hash_algorithm_name(alg))
+    return errx(dliteValueError, "invalid hash algorithm: %d", alg);
+  if (hashsize <= 0 || hashsize > 64)
+    return errx(dliteValueError, "invalid hash size: %d", hashsize);
+
+  /* Instances with internal state may change without notice and are
+     therefore not cached */
+  if (!inst->meta->_getdim && !inst->meta->_saveprop &&
+      (cache = _instance_hashcache(inst, 0)))
+    return (alg == dliteHashSha3) ?
+      _instance_get_cached_sha3(inst, cache, hash, hashsize) :
+      _instance_get_cached_tree(inst, cache, hash, hashsize, alg);
+
+  if (alg != dliteHashSha3) {
+    uint8_t digestbuf[NSTACK * SHA3_TREE_DIGEST_SIZE], *digests=digestbuf;
+    size_t digestsize = _hash_digest_size(alg);
+    if (DLITE_NPROP(inst) > NSTACK &&
+        !(digests = malloc(DLITE_NPROP(inst) * digestsize)))
+      return err(dliteMemoryError, "allocation failure");
+    for (i=0; i<DLITE_NPROP(inst); i++) {
+      void *ptr = _instance_get_property(inst, i, 0);
+      if ((retval = _digest_property(inst, i, ptr, digests + i*digestsize,
+                                     alg))) break;
+    }
+    if (!retval) _hash_combine(inst, digests, alg, hash, hashsize);
+    if (digests != digestbuf) free(digests);
+  } else {
+    sha3_context c;
+    sha3_Init(&c, hashsize * 8);
+    sha3_SetFlags(&c, SHA3_FLAGS_KECCAK);
+    _hash_header(_sha3_update, &c, inst, alg);
+    for (i=0; i<DLITE_NPROP(inst); i++) {
+      void *ptr = _instance_get_property(inst, i, 0);
+      if ((retval = _hash_property(_sha3_update, &c, inst, i, ptr))) break;
     }
+    memcpy(hash, sha3_Finalize(&c), hashsize);
   }
-
-  buf = sha3_Finalize(&c);
-  memcpy(hash, buf, hashsize);
   return retval;
 }
 
+/*
+  Enables caching of the hash of `inst` if `enable` is non-zero and
+  disables it otherwise.
+
+  With a hash cache, dlite_instance_get_hash() only rehashes the
+  properties that may have been modified since the last call.  These
+  are the properties assigned with dlite_instance_set_property() or
+  related functions, the properties for which a writable pointer has
+  been returned by dlite_instance_get_property() or related functions
+  and all properties when the dimensions are resized.  Properties
+  modified by other means, e.g. through DLITE_PROP() or the members of
+  a generated C struct, must be marked with
+  dlite_instance_mark_modified().
+
+  Instances of metadata with a custom hash function or internal state
+  are never cached.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_set_hash_cache(DLiteInstance *inst, int enable)
+{
+  if (!enable)
+    _instance_release_hashcache(inst);
+  else if (!inst->meta->_gethash && !inst->meta->_getdim &&
+           !inst->meta->_saveprop && !_instance_hashcache(inst, 1))
+    return dliteMemoryError;
+  return 0;
+}
+
+/*
+  Marks property `i` of `inst` as modified, such that it will be
+  rehashed by the next call to dlite_instance_get_hash().  If `i` is
+  negative, all properties are marked.
+
+  This is only needed for instances with a hash cache, if the property
+  is modified without using the DLite API, e.g. through the members of
+  a generated C struct.
+ */
+void dlite_instance_mark_modified(DLiteInstance *inst, int i)
+{
+  _instance_hash_mark(inst, i, hashDirty);
+}
+
 /********************************************************************
  *  Transactions
  ********************************************************************/
@@ -2213,9 +4536,71 @@ int dlite_instance_is_frozen(const DLiteInstance *inst)
   return inst->_flags & dliteImmutable;
 }
 
+/*
+  Sets the parent of `inst` to `parent`, whos hash calculated with
+  algorithm `alg` is `hash`.  No checks are done.
+
+  Returns non-zero on error.
+ */
+static int _instance_set_parent(DLiteInstance *inst,
+                                const DLiteInstance *parent,
+                                const uint8_t *hash, DLiteHashAlgorithm alg)
+{
+  DLiteParent *p = inst->_parent;
+  if (p) {
+    if (p->parent) dlite_instance_decref((DLiteInstance *)p->parent);
+  } else {
+    if (!(p = calloc(1, sizeof(DLiteParent))))
+      return err(-1, "Allocation failure");
+    inst->_parent = p;
+  }
+  p->parent = parent;
+  strncpy(p->uuid, parent->uuid, DLITE_UUID_LENGTH+1);
+  memcpy(p->hash, hash, DLITE_HASH_SIZE);
+  p->hashalg = alg;
+  dlite_instance_incref((DLiteInstance *)p->parent);
+  return 0;
+}
+
 /* Number of random characters in shapshot id (sid) */
 #define SID_LEN 12
 
+/*
+  Lets snapshots of `inst` share its arrays of non-allocated types if
+  `enable` is non-zero and disables sharing otherwise.
+
+  Shared arrays are copied when they are modified through the DLite
+  API (copy-on-write), i.e. when they are assigned with
+  dlite_instance_set_property() or related functions, when a writable
+  pointer is returned by dlite_instance_get_property() or related
+  functions and when the dimensions are resized.  Properties for which
+  a writable pointer has been returned before the snapshot are copied
+  to the snapshot.
+
+  While sharing is enabled, arrays of `inst` must not be written to by
+  other means, e.g. through DLITE_PROP() or the members of a generated
+  C struct, since that would modify the snapshots as well.  Such
+  modifications are detected by dlite_instance_verify_transaction().
+
+  Instances of metadata with internal state cannot share arrays with
+  their snapshots.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_set_shared_snapshots(DLiteInstance *inst, int enable)
+{
+  if (!enable) {
+    inst->_flags &= ~dliteShareSnapshots;
+    return 0;
+  }
+  if (inst->meta->_getdim || inst->meta->_loadprop || inst->meta->_saveprop)
+    return errx(dliteUnsupportedError,
+                "instances of '%s' cannot share arrays with snapshots",
+                inst->meta->uri);
+  inst->_flags |= dliteShareSnapshots;
+  return 0;
+}
+
 /*
   Make a snapshop of mutable instance `inst`.
 
@@ -2226,6 +4611,9 @@ int dlite_instance_is_frozen(const DLiteInstance *inst)
   The reason that `inst` must be mutable, is that its hash will change
   due to change in its parent.
 
+  The arrays of `inst` are copied to the snapshot, unless sharing has
+  been enabled with dlite_instance_set_shared_snapshots().
+
   The snapshot will be assigned an URI of the form
   "snapshot-XXXXXXXXXXXX" (or inst->uri#snapshot-XXXXXXXXXXXX if
   inst->uri is not NULL) where each X is replaces with a random
@@ -2236,6 +4624,8 @@ int dlite_instance_is_frozen(const DLiteInstance *inst)
 int dlite_instance_snapshot(DLiteInstance *inst)
 {
   DLiteInstance *snapshot=NULL;
+  DLiteHashAlgorithm alg = dlite_instance_hash_algorithm();
+  uint8_t hash[DLITE_HASH_SIZE];
   int retval=1, i;
   const char *id = (inst->uri) ? inst->uri : inst->uuid;
   int len = strcspn(id, "#");
@@ -2258,9 +4648,15 @@ int dlite_instance_snapshot(DLiteInstance *inst)
   if (asprintf(&uri, "%.*s#snapshot-%s", len, id, sid) < 0)
     FAIL1("error formatting uri for snapshot of %s", id);
 
-  if (!(snapshot = dlite_instance_copy(inst, uri))) goto fail;
+  /* The snapshot has the same hash as `inst`, which is cheaply obtained
+     if `inst` has a hash cache */
+  if (dlite_instance_get_hash_alg(inst, hash, DLITE_HASH_SIZE, alg))
+    goto fail;
+  if (!(snapshot = _instance_copy(inst, uri,
+                                  inst->_flags & dliteShareSnapshots)))
+    goto fail;
   dlite_instance_freeze(snapshot);
-  if (dlite_instance_set_parent(inst, snapshot)) goto fail;
+  if (_instance_set_parent(inst, snapshot, hash, alg)) goto fail;
   retval = 0;
  fail:
   if (uri) free(uri);
@@ -2400,7 +4796,7 @@ int dlite_instance_print_transaction(const DLiteInstance *inst)
  */
 int dlite_instance_set_parent(DLiteInstance *inst, const DLiteInstance *parent)
 {
-  DLiteParent *p = inst->_parent;
+  DLiteHashAlgorithm alg = dlite_instance_hash_algorithm();
   uint8_t hash[DLITE_HASH_SIZE];
   if (inst->_flags & dliteImmutable)
     return err(-1, "Parent cannot be added to immutable instance: %s",
@@ -2408,21 +4804,10 @@ int dlite_instance_set_parent(DLiteInstance *inst, const DLiteInstance *parent)
   if (!(parent->_flags & dliteImmutable))
     return err(-1, "Mutable instance \"%s\" cannot be added as parent",
                (parent->uri) ? parent->uri : parent->uuid);
-  if (dlite_instance_get_hash(parent, hash, DLITE_HASH_SIZE))
+  if (dlite_instance_get_hash_alg(parent, hash, DLITE_HASH_SIZE, alg))
     return err(-1, "Error calculating hash of parent instance \"%s\"",
                (parent->uri) ? parent->uri : parent->uuid);
-  if (p) {
-    if (p->parent) dlite_instance_decref((DLiteInstance *)p->parent);
-  } else {
-    if (!(p = calloc(1, sizeof(DLiteParent))))
-      return err(-1, "Allocation failure");
-    inst->_parent = p;
-  }
-  p->parent = parent;
-  strncpy(p->uuid, parent->uuid, DLITE_UUID_LENGTH+1);
-  memcpy(p->hash, hash, DLITE_HASH_SIZE);
-  dlite_instance_incref((DLiteInstance *)p->parent);
-  return 0;
+  return _instance_set_parent(inst, parent, hash, alg);
 }
 
 
@@ -2469,37 +4854,19 @@ int dlite_instance_has_parent(const DLiteInstance *inst)
 }
 
 /*
-  Verify that the hash of instance `inst`.
-
-  If `hash` is not NULL, this function verifies that the hash of
-  `inst` corresponds to the memory pointed to by `hash`.  The size of
-  the memory should be `DLITE_HASH_SIZE` bytes.
-
-  If `hash` is NULL and `inst` has a parent, this function will
-  instead verify that the parent hash stored in `inst` corresponds to
-  the value of the parent.
-
-  If `recursive` is non-zero, all ancestors of `inst` are also
-  included in the verification.
-
-  Returns zero if the hash is valid.  Otherwise non-zero is returned
-  and an error message is issued.
-
-  TODO:
-  If `recursive` is non-zero and `inst` is a collection or has
-  properties of type `dliteRef`, we should also verify the instances
-  that are referred to.  This is currently not implemented, because
-  we have to detect cyclic references to avoid infinite recursion.
+  Verifies the hash of instance `inst`, where `hash` is calculated
+  with algorithm `alg`.  See dlite_instance_verify_hash().
  */
-int dlite_instance_verify_hash(const DLiteInstance *inst, uint8_t *hash,
-                              int recursive)
+static int _instance_verify_hash(const DLiteInstance *inst, uint8_t *hash,
+                                 DLiteHashAlgorithm alg, int recursive)
 {
   uint8_t calculated_hash[DLITE_HASH_SIZE];
   const DLiteInstance *parent;
   int stat=0;
 
   if (hash) {
-    if (dlite_instance_get_hash(inst, calculated_hash, DLITE_HASH_SIZE))
+    if (dlite_instance_get_hash_alg(inst, calculated_hash, DLITE_HASH_SIZE,
+                                    alg))
       return 2;
     if (memcmp(hash, calculated_hash, DLITE_HASH_SIZE))
       return err(1, "hash does not correspond to the value of instance \"%s\"",
@@ -2513,7 +4880,8 @@ int dlite_instance_verify_hash(const DLiteInstance *inst, uint8_t *hash,
     stat = err(3, "cannot retrieve parent of instance \"%s\"",
                (inst->uri) ? inst->uri : inst->uuid);
   else if (recursive || !hash)
-    stat = dlite_instance_verify_hash(parent, inst->_parent->hash, recursive);
+    stat = _instance_verify_hash(parent, inst->_parent->hash,
+                                 inst->_parent->hashalg, recursive);
 
   if (parent && !inst->_parent->parent)
     dlite_instance_decref((DLiteInstance *)parent);
@@ -2521,6 +4889,40 @@ int dlite_instance_verify_hash(const DLiteInstance *inst, uint8_t *hash,
   return stat;
 }
 
+/*
+  Verify that the hash of instance `inst`.
+
+  If `hash` is not NULL, this function verifies that the hash of
+  `inst` corresponds to the memory pointed to by `hash`.  The size of
+  the memory should be `DLITE_HASH_SIZE` bytes.
+
+  If `hash` is NULL and `inst` has a parent, this function will
+  instead verify that the parent hash stored in `inst` corresponds to
+  the value of the parent.
+
+  If `recursive` is non-zero, all ancestors of `inst` are also
+  included in the verification.
+
+  `hash` is compared to a hash calculated with the current hash
+  algorithm, while parent hashes are verified with the algorithm they
+  were recorded with.
+
+  Returns zero if the hash is valid.  Otherwise non-zero is returned
+  and an error message is issued.
+
+  TODO:
+  If `recursive` is non-zero and `inst` is a collection or has
+  properties of type `dliteRef`, we should also verify the instances
+  that are referred to.  This is currently not implemented, because
+  we have to detect cyclic references to avoid infinite recursion.
+ */
+int dlite_instance_verify_hash(const DLiteInstance *inst, uint8_t *hash,
+                              int recursive)
+{
+  return _instance_verify_hash(inst, hash, dlite_instance_hash_algorithm(),
+                               recursive);
+}
+
 
 /*
   Verifies a transaction.
@@ -2605,7 +5007,7 @@ dlite_meta_create(const char *uri, const char *description,
  */
 int dlite_meta_init(DLiteMeta *meta)
 {
-  size_t i, size;
+  size_t i, size, *propoffsets;
   int j;
   int idim_dim=-1, idim_prop=-1, idim_rel=-1;
   int iprop_dim=-1, iprop_prop=-1, iprop_rel=-1;
@@ -2666,6 +5068,7 @@ int dlite_meta_init(DLiteMeta *meta)
     j += meta->_properties[i].ndims;
   }
   _instance_propdims_eval((DLiteInstance *)meta, DLITE_DIMS(meta));
+  _propdimexprs_compile(meta);
 
   /* Assign memory layout of instances */
   size = meta->_headersize;
@@ -2681,21 +5084,21 @@ int dlite_meta_init(DLiteMeta *meta)
             (int)sizeof(size_t));
 
   /* -- property values (propoffsets[]) */
-  meta->_propoffsets = (size_t *)((char *)meta + DLITE_PROPOFFSETSOFFSET(meta));
+  propoffsets = (size_t *)((char *)meta + DLITE_PROPOFFSETSOFFSET(meta));
   for (i=0; i<meta->_nproperties; i++) {
     DLiteProperty *p = meta->_properties + i;
     if (p->ndims) {
       size += padding_at(void *, size);
-      meta->_propoffsets[i] = size;
+      propoffsets[i] = size;
       size += sizeof(void *);
     } else {
       size += dlite_type_padding_at(p->type, p->size, size);
-      meta->_propoffsets[i] = size;
+      propoffsets[i] = size;
       size += p->size;
     }
     DEBUG_LOG("    propoffset[%d]=%d (type=%d size=%-2d ndims=%d)"
               " + %d\n",
-              (int)i, (int)meta->_propoffsets[i], (int)p->type, (int)p->size,
+              (int)i, (int)propoffsets[i], (int)p->type, (int)p->size,
               (int)p->ndims,
               (int)((p->ndims) ? sizeof(size_t *) : p->size));
   }
@@ -2727,6 +5130,10 @@ int dlite_meta_init(DLiteMeta *meta)
   size += padding_at(size_t, size);
   DEBUG_LOG("    size=%d\n", (int)size);
 
+  /* Assign `_propoffsets` last, since a non-NULL value signals other
+     threads that the metadata is fully initialised. */
+  sync_store_ptr((void **)&meta->_propoffsets, propoffsets);
+
   return 0;
  fail:
   return 1;
@@ -3093,18 +5500,18 @@ static int writedim(int d, char *dest, size_t n, const void **pptr,
   char *sep   = (compact) ? ", " : ",\n        ";
   char *end   = (compact) ? "]"  : "\n      ]";
   if (d < p->ndims) {
-    if ((m = snprintf(dest+N, PDIFF(n, N), "%s", start)) < 0) goto fail;
+    if ((m = strsets(dest+N, PDIFF(n, N), start)) < 0) goto fail;
     N += m;
     for (i=0; i < shape[d]; i++) {
       if ((m = writedim(d+1, dest+N, PDIFF(n, N), pptr, p, shape,
                         width, prec, flags)) < 0) return -1;
       N += m;
       if (i < shape[d]-1) {
-        if ((m = snprintf(dest+N, PDIFF(n, N), "%s", sep)) < 0) goto fail;
+        if ((m = strsets(dest+N, PDIFF(n, N), sep)) < 0) goto fail;
         N += m;
       }
     }
-    if ((m = snprintf(dest+N, PDIFF(n, N), "%s", end)) < 0) goto fail;
+    if ((m = strsets(dest+N, PDIFF(n, N), end)) < 0) goto fail;
     N += m;
   } else {
     if ((m = dlite_type_print(dest+N, PDIFF(n, N), *pptr, p->type, p->size,
@@ -3186,6 +5593,77 @@ int dlite_property_aprint(char **dest, size_t *n, size_t pos, const void *ptr,
 }
 
 
+/*
+  Help function for scandim().  Scans the number of type `type` and
+  size `size` from the `len` first characters of `s` and writes it to
+  `ptr`.
+
+  Only plain decimal numbers are handled, using the fast scanners in
+  numscan.h rather than sscanf(), which may call strlen() on the rest
+  of the document for each number.
+
+  Returns zero on success and non-zero if the number is not handled,
+  in which case the caller should fall back to dlite_type_scan().
+ */
+static int scannumber(const char *s, int len, void *ptr, DLiteType type,
+                      size_t size)
+{
+  int64_t iv;
+  uint64_t uv;
+  switch (type) {
+  case dliteInt:
+    if (numscan_int64(s, len, &iv) != len) return 1;
+    switch (size) {
+    case 1:
+      if (iv < INT8_MIN || iv > INT8_MAX) return 1;
+      *((int8_t *)ptr) = (int8_t)iv;
+      return 0;
+    case 2:
+      if (iv < INT16_MIN || iv > INT16_MAX) return 1;
+      *((int16_t *)ptr) = (int16_t)iv;
+      return 0;
+    case 4:
+      if (iv < INT32_MIN || iv > INT32_MAX) return 1;
+      *((int32_t *)ptr) = (int32_t)iv;
+      return 0;
+    case 8:
+      *((int64_t *)ptr) = iv;
+      return 0;
+    }
+    return 1;
+  case dliteUInt:
+    if (numscan_uint64(s, len, &uv) != len) return 1;
+    switch (size) {
+    case 1:
+      if (uv > UINT8_MAX) return 1;
+      *((uint8_t *)ptr) = (uint8_t)uv;
+      return 0;
+    case 2:
+      if (uv > UINT16_MAX) return 1;
+      *((uint16_t *)ptr) = (uint16_t)uv;
+      return 0;
+    case 4:
+      if (uv > UINT32_MAX) return 1;
+      *((uint32_t *)ptr) = (uint32_t)uv;
+      return 0;
+    case 8:
+      *((uint64_t *)ptr) = uv;
+      return 0;
+    }
+    return 1;
+  case dliteFloat:
+    switch (size) {
+    case 4:
+      return numscan_float(s, len, (float *)ptr) != len;
+    case 8:
+      return numscan_double(s, len, (double *)ptr) != len;
+    }
+    return 1;
+  default:
+    return 1;
+  }
+}
+
 /*
   Recursive help function for dlite_property_scan() for handling
   n-dimensional arrays.
@@ -3212,6 +5690,22 @@ static int scandim(int d, const char *src, void **pptr,
     if ((*t)->size != (int)shape[d])
       return err(dliteIndexError, "for dimension %d, expected %d elements, got %d",
                  d, (int)shape[d], (*t)->size);
+    if (d == p->ndims-1 && (p->type == dliteInt || p->type == dliteUInt ||
+                            p->type == dliteFloat)) {
+      /* Innermost dimension of numbers, scan them in one go */
+      jsmntok_t *tok = *t + 1;
+      for (i=0; i < shape[d]; i++, tok++) {
+        const char *s = src + tok->start;
+        int len = tok->end - tok->start;
+        if (tok->type != JSMN_PRIMITIVE && tok->type != JSMN_STRING) goto fail;
+        if (scannumber(s, len, *pptr, p->type, p->size) &&
+            (m = dlite_type_scan(s, len, *pptr, p->type, p->size, flags)) < 0)
+          return m;
+        *((char **)pptr) += p->size;
+      }
+      *t += shape[d];
+      return 0;
+    }
     for (i=0; i < shape[d]; i++) {
       (*t)++;
       if (scandim(d+1, src, pptr, p, shape, flags, t)) goto fail;
@@ -192,13 +192,42 @@ typedef int (*DLiteSaveProperty)(DLiteInstance *inst, size_t i);
 /** Flags for describing the state of an instance.  This should be as
     minimalistic as possible, but a flag for immutability is needed. */
 typedef enum _DLiteFlag {
-  dliteImmutable=1  /*!< Whether instance is immutable. */
+  dliteImmutable=1,   /*!< Whether instance is immutable. */
+  dliteArena=2,       /*!< Whether instance is allocated as one memory arena. */
+  dliteBorrowed=4,    /*!< Whether instance borrows a buffer. */
+  dliteHashCached=8,  /*!< Whether instance has a hash cache. */
+  dliteShared=16,     /*!< Whether instance may share arrays with others. */
+  dliteReserved=32,   /*!< Whether instance has reserved array capacity. */
+  dliteShareSnapshots=64 /*!< Whether snapshots may share arrays with the
+                              instance. */
 } DLiteFlag;
 
+/** Function releasing a buffer borrowed by an instance. */
+typedef void (*DLiteBufferFree)(void *buf);
+
 /** The size in bytes of sha3 hash used by transactions.
     Should be 32, 48 or 64. */
 #define DLITE_HASH_SIZE 32
 
+/** Algorithms for calculating instance hashes.
+
+    The sha3 hash is calculated over the instance header followed by
+    the values of all properties.  The fast and sha3-tree hashes are
+    tree hashes, calculated over the instance header followed by a
+    digest of each property, such that a cached hash only needs to
+    rehash the properties that have changed.  Since the digests
+    differ, the three algorithms are distinct digest versions and an
+    instance hash can only be verified with the algorithm it was
+    calculated with. */
+typedef enum _DLiteHashAlgorithm {
+  dliteHashSha3=0,     /*!< Keccak/SHA3 (default) */
+  dliteHashFast=1,     /*!< Fast non-cryptographic tree hash.  Suitable
+                            for change detection, but not for protecting
+                            against deliberate tampering. */
+  dliteHashSha3Tree=2  /*!< Keccak/SHA3 tree hash over 256-bit property
+                            digests. */
+} DLiteHashAlgorithm;
+
 /** Reference to parent instance.  Used by transactions. */
 typedef struct _DLiteParent {
   const struct _DLiteInstance *parent;  /*!< Pointer to parent instance.
@@ -206,6 +235,7 @@ typedef struct _DLiteParent {
                                        parent must be accessed via uuid. */
   char uuid[DLITE_UUID_LENGTH+1]; /*!< UUID of parent instance. */
   uint8_t hash[DLITE_HASH_SIZE];  /*!< Hash of parent instance. */
+  DLiteHashAlgorithm hashalg;     /*!< Algorithm used to calculate `hash`. */
 } DLiteParent;
 
 
@@ -267,6 +297,9 @@ typedef struct _DLiteParent {
   size_t *_propdiminds;   /* Pointer to array (within this metadata) */ \
                           /* of `propdims` indices to first property */ \
                           /* dimension. Length: nproperties */          \
+  struct _InfixCalcExpr **_propdimexprs; /* Compiled property */        \
+                          /* dimension expressions or NULL. */          \
+                          /* Length: npropdims */                       \
                                                                         \
   /* Memory layout of instances */                                      \
   /* If `size` is zero, these values will automatically be assigned */  \
@@ -480,6 +513,107 @@ DLiteInstance *dlite_instance_create(const DLiteMeta *meta,
                                      const size_t *dims,
                                      const char *id);
 
+/**
+  Returns non-zero if new data instances are allocated as a single
+  memory arena holding the header, dimensions, property dimensions
+  and all property arrays.
+ */
+int dlite_instance_use_arena(void);
+
+/**
+  Sets whether new data instances should be allocated as a single
+  memory arena.  This reduces the allocation overhead when creating
+  many small instances.  Arrays that grow when calling
+  dlite_instance_set_dimension_sizes() are moved to separate buffers.
+
+  Default is separate allocations, unless the environment variable
+  DLITE_INSTANCE_ARENA is set and is not false.
+ */
+void dlite_instance_set_use_arena(int v);
+
+/**
+  Returns the hash algorithm used by dlite_instance_get_hash() and
+  when creating transactions.
+ */
+DLiteHashAlgorithm dlite_instance_hash_algorithm(void);
+
+/**
+  Sets the hash algorithm used by dlite_instance_get_hash() and when
+  creating transactions.  The algorithm is recorded together with the
+  parent hash of a transaction, such that transactions created with
+  different algorithms remain verifiable.
+
+  Default is `dliteHashSha3`, unless the environment variable
+  DLITE_HASH_ALGORITHM is set to the name of another algorithm.
+ */
+void dlite_instance_set_hash_algorithm(DLiteHashAlgorithm alg);
+
+/**
+  Returns the name of hash algorithm `alg` or NULL if `alg` is invalid.
+ */
+const char *dlite_hash_algorithm_name(DLiteHashAlgorithm alg);
+
+/**
+  Returns the hash algorithm with the given name ("sha3", "fast" or
+  "sha3-tree").
+  Returns -1 on error.
+ */
+int dlite_hash_algorithm_from_name(const char *name);
+
+/**
+  Lets `inst` borrow the `size` bytes long buffer `buf`.  Array
+  properties may then be turned into views into the buffer with
+  dlite_instance_borrow_property_by_index().
+
+  If `freefun` is not NULL, `inst` takes over the ownership of `buf`
+  and calls `freefun` on it when the instance is free'ed.  Otherwise
+  the caller must keep `buf` alive as long as `inst` exists.
+
+  Borrowed arrays are copied on write.  This is done by the functions
+  in this module that modifies properties, like
+  dlite_instance_set_property() and dlite_instance_set_dimension_sizes(),
+  and by the functions returning a writable pointer to a property, like
+  dlite_instance_get_property().  Use
+  dlite_instance_get_property_const() to read a borrowed array without
+  copying it.  Writes through DLITE_PROP() or the members of a
+  generated C struct are not detected.  Call dlite_instance_unborrow()
+  first if you intend to modify the arrays that way.
+
+  An instance can only borrow one buffer at a time.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_borrow_buffer(DLiteInstance *inst, void *buf, size_t size,
+                                 DLiteBufferFree freefun);
+
+/**
+  Lets array property `i` of `inst` be a view into the buffer borrowed
+  by `inst`, starting at `ptr`.  The whole array must be within the
+  borrowed buffer and `ptr` must be suitably aligned.  Only properties
+  whos type does not allocate additional memory can be borrowed.
+
+  The previous array of property `i` is free'ed.  Its content is not
+  copied.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_borrow_property_by_index(DLiteInstance *inst, size_t i,
+                                            void *ptr);
+
+/**
+  Returns non-zero if array property `i` of `inst` is a view into a
+  borrowed buffer.
+ */
+int dlite_instance_is_borrowed(const DLiteInstance *inst, size_t i);
+
+/**
+  Replaces all views into the buffer borrowed by `inst` with copies
+  owned by the instance and releases the buffer.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_unborrow(DLiteInstance *inst);
+
 /**
   Like dlite_instance_create() but takes the uri or uuid of the
   metadata as the first argument.
@@ -493,6 +627,9 @@ DLiteInstance *dlite_instance_create_from_id(const char *metaid,
 /**
   Increases reference count on `inst`.
 
+  The reference count is updated atomically, so this function may be
+  called concurrently from several threads.
+
   Returns the new reference count.
  */
 int dlite_instance_incref(DLiteInstance *inst);
@@ -596,12 +733,79 @@ DLiteInstance *dlite_instance_load_casted(const DLiteStorage *s,
                                           const char *id,
                                           const char *metaid);
 
+/**
+  Loads the `n` instances with the given `ids` from storage `s` and
+  stores new references to them in `instances`, which must have space
+  for `n` pointers.
+
+  Instances that already are in memory are not reloaded.  The rest are
+  loaded with a single call to the loadInstances() plugin function if
+  the storage provides it and otherwise one by one.
+
+  Returns non-zero on error, in which case no references are left in
+  `instances`.
+ */
+int dlite_instance_load_many(const DLiteStorage *s, const char **ids,
+                             size_t n, DLiteInstance **instances);
+
+/**
+  Like dlite_instance_load_many(), but loads the instances concurrently
+  using up to `nworkers` threads.  If `nworkers` is zero or negative,
+  the number of processors is used.  If it is one, this function is
+  equivalent to dlite_instance_load_many().
+
+  Instances are parsed concurrently if the storage sets the
+  `dliteThreadSafe` flag.  Otherwise this function is equivalent to
+  dlite_instance_load_many(), since storages that are not thread safe
+  (like the Python storage plugins) are only called from the calling
+  thread.
+
+  Errors are collected per instance and reported in the order of
+  `ids` when all workers have finished.  Returns non-zero on error,
+  in which case no references are left in `instances`.
+ */
+int dlite_instance_load_parallel(const DLiteStorage *s, const char **ids,
+                                 size_t n, DLiteInstance **instances,
+                                 int nworkers);
+
 
 /**
   Saves instance `inst` to storage `s`.  Returns non-zero on error.
  */
 int dlite_instance_save(DLiteStorage *s, const DLiteInstance *inst);
 
+/**
+  Saves the `n` instances in `instances` to storage `s`.
+
+  If the storage provides the saveInstances() plugin function, all
+  instances are passed to it in one call.  Otherwise they are saved
+  one by one with dlite_instance_save().
+
+  Returns non-zero on error.
+ */
+int dlite_instance_save_many(DLiteStorage *s, const DLiteInstance **instances,
+                             size_t n);
+
+/**
+  Like dlite_instance_save_many(), but saves the instances concurrently
+  using up to `nworkers` threads.  If `nworkers` is zero or negative,
+  the number of processors is used.  If it is one, this function is
+  equivalent to dlite_instance_save_many().
+
+  Instances are serialised concurrently if the storage sets the
+  `dliteThreadSafe` flag.  Otherwise this function is equivalent to
+  dlite_instance_save_many(), since storages that are not thread safe
+  (like the Python storage plugins) are only called from the calling
+  thread.
+
+  Errors are collected per instance and reported in the order of
+  `instances` when all workers have finished.  Returns non-zero on
+  error.
+ */
+int dlite_instance_save_parallel(DLiteStorage *s,
+                                 const DLiteInstance **instances, size_t n,
+                                 int nworkers);
+
 /**
   A convinient function that saves instance `inst` to the storage specified
   by `driver`, `location` and `options`.
@@ -697,9 +901,26 @@ size_t dlite_instance_get_dimension_size_by_index(const DLiteInstance *inst,
 
   The returned pointer points to the actual data and should not be
   dereferred for arrays.
+
+  The caller may write through the returned pointer.  Use
+  dlite_instance_get_property_const_by_index() if you only need to
+  read the property.
  */
 void *dlite_instance_get_property_by_index(const DLiteInstance *inst, size_t i);
 
+/**
+  Like dlite_instance_get_property_by_index(), but returns a read-only
+  pointer to data corresponding to property with index `i` or NULL on
+  error.
+
+  The property is neither unshared from snapshots nor recorded as
+  exposed, so this accessor is cheaper and should be used by
+  serialisers, storage plugins and other code that only reads the
+  instance.
+ */
+const void *dlite_instance_get_property_const_by_index(const DLiteInstance *inst,
+                                                       size_t i);
+
 /**
   Sets property `i` to the value pointed to by `ptr`.
   Returns non-zero on error.
@@ -733,9 +954,20 @@ int dlite_instance_get_dimension_size(const DLiteInstance *inst,
 
 /**
   Returns a pointer to data corresponding to `name` or NULL on error.
+
+  The caller may write through the returned pointer.  Use
+  dlite_instance_get_property_const() if you only need to read the
+  property.
  */
 void *dlite_instance_get_property(const DLiteInstance *inst, const char *name);
 
+/**
+  Like dlite_instance_get_property(), but returns a read-only pointer
+  to data corresponding to `name` or NULL on error.
+ */
+const void *dlite_instance_get_property_const(const DLiteInstance *inst,
+                                              const char *name);
+
 /**
   Copies memory pointed to by `ptr` to property `name`.
   Returns non-zero on error.
@@ -924,6 +1156,49 @@ int dlite_instance_set_dimension_size_by_index(DLiteInstance *inst,
 int dlite_instance_set_dimension_size(DLiteInstance *inst, const char *name,
                                       size_t size);
 
+/**
+  Reserves room for `capacity` rows along dimension `i` of `inst`, such
+  that rows can be appended with dlite_instance_append_rows_by_index()
+  until dimension `i` has size `capacity` without reallocating any
+  arrays.  Does nothing if dimension `i` is already at least
+  `capacity` long.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_reserve_rows_by_index(DLiteInstance *inst, size_t i,
+                                         size_t capacity);
+
+/**
+  Like dlite_instance_reserve_rows_by_index(), but dimension is
+  specified by name.
+ */
+int dlite_instance_reserve_rows(DLiteInstance *inst, const char *name,
+                                size_t capacity);
+
+/**
+  Increases the size of dimension `i` of `inst` by `n` and zero the
+  new rows of all properties depending on it.
+
+  In contrast to dlite_instance_set_dimension_sizes(), the arrays
+  grow geometrically, such that appending rows one by one is amortised
+  linear in the number of rows.  Properties where dimension `i` is
+  not the first dimension are laid out again, such that all existing
+  elements keep their indices.  This is linear in the size of the
+  property, so streamed data should preferably be appended along the
+  first dimension.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_append_rows_by_index(DLiteInstance *inst, size_t i,
+                                        size_t n);
+
+/**
+  Like dlite_instance_append_rows_by_index(), but dimension is
+  specified by name.
+ */
+int dlite_instance_append_rows(DLiteInstance *inst, const char *name,
+                               size_t n);
+
 /**
   Copies instance `inst` to a newly created instance.
 
@@ -1054,11 +1329,70 @@ char *dlite_instance_default_uri(const DLiteInstance *inst);
   in `hash`, where `hashsize` is the size of `hash` in bytes.  It should
   be 32, 48 or 64.
 
+  If the hash cache is enabled with dlite_instance_set_hash_cache(),
+  properties that have not been modified since the last call are not
+  rehashed.
+
+  The hash is calculated with the algorithm returned by
+  dlite_instance_hash_algorithm().
+
   Return non-zero on error.
  */
 int dlite_instance_get_hash(const DLiteInstance *inst,
                             unsigned char *hash, int hashsize);
 
+/**
+  Like dlite_instance_get_hash(), but calculates the hash with
+  algorithm `alg`.
+
+  With `dliteHashFast` and `dliteHashSha3Tree`, a 128-bit fast or a
+  256-bit sha3 digest of each property is calculated and cached.  The
+  hash is a digest of the instance header and the property digests,
+  such that changing a property only requires that property to be
+  rehashed.  With `dliteHashSha3`, a cached hash must be recalculated
+  from the first modified property.  `hashsize` may be up to 64 bytes
+  for `dliteHashFast` and must be 32, 48 or 64 for the sha3 algorithms.
+
+  Metadata defining a custom hash function ignores `alg`.
+
+  Return non-zero on error.
+ */
+int dlite_instance_get_hash_alg(const DLiteInstance *inst,
+                                unsigned char *hash, int hashsize,
+                                DLiteHashAlgorithm alg);
+
+/**
+  Enables caching of the hash of `inst` if `enable` is non-zero and
+  disables it otherwise.
+
+  With a hash cache, dlite_instance_get_hash() only rehashes the
+  properties that may have been modified since the last call.  These
+  are the properties assigned with dlite_instance_set_property() or
+  related functions, the properties for which a writable pointer has
+  been returned by dlite_instance_get_property() or related functions
+  and all properties when the dimensions are resized.  Properties
+  modified by other means, e.g. through DLITE_PROP() or the members of
+  a generated C struct, must be marked with
+  dlite_instance_mark_modified().
+
+  Instances of metadata with a custom hash function or internal state
+  are never cached.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_set_hash_cache(DLiteInstance *inst, int enable);
+
+/**
+  Marks property `i` of `inst` as modified, such that it will be
+  rehashed by the next call to dlite_instance_get_hash().  If `i` is
+  negative, all properties are marked.
+
+  This is only needed for instances with a hash cache, if the property
+  is modified without using the DLite API, e.g. through the members of
+  a generated C struct.
+ */
+void dlite_instance_mark_modified(DLiteInstance *inst, int i);
+
 
 /** @} */
 /* ================================================================= */
@@ -1087,6 +1421,30 @@ void dlite_instance_freeze(DLiteInstance *inst);
  */
 int dlite_instance_is_frozen(const DLiteInstance *inst);
 
+/**
+  Lets snapshots of `inst` share its arrays of non-allocated types if
+  `enable` is non-zero and disables sharing otherwise.
+
+  Shared arrays are copied when they are modified through the DLite
+  API (copy-on-write), i.e. when they are assigned with
+  dlite_instance_set_property() or related functions, when a writable
+  pointer is returned by dlite_instance_get_property() or related
+  functions and when the dimensions are resized.  Properties for which
+  a writable pointer has been returned before the snapshot are copied
+  to the snapshot.
+
+  While sharing is enabled, arrays of `inst` must not be written to by
+  other means, e.g. through DLITE_PROP() or the members of a generated
+  C struct, since that would modify the snapshots as well.  Such
+  modifications are detected by dlite_instance_verify_transaction().
+
+  Instances of metadata with internal state cannot share arrays with
+  their snapshots.
+
+  Returns non-zero on error.
+ */
+int dlite_instance_set_shared_snapshots(DLiteInstance *inst, int enable);
+
 /**
   Make a snapshop of mutable instance `inst`.
 
@@ -1097,6 +1455,9 @@ int dlite_instance_is_frozen(const DLiteInstance *inst);
   The reason that `inst` must be mutable, is that its hash will change
   due to change in its parent.
 
+  The arrays of `inst` are copied to the snapshot, unless sharing has
+  been enabled with dlite_instance_set_shared_snapshots().
+
   The snapshot will be assigned an URI of the form
   "snapshot-XXXXXXXXXXXX" (or inst->uri#snapshot-XXXXXXXXXXXX if
   inst->uri is not NULL) where each X is replaces with a random
@@ -1183,6 +1544,10 @@ int dlite_instance_has_parent(const DLiteInstance *inst);
   If `recursive` is non-zero, all ancestors of `inst` are also
   included in the verification.
 
+  `hash` is compared to a hash calculated with the current hash
+  algorithm.  Parent hashes are verified with the algorithm they
+  were recorded with.
+
   Returns zero if the hash is valid.  Otherwise non-zero is returned
   and an error message is issued.
 
@@ -105,7 +105,7 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
     for (i=0; i < inst->meta->_nproperties; i++) {
       char *c = (i < inst->meta->_nproperties - 1) ? "," : "";
       DLiteProperty *p = inst->meta->_properties + i;
-      void *ptr = dlite_instance_get_property_by_index(inst, i);
+      const void *ptr = dlite_instance_get_property_const_by_index(inst, i);
       size_t *shape= DLITE_PROP_DIMS(inst, i);
       PRINT2("%s    \"%s\": ", in, p->name);
       m = dlite_property_print(dest+n, PDIFF(size, n), ptr, p, shape, 0, -2, f);
@@ -118,7 +118,7 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
   } else if (flags & dliteJsonArrays) {  // metadata: soft5 format
     DLiteMeta *met = (DLiteMeta *)inst;
     char *description =
-      *((char **)dlite_instance_get_property(inst, "description"));
+      *((char *const *)dlite_instance_get_property_const(inst, "description"));
     if (description)
       PRINT2("%s  \"description\": \"%s\",\n", in, description);
 
@@ -161,7 +161,8 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
     }
     PRINT1("%s  ]\n", in);
 
-    if (dlite_instance_get_property((DLiteInstance *)inst->meta, "relations")) {
+    if (dlite_instance_get_property_const((DLiteInstance *)inst->meta,
+                                          "relations")) {
       PRINT1("%s  \"relations\": [\n", in);
       for (i=0; i < met->_nrelations; i++) {
         int m;
@@ -187,7 +188,7 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
   } else {  // metadata: soft7 format
     DLiteMeta *met = (DLiteMeta *)inst;
     char *description =
-      *((char **)dlite_instance_get_property(inst, "description"));
+      *((char *const *)dlite_instance_get_property_const(inst, "description"));
 
     if (description)
       PRINT2("%s  \"description\": \"%s\",\n", in, description);
@@ -226,7 +227,8 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
     }
     PRINT1("%s  }\n", in);
 
-    if (dlite_instance_get_property((DLiteInstance *)inst->meta, "relations")) {
+    if (dlite_instance_get_property_const((DLiteInstance *)inst->meta,
+                                          "relations")) {
       PRINT1("%s  \"relations\": [\n", in);
       for (i=0; i < met->_nrelations; i++) {
         int m;
@@ -257,6 +259,9 @@ int _dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
                 "cannot encode hash of parent: %s", inst->_parent->uuid);
     PRINT1("%s  \"parent\": {\n", in);
     PRINT2("%s    \"uuid\": \"%s\",\n", in, inst->_parent->uuid);
+    if (inst->_parent->hashalg != dliteHashSha3)
+      PRINT2("%s    \"hashalg\": \"%s\",\n", in,
+             dlite_hash_algorithm_name(inst->_parent->hashalg));
     PRINT2("%s    \"hash\": \"%s\"\n", in, hex);
     PRINT1("%s  }\n", in);
   }
@@ -308,6 +313,35 @@ int dlite_json_sprint(char *dest, size_t size, const DLiteInstance *inst,
 }
 
 
+/*
+  Returns a rough estimate of the size of the json representation of
+  `inst`.  It is used for the initial allocation in dlite_json_asprint(),
+  such that the instance normally only has to be serialised once.
+ */
+static size_t json_size_hint(const DLiteInstance *inst)
+{
+  size_t i, size=1024;
+  int j;
+  for (i=0; i < inst->meta->_nproperties; i++) {
+    DLiteProperty *p = inst->meta->_properties + i;
+    size_t *shape = DLITE_PROP_DIMS(inst, i);
+    size_t nelem=1, elemsize;
+    for (j=0; j < p->ndims; j++) nelem *= shape[j];
+    switch (p->type) {
+    case dliteBlob:       elemsize = 2*p->size + 4; break;
+    case dliteBool:       elemsize = 7;             break;
+    case dliteInt:
+    case dliteUInt:       elemsize = 3*p->size + 3; break;
+    case dliteFloat:      elemsize = 16;            break;
+    case dliteFixString:  elemsize = p->size + 4;   break;
+    default:              elemsize = 64;            break;
+    }
+    size += strlen(p->name) + 8 + nelem*elemsize;
+  }
+  return size;
+}
+
+
 /*
   Like dlite_json_sprint(), but prints to allocated buffer.
 
@@ -331,16 +365,22 @@ int dlite_json_asprint(char **dest, size_t *size, size_t pos,
   char *q;
   size_t newsize;
 
-  if (!dest || !*dest || !*size) {
-    /* Just count number of bytes to write */
-    m = dlite_json_sprint(*dest, 0, inst, indent, flags);
-    if (m < 0) return m;
-  } else {
-    /* Try to write to existing buffer */
-    m = dlite_json_sprint(*dest + pos, PDIFF(*size, pos), inst, indent, flags);
-    if (m < (int)PDIFF(*size, pos)) return m;
+  if (!*dest || !*size) {
+    /* Allocate buffer from an estimated size */
+    if (!*dest) *size = 0;
+    newsize = pos + json_size_hint(inst);
+    if (!(q = realloc(*dest, newsize)))
+      return err(dliteMemoryError, "allocation failure");
+    if (pos > *size) memset(q + *size, ' ', pos - *size);
+    *dest = q;
+    *size = newsize;
   }
 
+  /* Try to write to existing buffer */
+  m = dlite_json_sprint(*dest + pos, PDIFF(*size, pos), inst, indent, flags);
+  if (m < 0) return m;
+  if (m < (int)PDIFF(*size, pos)) return m;
+
   /* Reallocate buffer to required size. */
 
   // FIXME: newsize should really be `newsize = m + pos + 1;`.
@@ -377,10 +417,15 @@ int dlite_json_asprint(char **dest, size_t *size, size_t pos,
 char *dlite_json_aprint(const DLiteInstance *inst, int indent,
                         DLiteJsonFlag flags)
 {
-  char *dest=NULL;
+  char *dest=NULL, *q;
   size_t size=0;
-  if ((dlite_json_asprint(&dest, &size, 0, inst, indent, flags)) < 0)
+  int m;
+  if ((m = dlite_json_asprint(&dest, &size, 0, inst, indent, flags)) < 0) {
+    if (dest) free(dest);
     return NULL;
+  }
+  /* shrink buffer to what is needed */
+  if (size > (size_t)m + 1 && (q = realloc(dest, m + 1))) dest = q;
   return dest;
 }
 
@@ -396,9 +441,10 @@ int dlite_json_fprint(FILE *fp, const DLiteInstance *inst, int indent,
   char *buf=NULL;
   size_t size=0;
   if ((m = dlite_json_asprint(&buf, &size, 0, inst, indent, flags)) >= 0) {
-    fprintf(fp, "%s\n", buf);
-    free(buf);
+    if (fwrite(buf, 1, m, fp) != (size_t)m || fputc('\n', fp) == EOF)
+      m = err(dliteIOError, "error writing json to stream");
   }
+  if (buf) free(buf);
   return m;
 }
 
@@ -775,6 +821,19 @@ static DLiteInstance *parse_instance(const char *src, jsmntok_t *obj,
 */
 DLiteInstance *dlite_json_sscan(const char *src, const char *id,
                                 const char *metaid)
+{
+  return dlite_json_sscann(src, strlen(src), id, metaid);
+}
+
+
+/*
+  Like dlite_json_sscan(), but `src` needs not to be NUL-terminated.
+  `len` is the length of `src`.
+
+  Returns the instance or NULL on error.
+ */
+DLiteInstance *dlite_json_sscann(const char *src, size_t len, const char *id,
+                                 const char *metaid)
 {
   int i, r;
   char *buf=NULL;
@@ -783,7 +842,7 @@ DLiteInstance *dlite_json_sscan(const char *src, const char *id,
   unsigned int ntokens=0;
   jsmntok_t *tokens=NULL, *root;
   jsmn_parser parser;
-  size_t srclen = strlen(src);
+  size_t srclen = len;
   errno = 0;
 
   jsmn_init(&parser);
@@ -1264,6 +1323,144 @@ DLiteJsonFormat dlite_jstore_loadf(JStore *js, const char *filename)
   return fmt;
 }
 
+/* Returns the position of the first non-whitespace character in `src`
+   at or after `pos`. */
+static size_t skip_space(const char *src, size_t len, size_t pos)
+{
+  while (pos < len && isspace(src[pos])) pos++;
+  return pos;
+}
+
+/* Returns the position just after the json value that starts at `pos` in
+   `src`, or zero if the value is not terminated.  Only the nesting of
+   strings, objects and arrays are considered, no further validation is
+   done. */
+static size_t skip_value(const char *src, size_t len, size_t pos)
+{
+  size_t start=pos;
+  int depth=0;
+  for (; pos < len; pos++) {
+    switch (src[pos]) {
+    case '"':
+      for (pos++; pos < len && src[pos] != '"'; pos++)
+        if (src[pos] == '\\') pos++;
+      if (pos >= len) return 0;
+      if (depth == 0) return pos + 1;
+      break;
+    case '{':
+    case '[':
+      depth++;
+      break;
+    case '}':
+    case ']':
+      if (depth == 0) return (pos > start) ? pos : 0;
+      if (--depth == 0) return pos + 1;
+      break;
+    case ',':
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      if (depth == 0) return (pos > start) ? pos : 0;
+      break;
+    }
+  }
+  return (depth == 0 && pos > start) ? pos : 0;
+}
+
+/* Location of a top-level item in a json source */
+typedef struct {
+  size_t key;      /* offset of key (excluding the quote) */
+  size_t keylen;   /* length of key */
+  size_t val;      /* offset of value */
+  size_t vallen;   /* length of value */
+} JsonItemLoc;
+
+/*
+  Like dlite_jstore_loadf(), but instead of reading and parsing the
+  whole file, it is memory mapped and only the location of each
+  instance is recorded.  Instances are parsed on demand when they are
+  retrieved from the store.
+
+  Files in single-entity format are loaded as with dlite_jstore_loadf().
+
+  Returns json format or -1 on error.
+ */
+DLiteJsonFormat dlite_jstore_loadf_lazy(JStore *js, const char *filename)
+{
+  DLiteJsonFormat retval=-1, format;
+  JsonItemLoc *items=NULL, *q;
+  size_t i, n=0, size=0, len, pos, end;
+  char uuid[DLITE_UUID_LENGTH+1];
+  const char *src;
+
+  if (!(src = jstore_attach_file(js, filename, &len)))
+    return err(dliteStorageLoadError, "cannot load JSON file \"%s\"",
+               filename);
+
+  /* Index top-level items */
+  pos = skip_space(src, len, 0);
+  if (pos >= len || src[pos] != '{')
+    FAIL1("root of json file must be an object: \"%s\"", filename);
+  pos = skip_space(src, len, pos+1);
+  while (pos < len && src[pos] != '}') {
+    if (n >= size) {
+      size = (size) ? 2*size : 64;
+      if (!(q = realloc(items, size*sizeof(JsonItemLoc))))
+        FAILCODE(dliteMemoryError, "allocation failure");
+      items = q;
+    }
+    q = items + n++;
+    if (src[pos] != '"' || !(end = skip_value(src, len, pos)))
+      FAIL2("expected json key at offset %zu in \"%s\"", pos, filename);
+    q->key = pos + 1;
+    q->keylen = end - pos - 2;
+    pos = skip_space(src, len, end);
+    if (pos >= len || src[pos] != ':')
+      FAIL2("expected ':' at offset %zu in \"%s\"", pos, filename);
+    pos = skip_space(src, len, pos+1);
+    if (!(end = skip_value(src, len, pos)))
+      FAIL2("invalid json value at offset %zu in \"%s\"", pos, filename);
+    q->val = pos;
+    q->vallen = end - pos;
+
+    /* Single-entity format is loaded the normal way */
+    if (q->keylen == 10 && strncmp(src + q->key, "properties", 10) == 0) {
+      retval = dlite_jstore_loads(js, src, len);
+      goto fail;
+    }
+
+    pos = skip_space(src, len, end);
+    if (pos < len && src[pos] == ',') pos = skip_space(src, len, pos+1);
+  }
+  if (pos >= len)
+    FAIL1("unterminated root object in json file: \"%s\"", filename);
+  if (n == 0) {
+    retval = dliteJsonDataFormat;  /* empty root object */
+    goto fail;
+  }
+
+  /* The format is determined from the first item */
+  if ((format = dlite_json_scheck(src + items[0].val, items[0].vallen,
+                                  NULL, NULL)) < 0) goto fail;
+
+  for (i=0; i<n; i++) {
+    const char *id = src + items[i].key;
+    int idlen = items[i].keylen;
+    if (dlite_get_uuidn(uuid, id, idlen) < 0)
+      goto fail;
+    else if (idlen != DLITE_UUID_LENGTH || !dlite_isuuid(id))
+      jstore_set_labeln(js, uuid, id, idlen);
+    if (jstore_addref(js, uuid, DLITE_UUID_LENGTH,
+                      src + items[i].val, items[i].vallen)) goto fail;
+  }
+  retval = format;
+
+ fail:
+  if (items) free(items);
+  return retval;
+}
+
 /*
   Add json representation of `inst` to json store `js`.
 
@@ -1294,18 +1491,19 @@ DLiteInstance *dlite_jstore_get(JStore *js, const char *id)
 {
   char uuid[DLITE_UUID_LENGTH+1];
   const char *buf=NULL, *scanid=id;
+  size_t len;
   DLiteIdType idtype = dlite_get_uuid(uuid, id);
   if (idtype < 0 || idtype == dliteIdRandom)
     return errx(dliteKeyError, "cannot derive UUID from id: '%s'", id), NULL;
-  if (!(buf = jstore_get(js, uuid)) &&
-      !(buf = jstore_get(js, id)))
+  if (!(buf = jstore_getn(js, uuid, &len)) &&
+      !(buf = jstore_getn(js, id, &len)))
     return errx(dliteKeyError, "no such id in store: '%s'", id), NULL;
 
   /* If `id` is an UUID, check if `id` has been associated with a label */
   if (idtype == dliteIdCopy && !(scanid = jstore_get_label(js, id)))
     scanid = id;
 
-  return dlite_json_sscan(buf, scanid, NULL);
+  return dlite_json_sscann(buf, len, scanid, NULL);
 }
 
 /*
@@ -1349,21 +1547,23 @@ const char *dlite_jstore_iter_next(DLiteJStoreIter *iter)
   while ((iid = jstore_iter_next(&iter->jiter))) {
     if (iter->metauuid[0]) {
       char metauuid[DLITE_UUID_LENGTH+1];
-      const char *val = jstore_get(js, iid);
+      size_t len;
+      const char *val = jstore_getn(js, iid, &len);
       int r;
 
       jsmn_init(&parser);
-      if ((r = jsmn_parse_alloc(&parser, val, strlen(val),
+      if ((r = jsmn_parse_alloc(&parser, val, len,
                                 &iter->tokens, &iter->ntokens)) < 0) {
         if (r == JSMN_ERROR_INVAL)
-          err(dliteParseError, "invalid json input: \"%s\"", val);
+          err(dliteParseError, "invalid json input: \"%.*s\"",
+              (int)len, val);
         else
           err(dliteParseError, "json parse error: \"%s\"", jsmn_strerror(r));
         continue;
       }
       if (get_meta_uuid(metauuid, val, iter->tokens)) {
         err(dliteMissingMetadataError,
-            "json input has no meta uri: \"%s\"", val);
+            "json input has no meta uri: \"%.*s\"", (int)len, val);
         continue;
       }
       if (strcmp(metauuid, iter->metauuid)) continue;
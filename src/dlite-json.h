@@ -138,6 +138,15 @@ int dlite_json_append(char **s, size_t *size, const DLiteInstance *inst,
 DLiteInstance *dlite_json_sscan(const char *src, const char *id,
                                 const char *metaid);
 
+/**
+  Like dlite_json_sscan(), but `src` needs not to be NUL-terminated.
+  `len` is the length of `src`.
+
+  Returns the instance or NULL on error.
+ */
+DLiteInstance *dlite_json_sscann(const char *src, size_t len, const char *id,
+                                 const char *metaid);
+
 /**
   Like dlite_sscan(), but scans instance `id` from stream `fp` instead
   of a string.
@@ -276,6 +285,18 @@ DLiteJsonFormat dlite_jstore_loads(JStore *js, const char *src, int len);
  */
 DLiteJsonFormat dlite_jstore_loadf(JStore *js, const char *filename);
 
+/**
+  Like dlite_jstore_loadf(), but instead of reading and parsing the
+  whole file, it is memory mapped and only the location of each
+  instance is recorded.  Instances are parsed on demand when they are
+  retrieved from the store.
+
+  Files in single-entity format are loaded as with dlite_jstore_loadf().
+
+  Returns json format or -1 on error.
+ */
+DLiteJsonFormat dlite_jstore_loadf_lazy(JStore *js, const char *filename);
+
 /** Opaque iterator struct */
 typedef struct _DLiteJStoreIter DLiteJStoreIter;
 
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -54,6 +55,8 @@ static Globals *get_globals(void) {
                                                 "DLITE_MAPPING_PLUGIN_DIRS",
                                                 dlite_globals_get());
     if (!g->mapping_plugin_info) goto fail;
+    plugin_info_set_api_version(g->mapping_plugin_info,
+                                DLITE_MAPPING_PLUGIN_API_VERSION);
     fu_paths_set_platform(&g->mapping_plugin_info->paths, dlite_get_platform());
     if (dlite_use_build_root())
       plugin_path_extend(g->mapping_plugin_info, dlite_MAPPING_PLUGINS, NULL);
@@ -139,7 +142,11 @@ const DLiteMappingPlugin *dlite_mapping_plugin_get(const char *name)
   load_mapping_plugins();
   if ((api = (DLiteMappingPlugin *)plugin_get_api(info, name, code))) return api;
 #ifdef WITH_PYTHON
-  if ((api = dlite_python_mapping_get_api(name))) return api;
+  if ((api = dlite_python_mapping_get_api(name))) {
+    if (!plugin_has_api(info, api->name))
+      plugin_register_api(info, (PluginAPI *)api);
+    return api;
+  }
 #endif
   /* Cannot find API */
   int i=0, j=2, m=0;
@@ -168,6 +175,20 @@ const DLiteMappingPlugin *dlite_mapping_plugin_get(const char *name)
 }
 
 
+/*
+  Returns the api version implemented by mapping plugin `api`.
+
+  The fields following `data` in DLiteMappingPlugin may only be
+  accessed if this is at least 2.
+ */
+int dlite_mapping_plugin_api_version(const DLiteMappingPlugin *api)
+{
+  PluginInfo *info;
+  if (!(info = get_mapping_plugin_info())) return 0;
+  return plugin_api_version(info, api->name);
+}
+
+
 /*
   Initiates a mapping plugin iterator.  Returns non-zero on error.
 */
@@ -209,6 +230,39 @@ dlite_mapping_plugin_next(DLiteMappingPluginIter *iter)
 }
 
 
+/* Updates FNV-1a hash `h` with NULL-terminated string array `strings`. */
+static uint64_t hash_strings(uint64_t h, const char **strings)
+{
+  const char **p, *c;
+  if (!strings) return h;
+  for (p=strings; *p; p++) {
+    for (c=*p; *c; c++) h = (h ^ (unsigned char)*c) * 0x100000001b3ULL;
+    h = (h ^ '\n') * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/*
+  Returns a stamp that changes whenever a mapping plugin is registered
+  or unloaded or the mapping plugin search path is modified.
+
+  The stamp is cheap to compute.  It does not look into the
+  directories in the search path, hence plugins added to these
+  directories are not detected.
+ */
+uint64_t dlite_mapping_plugin_stamp(void)
+{
+  PluginInfo *info;
+  uint64_t h = 0xcbf29ce484222325ULL;
+  if (!(info = get_mapping_plugin_info())) return 0;
+  h = hash_strings(h, plugin_path_get(info));
+#ifdef WITH_PYTHON
+  h = hash_strings(h, dlite_python_mapping_paths_get());
+#endif
+  return (h ^ info->generation) * 0x100000001b3ULL;
+}
+
+
 /*
   Unloads and unregisters mapping plugin with the given name.
 
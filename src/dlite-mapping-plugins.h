@@ -9,7 +9,7 @@
   function
 
       const DLiteMappingPlugin *
-      get_dlite_mapping_api(const char *name);
+      get_dlite_mapping_api_v2(const char *name);
 
   that returns a pointer to a struct with pointers to all functions
   provided by the plugin.  The `name` is just a hint that plugins are
@@ -17,10 +17,16 @@
   several different drivers, to select which api that should be
   returned.
 
+  Plugins defining the older `get_dlite_mapping_api()` are still
+  loaded, but only provide the fields of DLiteMappingPlugin up to and
+  including `data`.
+
   The mapping plugin search path is initialised from the environment
   variable `DLITE_MAPPING_PLUGIN_DIRS`.
 */
 
+#include <stdint.h>
+
 #include "utils/dsl.h"
 #include "utils/plugin.h"
 #include "utils/fileutils.h"
@@ -79,6 +85,14 @@ typedef const DLiteMappingPlugin *(*GetDLiteMappingAPI)(int *iter);
  */
 const DLiteMappingPlugin *dlite_mapping_plugin_get(const char *name);
 
+/**
+  Returns the api version implemented by mapping plugin `api`.
+
+  The fields following `data` in DLiteMappingPlugin may only be
+  accessed if this is at least 2.
+ */
+int dlite_mapping_plugin_api_version(const DLiteMappingPlugin *api);
+
 /**
   Initiates a mapping plugin iterator.  Returns non-zero on error.
 */
@@ -95,6 +109,16 @@ const DLiteMappingPlugin *
 dlite_mapping_plugin_next(DLiteMappingPluginIter *iter);
 
 
+/**
+  Returns a stamp that changes whenever a mapping plugin is registered
+  or unloaded or the mapping plugin search path is modified.
+
+  Used for invalidating cached mapping plans.  Plugins added to a
+  directory in the search path are not detected.
+ */
+uint64_t dlite_mapping_plugin_stamp(void);
+
+
 /**
   Unloads and unregisters mapping plugin with the given name.
 
@@ -179,10 +203,32 @@ int dlite_mapping_plugin_path_remove_index(int index);
 /**
   Returns a new instance obtained by mapping `instances`.
   Returns NULL on error.
+
+  The input instances are borrowed.  The mapper must not decrease
+  their reference count.
  */
 typedef DLiteInstance *(*Mapper)(const DLiteMappingPlugin *api,
                                  const DLiteInstance **instances, int n);
 
+/**
+  Optional function that maps `ntuples` tuples of input instances at
+  once.
+
+  `instances` is an array of length `ntuples * ninput`, where the
+  inputs of tuple `t` are found at `instances[t*ninput]`, ordered as
+  `input_uris`.  New instances are written to the array `outputs` of
+  length `ntuples`.
+
+  Like for Mapper, the input instances are borrowed and the outputs
+  are new references.
+
+  Returns non-zero on error.  The caller releases the instances
+  written to `outputs` in case of errors.
+ */
+typedef int (*MapperMany)(const DLiteMappingPlugin *api,
+                          const DLiteInstance **instances, int ninput,
+                          size_t ntuples, DLiteInstance **outputs);
+
 /**
   Releases internal resources associated with `api`.
  */
@@ -192,6 +238,15 @@ typedef void (*Freer)(DLiteMappingPlugin *api);
 
 
 
+/**
+  Current version of the mapping plugin api.  Plugins implementing it
+  define `get_dlite_mapping_api_v2()`.  Plugins providing the older
+  `get_dlite_mapping_api()` are compiled against a shorter
+  DLiteMappingPlugin struct, without the fields following `data`.
+ */
+#define DLITE_MAPPING_PLUGIN_API_VERSION 2
+
+
 /**
   Struct with the name and pointers to function for a plugin. All
   plugins should define themselves by defining an intance of
@@ -210,6 +265,10 @@ struct _DLiteMappingPlugin {
   Mapper         mapper;     /*!< Pointer to mapping function */
   int            cost;       /*!< Cost of this mapping. Default: 20 */
   void *         data;       /*!< Internal data used by the mapper */
+
+  /* Fields added in version 2 of the api.  They are only accessed if
+     dlite_mapping_plugin_api_version() returns at least 2. */
+  MapperMany     map_many;   /*!< Optional. Maps many tuples of inputs */
 };
 
 
@@ -1,12 +1,15 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "utils/err.h"
 #include "utils/map.h"
 #include "utils/tgen.h"
 #include "utils/plugin.h"
+#include "utils/sync.h"
 
 #include "dlite-macros.h"
 #include "dlite-store.h"
@@ -205,6 +208,228 @@ DLiteMapping *mapping_create_base(const char *output_uri, Instances *inputs)
 }
 
 
+/*
+  Cache of mapping plans.
+
+  Finding the cheapest way to map a set of input metadata to the
+  output metadata requires a recursive search over all registered
+  mapping plugins.  Since dlite_mapping() typically is called over
+  and over again with instances of the same metadata (e.g. when
+  casting a stream of instances), resolved plans are cached in a
+  global map.  The key is the output URI followed by the sorted input
+  URIs, separated by newlines.
+
+  All cached plans are dropped when the stamp returned by
+  dlite_mapping_plugin_stamp() changes, i.e. when a mapping plugin is
+  registered or unloaded or the search path is modified.  A cached
+  plan only refers to strings owned by the mapping plugins, which are
+  valid until the plugin is unloaded.
+
+  Cached plans are reference counted, such that a plan that is in use
+  by one thread stays valid when another thread drops it from the
+  cache.  The cache holds one reference and each user of the plan
+  holds one, taken and released with the cache lock held.
+
+  The trivial case, where one of the inputs has the output metadata,
+  is cheap and not cached.  Neither are failed searches.
+*/
+
+/* A reference counted plan in the mapping plan cache. */
+typedef struct {
+  DLiteMapping *m;  /* The plan */
+  int refcount;     /* Number of references, including the cache's own */
+} CachedPlan;
+
+typedef map_t(CachedPlan *) CachedPlans;
+
+/* The mapping plan cache. */
+typedef struct {
+  Mutex lock;         /* Protects the fields below and plan refcounts */
+  uint64_t stamp;     /* Mapping plugin stamp that `plans` are valid for */
+  CachedPlans plans;  /* Maps keys to cached plans */
+} MappingCache;
+
+/* Lock serialising lazy creation of the mapping plan cache. */
+static Mutex _mapping_cache_init_lock = MUTEX_INITIALIZER;
+
+/* Releases the cache's reference to all plans in `cache` and leaves it
+   empty.  Plans that are still in use are freed by their last user.
+   The cache lock must be held. */
+static void _mapping_cache_reset(MappingCache *cache)
+{
+  const char *key;
+  map_iter_t iter = map_iter(&cache->plans);
+  while ((key = map_next(&cache->plans, &iter))) {
+    CachedPlan **pp = map_get(&cache->plans, key);
+    assert(pp && *pp);
+    if (--(*pp)->refcount == 0) {
+      dlite_mapping_free((*pp)->m);
+      free(*pp);
+    }
+  }
+  map_deinit(&cache->plans);
+  map_init(&cache->plans);
+}
+
+/* Frees the mapping plan cache. */
+static void _mapping_cache_free(void *mapping_cache)
+{
+  MappingCache *cache = mapping_cache;
+  _mapping_cache_reset(cache);
+  map_deinit(&cache->plans);
+  mutex_destroy(&cache->lock);
+  free(cache);
+}
+
+/* Returns a pointer to the mapping plan cache or NULL on error. */
+static MappingCache *_mapping_cache(void)
+{
+  MappingCache *cache = dlite_globals_get_state("dlite-mapping-cache");
+  if (!cache) {
+    mutex_lock(&_mapping_cache_init_lock);
+    if (!(cache = dlite_globals_get_state("dlite-mapping-cache"))) {
+      if ((cache = calloc(1, sizeof(MappingCache)))) {
+        mutex_init(&cache->lock);
+        map_init(&cache->plans);
+        dlite_globals_add_state("dlite-mapping-cache", cache,
+                                _mapping_cache_free);
+      }
+    }
+    mutex_unlock(&_mapping_cache_init_lock);
+  }
+  return cache;
+}
+
+/* Compares two strings, for qsort(). */
+static int _strcmp_p(const void *a, const void *b)
+{
+  return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* Returns a newly allocated cache key for mapping `inputs` to
+   `output_uri` or NULL on error. */
+static char *mapping_cache_key(const char *output_uri, Instances *inputs)
+{
+  const char *uri, **uris;
+  size_t i, n=0, len=strlen(output_uri)+1;
+  char *key=NULL, *p;
+  map_iter_t iter = map_iter(inputs);
+
+  if (!(uris = malloc((inputs->base.nnodes + 1) * sizeof(char *))))
+    return err(dliteMemoryError, "allocation failure"), NULL;
+  while ((uri = map_next(inputs, &iter))) {
+    uris[n++] = uri;
+    len += strlen(uri) + 1;
+  }
+  qsort(uris, n, sizeof(char *), _strcmp_p);
+
+  if (!(key = malloc(len))) {
+    free(uris);
+    return err(dliteMemoryError, "allocation failure"), NULL;
+  }
+  p = key;
+  p += sprintf(p, "%s", output_uri);
+  for (i=0; i<n; i++) p += sprintf(p, "\n%s", uris[i]);
+  free(uris);
+  return key;
+}
+
+/*
+  Like mapping_create_base(), but looks up the plan in the mapping plan
+  cache first.  New plans are added to the cache.
+
+  On return, `*plan` is set to a new reference to the cache entry if
+  the returned plan is owned by the cache.  It should then be released
+  with mapping_cache_release() instead of freeing the plan.  Otherwise
+  `*plan` is set to NULL and the caller owns the returned plan.
+ */
+static DLiteMapping *mapping_cache_get(const char *output_uri,
+                                       Instances *inputs, CachedPlan **plan)
+{
+  MappingCache *cache;
+  DLiteMapping *m=NULL;
+  CachedPlan *p, **pp;
+  uint64_t stamp;
+  char *key;
+
+  *plan = NULL;
+  if (map_get(inputs, output_uri) || !(cache = _mapping_cache()))
+    return mapping_create_base(output_uri, inputs);
+  if (!(key = mapping_cache_key(output_uri, inputs))) return NULL;
+
+  stamp = dlite_mapping_plugin_stamp();
+  mutex_lock(&cache->lock);
+  if (stamp != cache->stamp) {
+    _mapping_cache_reset(cache);
+    cache->stamp = stamp;
+  }
+  if ((pp = map_get(&cache->plans, key))) {
+    *plan = *pp;
+    (*plan)->refcount++;
+    m = (*plan)->m;
+  }
+  mutex_unlock(&cache->lock);
+
+  /* Search without holding the lock.  The search may register new
+     plugins (e.g. Python mappings), so the stamp is checked again. */
+  if (!m && (m = mapping_create_base(output_uri, inputs))) {
+    stamp = dlite_mapping_plugin_stamp();
+    mutex_lock(&cache->lock);
+    if (stamp != cache->stamp) {
+      _mapping_cache_reset(cache);
+      cache->stamp = stamp;
+    }
+    if ((pp = map_get(&cache->plans, key))) {
+      /* Another thread added the same plan in the meantime */
+      dlite_mapping_free(m);
+      *plan = *pp;
+      (*plan)->refcount++;
+      m = (*plan)->m;
+    } else if ((p = malloc(sizeof(CachedPlan)))) {
+      p->m = m;
+      p->refcount = 2;  /* the cache and the caller */
+      if (map_set(&cache->plans, key, p) == 0)
+        *plan = p;
+      else
+        free(p);
+    }
+    mutex_unlock(&cache->lock);
+  }
+  free(key);
+  return m;
+}
+
+/*
+  Releases a reference to `plan` returned by mapping_cache_get().  The
+  plan is freed if it is no longer in the cache or in use.
+ */
+static void mapping_cache_release(CachedPlan *plan)
+{
+  MappingCache *cache = _mapping_cache();
+  int refcount;
+  assert(cache);
+  mutex_lock(&cache->lock);
+  refcount = --plan->refcount;
+  mutex_unlock(&cache->lock);
+  if (refcount == 0) {
+    dlite_mapping_free(plan->m);
+    free(plan);
+  }
+}
+
+/*
+  Clears the cache of mapping plans used by dlite_mapping().
+ */
+void dlite_mapping_cache_clear(void)
+{
+  MappingCache *cache;
+  if (!(cache = _mapping_cache())) return;
+  mutex_lock(&cache->lock);
+  _mapping_cache_reset(cache);
+  mutex_unlock(&cache->lock);
+}
+
+
 /*
   Returns a new nested mapping structure describing how `n` input
   instances of metadata `input_uris` can be mapped to `output_uri`.
@@ -436,11 +661,142 @@ DLiteInstance *dlite_mapping_map(const DLiteMapping *m,
 }
 
 
+/* Returns the index of the instance in the first input tuple of
+   `instances` with metadata `uri` or -1 if there is no such instance. */
+static int input_index(const DLiteInstance **instances, int n,
+                       const char *uri)
+{
+  int k;
+  for (k=0; k<n; k++)
+    if (strcmp(instances[k]->meta->uri, uri) == 0) return k;
+  return -1;
+}
+
+/*
+  Recursive help function for dlite_mapping_map_many().  Returns a
+  newly allocated array with `ntuples` new instances of metadata
+  `m->output_uri` or NULL on error.
+
+  Each node in the mapping tree is applied to all tuples before moving
+  on to the next node, such that plugins providing a `map_many()`
+  function are called only once per node.
+ */
+static DLiteInstance **mapping_map_many_rec(const DLiteMapping *m,
+                                            const DLiteInstance **instances,
+                                            int n, size_t ntuples)
+{
+  int i, k, ok=0;
+  size_t t;
+  const DLiteInstance **args=NULL;
+  DLiteInstance ***subs=NULL, **outputs=NULL;
+
+  if (!(outputs = calloc(ntuples, sizeof(DLiteInstance *))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+
+  /* Trivial case - one of the inputs has metadata `m->output_uri` */
+  if (!m->name) {
+    if ((k = input_index(instances, n, m->output_uri)) < 0)
+      FAIL1("no input instance of metadata: %s", m->output_uri);
+    for (t=0; t<ntuples; t++) {
+      outputs[t] = (DLiteInstance *)instances[t*n + k];
+      dlite_instance_incref(outputs[t]);
+    }
+    return outputs;
+  }
+
+  /* Collect arguments, applying sub-mappings for all tuples */
+  if (!(subs = calloc(m->ninput, sizeof(DLiteInstance **))) ||
+      !(args = calloc(ntuples * m->ninput, sizeof(DLiteInstance *))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+  for (i=0; i < m->ninput; i++) {
+    if (m->input_maps[i]) {
+      if (!(subs[i] = mapping_map_many_rec(m->input_maps[i], instances, n,
+                                           ntuples))) goto fail;
+      for (t=0; t<ntuples; t++) args[t*m->ninput + i] = subs[i][t];
+    } else {
+      if ((k = input_index(instances, n, m->input_uris[i])) < 0)
+        FAIL1("no input instance of metadata: %s", m->input_uris[i]);
+      for (t=0; t<ntuples; t++) args[t*m->ninput + i] = instances[t*n + k];
+    }
+  }
+
+  /* Call the mapper functions from plugin */
+  if (dlite_mapping_plugin_api_version(m->api) >= 2 && m->api->map_many) {
+    if (m->api->map_many(m->api, args, m->ninput, ntuples, outputs))
+      goto fail;
+  } else {
+    for (t=0; t<ntuples; t++)
+      if (!(outputs[t] = m->api->mapper(m->api, args + t*m->ninput,
+                                        m->ninput))) goto fail;
+  }
+  ok = 1;
+
+ fail:
+  if (subs) {
+    for (i=0; i < m->ninput; i++) {
+      if (!subs[i]) continue;
+      for (t=0; t<ntuples; t++) dlite_instance_decref(subs[i][t]);
+      free(subs[i]);
+    }
+    free(subs);
+  }
+  if (args) free((void *)args);
+  if (!ok && outputs) {
+    for (t=0; t<ntuples; t++)
+      if (outputs[t]) dlite_instance_decref(outputs[t]);
+    free(outputs);
+    outputs = NULL;
+  }
+  return outputs;
+}
+
+/*
+  Applies the mapping `m` on `ntuples` tuples of input instances.
+
+  `instances` is an array of length `ntuples * n`, where the inputs of
+  tuple `t` are found at `instances[t*n]`.  All tuples must have the
+  same metadata in the same order.
+
+  Returns a newly allocated array of length `ntuples` with new
+  instances or NULL on error.
+ */
+DLiteInstance **dlite_mapping_map_many(const DLiteMapping *m,
+                                       const DLiteInstance **instances, int n,
+                                       size_t ntuples)
+{
+  int j, k;
+  size_t t;
+
+  /* Check that all tuples have the same unique metadata */
+  for (k=0; k<n && ntuples; k++) {
+    const DLiteMeta *meta = instances[k]->meta;
+    for (j=0; j<k; j++)
+      if (strcmp(instances[j]->meta->uri, meta->uri) == 0)
+        return err(1, "more than one instance of the same metadata: %s",
+                   meta->uri), NULL;
+    for (t=1; t<ntuples; t++) {
+      const DLiteMeta *tmeta = instances[t*n + k]->meta;
+      if (tmeta != meta && strcmp(tmeta->uri, meta->uri) != 0)
+        return err(1, "input %d of tuple %lu is of metadata %s, expected %s",
+                   k, (unsigned long)t, tmeta->uri, meta->uri), NULL;
+    }
+  }
+  if (!ntuples) {
+    DLiteInstance **outputs = calloc(1, sizeof(DLiteInstance *));
+    if (!outputs) err(dliteMemoryError, "allocation failure");
+    return outputs;
+  }
+  return mapping_map_many_rec(m, instances, n, ntuples);
+}
+
+
 /*
   Returns a new instance of metadata `output_uri` by mapping the `n` input
   instances in the array `instances`.
 
-  This is the main function in the mapping api.
+  This is the main function in the mapping api.  The mapping plan is
+  cached, such that only the first call for a given output metadata
+  and set of input metadata searches the mapping plugins.
  */
 DLiteInstance *dlite_mapping(const char *output_uri,
                              const DLiteInstance **instances, int n)
@@ -448,16 +804,20 @@ DLiteInstance *dlite_mapping(const char *output_uri,
   DLiteInstance *inst=NULL;
   DLiteMapping *m=NULL;
   Instances inputs;
+  CachedPlan *plan=NULL;
 
   map_init(&inputs);
 
   /* Increases refcount on each input instance */
   if (set_inputs(&inputs, instances, n)) goto fail;
-  if (!(m = mapping_create_base(output_uri, &inputs))) goto fail;
+  if (!(m = mapping_cache_get(output_uri, &inputs, &plan))) goto fail;
   inst = dlite_mapping_map(m, instances, n);
 
  fail:
-  if (m) dlite_mapping_free(m);
+  if (plan)
+    mapping_cache_release(plan);
+  else if (m)
+    dlite_mapping_free(m);
 
   /* Decrease refcount */
   decref_inputs(&inputs);
@@ -465,3 +825,43 @@ DLiteInstance *dlite_mapping(const char *output_uri,
 
   return inst;
 }
+
+
+/*
+  Returns a newly allocated array of `ntuples` new instances of
+  metadata `output_uri` by mapping `ntuples` tuples of input instances.
+
+  `instances` is an array of length `ntuples * n`, where the inputs of
+  tuple `t` are found at `instances[t*n]`.  All tuples must have the
+  same metadata in the same order.
+
+  The mapping plan is resolved only once and applied to all tuples
+  with dlite_mapping_map_many().  Returns NULL on error.
+ */
+DLiteInstance **dlite_mapping_many(const char *output_uri,
+                                   const DLiteInstance **instances, int n,
+                                   size_t ntuples)
+{
+  DLiteInstance **outputs=NULL;
+  DLiteMapping *m=NULL;
+  Instances inputs;
+  CachedPlan *plan=NULL;
+
+  if (!ntuples) return dlite_mapping_map_many(NULL, instances, n, 0);
+
+  map_init(&inputs);
+
+  /* Resolve the plan from the first tuple */
+  if (set_inputs(&inputs, instances, n)) goto fail;
+  if (!(m = mapping_cache_get(output_uri, &inputs, &plan))) goto fail;
+  outputs = dlite_mapping_map_many(m, instances, n, ntuples);
+
+ fail:
+  if (plan)
+    mapping_cache_release(plan);
+  else if (m)
+    dlite_mapping_free(m);
+  decref_inputs(&inputs);
+  map_deinit(&inputs);
+  return outputs;
+}
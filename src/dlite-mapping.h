@@ -42,11 +42,23 @@ typedef struct _DLiteMapping {
   Returns a new instance of metadata `output_uri` by mapping the `n` input
   instances in the array `instances`.
 
-  This is the main function in the mapping api.
+  This is the main function in the mapping api.  The mapping plan is
+  cached, such that only the first call for a given output metadata
+  and set of input metadata searches the mapping plugins.
  */
 DLiteInstance *dlite_mapping(const char *output_uri,
                              const DLiteInstance **instances, int n);
 
+/**
+  Clears the cache of mapping plans used by dlite_mapping().
+
+  There is normally no need to call this function, since the cache is
+  invalidated when mapping plugins are registered or unloaded or the
+  search path is modified.  Call it after adding new plugins to a
+  directory that already is in the search path.
+ */
+void dlite_mapping_cache_clear(void);
+
 
 
 /**
@@ -78,5 +90,37 @@ char *dlite_mapping_string(const DLiteMapping *m);
 DLiteInstance *dlite_mapping_map(const DLiteMapping *m,
                                  const DLiteInstance **instances, int n);
 
+/**
+  Applies the mapping `m` on `ntuples` tuples of input instances.
+
+  `instances` is an array of length `ntuples * n`, where the inputs of
+  tuple `t` are found at `instances[t*n]`.  All tuples must have the
+  same metadata in the same order.
+
+  Each node in the mapping is applied to all tuples at once.  Mapping
+  plugins that provide a `map_many()` function are called once per
+  node, other plugins once per tuple.
+
+  Returns a newly allocated array of length `ntuples` with new
+  instances or NULL on error.  The caller must decref the instances
+  and free the array.
+ */
+DLiteInstance **dlite_mapping_map_many(const DLiteMapping *m,
+                                       const DLiteInstance **instances, int n,
+                                       size_t ntuples);
+
+/**
+  Returns a newly allocated array of `ntuples` new instances of
+  metadata `output_uri` by mapping `ntuples` tuples of input instances.
+
+  Like dlite_mapping(), but the mapping plan is resolved only once and
+  applied to all tuples with dlite_mapping_map_many().
+
+  Returns NULL on error.
+ */
+DLiteInstance **dlite_mapping_many(const char *output_uri,
+                                   const DLiteInstance **instances, int n,
+                                   size_t ntuples);
+
 
 #endif /* _DLITE_MAPPING_H */
@@ -9,6 +9,7 @@
 
 #include "utils/compat.h"
 #include "utils/map.h"
+#include "utils/sync.h"
 #include "utils/err.h"
 #include "utils/strtob.h"
 #include "utils/tgen.h"
@@ -169,6 +170,133 @@ static void uuid5n(char *buff, const char *id, size_t len)
   uuid_as_string(&uuid, buff);
 }
 
+/*
+  Cache of UUIDs derived from ids by hashing.
+
+  Deriving the UUID of an URI or a name requires a SHA-1 hash.  Since
+  the same (metadata) URIs are resolved over and over again, the
+  results are memoised in a global map from id to UUID.  The cache is
+  bounded to UUID_CACHE_MAXSIZE entries and is simply cleared when it
+  is full.  Ids longer than UUID_CACHE_MAXIDLEN are not cached.
+
+  The UUID of a name depends on the namespacedID behavior.  Entries
+  for names record the value of the behavior they were derived with,
+  and are ignored if it has changed.  The UUID of an URI is
+  independent of the behavior, so hits on URIs don't need to look it
+  up.
+
+  Ids that are UUIDs or ends with an UUID are not cached, since they
+  are cheap to resolve.
+*/
+#define UUID_CACHE_MAXSIZE 4096
+#define UUID_CACHE_MAXIDLEN 255
+
+/* An entry in the UUID cache. */
+typedef struct {
+  char uuid[DLITE_UUID_LENGTH+1];  /* Derived UUID */
+  int namespacedID;  /* Behavior used to derive `uuid`, -1 for URIs. */
+} UuidCacheEntry;
+
+typedef map_t(UuidCacheEntry) uuid_cache_map_t;
+
+/* The UUID cache. */
+typedef struct {
+  RWLock lock;           /* Protects `map` */
+  uuid_cache_map_t map;  /* Maps ids to UUIDs */
+} UuidCache;
+
+/* Lock serialising lazy creation of the UUID cache. */
+static Mutex _uuid_cache_init_lock = MUTEX_INITIALIZER;
+
+/* Frees the UUID cache. */
+static void _uuid_cache_free(void *uuid_cache)
+{
+  UuidCache *cache = uuid_cache;
+  map_deinit(&cache->map);
+  rwlock_destroy(&cache->lock);
+  free(cache);
+}
+
+/* Returns a pointer to the UUID cache or NULL on error. */
+static UuidCache *_uuid_cache(void)
+{
+  UuidCache *cache = dlite_globals_get_state("dlite-uuid-cache");
+  if (!cache) {
+    mutex_lock(&_uuid_cache_init_lock);
+    if (!(cache = dlite_globals_get_state("dlite-uuid-cache"))) {
+      if ((cache = malloc(sizeof(UuidCache)))) {
+        rwlock_init(&cache->lock);
+        map_init(&cache->map);
+        dlite_globals_add_state("dlite-uuid-cache", cache, _uuid_cache_free);
+      }
+    }
+    mutex_unlock(&_uuid_cache_init_lock);
+  }
+  return cache;
+}
+
+/*
+  Looks up NUL-terminated `key` in the UUID cache.  If found, the
+  UUID is written to `buff` and 1 is returned.  `*namespacedID` is
+  the current namespacedID behavior.  It is initialised if needed and
+  it is negative.
+
+  Returns 0 if `key` is not in the cache.
+ */
+static int _uuid_cache_get(char *buff, const char *key, int *namespacedID)
+{
+  UuidCache *cache;
+  UuidCacheEntry *entry, e;
+  if (!(cache = _uuid_cache())) return 0;
+  rwlock_rdlock(&cache->lock);
+  entry = map_get_(&cache->map.base, key);
+  if (entry) e = *entry;
+  rwlock_rdunlock(&cache->lock);
+  if (!entry) return 0;
+  if (e.namespacedID >= 0) {
+    if (*namespacedID < 0) *namespacedID = dlite_behavior_get("namespacedID");
+    if (e.namespacedID != *namespacedID) return 0;
+  }
+  memcpy(buff, e.uuid, DLITE_UUID_LENGTH+1);
+  return 1;
+}
+
+/*
+  Adds NUL-terminated `key` mapped to `uuid` to the UUID cache.
+  `namespacedID` is the behavior used to derive `uuid` or -1 if `key`
+  is an URI.
+ */
+static void _uuid_cache_add(const char *key, const char *uuid,
+                            int namespacedID)
+{
+  UuidCache *cache;
+  UuidCacheEntry e;
+  if (!(cache = _uuid_cache())) return;
+  memcpy(e.uuid, uuid, DLITE_UUID_LENGTH+1);
+  e.namespacedID = namespacedID;
+  rwlock_wrlock(&cache->lock);
+  if (cache->map.base.nnodes >= UUID_CACHE_MAXSIZE) {
+    map_deinit(&cache->map);
+    map_init(&cache->map);
+  }
+  map_set(&cache->map, key, e);
+  rwlock_wrunlock(&cache->lock);
+}
+
+/*
+  Clears the cache of UUIDs derived from ids.
+ */
+void dlite_uuid_cache_clear(void)
+{
+  UuidCache *cache;
+  if (!(cache = _uuid_cache())) return;
+  rwlock_wrlock(&cache->lock);
+  map_deinit(&cache->map);
+  map_init(&cache->map);
+  rwlock_wrunlock(&cache->lock);
+}
+
+
 /*
   Writes instance UUID to `buff` based on `id`.
 
@@ -195,7 +323,8 @@ static void uuid5n(char *buff, const char *id, size_t len)
   - *name* is a string that is neither a UUID or a URL. Ex: "aa6060"
 
   A version 4 UUID is used for the random UUID and a version 5 UUID
-  (with the DNS namespace) is used for the hash.
+  (with the DNS namespace) is used for the hash.  Hashed UUIDs are
+  memoised in a bounded cache.
 
   Returns the DLite ID type or a negative error code on error.
  */
@@ -210,8 +339,23 @@ DLiteIdType dlite_get_uuid(char *buff, const char *id)
  */
 DLiteIdType dlite_get_uuidn(char *buff, const char *id, size_t len)
 {
-  int namespacedID = dlite_behavior_get("namespacedID");
-  return _dlite_get_uuidn(buff, id, len, namespacedID);
+  char key[UUID_CACHE_MAXIDLEN+1];
+  int namespacedID=-1, type;
+
+  if (!id || !len || !*id || len > UUID_CACHE_MAXIDLEN ||
+      (len == DLITE_UUID_LENGTH && isuuid(id)) || memchr(id, '\0', len))
+    return _dlite_get_uuidn(buff, id, len,
+                            dlite_behavior_get("namespacedID"));
+
+  memcpy(key, id, len);
+  key[len] = '\0';
+  if (_uuid_cache_get(buff, key, &namespacedID)) return dliteIdHash;
+
+  if (namespacedID < 0) namespacedID = dlite_behavior_get("namespacedID");
+  type = _dlite_get_uuidn(buff, id, len, namespacedID);
+  if (type == dliteIdHash && namespacedID >= 0)
+    _uuid_cache_add(key, buff, (isurln(id, len)) ? -1 : namespacedID);
+  return type;
 }
 
 /*
@@ -129,7 +129,8 @@ int dlite_normalise_idn(char *buff, size_t n,
   - *name* is a string that is neither a UUID or a URL. Ex: "aa6060"
 
   A version 4 UUID is used for the random UUID and a version 5 UUID
-  (with the DNS namespace) is used fhr the hash.
+  (with the DNS namespace) is used fhr the hash.  Hashed UUIDs are
+  memoised in a bounded cache.
 
   Returns the DLite ID type or a negative error code on error.
  */
@@ -148,6 +149,14 @@ DLiteIdType dlite_get_uuidn(char *buff, const char *id, size_t len);
 DLiteIdType _dlite_get_uuidn(char *buff, const char *id, size_t len,
                              int namespacedID);
 
+/**
+  Clears the cache of UUIDs derived from ids by dlite_get_uuid().
+  There is normally no need to call this function, since the cache
+  is bounded and entries for names are ignored when the namespacedID
+  behavior changes.
+ */
+void dlite_uuid_cache_clear(void);
+
 /**
   Returns an unique uri for metadata defined by `name`, `version`
   and `namespace` as a newly malloc()'ed string or NULL on error.
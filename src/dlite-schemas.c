@@ -3,8 +3,11 @@
 
 #include "dlite.h"
 #include "dlite-collection.h"
+#include "dlite-macros.h"
 #include "dlite-schemas.h"
 
+#define GLOBALS_ID "dlite-schemas-id"
+
 
 
 /***********************************************************
@@ -140,6 +143,7 @@ static struct _BasicMetadataSchema {
 
   3,                                             /* _npropdims */
   (size_t *)basic_metadata_schema.__propdiminds, /* _propdiminds */
+  NULL,                                          /* _propdimexprs */
 
   offsetof(struct _BasicMetadataSchema, ndimensions),  /* _dimoffset */
   (size_t *)basic_metadata_schema.__propoffsets,       /* _propoffsets */
@@ -298,6 +302,7 @@ static struct _EntitySchema {
 
   0,                                          /* _npropdims */
   NULL,                                       /* _propdiminds */
+  NULL,                                       /* _propdimexprs */
 
   0,                                          /* _dimoffset */
   NULL,                                       /* _propoffsets */
@@ -398,6 +403,7 @@ static struct _CollectionEntity {
 
   0,                                             /* _npropdims */
   NULL,                                          /* _propdiminds */
+  NULL,                                          /* _propdimexprs */
 
   0,                                             /* _dimoffset */
   NULL,                                          /* _propoffsets */
@@ -429,14 +435,35 @@ static struct _CollectionEntity {
  * Exposed pointers to schemas
  **************************************************************/
 
-/* Forward declaration */
+/* Forward declarations */
 int dlite_meta_init(DLiteMeta *meta);
+void dlite_meta_free_propdimexprs(DLiteMeta *meta);
+
+/* Frees memory allocated by dlite_meta_init() for the schemas - called
+   by atexit() */
+static void free_schemas(void *state)
+{
+  UNUSED(state);
+  dlite_meta_free_propdimexprs((DLiteMeta *)&basic_metadata_schema);
+  dlite_meta_free_propdimexprs((DLiteMeta *)&entity_schema);
+  dlite_meta_free_propdimexprs((DLiteMeta *)&collection_entity);
+}
+
+/* Initialises schema `meta`.  The schemas are never freed, so
+   free_schemas() is registered to release what dlite_meta_init()
+   allocates. */
+static void init_schema(DLiteMeta *meta)
+{
+  dlite_meta_init(meta);
+  if (!dlite_globals_get_state(GLOBALS_ID))
+    dlite_globals_add_state(GLOBALS_ID, meta, free_schemas);
+}
 
 const DLiteMeta *dlite_get_basic_metadata_schema()
 {
   dlite_get_uuid(basic_metadata_schema.uuid, DLITE_BASIC_METADATA_SCHEMA);
   if (!basic_metadata_schema._headersize)
-    dlite_meta_init((DLiteMeta *)&basic_metadata_schema);
+    init_schema((DLiteMeta *)&basic_metadata_schema);
   return (DLiteMeta *)&basic_metadata_schema;
 }
 
@@ -444,7 +471,7 @@ const DLiteMeta *dlite_get_entity_schema()
 {
   dlite_get_uuid(entity_schema.uuid, DLITE_ENTITY_SCHEMA);
   if (!entity_schema._headersize)
-    dlite_meta_init((DLiteMeta *)&entity_schema);
+    init_schema((DLiteMeta *)&entity_schema);
   return (DLiteMeta *)&entity_schema;
 }
 
@@ -452,6 +479,6 @@ const DLiteMeta *dlite_get_collection_entity()
 {
   dlite_get_uuid(collection_entity.uuid, DLITE_COLLECTION_ENTITY);
   if (!collection_entity._npropdims)
-    dlite_meta_init((DLiteMeta *)&collection_entity);
+    init_schema((DLiteMeta *)&collection_entity);
   return (DLiteMeta *)&collection_entity;
 }
@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,6 +11,7 @@
 #include "utils/err.h"
 #include "utils/tgen.h"
 #include "utils/plugin.h"
+#include "utils/sync.h"
 
 #include "pathshash.h"
 #include "dlite-misc.h"
@@ -23,6 +25,13 @@
 
 #define GLOBALS_ID "dlite-storage-plugins-id"
 
+/* Lock serialising lookup and loading of storage plugins, which may
+   happen concurrently when storages are opened from several threads.
+   It is only taken by the outermost call in each thread, since
+   loading a plugin may look up other plugins. */
+static Mutex _plugin_get_lock = MUTEX_INITIALIZER;
+static _thread_local int _plugin_get_depth = 0;
+
 
 struct _DLiteStoragePluginIter {
   PluginIter iter;
@@ -39,6 +48,10 @@ typedef struct {
 static void free_globals(void *globals)
 {
   Globals *g = globals;
+
+  /* Close pooled storages while their plugins are still loaded */
+  dlite_storage_pool_clear();
+
   if (g->storage_plugin_info) plugin_info_free(g->storage_plugin_info);
   free(g);
 }
@@ -67,6 +80,8 @@ static PluginInfo *get_storage_plugin_info(void)
 			  "get_dlite_storage_plugin_api",
 			  "DLITE_STORAGE_PLUGIN_DIRS",
                           dlite_globals_get()))) {
+    plugin_info_set_api_version(g->storage_plugin_info,
+                                DLITE_STORAGE_PLUGIN_API_VERSION);
     fu_paths_set_platform(&g->storage_plugin_info->paths, dlite_get_platform());
     if (dlite_use_build_root())
       plugin_path_extend(g->storage_plugin_info, dlite_STORAGE_PLUGINS, NULL);
@@ -82,45 +97,162 @@ static PluginInfo *get_storage_plugin_info(void)
 
 
 /*
-  Returns a storage plugin with the given name, or NULL if it cannot
-  be found.
+  Assigns `keyhash` to the hash identifying the manifest of storage
+  plugins, from the hash `hash` of the storage plugin search path.
+  Both should be `hashsize` bytes long.
 
-  If a plugin with the given name is registered, it is returned.
+  Python storage plugins are all exposed by a single shared library,
+  so when compiled with Python, the hash of the Python storage plugin
+  search path is also included.
 
-  Otherwise the plugin search path is checked for shared libraries
-  matching `name.EXT` where `EXT` is the extension for shared library
-  on the current platform ("dll" on Windows and "so" on Unix/Linux).
-  If a plugin with the provided name is found, it is loaded,
-  registered and returned.
+  Returns non-zero on error.
+ */
+static int manifest_hash(const unsigned char *hash, unsigned char *keyhash,
+                         size_t hashsize)
+{
+#ifdef WITH_PYTHON
+  size_t i;
+  FUPaths *ppaths = dlite_python_storage_paths();
+  if (!ppaths || pathshash(keyhash, hashsize, ppaths, "*.py")) return 1;
+  for (i=0; i < hashsize; i++) keyhash[i] ^= hash[i];
+#else
+  memcpy(keyhash, hash, hashsize);
+#endif
+  return 0;
+}
 
-  Otherwise the plugin search path is checked again, but this time for
-  any shared library.  If a plugin with the provided name is found, it
-  is loaded, registered and returned.
+/*
+  Returns a newly allocated path to the manifest of storage plugins
+  (see plugin_manifest_write()) or NULL if manifests are disabled.
+  `hash` is the hash returned by manifest_hash().  Its hex
+  representation is written to `key`, which must be at least
+  2*hashsize+1 bytes long.
+
+  Manifests are stored in the directory given by the
+  DLITE_PLUGIN_MANIFEST_DIR environment variable.  If it is unset, a
+  `dlite` subdirectory of the user cache directory is used.  Setting
+  it to an empty string disables manifests.
+
+  No directories are created by this function.  See manifest_write().
+ */
+static char *manifest_path(const unsigned char *hash, size_t hashsize,
+                           char *key)
+{
+  char *dir, *path;
+  const char *envdir = getenv("DLITE_PLUGIN_MANIFEST_DIR");
+  size_t i;
+
+  for (i=0; i < hashsize; i++) sprintf(key + 2*i, "%02x", hash[i]);
+
+  if (envdir) {
+    if (!*envdir) return NULL;
+    if (!(dir = strdup(envdir))) return NULL;
+  } else {
+#ifdef _WIN32
+    const char *cachedir = getenv("LOCALAPPDATA");
+    if (!cachedir) return NULL;
+    dir = fu_join(cachedir, "dlite", NULL);
+#else
+    const char *cachedir = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    if (cachedir && *cachedir) {
+      dir = fu_join(cachedir, "dlite", NULL);
+    } else if (home && *home) {
+      dir = fu_join(home, ".cache", "dlite", NULL);
+    } else {
+      return NULL;
+    }
+#endif
+    if (!dir) return NULL;
+  }
+  if ((path = malloc(strlen(dir) + 64)))
+    snprintf(path, strlen(dir) + 64, "%s/storage-plugins-%.16s.manifest",
+             dir, key);
+  free(dir);
+  return path;
+}
 
-  Otherwise NULL is returned.
-*/
-const DLiteStoragePlugin *dlite_storage_plugin_get(const char *name)
+/*
+  Writes the manifest of the storage plugins in `info` to `manifest`.
+
+  The directory of `manifest` is created if needed, but not its
+  parent.  Hence, a missing user cache directory is not created as a
+  side effect of looking up a plugin.  Returns non-zero on error.
+ */
+static int manifest_write(PluginInfo *info, const char *manifest,
+                          const char *key)
 {
-  const DLiteStoragePlugin *api;
+  int stat;
+  char *dir = fu_dirname(manifest);
+  if (!dir) return err(dliteMemoryError, "allocation failure");
+  stat = fu_mkdir(dir);
+  free(dir);
+  if (stat) return err(dliteIOError, "cannot create directory for "
+                       "plugin manifest: %s", manifest);
+  return plugin_manifest_write(info, manifest, key);
+}
+
+
+/* Help function for dlite_storage_plugin_get(). */
+static const DLiteStoragePlugin *_storage_plugin_get(const char *name)
+{
+  const DLiteStoragePlugin *api=NULL;
   PluginInfo *info;
-  unsigned char hash[32];
+  unsigned char hash[32], keyhash[32];
+  char key[2*sizeof(hash)+1], *manifest;
+  int missing=0, hashed=0;
   Globals *g;
 
   if (!(g = get_globals())) return NULL;
   if (!(info = get_storage_plugin_info())) return NULL;
 
+  /* Look up unregistered plugins in the manifest, such that only the
+     shared library providing it needs to be loaded */
+  if (!plugin_has_api(info, name) &&
+      (hashed = !pathshash(hash, sizeof(hash), &info->paths, "*" DSL_EXT)) &&
+      !manifest_hash(hash, keyhash, sizeof(hash)) &&
+      (manifest = manifest_path(keyhash, sizeof(keyhash), key))) {
+    int valid;
+    api = (const DLiteStoragePlugin *)
+      plugin_manifest_get_api(info, manifest, key, name, &valid);
+    if (!api) {
+      /* Missing or outdated manifest, or `name` not listed in it.  The
+         latter may be because the shared library providing `name`
+         failed to load (e.g. due to a missing dependency or a failing
+         Python import) when the manifest was written.  Load all plugins
+         and rewrite the manifest if it has changed. */
+      unsigned long generation = info->generation;
+      plugin_load_all(info);
+      memcpy(g->storage_plugin_path_hash, hash, sizeof(hash));
+      if (!valid || info->generation != generation) {
+       ErrTry:  // a manifest that cannot be written is not an error
+        manifest_write(info, manifest, key);
+       ErrOther:
+        break;
+       ErrEnd;
+      }
+      if (plugin_has_api(info, name))
+        api = (const DLiteStoragePlugin *)plugin_get_api(info, name, 0);
+    }
+    free(manifest);
+    if (api) return api;
+    missing = 1;
+  }
+
   /* Return plugin if it is loaded */
- ErrTry:  // silence dliteStorageLoadError
-  api = (const DLiteStoragePlugin *)plugin_get_api(info, name,
-                                                   dliteStorageLoadError);
- ErrCatch(dliteStorageLoadError):
-  break;
- ErrEnd;
+  if (!missing) {
+   ErrTry:  // silence dliteStorageLoadError
+    api = (const DLiteStoragePlugin *)plugin_get_api(info, name,
+                                                     dliteStorageLoadError);
+   ErrCatch(dliteStorageLoadError):
+    break;
+   ErrEnd;
+  }
   if (api) return api;
 
   /* ...otherwise, if any plugin path has changed, reload all plugins
      and try again */
-  if (pathshash(hash, sizeof(hash), &info->paths, DSL_EXT) == 0) {
+  if (!missing && (hashed ||
+                   !pathshash(hash, sizeof(hash), &info->paths, "*" DSL_EXT))) {
 
     if (memcmp(g->storage_plugin_path_hash, hash, sizeof(hash)) != 0) {
       plugin_load_all(info);
@@ -208,6 +340,51 @@ const DLiteStoragePlugin *dlite_storage_plugin_get(const char *name)
   return NULL;
 }
 
+/*
+  Returns a storage plugin with the given name, or NULL if it cannot
+  be found.
+
+  If a plugin with the given name is registered, it is returned.
+
+  Otherwise the plugin search path is checked for shared libraries
+  matching `name.EXT` where `EXT` is the extension for shared library
+  on the current platform ("dll" on Windows and "so" on Unix/Linux).
+  If a plugin with the provided name is found, it is loaded,
+  registered and returned.
+
+  Otherwise the plugin search path is checked again, but this time for
+  any shared library.  If a plugin with the provided name is found, it
+  is loaded, registered and returned.
+
+  Otherwise NULL is returned.
+
+  To avoid opening all shared libraries in the search path, a manifest
+  mapping plugin names to shared libraries is kept on disk.  It is
+  rewritten when the search path or any of the shared libraries
+  change.
+*/
+const DLiteStoragePlugin *dlite_storage_plugin_get(const char *name)
+{
+  const DLiteStoragePlugin *api;
+  if (_plugin_get_depth++ == 0) mutex_lock(&_plugin_get_lock);
+  api = _storage_plugin_get(name);
+  if (--_plugin_get_depth == 0) mutex_unlock(&_plugin_get_lock);
+  return api;
+}
+
+/*
+  Returns the api version implemented by storage plugin `api`.
+
+  The fields following `data` in DLiteStoragePlugin may only be
+  accessed if this is at least 2.
+ */
+int dlite_storage_plugin_api_version(const DLiteStoragePlugin *api)
+{
+  PluginInfo *info;
+  if (!(info = get_storage_plugin_info())) return 0;
+  return plugin_api_version(info, api->name);
+}
+
 /*
   Load all plugins that can be found in the plugin search path.
   Returns non-zero on error.
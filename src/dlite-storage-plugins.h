@@ -73,6 +73,8 @@ typedef enum _DLiteStorageFlags {
   dliteWritable=2,    /*!< Whether storage is writable */
   dliteGeneric=4,     /*!< Whether storage may hold both data and metadata */
   dliteTransaction=8, /*!< Whether storage supports transactions */
+  dliteThreadSafe=16, /*!< Whether loadInstance() and saveInstance() may be
+                           called concurrently for different instances */
 } DLiteStorageFlags;
 
 /** Base definition of a DLite storage, that all plugin storage
@@ -99,10 +101,21 @@ struct _DLiteDataModel {
   The `iter` argument is normally ignored.  It is provided to support
   plugins exposing several APIs.  If the plugin has more APIs to
   expose, it should increase the integer pointed to by `iter` by one.
+
+  Plugins should name this function
+  `get_dlite_storage_plugin_api_v2()`.  Plugins providing the older
+  `get_dlite_storage_plugin_api()` are compiled against a shorter
+  DLiteStoragePlugin struct, without the fields following `data`.
  */
 typedef const DLiteStoragePlugin *(*GetDLiteStorageAPI)(DLiteGlobals *g,
                                                         int *iter);
 
+/**
+  Current version of the storage plugin api.  Plugins implementing it
+  define `get_dlite_storage_plugin_api_v2()`.
+ */
+#define DLITE_STORAGE_PLUGIN_API_VERSION 2
+
 
 /**
   Returns a storage plugin with the given name, or NULL if it cannot
@@ -124,6 +137,14 @@ typedef const DLiteStoragePlugin *(*GetDLiteStorageAPI)(DLiteGlobals *g,
  */
 const DLiteStoragePlugin *dlite_storage_plugin_get(const char *name);
 
+/**
+  Returns the api version implemented by storage plugin `api`.
+
+  The fields following `data` in DLiteStoragePlugin may only be
+  accessed if this is at least 2.
+ */
+int dlite_storage_plugin_api_version(const DLiteStoragePlugin *api);
+
 /**
   Load all plugins that can be found in the plugin search path.
  */
@@ -348,6 +369,48 @@ typedef int (*SaveInstance)(DLiteStorage *s, const DLiteInstance *inst);
  */
 typedef int (*DeleteInstance)(DLiteStorage *s, const char *id);
 
+/**
+  Loads the `n` instances with the given `ids` from storage `s` and
+  stores new references to them in `instances`, which must have space
+  for `n` pointers.
+
+  Optional.  If not implemented, LoadInstance() is called for each id.
+
+  The operation is all-or-nothing.  On error, non-zero is returned and
+  no references are left in `instances`.
+ */
+typedef int (*LoadInstances)(const DLiteStorage *s, const char **ids,
+                             size_t n, DLiteInstance **instances);
+
+/**
+  Stores the `n` instances in `instances` to storage `s`.
+
+  Optional.  If not implemented, SaveInstance() is called for each
+  instance.
+
+  Returns non-zero on error.
+ */
+typedef int (*SaveInstances)(DLiteStorage *s, const DLiteInstance **instances,
+                             size_t n);
+
+/**
+  Reads a hyperslab of array property `name` of instance `id` in
+  storage `s` into the memory pointed to by `ptr`.
+
+  `start` and `count` are arrays with one element per dimension of the
+  property, giving the index of the first element and the number of
+  elements to read along each dimension.  `ptr` must have space for
+  the product of `count` elements, which are written in C order.
+
+  Optional.  Allows to read parts of large array properties without
+  loading the whole instance.
+
+  Returns non-zero on error.
+ */
+typedef int (*LoadSlab)(const DLiteStorage *s, const char *id,
+                        const char *name, const size_t *start,
+                        const size_t *count, void *ptr);
+
 /** @} */
 
 
@@ -587,6 +650,18 @@ struct _DLiteStoragePlugin {
 
   /* Driver data */
   void *             data;             /*!< Internal data used by the driver */
+
+  /* Fields added in version 2 of the api.  Plugins providing the
+     unversioned get_dlite_storage_plugin_api() don't have them, so
+     they are only accessed if dlite_storage_plugin_api_version()
+     returns at least 2. */
+
+  /* Batched instance API (optional) */
+  LoadInstances      loadInstances;    /*!< Load several instances */
+  SaveInstances      saveInstances;    /*!< Save several instances */
+
+  /* Partial read API (optional) */
+  LoadSlab           loadSlab;         /*!< Read part of a property */
 };
 
 
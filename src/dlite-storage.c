@@ -2,10 +2,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#include "config.h"
 
 #include "utils/compat.h"
 #include "utils/err.h"
+#include "utils/fileinfo.h"
 #include "utils/fileutils.h"
+#include "utils/map.h"
+#include "utils/strutils.h"
+#include "utils/sync.h"
 
 #include "config-paths.h"
 
@@ -16,6 +23,7 @@
 
 #define GLOBALS_ID "dlite-storage-id"
 #define HOTLIST_CHUNK_LENGTH 8
+#define POOL_MAX_IDLE 16      /* max number of idle handles in the pool */
 
 
 /* Iterator over dlite storage paths. */
@@ -32,19 +40,92 @@ typedef struct _DLiteStorageHotlist {
 } DLiteStorageHotlist;
 
 
+/* Kind of location in the storage paths lookup cache. */
+typedef enum {
+  locIndexed,     /* storage whose instances are indexed */
+  locUnindexed,   /* storage that cannot be indexed, must be searched */
+  locInvalid,     /* cannot be opened as a storage */
+  locDirectory    /* directory in storage paths, watched for modifications */
+} LookupLocKind;
+
+/* A location in the storage paths lookup cache. */
+typedef struct {
+  char *driver;         /* storage driver */
+  char *location;       /* storage location */
+  char *options;        /* storage options */
+  LookupLocKind kind;   /* kind of location */
+  int stamped;          /* whether `stamp` is valid */
+  FileStamp stamp;      /* modification stamp at the time of scanning */
+} LookupLoc;
+
+/* Lookup cache mapping instance UUIDs to the storages in the storage
+   paths that contain them. */
+typedef struct {
+  char **paths;         /* copy of storage paths at the time of scanning */
+  size_t npaths;        /* number of storage paths */
+  LookupLoc *locs;      /* scanned locations */
+  size_t nlocs;         /* number of scanned locations */
+  size_t size;          /* allocated length of `locs` */
+  map_int_t ids;        /* maps uuid to index of location in `locs` */
+  map_int_t misses;     /* negative cache, uuids not found in any storage */
+  int cachemisses;      /* whether misses can be cached, i.e. all
+                           unindexed locations are stamped */
+} LookupCache;
+
+
+/* A read-only storage handle in the storage pool. */
+typedef struct {
+  DLiteStorage *s;      /* pooled storage */
+  int nusers;           /* number of users currently holding `s` (0 or 1) */
+  time_t last_used;     /* time when `s` was last released */
+  int stamped;          /* whether `stamp` is valid */
+  FileStamp stamp;      /* modification stamp of location when opened */
+} PoolEntry;
+
+/* Maps "driver\nlocation\noptions" to pooled storages. */
+typedef map_t(PoolEntry *) pool_map_t;
+
+
 /* Global variables for dlite-storage */
 typedef struct {
   FUPaths *storage_paths;
   DLiteStorageHotlist hotlist;
+  LookupCache *lookup;
 } Globals;
 
+/* Lock serialising lazy creation of the global state */
+static Mutex globals_lock = MUTEX_INITIALIZER;
+
+/* Lock protecting the lookup cache and its statistics */
+static Mutex lookup_lock = MUTEX_INITIALIZER;
+static DLiteLookupStats lookup_stats;
+
+/* Lock protecting the hotlist, which is modified when storages are
+   opened or closed and iterated over by dlite_instance_get() */
+static Mutex hotlist_lock = MUTEX_INITIALIZER;
+
+/* Pool of open read-only storages and the lock protecting it.  The
+   pool is not a part of the global state, since it may be cleared
+   when the storage plugins are unloaded, which may happen after the
+   global state has been freed. */
+static pool_map_t pool;
+static Mutex pool_lock = MUTEX_INITIALIZER;
+
+/* Seconds idle handles are kept in the storage pool */
+static double pool_timeout = 30.0;
+
+static void _lookup_free(LookupCache *c);
+static void _pool_free(void);
+
 
 /* Frees global state for this module - called by atexit() */
 static void free_globals(void *globals)
 {
   Globals *g = globals;
+  _pool_free();
   dlite_storage_paths_free();
   dlite_storage_hotlist_clear();
+  if (g->lookup) _lookup_free(g->lookup);
   free(g);
 }
 
@@ -53,14 +134,16 @@ static Globals *get_globals(void)
 {
   Globals *g = dlite_globals_get_state(GLOBALS_ID);
   if (!g) {
-    if (!(g = calloc(1, sizeof(Globals))))
-     FAILCODE(dliteMemoryError, "allocation failure");
-    dlite_globals_add_state(GLOBALS_ID, g, free_globals);
+    mutex_lock(&globals_lock);
+    if (!(g = dlite_globals_get_state(GLOBALS_ID))) {
+      if ((g = calloc(1, sizeof(Globals))))
+        dlite_globals_add_state(GLOBALS_ID, g, free_globals);
+      else
+        err(dliteMemoryError, "allocation failure");
+    }
+    mutex_unlock(&globals_lock);
   }
   return g;
- fail:
-  if (g) free(g);
-  return NULL;
 }
 
 
@@ -246,7 +329,11 @@ DLiteInstance *dlite_storage_load(const DLiteStorage *s, const char *id)
   char uuid[DLITE_UUID_LENGTH+1];
   DLiteInstance **ptr, *inst=NULL;
   if (dlite_get_uuid(uuid, id) < 0) return NULL;
-  if ((ptr = map_get(&(((DLiteStorage *)s)->cache), uuid))) return *ptr;
+
+  /* The cache holds weak references.  Ignore instances that have been
+     free'ed since they were loaded. */
+  if ((ptr = map_get(&(((DLiteStorage *)s)->cache), uuid)) &&
+      (!*ptr || dlite_instance_has(uuid, 0) == *ptr)) return *ptr;
 
   if (s->api->loadInstance) {
     /* Add NULL to cache to mark that we are about to load the instance and
@@ -259,6 +346,82 @@ DLiteInstance *dlite_storage_load(const DLiteStorage *s, const char *id)
 }
 
 
+/*
+  Loads the `n` instances with the given `ids` from storage `s` using
+  the loadInstances api and writes new references to them to
+  `instances`.
+
+  Like dlite_storage_load(), the loaded instances are recorded in the
+  storage cache, which also breaks recursive loads.
+
+  Returns non-zero on error or if loadInstances is not supported.
+ */
+int dlite_storage_load_many(const DLiteStorage *s, const char **ids,
+                            size_t n, DLiteInstance **instances)
+{
+  DLiteMapInstance *cache = &(((DLiteStorage *)s)->cache);
+  char (*uuids)[DLITE_UUID_LENGTH+1] = NULL;
+  DLiteInstance **ptr;
+  size_t i, nmarked=0;
+  int retval=1;
+
+  memset(instances, 0, n*sizeof(DLiteInstance *));
+  if (dlite_storage_plugin_api_version(s->api) < 2 ||
+      !s->api->loadInstances)
+    return errx(dliteUnsupportedError,
+                "driver '%s' does not support loadInstances()", s->api->name);
+  if (!n) return 0;
+  if (!(uuids = calloc(n, sizeof(*uuids))))
+    return err(dliteMemoryError, "allocation failure");
+
+  for (i=0; i<n; i++) {
+    if (!ids[i] || !*ids[i]) continue;
+    if (dlite_get_uuid(uuids[i], ids[i]) < 0) goto fail;
+    if ((ptr = map_get(cache, uuids[i])) && !*ptr)
+      FAILCODE1(dliteStorageLoadError,
+                "recursive load of '%s'", ids[i]);
+  }
+
+  /* Add NULL to cache to mark that we are about to load the instances
+     and break recursive calls */
+  for (nmarked=0; nmarked<n; nmarked++)
+    if (*uuids[nmarked]) map_set(cache, uuids[nmarked], NULL);
+
+  if (s->api->loadInstances(s, ids, n, instances)) goto fail;
+  retval = 0;
+ fail:
+  for (i=0; i<nmarked; i++) {
+    if (!*uuids[i]) continue;
+    if (retval)
+      map_remove(cache, uuids[i]);
+    else
+      map_set(cache, uuids[i], instances[i]);
+  }
+  free(uuids);
+  return retval;
+}
+
+
+/*
+  Reads a hyperslab of array property `name` of instance `id` from
+  storage `s` into `ptr` using the loadSlab api.  `start` and `count`
+  have one element per dimension of the property and give the first
+  index and number of elements to read along each dimension.  `ptr`
+  must have space for the product of `count` elements.
+
+  Returns non-zero on error or if loadSlab is not supported.
+ */
+int dlite_storage_load_slab(const DLiteStorage *s, const char *id,
+                            const char *name, const size_t *start,
+                            const size_t *count, void *ptr)
+{
+  if (dlite_storage_plugin_api_version(s->api) < 2 || !s->api->loadSlab)
+    return errx(dliteUnsupportedError,
+                "driver '%s' does not support loadSlab()", s->api->name);
+  return s->api->loadSlab(s, id, name, start, count, ptr);
+}
+
+
 /*
   Delete instance from storage `s` using the deleteInstance api.
   Returns non-zero on error or if deleteInstance is not supported.
@@ -505,8 +668,10 @@ int dlite_storage_hotlist_clear()
   DLiteStorageHotlist *h;
   if (!(g = get_globals())) return -1;
   h = &g->hotlist;
+  mutex_lock(&hotlist_lock);
   if (h->storages) free((void *)h->storages);
   memset(h, 0, sizeof(DLiteStorageHotlist));
+  mutex_unlock(&hotlist_lock);
   return 0;
 }
 
@@ -519,16 +684,21 @@ int dlite_storage_hotlist_add(const DLiteStorage *s)
   assert(s);
   if (!(g = get_globals())) return -1;
   h = &g->hotlist;
+  mutex_lock(&hotlist_lock);
   if (h->length <= h->nmemb) {
     size_t newlength = h->length + HOTLIST_CHUNK_LENGTH;
     const DLiteStorage **storages = realloc((DLiteStorage **)h->storages,
                                             newlength*sizeof(DLiteStorage *));
-    if (!storages) return err(dliteMemoryError, "allocation failure");
+    if (!storages) {
+      mutex_unlock(&hotlist_lock);
+      return err(dliteMemoryError, "allocation failure");
+    }
     h->length = newlength;
     h->storages = storages;
   }
   assert(h->length > h->nmemb);
   h->storages[h->nmemb++] = s;
+  mutex_unlock(&hotlist_lock);
   return 0;
 }
 
@@ -544,6 +714,7 @@ int dlite_storage_hotlist_remove(const DLiteStorage *s)
   assert(s);
   if (!(g = get_globals())) return -1;
   h = &g->hotlist;
+  mutex_lock(&hotlist_lock);
   for (i=0; i < h->nmemb; i++) {
     if (h->storages[i] == s) {
       removed = i;
@@ -559,11 +730,12 @@ int dlite_storage_hotlist_remove(const DLiteStorage *s)
   assert(length > h->nmemb);
   if (h->length > length) {
     const DLiteStorage **storages = realloc((DLiteStorage **)h->storages,
-                                            length);
+                                            length*sizeof(DLiteStorage *));
     assert(storages);  // redusing allocated memory should always be successful
     h->length = length;
     h->storages = storages;
   }
+  mutex_unlock(&hotlist_lock);
   return (removed >= 0) ? 0 : 1;
 }
 
@@ -582,10 +754,13 @@ dlite_storage_hotlist_iter_next(DLiteStorageHotlistIter *iter)
 {
   Globals *g;
   DLiteStorageHotlist *h;
+  const DLiteStorage *s=NULL;
   if (!(g = get_globals())) return NULL;
   h = &g->hotlist;
-  if (*(size_t *)iter >= h->nmemb) return NULL;
-  return h->storages[(*(size_t *)iter)++];
+  mutex_lock(&hotlist_lock);
+  if (*(size_t *)iter < h->nmemb) s = h->storages[(*(size_t *)iter)++];
+  mutex_unlock(&hotlist_lock);
+  return s;
 }
 
 /* Deinitialise hotlist iterator `iter`.
@@ -595,3 +770,743 @@ int dlite_storage_hotlist_iter_deinit(DLiteStorageHotlistIter *iter)
   UNUSED(iter);
   return 0;
 }
+
+
+
+/*******************************************************************
+ *  Pool of open read-only storages
+ *******************************************************************/
+
+/* Returns non-zero if `s` is added to the hotlist when opened. */
+static int _hotlisted(const DLiteStorage *s)
+{
+  return (s->flags & dliteReadable && s->flags & dliteGeneric);
+}
+
+/* Returns non-zero if the location of pooled storage `e` has been
+   modified since it was opened. */
+static int _pool_entry_modified(const PoolEntry *e)
+{
+  FileStamp stamp;
+  if (!e->stamped) return 0;
+  if (fileinfo_stamp(e->s->location, &stamp)) return 1;
+  return !fileinfo_stamp_equal(&stamp, &e->stamp);
+}
+
+/* Returns non-zero if `options` specifies a mode. */
+static int _options_has_mode(const char *options)
+{
+  const char *p = options;
+  while (p && *p) {
+    size_t n = strcspn(p, ";&");
+    if (n >= 5 && strncmp(p, "mode=", 5) == 0) return 1;
+    p += n;
+    if (*p) p++;
+  }
+  return 0;
+}
+
+/* Closes the `n` storages in `closing` and frees `closing`. */
+static void _pool_close(DLiteStorage **closing, size_t n)
+{
+  size_t i;
+  for (i=0; i<n; i++) dlite_storage_close(closing[i]);
+  if (closing) free(closing);
+}
+
+/* Removes the pool entry with the given key and appends its storage
+   to `*closing`.  Returns non-zero on error. */
+static int _pool_remove(pool_map_t *pool, const char *key,
+                        DLiteStorage ***closing, size_t *nclosing)
+{
+  PoolEntry *e = *map_get(pool, key);
+  DLiteStorage **ptr;
+  if (!(ptr = realloc(*closing, (*nclosing + 1)*sizeof(DLiteStorage *))))
+    return err(dliteMemoryError, "allocation failure");
+  *closing = ptr;
+  ptr[(*nclosing)++] = e->s;
+  map_remove(pool, key);
+  free(e);
+  return 0;
+}
+
+/* Removes idle entries that have timed out or whose location has been
+   modified from the pool.  All idle entries are removed if `all` is
+   non-zero.  If more than POOL_MAX_IDLE entries remain idle, the least
+   recently used are removed.
+
+   The storages of removed entries are appended to `*closing`.  They
+   should be closed with _pool_close() after releasing `pool_lock`.
+
+   Must be called with `pool_lock` held. */
+static void _pool_sweep(pool_map_t *pool, int all, DLiteStorage ***closing,
+                        size_t *nclosing)
+{
+  time_t now = time(NULL);
+  const char *key;
+  map_iter_t iter;
+  int removed;
+
+  /* Restart the iteration after each removal, since the map may not be
+     modified while iterating over it */
+  do {
+    const char *oldest=NULL;
+    int nidle = 0;
+    removed = 0;
+    iter = map_iter(pool);
+    while ((key = map_next(pool, &iter))) {
+      PoolEntry *e = *map_get(pool, key);
+      if (e->nusers) continue;
+      if (all || difftime(now, e->last_used) > pool_timeout ||
+          _pool_entry_modified(e)) {
+        if (_pool_remove(pool, key, closing, nclosing)) return;
+        removed = 1;
+        break;
+      }
+      if (!oldest || e->last_used < (*map_get(pool, oldest))->last_used)
+        oldest = key;
+      nidle++;
+    }
+    if (!removed && nidle > POOL_MAX_IDLE) {
+      if (_pool_remove(pool, oldest, closing, nclosing)) return;
+      removed = 1;
+    }
+  } while (removed);
+}
+
+/* Closes all idle storages in the pool.  The pool itself is freed if
+   no storages in it are in use. */
+static void _pool_free(void)
+{
+  dlite_storage_pool_clear();
+  mutex_lock(&pool_lock);
+  if (pool.base.nnodes == 0) {
+    map_deinit(&pool);
+    map_init(&pool);
+  }
+  mutex_unlock(&pool_lock);
+}
+
+/*
+  Returns a storage for loading instances from `location` with `driver`
+  and `options`.  It should be released with dlite_storage_pool_release().
+
+  If the pool has an open handle for the same driver, location and
+  options that is not used by anyone else, it is returned.  Otherwise
+  a new read-only storage is opened and added to the pool, unless the
+  pooled handle is busy.  Pooled handles are never shared between
+  concurrent users, since loading updates the instance cache of the
+  storage.
+
+  Returns NULL on error.
+ */
+DLiteStorage *dlite_storage_pool_open(const char *driver, const char *location,
+                                      const char *options)
+{
+  PoolEntry **v, *e=NULL;
+  DLiteStorage *s=NULL, **closing=NULL;
+  size_t nclosing=0;
+  FileStamp stamp;
+  char *key=NULL, *opts=NULL;
+  int stamped;
+
+  if (pool_timeout <= 0 || !location)
+    return dlite_storage_open(driver, location, options);
+  if (!driver || !*driver) driver = fu_fileext(location);
+  if (!driver || !*driver ||
+      !(key = aprintf("%s\n%s\n%s", driver, location,
+                      (options) ? options : "")))
+    return dlite_storage_open(driver, location, options);
+
+  mutex_lock(&pool_lock);
+  _pool_sweep(&pool, 0, &closing, &nclosing);
+  if ((v = map_get(&pool, key))) {
+    e = *v;
+    if (e->nusers == 0 && !_pool_entry_modified(e)) {
+      e->nusers = 1;
+      if (_hotlisted(e->s)) dlite_storage_hotlist_add(e->s);
+      s = e->s;
+    }
+  }
+  mutex_unlock(&pool_lock);
+  _pool_close(closing, nclosing);
+  if (s) goto done;
+
+  /* Open a new read-only storage.  The location is stamped before
+     opening, such that modifications made meanwhile are detected. */
+  stamped = (fileinfo_stamp(location, &stamp) == 0);
+  if (_options_has_mode(options))
+    opts = (options) ? strdup(options) : NULL;
+  else if (options && *options)
+    opts = aprintf("%s;mode=r", options);
+  else
+    opts = strdup("mode=r");
+  if (!opts) goto done;
+  ErrTry:
+    s = dlite_storage_open(driver, location, opts);
+  ErrOther:  // fall back to opening the storage unpooled
+    break;
+  ErrEnd;
+  if (!s || s->flags & dliteWritable) goto done;
+
+  mutex_lock(&pool_lock);
+  if (!map_get(&pool, key) && (e = calloc(1, sizeof(PoolEntry)))) {
+    e->s = s;
+    e->nusers = 1;
+    e->stamped = stamped;
+    e->stamp = stamp;
+    if (map_set(&pool, key, e)) free(e);
+  }
+  mutex_unlock(&pool_lock);
+
+ done:
+  if (key) free(key);
+  if (opts) free(opts);
+  if (!s) s = dlite_storage_open(driver, location, options);
+  return s;
+}
+
+/*
+  Releases storage `s` returned by dlite_storage_pool_open().  Storages
+  that are not pooled are closed.
+
+  Returns non-zero on error.
+ */
+int dlite_storage_pool_release(DLiteStorage *s)
+{
+  PoolEntry *e=NULL;
+  const char *key;
+  map_iter_t iter;
+
+  mutex_lock(&pool_lock);
+  iter = map_iter(&pool);
+  while ((key = map_next(&pool, &iter)))
+    if ((*map_get(&pool, key))->s == s) {
+      e = *map_get(&pool, key);
+      break;
+    }
+  if (e && --e->nusers == 0) {
+    /* Like a closed storage, an idle storage should neither keep weak
+       references to loaded instances nor be searched by
+       dlite_instance_get() */
+    map_deinit(&s->cache);
+    map_init(&s->cache);
+    if (_hotlisted(s)) dlite_storage_hotlist_remove(s);
+    e->last_used = time(NULL);
+  }
+  mutex_unlock(&pool_lock);
+  return (e) ? 0 : dlite_storage_close(s);
+}
+
+/*
+  Closes all idle handles in the storage pool.
+ */
+void dlite_storage_pool_clear(void)
+{
+  DLiteStorage **closing=NULL;
+  size_t nclosing=0;
+  mutex_lock(&pool_lock);
+  _pool_sweep(&pool, 1, &closing, &nclosing);
+  mutex_unlock(&pool_lock);
+  _pool_close(closing, nclosing);
+}
+
+/*
+  Sets the number of seconds idle handles are kept open in the storage
+  pool.  A non-positive value disables the pool.
+ */
+void dlite_storage_pool_set_timeout(double seconds)
+{
+  pool_timeout = seconds;
+  if (seconds <= 0) dlite_storage_pool_clear();
+}
+
+/*
+  Returns the number of seconds idle handles are kept open in the
+  storage pool.
+ */
+double dlite_storage_pool_get_timeout(void)
+{
+  return pool_timeout;
+}
+
+
+
+/*******************************************************************
+ *  Lookup cache for instances in storage paths
+ *******************************************************************/
+
+/* Status returned by _lookup_query(). */
+enum {
+  lookupStale,   /* the cache must be rebuilt */
+  lookupHit,     /* the uuid is indexed */
+  lookupSearch,  /* the uuid is not indexed */
+  lookupMiss,    /* the uuid is in the negative cache */
+  lookupError    /* error */
+};
+
+/* Returns a newly malloc'ed copy of `s` or NULL if `s` is NULL. */
+static char *_strdup_or_null(const char *s)
+{
+  return (s) ? strdup(s) : NULL;
+}
+
+/* Frees memory held by location `loc`. */
+static void _loc_clean(LookupLoc *loc)
+{
+  if (loc->driver) free(loc->driver);
+  if (loc->location) free(loc->location);
+  if (loc->options) free(loc->options);
+}
+
+/* Frees array of `n` locations. */
+static void _locs_free(LookupLoc *locs, size_t n)
+{
+  size_t i;
+  if (!locs) return;
+  for (i=0; i<n; i++) _loc_clean(locs + i);
+  free(locs);
+}
+
+/* Returns non-zero if location `loc` has been modified since it
+   was scanned. */
+static int _loc_modified(const LookupLoc *loc)
+{
+  FileStamp stamp;
+  if (!loc->stamped) return 0;
+  if (fileinfo_stamp(loc->location, &stamp)) return 1;
+  return !fileinfo_stamp_equal(&stamp, &loc->stamp);
+}
+
+/* Frees lookup cache `c`. */
+static void _lookup_free(LookupCache *c)
+{
+  size_t i;
+  if (c->paths) {
+    for (i=0; i<c->npaths; i++) free(c->paths[i]);
+    free(c->paths);
+  }
+  for (i=0; i<c->nlocs; i++) _loc_clean(c->locs + i);
+  if (c->locs) free(c->locs);
+  map_deinit(&c->ids);
+  map_deinit(&c->misses);
+  free(c);
+}
+
+/* Adds a location of the given kind to `c`.  Storages that cannot be
+   stamped (e.g. not a file) are added as unindexed.
+
+   Returns the index of the new location or -1 on error. */
+static int _lookup_addloc(LookupCache *c, const char *driver,
+                          const char *location, const char *options,
+                          LookupLocKind kind)
+{
+  LookupLoc *loc;
+  if (c->nlocs >= c->size) {
+    size_t size = (c->size) ? 2*c->size : 16;
+    void *ptr = realloc(c->locs, size*sizeof(LookupLoc));
+    if (!ptr) return err(dliteMemoryError, "allocation failure");
+    c->locs = ptr;
+    c->size = size;
+  }
+  loc = c->locs + c->nlocs;
+  memset(loc, 0, sizeof(LookupLoc));
+  loc->driver = _strdup_or_null(driver);
+  loc->location = _strdup_or_null(location);
+  loc->options = _strdup_or_null(options);
+  loc->stamped = (location && fileinfo_stamp(location, &loc->stamp) == 0);
+  loc->kind = (kind == locIndexed && !loc->stamped) ? locUnindexed : kind;
+  return c->nlocs++;
+}
+
+/* Adds opened storage `s` to `c` and indexes the UUIDs of all its
+   instances.  Returns non-zero on error. */
+static int _lookup_addstorage(LookupCache *c, const DLiteStorage *s,
+                              const char *driver, const char *location,
+                              const char *options)
+{
+  char **uuids=NULL, **u;
+  int n, indexable=1;
+  ErrTry:
+    uuids = dlite_storage_uuids(s, NULL);
+  ErrOther:  // driver does not support listing of its instances
+    indexable = 0;
+    break;
+  ErrEnd;
+  if ((n = _lookup_addloc(c, driver, location, options,
+                          (indexable) ? locIndexed : locUnindexed)) < 0)
+    return -1;
+  if (c->locs[n].kind == locIndexed && uuids)
+    for (u=uuids; *u; u++)
+      if (!map_get_(&c->ids.base, *u)) map_set(&c->ids, *u, n);
+  dlite_storage_uuids_free(uuids);
+  return 0;
+}
+
+/* Splits `url` returned by the storage path iterator into `driver`,
+   `location` and `options`.  The driver is inferred from the file
+   extension if not given and options default to read-only mode.
+
+   Returns a malloc'ed buffer that `driver`, `location` and `options`
+   points into or NULL on error. */
+static char *_paths_split(const char *url, char **driver, char **location,
+                          char **options)
+{
+  char *copy;
+  if (!(copy = strdup(url)))
+    return err(dliteMemoryError, "allocation failure"), NULL;
+#ifdef _WIN32
+  /* Hack: on Window, don't interpreat the "C" in urls starting with
+     "C:\" or "C:/" as a driver, but rather as a part of the location...
+
+     The concequence of this is that we cannot have a driver named
+     "C" on Windows.
+  */
+  dlite_split_url_winpath(copy, driver, location, options, NULL, 1);
+#else
+  dlite_split_url(copy, driver, location, options, NULL);
+#endif
+
+  /* If driver is not given, infer it from file extension */
+  if (!*driver || !**driver) *driver = (char *)fu_fileext(*location);
+
+  /* Set read-only as default mode (all drivers should support this) */
+  if (!*options) *options = "mode=r";
+  return copy;
+}
+
+/* Opens storage, suppressing errors for storages that cannot be opened.
+   Returns NULL on error. */
+static DLiteStorage *_paths_open(const char *driver, const char *location,
+                                 const char *options)
+{
+  DLiteStorage *s=NULL;
+  ErrTry:
+    s = dlite_storage_open(driver, location, options);
+  ErrCatch(dliteStorageOpenError):  // suppressed error
+  ErrCatch(dliteStorageLoadError):  // suppressed error
+    break;
+  ErrEnd;
+  return s;
+}
+
+/* Opens storage and loads instance `id` from it using `loader`.
+   Returns a new reference to the instance or NULL on error. */
+static DLiteInstance *_paths_try(const char *driver, const char *location,
+                                 const char *options, const char *id,
+                                 DLiteStorageLoader loader)
+{
+  DLiteInstance *inst=NULL;
+  DLiteStorage *s=NULL;
+  ErrTry:
+    s = dlite_storage_pool_open(driver, location, options);
+  ErrCatch(dliteStorageOpenError):  // suppressed error
+  ErrCatch(dliteStorageLoadError):  // suppressed error
+    break;
+  ErrEnd;
+  if (!s) return NULL;
+  ErrTry:
+    inst = loader(s, id);
+  ErrCatch(dliteStorageLoadError):  // suppressed error
+    break;
+  ErrEnd;
+  dlite_storage_pool_release(s);
+  return inst;
+}
+
+/* Searches all storages in the storage paths for instance `id`,
+   without using the lookup cache.  Returns a new reference to the
+   instance or NULL if it cannot be found. */
+static DLiteInstance *_paths_search(const char *id, DLiteStorageLoader loader)
+{
+  DLiteInstance *inst=NULL;
+  DLiteStoragePathIter *iter;
+  const char *url;
+
+  if (!(iter = dlite_storage_paths_iter_start())) return NULL;
+  while (!inst && (url = dlite_storage_paths_iter_next(iter))) {
+    DLiteStorage *s;
+    char *copy, *driver=NULL, *location=NULL, *options=NULL;
+    if (!(copy = _paths_split(url, &driver, &location, &options))) break;
+
+    if ((s = _paths_open(driver, location, options))) {
+      /* url is a storage we can open... */
+      ErrTry:
+        inst = loader(s, id);
+      ErrCatch(dliteStorageLoadError):  // suppressed error
+        break;
+      ErrEnd;
+      dlite_storage_close(s);
+    } else {
+      /* ...otherwise it may be a glob pattern */
+      FUIter *fiter;
+      if ((fiter = fu_glob(location, "|"))) {
+        const char *path;
+        while (!inst && (path = fu_globnext(fiter)))
+          inst = _paths_try(fu_fileext(path), path, options, id, loader);
+        fu_globend(fiter);
+      }
+    }
+    free(copy);
+  }
+  dlite_storage_paths_iter_stop(iter);
+  return inst;
+}
+
+/* Returns non-zero if the storage paths or the locations in `c` have
+   been modified since `c` was built.  Only directories are checked
+   unless `all` is non-zero. */
+static int _lookup_modified(const LookupCache *c, int all)
+{
+  const char **paths = dlite_storage_paths_get();
+  size_t i, n=0;
+  if (paths)
+    for (; paths[n]; n++)
+      if (n >= c->npaths || strcmp(paths[n], c->paths[n])) return 1;
+  if (n != c->npaths) return 1;
+  for (i=0; i<c->nlocs; i++) {
+    const LookupLoc *loc = c->locs + i;
+    if ((all || loc->kind == locDirectory) && _loc_modified(loc)) return 1;
+  }
+  return 0;
+}
+
+/* Appends a copy of `loc` to `*locs`.  Returns non-zero on error. */
+static int _locs_append(LookupLoc **locs, size_t *n, const LookupLoc *loc)
+{
+  LookupLoc *ptr, *p;
+  if (!(ptr = realloc(*locs, (*n + 1)*sizeof(LookupLoc))))
+    return err(dliteMemoryError, "allocation failure");
+  *locs = ptr;
+  p = ptr + (*n)++;
+  memcpy(p, loc, sizeof(LookupLoc));
+  p->driver = _strdup_or_null(loc->driver);
+  p->location = _strdup_or_null(loc->location);
+  p->options = _strdup_or_null(loc->options);
+  return 0;
+}
+
+/* Queries lookup cache `c` for `uuid`.  For lookupHit and lookupSearch,
+   `*locs` is assigned to a newly malloc'ed array of copies of the
+   `*nlocs` locations to search.
+
+   Must be called with `lookup_lock` held. */
+static int _lookup_query(const LookupCache *c, const char *uuid,
+                         LookupLoc **locs, size_t *nlocs)
+{
+  const int *n;
+  size_t i;
+  *locs = NULL;
+  *nlocs = 0;
+  if (!c || _lookup_modified(c, 0)) return lookupStale;
+  if ((n = map_get_(&c->ids.base, uuid))) {
+    if (_loc_modified(c->locs + *n)) return lookupStale;
+    if (_locs_append(locs, nlocs, c->locs + *n)) return lookupError;
+    return lookupHit;
+  }
+  if (_lookup_modified(c, 1)) return lookupStale;
+  if (map_get_(&c->misses.base, uuid)) return lookupMiss;
+  for (i=0; i<c->nlocs; i++) {
+    if (c->locs[i].kind != locUnindexed) continue;
+    if (_locs_append(locs, nlocs, c->locs + i)) {
+      _locs_free(*locs, *nlocs);
+      return lookupError;
+    }
+  }
+  return lookupSearch;
+}
+
+/* Scans the storage paths and returns a new lookup cache or NULL on
+   error. */
+static LookupCache *_lookup_scan(void)
+{
+  LookupCache *c;
+  DLiteStoragePathIter *iter=NULL;
+  const char **paths, *url;
+  size_t i;
+
+  if (!(c = calloc(1, sizeof(LookupCache))))
+    return err(dliteMemoryError, "allocation failure"), NULL;
+  map_init(&c->ids);
+  map_init(&c->misses);
+
+  /* Remember storage paths and watch their directories for new files */
+  if ((paths = dlite_storage_paths_get())) {
+    while (paths[c->npaths]) c->npaths++;
+    if (!(c->paths = calloc(c->npaths, sizeof(char *))))
+      FAILCODE(dliteMemoryError, "allocation failure");
+    for (i=0; i<c->npaths; i++) {
+      char *dir;
+      if (!(c->paths[i] = strdup(paths[i])))
+        FAILCODE(dliteMemoryError, "allocation failure");
+      dir = (fileinfo_isdir(paths[i])) ?
+        strdup(paths[i]) : fu_dirname(paths[i]);
+      if (dir && !*dir) {
+        free(dir);
+        dir = strdup(".");
+      }
+      if (dir && fileinfo_isdir(dir) &&
+          _lookup_addloc(c, NULL, dir, NULL, locDirectory) < 0) {
+        free(dir);
+        goto fail;
+      }
+      if (dir) free(dir);
+    }
+  }
+
+  /* Index all storages */
+  if (!(iter = dlite_storage_paths_iter_start())) goto fail;
+  while ((url = dlite_storage_paths_iter_next(iter))) {
+    DLiteStorage *s;
+    char *copy, *driver=NULL, *location=NULL, *options=NULL;
+    int stat=0;
+    if (!(copy = _paths_split(url, &driver, &location, &options))) goto fail;
+
+    if ((s = _paths_open(driver, location, options))) {
+      stat = _lookup_addstorage(c, s, driver, location, options);
+      dlite_storage_close(s);
+    } else {
+      /* it may be a glob pattern */
+      FUIter *fiter;
+      int n=0;
+      if ((fiter = fu_glob(location, "|"))) {
+        const char *path;
+        while (!stat && (path = fu_globnext(fiter))) {
+          const char *ext = fu_fileext(path);
+          if (!(s = _paths_open(ext, path, options))) continue;
+          stat = _lookup_addstorage(c, s, ext, path, options);
+          dlite_storage_close(s);
+          n++;
+        }
+        fu_globend(fiter);
+      }
+      if (!stat && !n)
+        stat = (_lookup_addloc(c, driver, location, options, locInvalid) < 0);
+    }
+    free(copy);
+    if (stat) goto fail;
+  }
+  dlite_storage_paths_iter_stop(iter);
+
+  /* A miss stays valid as long as no stamped location is modified.
+     Hence, misses cannot be cached if an unindexed storage (which is
+     searched for every uuid not in the index) cannot be stamped. */
+  c->cachemisses = 1;
+  for (i=0; i<c->nlocs; i++)
+    if (c->locs[i].kind == locUnindexed && !c->locs[i].stamped)
+      c->cachemisses = 0;
+  return c;
+ fail:
+  if (iter) dlite_storage_paths_iter_stop(iter);
+  _lookup_free(c);
+  return NULL;
+}
+
+
+/*
+  Searches the storage paths for the instance with given `id` and
+  loads it with `loader`.
+
+  The first call opens all storages in the storage paths and indexes
+  the UUIDs of the instances they contain.  Later calls only open the
+  storage that the index says contains `id`.  Storages whose driver
+  cannot list their instances are searched when `id` is not in the
+  index.  Ids that are not found in any storage are kept in a negative
+  cache, unless some of these storages are not files.
+
+  The index and the negative cache are rebuilt if the storage paths
+  change, or if a directory in the storage paths or a file in the
+  cache is modified.
+
+  Returns a new reference to the instance or NULL if it cannot be found.
+ */
+DLiteInstance *dlite_storage_paths_load(const char *id,
+                                        DLiteStorageLoader loader)
+{
+  /* Set while scanning, to avoid rebuilding the cache recursively if a
+     storage needs to look up other instances when it is opened. */
+  static _thread_local int scanning = 0;
+  Globals *g;
+  LookupCache *c, *cache;
+  LookupLoc *locs=NULL;
+  DLiteInstance *inst=NULL;
+  char uuid[DLITE_UUID_LENGTH+1];
+  size_t i, nlocs=0;
+  int status;
+
+  if (!(g = get_globals())) return NULL;
+  if (scanning) return _paths_search(id, loader);
+  if (dlite_get_uuid(uuid, id) < 0) return NULL;
+
+  mutex_lock(&lookup_lock);
+  cache = g->lookup;
+  status = _lookup_query(cache, uuid, &locs, &nlocs);
+  mutex_unlock(&lookup_lock);
+
+  if (status == lookupStale) {
+    scanning = 1;
+    c = _lookup_scan();
+    scanning = 0;
+    if (!c) return _paths_search(id, loader);
+    mutex_lock(&lookup_lock);
+    if (g->lookup) _lookup_free(g->lookup);
+    cache = g->lookup = c;
+    lookup_stats.scans++;
+    status = _lookup_query(cache, uuid, &locs, &nlocs);
+    mutex_unlock(&lookup_lock);
+
+    /* Storage paths modified while scanning */
+    if (status == lookupStale) return _paths_search(id, loader);
+  }
+  if (status == lookupError) return NULL;
+
+  mutex_lock(&lookup_lock);
+  switch (status) {
+  case lookupHit:    lookup_stats.hits++;     break;
+  case lookupMiss:   lookup_stats.misses++;   break;
+  case lookupSearch: lookup_stats.searches++; break;
+  }
+  mutex_unlock(&lookup_lock);
+  if (status == lookupMiss) return NULL;
+
+  for (i=0; i<nlocs && !inst; i++)
+    inst = _paths_try(locs[i].driver, locs[i].location, locs[i].options,
+                      id, loader);
+  _locs_free(locs, nlocs);
+  if (inst) return inst;
+
+  /* If the instance cannot be loaded from the indexed storage, fall
+     back to search all storages like if there were no index */
+  if (status == lookupHit) return _paths_search(id, loader);
+
+  /* Remember the miss, unless the cache has been replaced meanwhile */
+  mutex_lock(&lookup_lock);
+  if (g->lookup == cache && cache->cachemisses)
+    map_set(&cache->misses, uuid, 1);
+  mutex_unlock(&lookup_lock);
+  return NULL;
+}
+
+/*
+  Clears the storage paths lookup cache.  It will be rebuilt on the
+  next call to dlite_storage_paths_load().
+ */
+void dlite_storage_paths_lookup_clear(void)
+{
+  Globals *g;
+  if (!(g = get_globals())) return;
+  mutex_lock(&lookup_lock);
+  if (g->lookup) _lookup_free(g->lookup);
+  g->lookup = NULL;
+  mutex_unlock(&lookup_lock);
+}
+
+/*
+  Writes statistics of the storage paths lookup cache to `stats`.
+ */
+void dlite_storage_paths_lookup_stats(DLiteLookupStats *stats)
+{
+  mutex_lock(&lookup_lock);
+  memcpy(stats, &lookup_stats, sizeof(DLiteLookupStats));
+  mutex_unlock(&lookup_lock);
+}
@@ -90,6 +90,32 @@ void dlite_storage_set_idflag(DLiteStorage *s, DLiteIDFlag idflag);
  */
 DLiteInstance *dlite_storage_load(const DLiteStorage *s, const char *id);
 
+/**
+  Loads the `n` instances with the given `ids` from storage `s` using
+  the loadInstances api and writes new references to them to
+  `instances`.
+
+  Like dlite_storage_load(), the loaded instances are recorded in the
+  storage cache, which also breaks recursive loads.
+
+  Returns non-zero on error or if loadInstances is not supported.
+ */
+int dlite_storage_load_many(const DLiteStorage *s, const char **ids,
+                            size_t n, DLiteInstance **instances);
+
+/**
+  Reads a hyperslab of array property `name` of instance `id` from
+  storage `s` into `ptr` using the loadSlab api.  `start` and `count`
+  have one element per dimension of the property and give the first
+  index and number of elements to read along each dimension.  `ptr`
+  must have space for the product of `count` elements.
+
+  Returns non-zero on error or if loadSlab is not supported.
+ */
+int dlite_storage_load_slab(const DLiteStorage *s, const char *id,
+                            const char *name, const size_t *start,
+                            const size_t *count, void *ptr);
+
 /**
   Returns non-zero if storage `s` is writable.
  */
@@ -295,5 +321,127 @@ dlite_storage_hotlist_iter_next(DLiteStorageHotlistIter *iter);
 */
 int dlite_storage_hotlist_iter_deinit(DLiteStorageHotlistIter *iter);
 
+/** @} */
+
+
+
+/**
+ * @name Pool of open read-only storages, used by the dlite_instance_load_loc()
+ * family of functions and dlite_instance_get() to avoid reopening the
+ * same storage for each instance.  Mostly intended for internal use.
+ * @{
+ */
+
+/**
+  Returns a storage for loading instances from `location` with `driver`
+  and `options`.  It should be released with dlite_storage_pool_release().
+
+  If the pool has an open handle for the same driver, location and
+  options that is not used by anyone else, it is returned.  Otherwise
+  a new read-only storage is opened and added to the pool, unless the
+  pooled handle is busy.  Pooled handles are never shared between
+  concurrent users, since loading updates the instance cache of the
+  storage.  If `options` does not specify a mode, the storage is
+  opened with "mode=r".  If that fails, or the driver opens the
+  storage writable anyway, the storage is opened with
+  dlite_storage_open() and not pooled.
+
+  Released handles are closed after they have been idle for the time
+  given by dlite_storage_pool_set_timeout() or when the file at
+  `location` has been modified.
+
+  Returns NULL on error.
+ */
+DLiteStorage *dlite_storage_pool_open(const char *driver, const char *location,
+                                      const char *options);
+
+/**
+  Releases storage `s` returned by dlite_storage_pool_open().  Storages
+  that are not pooled are closed.
+
+  Returns non-zero on error.
+ */
+int dlite_storage_pool_release(DLiteStorage *s);
+
+/**
+  Closes all idle handles in the storage pool.
+ */
+void dlite_storage_pool_clear(void);
+
+/**
+  Sets the number of seconds idle handles are kept open in the storage
+  pool.  A non-positive value disables the pool.  Default is 30 seconds.
+ */
+void dlite_storage_pool_set_timeout(double seconds);
+
+/**
+  Returns the number of seconds idle handles are kept open in the
+  storage pool.
+ */
+double dlite_storage_pool_get_timeout(void);
+
+/** @} */
+
+
+
+/**
+ * @name Lookup cache for instances in the storage paths, used by
+ * dlite_instance_get().  Mostly intended for internal use.
+ * @{
+ */
+
+/**
+  Prototype for a function that loads instance `id` from storage `s`.
+  It should return a new reference to the instance or NULL if it
+  cannot be loaded.
+ */
+typedef DLiteInstance *(*DLiteStorageLoader)(const DLiteStorage *s,
+                                             const char *id);
+
+/**
+  Statistics of the storage paths lookup cache.  All counters are
+  cumulative since the start of the process.
+ */
+typedef struct {
+  size_t scans;     /*!< Number of times the cache has been (re)built */
+  size_t hits;      /*!< Lookups of ids found in the index */
+  size_t misses;    /*!< Lookups served by the negative cache */
+  size_t searches;  /*!< Lookups of ids not in the index or the negative
+                         cache, that searched the unindexed storages */
+} DLiteLookupStats;
+
+/**
+  Searches the storage paths for the instance with given `id` and
+  loads it with `loader`.
+
+  The first call opens all storages in the storage paths and indexes
+  the UUIDs of the instances they contain.  Later calls only open the
+  storage that the index says contains `id`.  Storages whose driver
+  cannot list their instances are searched when `id` is not in the
+  index.  Ids that are not found in any storage are kept in a negative
+  cache, unless some of these storages are not files.
+
+  The index and the negative cache are rebuilt if the storage paths
+  change, or if a directory in the storage paths or a file in the
+  cache is modified.  Only the directories and the matching file are
+  checked for a hit.  All files are checked when `id` is not in the
+  index.
+
+  Returns a new reference to the instance or NULL if it cannot be found.
+ */
+DLiteInstance *dlite_storage_paths_load(const char *id,
+                                        DLiteStorageLoader loader);
+
+/**
+  Clears the storage paths lookup cache.  It will be rebuilt on the
+  next call to dlite_storage_paths_load().
+ */
+void dlite_storage_paths_lookup_clear(void);
+
+/**
+  Writes statistics of the storage paths lookup cache to `stats`.
+ */
+void dlite_storage_paths_lookup_stats(DLiteLookupStats *stats);
+
 
 #endif /* _DLITE_STORAGE_H */
@@ -63,34 +63,61 @@ void dlite_store_free(DLiteStore *store)
 DLiteStore *dlite_store_load(DLiteStorage *s)
 {
   char **p, **uuids=NULL;
+  size_t i, n=0;
   DLiteStore *store=NULL, *retval=NULL;
-  DLiteInstance *inst;
+  DLiteInstance **instances=NULL;
   if (!(uuids = dlite_storage_uuids(s, NULL))) goto fail;
   if (!(store = dlite_store_create())) goto fail;
-  for (p=uuids; *p; p++) {
-    if (!(inst = dlite_instance_load(s, *p))) goto fail;
-    if (!dlite_store_add_new(store, inst)) goto fail;
+  for (p=uuids; *p; p++) n++;
+  if (!(instances = calloc(n+1, sizeof(DLiteInstance *))))
+    FAIL("allocation failure");
+  if (dlite_instance_load_many(s, (const char **)uuids, n, instances))
+    goto fail;
+  for (i=0; i<n; i++) {
+    if (dlite_store_add_new(store, instances[i])) {
+      for (; i<n; i++) dlite_instance_decref(instances[i]);
+      goto fail;
+    }
   }
   retval = store;
  fail:
+  if (instances) free(instances);
   if (uuids) dlite_storage_uuids_free(uuids);
   if (!retval && store) dlite_store_free(store);
   return retval;
 }
 
 /*
-  Saves store to storage.  Returns non-zero on error.
+  Saves store to storage.
+
+  The instances are first saved in one batch with
+  dlite_instance_save_many().  If that fails, they are saved one by
+  one, such that as many instances as possible are saved.
+
+  Returns the number of instances that failed to be saved, or a
+  negative error code on allocation failure.
 */
 int dlite_store_save(DLiteStorage *s, DLiteStore *store)
 {
   int retval=0;
+  size_t i, n=0;
   const char *uuid;
+  const DLiteInstance **instances;
   map_iter_t iter = map_iter(&store->map);
+  while (map_next(&store->map, &iter)) n++;
+  if (!(instances = calloc(n+1, sizeof(DLiteInstance *))))
+    return err(dliteMemoryError, "allocation failure");
+  n = 0;
+  iter = map_iter(&store->map);
   while ((uuid = map_next(&store->map, &iter))) {
     item_t *item = (item_t *)map_get(&store->map, uuid);
     assert(item);
-    retval += (dlite_instance_save(s, item->inst)) ? 1 : 0;
+    instances[n++] = item->inst;
   }
+  if (dlite_instance_save_many(s, instances, n))
+    for (i=0; i<n; i++)
+      retval += (dlite_instance_save(s, instances[i])) ? 1 : 0;
+  free(instances);
   return retval;
 }
 
@@ -37,7 +37,10 @@ void dlite_store_free(DLiteStore *store);
 DLiteStore *dlite_store_load(DLiteStorage *s);
 
 /**
-  Saves store to storage.  Returns non-zero on error.
+  Saves store to storage.
+
+  Returns the number of instances that failed to be saved, or a
+  negative error code on allocation failure.
 */
 int dlite_store_save(DLiteStorage *s, DLiteStore *store);
 
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stddef.h>
 #include <ctype.h>
+#include <math.h>
 #ifdef HAVE_INTTYPES_H
 #include <inttypes.h>
 #endif
@@ -697,6 +698,224 @@ static StrquoteFlags as_qflags(DLiteType dtype, DLiteTypeFlag flags)
 /* Expands to `a - b` if `a > b` else to `0`. */
 #define PDIFF(a, b) (((size_t)(a) > (size_t)(b)) ? (a) - (b) : 0)
 
+/*
+  Writes `len` bytes from `s` to `dest` with the same truncation
+  semantics as snprintf().  Returns `len`.
+ */
+static int print_bytes(char *dest, size_t n, const char *s, size_t len)
+{
+  if (n) {
+    size_t k = (len < n) ? len : n - 1;
+    memcpy(dest, s, k);
+    dest[k] = '\0';
+  }
+  return (int)len;
+}
+
+/*
+  Writes the decimal representation of `v` to `dest`, prefixed with a
+  minus sign if `neg` is non-zero.  Equivalent to snprintf() with "%d",
+  but without the overhead of parsing a format string.
+ */
+static int print_integer(char *dest, size_t n, uint64_t v, int neg)
+{
+  char buf[24], *q = buf + sizeof(buf);
+  do {
+    *--q = '0' + (char)(v % 10);
+    v /= 10;
+  } while (v);
+  if (neg) *--q = '-';
+  return print_bytes(dest, n, q, buf + sizeof(buf) - q);
+}
+
+/* Unsigned big integer used by print_double().  The capacity is enough
+   for the scaled numerators and denominators of all finite doubles
+   (at most about 1080 bits). */
+#define PRINT_BIG_LIMBS 40
+typedef struct {
+  int n;                         /* number of used limbs */
+  uint32_t d[PRINT_BIG_LIMBS];   /* limbs, least significant first */
+} PrintBig;
+
+/* Sets `b` to `v`. */
+static void big_set(PrintBig *b, uint64_t v)
+{
+  b->n = 0;
+  while (v) {
+    b->d[b->n++] = (uint32_t)v;
+    v >>= 32;
+  }
+}
+
+/* Multiplies `b` by `f`. */
+static void big_mul(PrintBig *b, uint32_t f)
+{
+  uint64_t carry=0;
+  int i;
+  for (i=0; i<b->n; i++) {
+    carry += (uint64_t)b->d[i] * f;
+    b->d[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  if (carry) b->d[b->n++] = (uint32_t)carry;
+  assert(b->n <= PRINT_BIG_LIMBS);
+}
+
+/* Multiplies `b` by 2^`s`. */
+static void big_shl(PrintBig *b, int s)
+{
+  int i, w=s/32, r=s%32;
+  if (!b->n) return;
+  assert(b->n + w + 1 <= PRINT_BIG_LIMBS);
+  b->d[b->n + w] = 0;
+  for (i=b->n-1; i>=0; i--) {
+    b->d[i + w + 1] |= (r) ? b->d[i] >> (32 - r) : 0;
+    b->d[i + w] = b->d[i] << r;
+  }
+  for (i=0; i<w; i++) b->d[i] = 0;
+  b->n += w + 1;
+  while (b->n && !b->d[b->n-1]) b->n--;
+}
+
+/* Multiplies `b` by 10^`k`. */
+static void big_mul_pow10(PrintBig *b, int k)
+{
+  static const uint32_t pow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000
+  };
+  for (; k >= 9; k -= 9) big_mul(b, pow10[9]);
+  if (k) big_mul(b, pow10[k]);
+}
+
+/* Returns negative, zero or positive if `a` is less, equal to or
+   larger than `b`. */
+static int big_cmp(const PrintBig *a, const PrintBig *b)
+{
+  int i;
+  if (a->n != b->n) return a->n - b->n;
+  for (i=a->n-1; i>=0; i--)
+    if (a->d[i] != b->d[i]) return (a->d[i] < b->d[i]) ? -1 : 1;
+  return 0;
+}
+
+/* Subtracts `b` from `a`.  Requires that `a` >= `b`. */
+static void big_sub(PrintBig *a, const PrintBig *b)
+{
+  int64_t borrow=0;
+  int i;
+  for (i=0; i<a->n; i++) {
+    borrow += (int64_t)a->d[i] - ((i < b->n) ? b->d[i] : 0);
+    a->d[i] = (uint32_t)borrow;
+    borrow = (borrow < 0) ? -1 : 0;
+  }
+  while (a->n && !a->d[a->n-1]) a->n--;
+}
+
+/*
+  Writes `v` to `dest` exactly as snprintf() with "%.6g" would do (with
+  round-half-even on the exact binary value, like glibc), but without
+  the overhead of parsing a format string and setting up the locale.
+
+  The six significant digits are obtained from the exact fraction
+  num/den = v / 10^E with simple big integer arithmetic.
+ */
+static int print_double(char *dest, size_t n, double v)
+{
+  char buf[32], *q=buf;
+  unsigned char digits[6];
+  uint64_t bits, m;
+  int e, k, i, nd, len;
+  PrintBig num, den, tmp;
+
+  memcpy(&bits, &v, sizeof(bits));
+  if (bits >> 63) *q++ = '-';
+  e = (int)((bits >> 52) & 0x7ff);
+  m = bits & 0xfffffffffffffULL;
+  if (e == 0x7ff) {
+    memcpy(q, (m) ? "nan" : "inf", 3);
+    return print_bytes(dest, n, buf, q + 3 - buf);
+  }
+  if (e == 0 && m == 0) {
+    *q++ = '0';
+    return print_bytes(dest, n, buf, q - buf);
+  }
+  if (e) m |= 1ULL << 52; else e = 1;
+  e -= 1075;  /* v = m * 2^e */
+
+  /* Estimate the decimal exponent from the position of the leading
+     bit, floor(x*log10(2)) ~ (x*78913) >> 18, and correct it below */
+  for (len=52; !(m >> len); len--);
+  k = e + len;
+  k = (k >= 0) ? (k * 78913) >> 18 : -((-k * 78913 + (1 << 18) - 1) >> 18);
+
+  big_set(&num, m);
+  big_set(&den, 1);
+  if (e > 0) big_shl(&num, e); else big_shl(&den, -e);
+  if (k > 0) big_mul_pow10(&den, k); else big_mul_pow10(&num, -k);
+  while (big_cmp(&num, &den) < 0) {
+    big_mul(&num, 10);
+    k--;
+  }
+  tmp = den;
+  big_mul(&tmp, 10);
+  if (big_cmp(&num, &tmp) >= 0) {
+    den = tmp;
+    k++;
+  }
+
+  /* Generate digits, 1 <= num/den < 10 */
+  for (i=0; i<6; i++) {
+    unsigned char d=0;
+    while (big_cmp(&num, &den) >= 0) {
+      big_sub(&num, &den);
+      d++;
+    }
+    digits[i] = d;
+    if (i < 5) big_mul(&num, 10);
+  }
+
+  /* Round half to even on the remainder */
+  big_shl(&num, 1);
+  i = big_cmp(&num, &den);
+  if (i > 0 || (i == 0 && digits[5] % 2)) {
+    for (i=5; i>=0 && digits[i] == 9; i--) digits[i] = 0;
+    if (i >= 0) {
+      digits[i]++;
+    } else {
+      digits[0] = 1;
+      k++;
+    }
+  }
+  for (nd=6; nd > 1 && digits[nd-1] == 0; nd--);
+
+  if (k < -4 || k >= 6) {
+    *q++ = '0' + digits[0];
+    if (nd > 1) {
+      *q++ = '.';
+      for (i=1; i<nd; i++) *q++ = '0' + digits[i];
+    }
+    *q++ = 'e';
+    *q++ = (k < 0) ? '-' : '+';
+    if (k < 0) k = -k;
+    if (k >= 100) *q++ = '0' + k / 100;
+    *q++ = '0' + (k / 10) % 10;
+    *q++ = '0' + k % 10;
+  } else if (k >= 0) {
+    for (i=0; i<=k; i++) *q++ = (i < nd) ? '0' + digits[i] : '0';
+    if (nd > k + 1) {
+      *q++ = '.';
+      for (i=k+1; i<nd; i++) *q++ = '0' + digits[i];
+    }
+  } else {
+    *q++ = '0';
+    *q++ = '.';
+    for (i=-1; i>k; i--) *q++ = '0';
+    for (i=0; i<nd; i++) *q++ = '0' + digits[i];
+  }
+  return print_bytes(dest, n, buf, q - buf);
+}
+
 /*
   Serialises data of type `dtype` and size `size` pointed to by `p`.
   The string representation is written to `dest`.  No more than
@@ -716,37 +935,43 @@ int dlite_type_print(char *dest, size_t n, const void *p, DLiteType dtype,
                      size_t size, int width, int prec,  DLiteTypeFlag flags)
 {
   int m=0, w=width, r=prec;
-  size_t i;
   StrquoteFlags qflags = as_qflags(dtype, flags);
   switch (dtype) {
 
   case dliteBlob:
-    if (!(qflags & strquoteNoQuote)) {
-        int v = snprintf(dest+m, PDIFF(n, m), "\"");
-        if (v < 0) return err(dliteSerialiseError,
-                              "error printing initial quote for blob");
-        m += v;
-      }
-    for (i=0; i<size; i++) {
-      int v = snprintf(dest+m, PDIFF(n, m), "%02x",
-                       *((unsigned char *)p+i));
-      if (v < 0) return err(dliteSerialiseError, "error printing blob");
-      m += v;
-    }
-    if (!(qflags & strquoteNoQuote)) {
-        int v = snprintf(dest+m, PDIFF(n, m), "\"");
-        if (v < 0) return err(dliteSerialiseError,
-                              "error printing final quote for blob");
-        m += v;
-      }
+    if (!(qflags & strquoteNoQuote))
+      m += print_bytes(dest+m, PDIFF(n, m), "\"", 1);
+    m += strhex_encode(dest+m, PDIFF(n, m), p, size);
+    if (!(qflags & strquoteNoQuote))
+      m += print_bytes(dest+m, PDIFF(n, m), "\"", 1);
     break;
 
   case dliteBool:
+    if (w == 0 && r < 0) {
+      if (*((bool *)p))
+        m = print_bytes(dest, n, "true", 4);
+      else
+        m = print_bytes(dest, n, "false", 5);
+      break;
+    }
     m = snprintf(dest, n, "%*.*s", w, r,
                       (*((bool *)p)) ? "true" : "false");
     break;
 
   case dliteInt:
+    if (w == 0 && r < 0) {
+      int64_t v;
+      switch (size) {
+      case 1: v = *((int8_t *)p);  break;
+      case 2: v = *((int16_t *)p); break;
+      case 4: v = *((int32_t *)p); break;
+      case 8: v = *((int64_t *)p); break;
+      default: return err(dliteValueError, "invalid int size: %lu",
+                          (unsigned long)size);
+      }
+      m = print_integer(dest, n, (v < 0) ? -(uint64_t)v : (uint64_t)v, v < 0);
+      break;
+    }
     if (w == -1) w = 8;
     switch (size) {
 #ifdef HAVE_INTTYPES_H
@@ -765,6 +990,19 @@ int dlite_type_print(char *dest, size_t n, const void *p, DLiteType dtype,
     break;
 
   case dliteUInt:
+    if (w == 0 && r < 0) {
+      uint64_t v;
+      switch (size) {
+      case 1: v = *((uint8_t *)p);  break;
+      case 2: v = *((uint16_t *)p); break;
+      case 4: v = *((uint32_t *)p); break;
+      case 8: v = *((uint64_t *)p); break;
+      default: return err(dliteValueError, "invalid int size: %lu",
+                          (unsigned long)size);
+      }
+      m = print_integer(dest, n, v, 0);
+      break;
+    }
     if (w == -1) w = 8;
     switch (size) {
 #ifdef HAVE_INTTYPES_H
@@ -785,6 +1023,18 @@ int dlite_type_print(char *dest, size_t n, const void *p, DLiteType dtype,
   case dliteFloat:
     if (w == -1) w = 12;
     if (r == -1) r = 6;
+    if (w == 0 && (r < 0 || r == 6) && (size == 4 || size == 8)) {
+      /* Integral values with at most 6 digits are printed by "%g" without
+         decimals or exponent, so they can be printed as integers */
+      double v = (size == 4) ? *((float32_t *)p) : *((float64_t *)p);
+      if (v > -1e6 && v < 1e6 && v == (double)(int64_t)v &&
+          !(v == 0.0 && signbit(v)))
+        m = print_integer(dest, n, (v < 0) ? (uint64_t)-v : (uint64_t)v,
+                          v < 0);
+      else
+        m = print_double(dest, n, v);
+      break;
+    }
     switch (size) {
     case 4:  m = snprintf(dest, n, "%*.*g",  w, r, *((float32_t *)p)); break;
     case 8:  m = snprintf(dest, n, "%*.*g",  w, r, *((float64_t *)p)); break;
@@ -954,6 +1204,24 @@ int dlite_type_scan(const char *src, int len, void *p, DLiteType dtype,
   int m=0, v;
   char *endptr;
   StrquoteFlags qflags = as_qflags(dtype, flags);
+
+  /* sscanf() and strtob() read until the terminating NUL.  Scan these
+     types from a NUL-terminated copy when `len` is given, such that
+     they never read past `len` bytes, e.g. at the end of a memory
+     mapped file, and sscanf() doesn't call strlen() on a long document */
+  if (len >= 0 && (dtype == dliteBlob || dtype == dliteBool ||
+                   dtype == dliteInt || dtype == dliteUInt ||
+                   dtype == dliteFloat)) {
+    char buf[64], *copy=buf;
+    if (len >= (int)sizeof(buf) && !(copy = malloc(len + 1)))
+      return err(dliteMemoryError, "allocation failure");
+    memcpy(copy, src, len);
+    copy[len] = '\0';
+    m = dlite_type_scan(copy, -1, p, dtype, size, flags);
+    if (copy != buf) free(copy);
+    return m;
+  }
+
   switch(dtype) {
 
   case dliteBlob:
@@ -1262,36 +1530,37 @@ int dlite_type_scan(const char *src, int len, void *p, DLiteType dtype,
 
 
 /*
-  Update sha3 hash context `c` from data pointed to by `ptr`.
-  The data is described by `dtype` and `size`.
+  Update hash state `state` from data pointed to by `ptr` by calling
+  `update` with the bytes representing the data.  The data is
+  described by `dtype` and `size`.
 
   Returns non-zero on error.
  */
-int dlite_type_update_sha3(sha3_context *c, const void *ptr,
-                           DLiteType dtype, size_t size)
+int dlite_type_update_hash(DLiteHashUpdate update, void *state,
+                           const void *ptr, DLiteType dtype, size_t size)
 {
   switch (dtype) {
 
   case dliteStringPtr:
     {
       char *s = *((char **)ptr);
-      if (s) sha3_Update(c, s, strlen(s));
+      if (s) update(state, s, strlen(s));
     }
     break;
 
   case dliteRef:
     {
       DLiteInstance *inst = *((DLiteInstance **)ptr);
-      if (inst) sha3_Update(c, inst->uuid, DLITE_UUID_LENGTH);
+      if (inst) update(state, inst->uuid, DLITE_UUID_LENGTH);
     }
     break;
 
   case dliteDimension:
     {
       const DLiteDimension *d = ptr;
-      sha3_Update(c, d->name, strlen(d->name));
+      update(state, d->name, strlen(d->name));
       if (d->description)
-        sha3_Update(c, d->description, strlen(d->description));
+        update(state, d->description, strlen(d->description));
     }
     break;
 
@@ -1307,37 +1576,55 @@ int dlite_type_update_sha3(sha3_context *c, const void *ptr,
     {
       int i;
       const DLiteProperty *p = ptr;
-      sha3_Update(c, p->name, strlen(p->name));
-      sha3_Update(c, &p->type, sizeof(DLiteType));
+      update(state, p->name, strlen(p->name));
+      update(state, &p->type, sizeof(DLiteType));
       if (!dlite_type_is_allocated(p->type)) {
         uint64_t size = p->size;  /* For consistency between x86_64 and i686 */
-        sha3_Update(c, &size, sizeof(uint64_t));
+        update(state, &size, sizeof(uint64_t));
       }
-      sha3_Update(c, &p->ndims, sizeof(int));
+      update(state, &p->ndims, sizeof(int));
       for (i=0; i<p->ndims; i++)
-        sha3_Update(c, p->shape[i], strlen(p->shape[i]));
-      if (p->unit) sha3_Update(c, p->unit, strlen(p->unit));
+        update(state, p->shape[i], strlen(p->shape[i]));
+      if (p->unit) update(state, p->unit, strlen(p->unit));
       if (p->description)
-        sha3_Update(c, p->description, strlen(p->description));
+        update(state, p->description, strlen(p->description));
     }
     break;
 
   case dliteRelation:
     {
       const DLiteRelation *rel = ptr;
-      if (rel->s) sha3_Update(c, rel->s, strlen(rel->s));
-      if (rel->p) sha3_Update(c, rel->p, strlen(rel->p));
-      if (rel->o) sha3_Update(c, rel->o, strlen(rel->o));
+      if (rel->s) update(state, rel->s, strlen(rel->s));
+      if (rel->p) update(state, rel->p, strlen(rel->p));
+      if (rel->o) update(state, rel->o, strlen(rel->o));
     }
     break;
 
   default:
-    sha3_Update(c, ptr, size);
+    update(state, ptr, size);
     break;
   }
   return 0;
 }
 
+/* Callback for dlite_type_update_hash() updating a sha3 context. */
+static void _sha3_update(void *state, const void *data, size_t len)
+{
+  sha3_Update(state, data, len);
+}
+
+/*
+  Update sha3 hash context `c` from data pointed to by `ptr`.
+  The data is described by `dtype` and `size`.
+
+  Returns non-zero on error.
+ */
+int dlite_type_update_sha3(sha3_context *c, const void *ptr,
+                           DLiteType dtype, size_t size)
+{
+  return dlite_type_update_hash(_sha3_update, c, ptr, dtype, size);
+}
+
 
 /*
   Returns the struct alignment of the given type or 0 on error.
@@ -1389,6 +1676,224 @@ int dlite_type_get_member_offset(size_t prev_offset, size_t prev_size,
 }
 
 
+/* Cast kernels used by dlite_type_ndcast()
+ * ----------------------------------------
+ * A cast kernel converts `n` numbers from `src` to `dest`, advancing
+ * `sstride` and `dstride` bytes, respectively, between each element.
+ * The contiguous case is written as a plain loop over typed arrays,
+ * such that it can be vectorised by the compiler.
+ *
+ * The kernels are only used for type pairs for which
+ * dlite_type_copy_cast() does a plain C conversion that cannot fail.
+ */
+typedef void (*CastKernel)(void *dest, ptrdiff_t dstride,
+                           const void *src, ptrdiff_t sstride, size_t n);
+
+/* Numeric types with cast kernels, in table order */
+#define KERNEL_TYPES(X, arg)                          \
+  X(int8_t, arg)   X(int16_t, arg)  X(int32_t, arg)   \
+  X(int64_t, arg)  X(uint8_t, arg)  X(uint16_t, arg)  \
+  X(uint32_t, arg) X(uint64_t, arg) X(float32_t, arg) \
+  X(float64_t, arg)
+
+/* Same as KERNEL_TYPES(), for nested expansion */
+#define KERNEL_TYPES2(X, arg)                         \
+  X(int8_t, arg)   X(int16_t, arg)  X(int32_t, arg)   \
+  X(int64_t, arg)  X(uint8_t, arg)  X(uint16_t, arg)  \
+  X(uint32_t, arg) X(uint64_t, arg) X(float32_t, arg) \
+  X(float64_t, arg)
+
+#define KERNEL_NTYPES 10
+
+#define KERNEL_DEF(stype, dtype)                                        \
+  static void cast_##dtype##_##stype(void *dest, ptrdiff_t dstride,     \
+                                     const void *src, ptrdiff_t sstride, \
+                                     size_t n)                          \
+  {                                                                     \
+    size_t i;                                                           \
+    if (dstride == sizeof(dtype) && sstride == sizeof(stype)) {         \
+      dtype *restrict d = dest;                                         \
+      const stype *restrict s = src;                                    \
+      for (i=0; i<n; i++) d[i] = (dtype)s[i];                           \
+    } else {                                                            \
+      char *d = dest;                                                   \
+      const char *s = src;                                              \
+      for (i=0; i<n; i++, d+=dstride, s+=sstride)                       \
+        *((dtype *)d) = (dtype)*((const stype *)s);                     \
+    }                                                                   \
+  }
+#define KERNEL_DEFS(dtype, unused) KERNEL_TYPES2(KERNEL_DEF, dtype)
+
+#define KERNEL_REF(stype, dtype) cast_##dtype##_##stype,
+#define KERNEL_ROW(dtype, unused) {KERNEL_TYPES2(KERNEL_REF, dtype)},
+
+KERNEL_TYPES(KERNEL_DEFS, _)
+
+/* Table of kernels indexed by destination and source type */
+static const CastKernel cast_kernels[KERNEL_NTYPES][KERNEL_NTYPES] = {
+  KERNEL_TYPES(KERNEL_ROW, _)
+};
+
+/* Returns the cast kernel table index of the given type or -1 if
+   there are no cast kernels for it. */
+static int kernel_index(DLiteType type, size_t size)
+{
+  int i;
+  switch (size) {
+  case 1: i = 0; break;
+  case 2: i = 1; break;
+  case 4: i = 2; break;
+  case 8: i = 3; break;
+  default: return -1;
+  }
+  switch (type) {
+  case dliteInt:   return i;
+  case dliteUInt:  return 4 + i;
+  case dliteFloat: return (size == 4) ? 8 : (size == 8) ? 9 : -1;
+  default:         return -1;
+  }
+}
+
+/* Returns a kernel for casting from `src_type` to `dest_type` that gives
+   the same result as dlite_type_copy_cast() or NULL if there is none. */
+static CastKernel get_cast_kernel(DLiteType dest_type, size_t dest_size,
+                                  DLiteType src_type, size_t src_size)
+{
+  int di = kernel_index(dest_type, dest_size);
+  int si = kernel_index(src_type, src_size);
+  if (di < 0 || si < 0) return NULL;
+
+  /* Casts to unsigned integers check for negative values and
+     dlite_type_copy_cast() copies bytes between unsigned integers of
+     different size */
+  if (dest_type == dliteUInt &&
+      (src_type != dliteUInt || src_size != dest_size)) return NULL;
+
+  return cast_kernels[di][si];
+}
+
+
+/* A dimension of an array in a kernel loop */
+typedef struct {
+  size_t n;          /* number of elements */
+  size_t idx;        /* current index */
+  ptrdiff_t dstride; /* destination stride in bytes */
+  ptrdiff_t sstride; /* source stride in bytes */
+} KernelDim;
+
+/* Number of dimensions handled by kernel_ndcast() without allocation */
+#define KERNEL_NSTACK 16
+
+/* Side length of the tiles in blocked transposes */
+#define KERNEL_BLOCK 32
+
+/*
+  Applies `kernel` to a two-dimensional tiling of dimension `a` and `b`.
+  The kernel is called along dimension `a`, which should be the
+  contiguous dimension of the destination.
+*/
+static void kernel_blocked(CastKernel kernel, char *dest, const char *src,
+                           const KernelDim *a, const KernelDim *b)
+{
+  size_t i, j, ni, nj;
+  for (i=0; i < a->n; i+=KERNEL_BLOCK) {
+    ni = (a->n - i < KERNEL_BLOCK) ? a->n - i : KERNEL_BLOCK;
+    for (j=0; j < b->n; j+=KERNEL_BLOCK) {
+      size_t k;
+      nj = (b->n - j < KERNEL_BLOCK) ? b->n - j : KERNEL_BLOCK;
+      for (k=j; k<j+nj; k++)
+        kernel(dest + (ptrdiff_t)i*a->dstride + (ptrdiff_t)k*b->dstride,
+               a->dstride,
+               src + (ptrdiff_t)i*a->sstride + (ptrdiff_t)k*b->sstride,
+               a->sstride, ni);
+    }
+  }
+}
+
+/*
+  Applies `kernel` on all elements of `ndims`-dimensional arrays `src`
+  and `dest` with the same dimensions `dims`, but possibly different
+  strides.
+
+  Dimensions that are contiguous in both source and destination are
+  merged, such that the kernel is called on runs as long as possible.
+  If the destination is not contiguous along the innermost dimension
+  (e.g. when converting from C to Fortran order), the two dimensions
+  with smallest strides are copied in tiles of KERNEL_BLOCK x
+  KERNEL_BLOCK elements to stay within cache.
+
+  Returns non-zero on error.
+*/
+static int kernel_ndcast(CastKernel kernel, int ndims, const size_t *dims,
+                         void *dest, const int *dest_strides, size_t dest_size,
+                         const void *src, const int *src_strides)
+{
+  int i, m=0, M, k=-1;
+  char *dp = dest;
+  const char *sp = src;
+  KernelDim buf[KERNEL_NSTACK], *d=buf;
+
+  for (i=0; i<ndims; i++)
+    if (dims[i] == 0) return 0;
+  if (ndims > KERNEL_NSTACK &&
+      !(d = malloc(ndims * sizeof(KernelDim))))
+    return err(dliteMemoryError, "allocation failure");
+
+  /* Drop dimensions of length one and merge contiguous dimensions */
+  for (i=0; i<ndims; i++) {
+    if (dims[i] == 1) continue;
+    if (m > 0 &&
+        d[m-1].dstride == dest_strides[i] * (ptrdiff_t)dims[i] &&
+        d[m-1].sstride == src_strides[i] * (ptrdiff_t)dims[i]) {
+      d[m-1].n *= dims[i];
+      d[m-1].dstride = dest_strides[i];
+      d[m-1].sstride = src_strides[i];
+    } else {
+      d[m].n = dims[i];
+      d[m].idx = 0;
+      d[m].dstride = dest_strides[i];
+      d[m].sstride = src_strides[i];
+      m++;
+    }
+  }
+  if (m == 0) {
+    kernel(dp, 0, sp, 0, 1);
+    if (d != buf) free(d);
+    return 0;
+  }
+
+  /* Use blocking if the destination is contiguous along another
+     dimension than the innermost */
+  M = m-1;
+  if (d[M].dstride != (ptrdiff_t)dest_size)
+    for (i=0; i<M; i++)
+      if (d[i].dstride == (ptrdiff_t)dest_size) { k = i; break; }
+
+  while (1) {
+    if (k < 0)
+      kernel(dp, d[M].dstride, sp, d[M].sstride, d[M].n);
+    else
+      kernel_blocked(kernel, dp, sp, &d[k], &d[M]);
+
+    /* Advance to next position in the outer dimensions */
+    for (i=M-1; i>=0; i--) {
+      if (i == k) continue;
+      if (++d[i].idx < d[i].n) {
+        dp += d[i].dstride;
+        sp += d[i].sstride;
+        break;
+      }
+      dp -= d[i].dstride * (ptrdiff_t)(d[i].n - 1);
+      sp -= d[i].sstride * (ptrdiff_t)(d[i].n - 1);
+      d[i].idx = 0;
+    }
+    if (i < 0) break;
+  }
+  if (d != buf) free(d);
+  return 0;
+}
+
+
 /*
   Copies n-dimensional array `src` to `dest` by calling `castfun` on
   each element.  `dest` must have sufficient size to hold the result.
@@ -1401,6 +1906,10 @@ int dlite_type_get_member_offset(size_t prev_offset, size_t prev_size,
   the order of `dest_dims` and `dest_strides` you can copy an
   n-dimensional array from C to Fortran order.
 
+  If `castfun` is NULL or dlite_type_copy_cast(), numeric types with
+  the same dimensions in `src` and `dest` are converted with
+  specialised kernels instead of calling `castfun` for each element.
+
   Arguments:
     - ndims: Number of dimensions for both source and destination.
           Zero means scalar.
@@ -1433,6 +1942,7 @@ int dlite_type_ndcast(int ndims,
   int i, retval=1, samelayout=1, *sstrides=NULL, *dstrides=NULL;
   size_t *sidx=NULL, *didx=NULL;
   size_t j, n, N=1;
+  CastKernel kernel=NULL;
 
   assert(src);
   assert(dest);
@@ -1490,18 +2000,30 @@ int dlite_type_ndcast(int ndims,
     int size = src_size;
     for (i=0; i<ndims; i++) {
       int iscont=0;
-      for (j=0; j < src_dims[j]; j++)
+      for (j=0; j < (size_t)ndims; j++)
         if (src_strides[j] == size) { iscont = 1; break; }
       if (!iscont) { samelayout = 0; break; }
       size *= src_dims[i];
     }
   }
 
+  /* -- check if a cast kernel can be used */
+  if (!samelayout && castfun == dlite_type_copy_cast &&
+      (kernel = get_cast_kernel(dest_type, dest_size, src_type, src_size))) {
+    for (i=0; i<ndims; i++)
+      if (dest_dims[i] != src_dims[i]) { kernel = NULL; break; }
+  }
+
   if (samelayout) {
     /* Special case: if source and dest have same layout and are
        contiguous, copy all data in one chunck */
     memcpy(dest, src, N * src_size);
 
+  } else if (kernel) {
+    /* Numeric types with same dimensions: convert with a cast kernel */
+    if (kernel_ndcast(kernel, ndims, src_dims, dest, dest_strides, dest_size,
+                      src, src_strides)) goto fail;
+
   } else {
     /* General case: copy all elements individually using castfun()
 
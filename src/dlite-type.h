@@ -269,6 +269,24 @@ int dlite_type_aprint(char **dest, size_t *n, size_t pos, const void *p,
 int dlite_type_scan(const char *src, int len, void *p, DLiteType dtype,
                     size_t size, DLiteTypeFlag flags);
 
+/**
+  Function updating the hash state `state` with `len` bytes from `data`.
+ */
+typedef void (*DLiteHashUpdate)(void *state, const void *data, size_t len);
+
+/**
+  Update hash state `state` from data pointed to by `ptr` by calling
+  `update` with the bytes representing the data.  The data is
+  described by `dtype` and `size`.
+
+  This makes it possible to hash allocated types with any streaming
+  hash function.
+
+  Returns non-zero on error.
+ */
+int dlite_type_update_hash(DLiteHashUpdate update, void *state,
+                           const void *ptr, DLiteType dtype, size_t size);
+
 /**
   Update sha3 hash context `c` from data pointed to by `ptr`.
   The data is described by `dtype` and `size`.
@@ -314,6 +332,10 @@ int dlite_type_get_member_offset(size_t prev_offset, size_t prev_size,
   the order of `dest_dims` and `dest_strides` you can copy an
   n-dimensional array from C to Fortran order.
 
+  If `castfun` is NULL or dlite_type_copy_cast(), numeric types with
+  the same dimensions in `src` and `dest` are converted with
+  specialised kernels instead of calling `castfun` for each element.
+
   Arguments:
     - ndims: Number of dimensions for both source and destination.
           Zero means scalar.
@@ -267,10 +267,94 @@ static DLiteInstance *mapper(const DLiteMappingPlugin *api,
   Py_XDECREF(outinst);
   Py_XDECREF(insts);
   Py_XDECREF(map);
-  for (i=0; i<n; i++) dlite_instance_decref((DLiteInstance *)instances[i]);
+  return inst;
+}
+
+/* Returns the C instance corresponding to Python instance `pyinst` or
+   NULL on error. */
+static DLiteInstance *get_instance(PyObject *pyinst)
+{
+  PyObject *pyuuid=NULL;
+  const char *uuid;
+  DLiteInstance *inst=NULL;
+  if (!(pyuuid = PyObject_GetAttrString(pyinst, "uuid")))
+    FAIL("output instance has no such attribute: uuid");
+  if (!PyUnicode_Check(pyuuid) || !(uuid = PyUnicode_AsUTF8(pyuuid)))
+    FAIL("cannot convert uuid");
+  if (!(inst = dlite_instance_get(uuid)))
+    FAIL1("no such instance: %s", uuid);
+ fail:
+  Py_XDECREF(pyuuid);
   return inst;
 }
 
+/*
+   Wraps Python method map_many() into a DLite MapperMany.
+
+   The Python method is called with a list of `ntuples` lists of input
+   instances and should return a sequence of `ntuples` output
+   instances.
+ */
+static int map_many(const DLiteMappingPlugin *api,
+                    const DLiteInstance **instances, int ninput,
+                    size_t ntuples, DLiteInstance **outputs)
+{
+  size_t t;
+  int i, retval=1;
+  const char *classname;
+  PyObject *method=NULL, *tuples=NULL, *outinsts=NULL;
+  PyObject *plugin = (PyObject *)api->data;
+  assert(plugin);
+  dlite_errclr();
+
+  /* Creates Python list of lists of input instances */
+  if (!(tuples = PyList_New(ntuples)))
+    FAIL("failed to create list");
+  for (t=0; t<ntuples; t++) {
+    PyObject *insts;
+    if (!(insts = PyList_New(ninput)))
+      FAIL("failed to create list");
+    PyList_SetItem(tuples, t, insts);
+    for (i=0; i<ninput; i++) {
+      PyObject *pyinst;
+      const DLiteInstance *inst = instances[t*ninput + i];
+      if (!(pyinst = dlite_pyembed_from_instance(inst->uuid))) goto fail;
+      PyList_SetItem(insts, i, pyinst);
+    }
+  }
+
+  /* Call Python map_many() method */
+  if (!(classname = dlite_pyembed_classname(plugin)))
+    dlite_warnx("cannot get class name for plugin %p", (void *)plugin);
+  if (!(method = PyObject_GetAttrString(plugin, "map_many")))
+    FAIL1("plugin '%s' has no method: 'map_many'", classname);
+  if (!(outinsts = PyObject_CallFunctionObjArgs(method, plugin, tuples,
+                                                NULL))) {
+    dlite_pyembed_err(1, "error calling %s.map_many()", classname);
+    goto fail;
+  }
+  if (!PySequence_Check(outinsts) ||
+      PySequence_Length(outinsts) != (Py_ssize_t)ntuples)
+    FAIL2("%s.map_many() should return a sequence of %lu instances",
+          classname, (unsigned long)ntuples);
+
+  /* Get corresponding C instances */
+  for (t=0; t<ntuples; t++) {
+    PyObject *outinst = PySequence_GetItem(outinsts, t);
+    if (!outinst) FAIL1("cannot get output %lu", (unsigned long)t);
+    outputs[t] = get_instance(outinst);
+    Py_DECREF(outinst);
+    if (!outputs[t]) goto fail;
+  }
+  retval = 0;
+
+ fail:
+  Py_XDECREF(outinsts);
+  Py_XDECREF(tuples);
+  Py_XDECREF(method);
+  return retval;
+}
+
 /*
   Free's internal resources in `api`.
 */
@@ -412,6 +496,11 @@ const DLiteMappingPlugin *get_dlite_mapping_api(void *state, int *iter)
   api->cost = cost;
   api->data = (void *)cls;
   Py_INCREF(cls);
+  if (PyObject_HasAttrString(cls, "map_many")) {
+    PyObject *mm = PyObject_GetAttrString(cls, "map_many");
+    if (mm && PyCallable_Check(mm)) api->map_many = map_many;
+    Py_XDECREF(mm);
+  }
 
   retval = api;
  fail:
@@ -1,4 +1,5 @@
 #include "utils/err.h"
+#include "utils/sync.h"
 
 #include "dlite.h"
 #include "dlite-macros.h"
@@ -13,7 +14,8 @@ DLiteInstance *mapper(const DLiteMappingPlugin *api,
 {
   const DLiteInstance *inst1;
   DLiteInstance *inst2;
-  int *p, a, b;
+  const int64_t *p;
+  int64_t a, b;
 
   Creater creater = dlite_instance_create_from_id;
   printf("*** creater: %p\n", *(void **)&creater);
@@ -26,7 +28,7 @@ DLiteInstance *mapper(const DLiteMappingPlugin *api,
   if (!(inst2 = dlite_instance_create_from_id("http://onto-ns.com/meta/0.1/ent2",
                                               NULL, NULL))) return NULL;
 
-  p = dlite_instance_get_property(inst1, "a");
+  p = dlite_instance_get_property_const(inst1, "a");
   a = *p;
   b = a + 1;
   dlite_instance_set_property(inst2, "b", &b);
@@ -36,7 +38,38 @@ DLiteInstance *mapper(const DLiteMappingPlugin *api,
 }
 
 
-DSL_EXPORT const DLiteMappingPlugin *get_dlite_mapping_api(void *state, int *iter)
+/* Number of calls to map_many(), exposed via the `data` field of the
+   api for testing. */
+static int nmap_many=0;
+
+int map_many(const DLiteMappingPlugin *api, const DLiteInstance **instances,
+             int ninput, size_t ntuples, DLiteInstance **outputs)
+{
+  DLiteMeta *meta;
+  size_t t;
+  int ia, ib, retval=1;
+
+  /* Resolve metadata and property indices once for all tuples */
+  if (!ntuples) return 0;
+  if (!(meta = dlite_meta_get(api->output_uri))) return 1;
+  if ((ia = dlite_meta_get_property_index(instances[0]->meta, "a")) < 0)
+    goto fail;
+  if ((ib = dlite_meta_get_property_index(meta, "b")) < 0) goto fail;
+
+  for (t=0; t<ntuples; t++) {
+    int64_t b = *(int64_t *)DLITE_PROP(instances[t*ninput], ia) + 1;
+    if (!(outputs[t] = dlite_instance_create(meta, NULL, NULL))) goto fail;
+    if (dlite_instance_set_property_by_index(outputs[t], ib, &b)) goto fail;
+  }
+  sync_add_int(&nmap_many, 1);
+  retval = 0;
+ fail:
+  dlite_meta_decref(meta);
+  return retval;
+}
+
+
+DSL_EXPORT const DLiteMappingPlugin *get_dlite_mapping_api_v2(void *state, int *iter)
 {
   static DLiteMappingPlugin api;
   static const char *input_uris[] = { "http://onto-ns.com/meta/0.1/ent1" };
@@ -50,5 +83,7 @@ DSL_EXPORT const DLiteMappingPlugin *get_dlite_mapping_api(void *state, int *ite
   api.input_uris = input_uris;
   api.mapper = mapper;
   api.cost = 20;
+  api.data = &nmap_many;
+  api.map_many = map_many;
   return &api;
 }
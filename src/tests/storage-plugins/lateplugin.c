@@ -0,0 +1,28 @@
+/*
+  Storage plugin that only exposes its api when the environment
+  variable DLITE_TEST_LATE_PLUGIN is set.
+
+  Used by test_storage to emulate a plugin that fails to load when the
+  plugin manifest is written (e.g. due to a missing dependency), but
+  can be loaded later.
+ */
+#include <stdlib.h>
+
+#include "utils/dsl.h"
+#include "dlite.h"
+#include "dlite-macros.h"
+#include "dlite-storage-plugins.h"
+
+
+static DLiteStoragePlugin late_plugin;
+
+
+DSL_EXPORT const DLiteStoragePlugin *
+get_dlite_storage_plugin_api_v2(void *state, int *iter)
+{
+  UNUSED(iter);
+  if (!getenv("DLITE_TEST_LATE_PLUGIN")) return NULL;
+  dlite_globals_set(state);
+  late_plugin.name = "late";
+  return &late_plugin;
+}
@@ -10,6 +10,7 @@
 #include "dlite.h"
 #include "dlite-collection.h"
 #include "dlite-macros.h"
+#include "dlite-storage-plugins.h"
 
 
 DLiteCollection *coll = NULL;
@@ -151,6 +152,7 @@ MU_TEST(test_collection_add)
   char *path, *uri;
   DLiteStorage *s;
   DLiteInstance *e, *inst;
+  int refcount;
 
   path = STRINGIFY(dlite_SOURCE_DIR) "/src/tests/test-entity.json";
   mu_check((s = dlite_storage_open("json", path, "mode=r")));
@@ -170,6 +172,14 @@ MU_TEST(test_collection_add)
   mu_check(!dlite_collection_add_new(coll, "inst2", inst));
   mu_assert_int_eq(3, dlite_collection_count(coll));
 
+  /* A failed add leaves the caller's reference untouched */
+  refcount = inst->_refcount;
+  dlite_err_set_stream(NULL);
+  mu_check(dlite_collection_add(coll, "inst", inst));
+  dlite_err_set_stream(stderr);
+  dlite_errclr();
+  mu_assert_int_eq(refcount, inst->_refcount);
+
   /* Save to file */
   dlite_collection_save_url(coll, "coll.json?mode=w");
 }
@@ -248,6 +258,183 @@ MU_TEST(test_collection_load)
 }
 
 
+MU_TEST(test_collection_lazy)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"values", dliteFloat, 8, NULL, 1, shape, "", "Values."}
+  };
+  char labels[5][8], uuids[5][DLITE_UUID_LENGTH+1];
+  size_t i, shp[] = {1000};
+  int n=0, nloaded=0;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/LazyItem", "...",
+                      1, dims, 1, props);
+  DLiteCollection *lazycoll;
+  DLiteCollectionState state;
+  DLiteInstance *inst;
+  DLiteStorage *s;
+  mu_check(meta);
+
+  mu_check((lazycoll = dlite_collection_create("lazycoll")));
+  for (i=0; i<5; i++) {
+    mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+    snprintf(labels[i], sizeof(labels[i]), "item%d", (int)i);
+    memcpy(uuids[i], inst->uuid, sizeof(uuids[i]));
+    mu_check(!dlite_collection_add_new(lazycoll, labels[i], inst));
+  }
+  mu_check(!dlite_collection_save_url(lazycoll, "lazycoll.json?mode=w"));
+  dlite_collection_decref(lazycoll);
+  for (i=0; i<5; i++) mu_check(!dlite_instance_has(uuids[i], 0));
+
+  /* Members are first loaded when they are accessed */
+  mu_check((s = dlite_storage_open("json", "lazycoll.json", "mode=r")));
+  mu_check((lazycoll = dlite_collection_load(s, "lazycoll", 1)));
+  mu_check(!dlite_storage_close(s));  // the collection keeps `s` open
+  for (i=0; i<5; i++) mu_check(!dlite_instance_has(uuids[i], 0));
+  mu_check(dlite_collection_get(lazycoll, "item3"));
+  mu_check(dlite_instance_has(uuids[3], 0));
+  mu_check(!dlite_instance_has(uuids[2], 0));
+
+  /* With a bounded cache, only the most recently used members are held */
+  dlite_collection_set_cache_size(lazycoll, 2);
+  dlite_collection_init_state(lazycoll, &state);
+  while ((inst = dlite_collection_next(lazycoll, &state))) n++;
+  dlite_collection_deinit_state(&state);
+  mu_assert_int_eq(5, n);
+  for (i=0; i<5; i++) if (dlite_instance_has(uuids[i], 0)) nloaded++;
+  mu_assert_int_eq(2, nloaded);
+
+  dlite_collection_decref(lazycoll);
+  for (i=0; i<5; i++) mu_check(!dlite_instance_has(uuids[i], 0));
+  dlite_meta_decref(meta);
+}
+
+
+MU_TEST(test_collection_parallel)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"values", dliteFloat, 8, NULL, 1, shape, "", "Values."}
+  };
+  char label[8], uuids[20][DLITE_UUID_LENGTH+1];
+  size_t i, shp[] = {100};
+  int stat=0;
+  double *v;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/ParallelItem", "...",
+                      1, dims, 1, props);
+  DLiteCollection *parcoll;
+  const DLiteInstance *members[3], *item;
+  DLiteInstance *inst;
+  DLiteStorage *s;
+  mu_check(meta);
+
+  mu_check((parcoll = dlite_collection_create("parcoll")));
+  for (i=0; i<20; i++) {
+    mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+    v = dlite_instance_get_property(inst, "values");
+    v[99] = (double)i;
+    snprintf(label, sizeof(label), "item%d", (int)i);
+    memcpy(uuids[i], inst->uuid, sizeof(uuids[i]));
+    mu_check(!dlite_collection_add_new(parcoll, label, inst));
+  }
+  mu_check((s = dlite_storage_open("json", "parcoll.json", "mode=w")));
+  mu_assert_int_eq(0, dlite_collection_save_parallel(parcoll, s, 4));
+  mu_check(!dlite_storage_close(s));
+  dlite_collection_decref(parcoll);
+  for (i=0; i<20; i++) mu_check(!dlite_instance_has(uuids[i], 0));
+
+  mu_check((s = dlite_storage_open("json", "parcoll.json", "mode=r")));
+  mu_check((parcoll = dlite_collection_load_parallel(s, "parcoll", 4)));
+  mu_assert_int_eq(20, dlite_collection_count(parcoll));
+  for (i=0; i<20; i++) {
+    snprintf(label, sizeof(label), "item%d", (int)i);
+    mu_check((item = dlite_collection_get(parcoll, label)));
+    mu_assert_string_eq(uuids[i], item->uuid);
+    v = dlite_instance_get_property(item, "values");
+    mu_assert_double_eq((double)i, v[99]);
+  }
+
+  /* Errors are reported per member */
+  for (i=0; i<3; i++) {
+    snprintf(label, sizeof(label), "item%d", (int)i);
+    members[i] = dlite_collection_get(parcoll, label);
+  }
+  ErrTry:
+    stat = dlite_instance_save_parallel(s, members, 3, 4);
+  ErrOther:
+    break;
+  ErrEnd;
+  mu_assert_int_eq(dliteStorageSaveError, stat);
+
+  mu_check(!dlite_storage_close(s));
+  dlite_collection_decref(parcoll);
+  for (i=0; i<20; i++) mu_check(!dlite_instance_has(uuids[i], 0));
+  dlite_meta_decref(meta);
+}
+
+
+MU_TEST(test_collection_parallel_stored_meta)
+{
+  /* The metadata of the loaded instances is only available from the
+     storage path, so it is resolved while the workers are running */
+  char *dir = STRINGIFY(dlite_SOURCE_DIR) "/src/tests/parallel";
+  char path[256], label[16], id[32], *ids[16];
+  DLiteInstance *records[16];
+  const DLiteInstance *item;
+  DLiteCollection *storedcoll;
+  DLiteStorage *s;
+  double *v;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/stored-entities.json", dir);
+  dlite_storage_paths_append(path);
+  mu_check(!dlite_instance_has("http://onto-ns.com/meta/0.1/StoredItem", 0));
+  mu_check(!dlite_instance_has("http://onto-ns.com/meta/0.1/StoredRecord",
+                               0));
+
+  snprintf(path, sizeof(path), "%s/stored-items.json", dir);
+  mu_check((s = dlite_storage_open("json", path, "mode=r")));
+  mu_check((storedcoll = dlite_collection_load_parallel(s, "storedcoll", 8)));
+  mu_assert_int_eq(16, dlite_collection_count(storedcoll));
+  for (i=0; i<16; i++) {
+    snprintf(label, sizeof(label), "item%d", i);
+    mu_check((item = dlite_collection_get(storedcoll, label)));
+    v = dlite_instance_get_property(item, "values");
+    mu_assert_double_eq(3.0*i, v[2]);
+  }
+  dlite_collection_decref(storedcoll);
+
+  /* Instances that are not in a collection */
+  for (i=0; i<16; i++) {
+    snprintf(id, sizeof(id), "stored-record%d", i);
+    mu_check((ids[i] = strdup(id)));
+  }
+  mu_assert_int_eq(0, dlite_instance_load_parallel(s, (const char **)ids, 16,
+                                                   records, 8));
+  for (i=0; i<16; i++) {
+    v = dlite_instance_get_property(records[i], "values");
+    mu_assert_double_eq(2.0*i, v[1]);
+    dlite_instance_decref(records[i]);
+  }
+
+  /* Storages that are not thread safe are only called from this thread */
+  s->flags &= ~dliteThreadSafe;
+  mu_assert_int_eq(0, dlite_instance_load_parallel(s, (const char **)ids, 16,
+                                                   records, 8));
+  for (i=0; i<16; i++) {
+    v = dlite_instance_get_property(records[i], "values");
+    mu_assert_double_eq(2.0*i, v[1]);
+    dlite_instance_decref(records[i]);
+    free(ids[i]);
+  }
+  mu_check(!dlite_storage_close(s));
+}
+
+
 MU_TEST(test_collection_free)
 {
   dlite_collection_decref(coll);
@@ -277,6 +464,9 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_collection_remove);
   MU_RUN_TEST(test_collection_save);
   MU_RUN_TEST(test_collection_load);
+  MU_RUN_TEST(test_collection_lazy);
+  MU_RUN_TEST(test_collection_parallel);
+  MU_RUN_TEST(test_collection_parallel_stored_meta);
 
   MU_RUN_TEST(test_collection_free);       /* tear down */
 }
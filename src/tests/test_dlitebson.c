@@ -96,6 +96,192 @@ MU_TEST(test_load_meta)
 }
 
 
+MU_TEST(test_from_instance)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"names", dliteStringPtr, sizeof(char *), NULL, 1, shape, "", "Names."}
+  };
+  char *names[] = {"first", "second"};
+  size_t n, shp[] = {2};
+  unsigned char *doc;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/BsonStrings", "...",
+                      1, dims, 1, props);
+  DLiteInstance *inst, *inst2;
+  mu_check(meta);
+  mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+  mu_check(dlite_instance_set_property(inst, "names", names) == 0);
+
+  /* The allocated size must include the terminator of string arrays */
+  mu_check((doc = dlite_bson_from_instance(inst, &n)));
+  mu_assert_int_eq(n, bson_docsize(doc));
+  dlite_instance_decref(inst);
+
+  mu_check((inst2 = dlite_bson_load_instance(doc)));
+  mu_assert_string_eq("second",
+                      ((char **)dlite_instance_get_property(inst2, "names"))[1]);
+  dlite_instance_decref(inst2);
+  dlite_meta_decref(meta);
+  free(doc);
+}
+
+
+MU_TEST(test_string_arrays)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"names", dliteStringPtr, sizeof(char *), NULL, 1, shape, "", "Names."},
+    {"codes", dliteFixString, 4, NULL, 1, shape, "", "Codes."},
+    {"count", dliteInt, sizeof(int), NULL, 0, NULL, "", "Count."}
+  };
+  char *names[] = {"a", "bb", "ccc"}, codes[3][4] = {"Al", "Mg", "Si"};
+  char **v, (*c)[4];
+  int count = 3;
+  size_t n, shp[] = {3};
+  unsigned char *doc;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/BsonStringArrays", "...",
+                      1, dims, 3, props);
+  DLiteInstance *inst, *inst2;
+  mu_check(meta);
+  mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+  mu_check(dlite_instance_set_property(inst, "names", names) == 0);
+  mu_check(dlite_instance_set_property(inst, "codes", codes) == 0);
+  mu_check(dlite_instance_set_property(inst, "count", &count) == 0);
+
+  /* The size of string arrays must be fully accounted for, otherwise
+     the following property ends up outside the document */
+  mu_check((doc = dlite_bson_from_instance(inst, &n)));
+  mu_assert_int_eq(n, bson_docsize(doc));
+  dlite_instance_decref(inst);
+
+  /* Every element must be decoded, not only the first */
+  mu_check((inst2 = dlite_bson_load_instance(doc)));
+  v = dlite_instance_get_property(inst2, "names");
+  mu_assert_string_eq("a", v[0]);
+  mu_assert_string_eq("bb", v[1]);
+  mu_assert_string_eq("ccc", v[2]);
+  c = dlite_instance_get_property(inst2, "codes");
+  mu_assert_string_eq("Al", c[0]);
+  mu_assert_string_eq("Si", c[2]);
+  mu_assert_int_eq(3, *(int *)dlite_instance_get_property(inst2, "count"));
+  dlite_instance_decref(inst2);
+  dlite_meta_decref(meta);
+  free(doc);
+}
+
+
+MU_TEST(test_load_instance_borrowed)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"bytes", dliteUInt, 1, NULL, 1, shape, "", "Bytes."},
+    {"values", dliteFloat, 8, NULL, 1, shape, "", "Values."}
+  };
+  uint8_t bytes[] = {1, 2, 3}, newbytes[] = {7, 8, 9};
+  double values[] = {1.5, 2.5, 3.5};
+  size_t n, shp[] = {3};
+  unsigned char *doc, *copy, *subdoc;
+  void *data;
+  const uint8_t *p;
+  const double *v;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/BsonBorrowed", "...",
+                      1, dims, 2, props);
+  DLiteInstance *inst;
+  mu_check(meta);
+  mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+  mu_check(dlite_instance_set_property(inst, "bytes", bytes) == 0);
+  mu_check(dlite_instance_set_property(inst, "values", values) == 0);
+  mu_check((doc = dlite_bson_from_instance(inst, &n)));
+  dlite_instance_decref(inst);
+  mu_check((copy = malloc(n)));
+  memcpy(copy, doc, n);
+
+  /* Byte arrays can always be borrowed */
+  mu_check((inst = dlite_bson_load_instance_borrowed(doc, free)));
+  mu_check(dlite_instance_is_borrowed(inst, 0));
+  p = dlite_instance_get_property_const(inst, "bytes");
+  mu_check(p >= doc && p < doc + n);
+  mu_assert_int_eq(2, p[1]);
+
+  /* Doubles are only borrowed if they are aligned in the document */
+  mu_check(bson_scan(doc, "properties", (void **)&subdoc, NULL) ==
+           bsonDocument);
+  mu_check(bson_scan(subdoc, "values", &data, NULL) == bsonBinary);
+  mu_assert_int_eq(((uintptr_t)data % sizeof(double)) == 0,
+                   dlite_instance_is_borrowed(inst, 1));
+  v = dlite_instance_get_property_const(inst, "values");
+  mu_assert_double_eq(2.5, v[1]);
+
+  /* Copy-on-write - the document is not modified */
+  mu_check(dlite_instance_set_property(inst, "bytes", newbytes) == 0);
+  mu_check(!dlite_instance_is_borrowed(inst, 0));
+  p = dlite_instance_get_property_const(inst, "bytes");
+  mu_assert_int_eq(8, p[1]);
+  mu_check(memcmp(doc, copy, n) == 0);
+
+  /* Resizing also copies */
+  mu_check(dlite_instance_set_dimension_size(inst, "N", 4) == 0);
+  mu_check(!dlite_instance_is_borrowed(inst, 1));
+  v = dlite_instance_get_property_const(inst, "values");
+  mu_assert_double_eq(3.5, v[2]);
+  mu_assert_double_eq(0.0, v[3]);
+  mu_check(memcmp(doc, copy, n) == 0);
+
+  /* `doc` is released together with the instance */
+  dlite_instance_decref(inst);
+  dlite_meta_decref(meta);
+  free(copy);
+}
+
+MU_TEST(test_load_instance_borrowed_writable)
+{
+  char *shape[] = {"N"};
+  DLiteDimension dims[] = {{"N", "Number of items."}};
+  DLiteProperty props[] = {
+    {"bytes", dliteUInt, 1, NULL, 1, shape, "", "Bytes."}
+  };
+  uint8_t bytes[] = {1, 2, 3};
+  size_t n, shp[] = {3};
+  unsigned char *doc, *copy;
+  uint8_t *p;
+  DLiteMeta *meta =
+    dlite_meta_create("http://onto-ns.com/meta/0.1/BsonBorrowedWritable",
+                      "...", 1, dims, 1, props);
+  DLiteInstance *inst;
+  mu_check(meta);
+  mu_check((inst = dlite_instance_create(meta, shp, NULL)));
+  mu_check(dlite_instance_set_property(inst, "bytes", bytes) == 0);
+  mu_check((doc = dlite_bson_from_instance(inst, &n)));
+  dlite_instance_decref(inst);
+  mu_check((copy = malloc(n)));
+  memcpy(copy, doc, n);
+
+  /* A writable pointer refers to a private copy of the borrowed array */
+  mu_check((inst = dlite_bson_load_instance_borrowed(doc, free)));
+  mu_check(dlite_instance_is_borrowed(inst, 0));
+  mu_check((p = dlite_instance_get_property(inst, "bytes")));
+  mu_check(!dlite_instance_is_borrowed(inst, 0));
+  mu_check(p < doc || p >= doc + n);
+  mu_assert_int_eq(2, p[1]);
+
+  /* Writing through it leaves the document untouched */
+  p[1] = 42;
+  mu_check(memcmp(doc, copy, n) == 0);
+  mu_assert_int_eq(42, ((const uint8_t *)
+                        dlite_instance_get_property_const(inst, "bytes"))[1]);
+
+  dlite_instance_decref(inst);
+  dlite_meta_decref(meta);
+  free(copy);
+}
+
+
 /***********************************************************************/
 
 MU_TEST_SUITE(test_suite)
@@ -104,6 +290,10 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_write_instance);
   MU_RUN_TEST(test_load_instance);
   MU_RUN_TEST(test_load_meta);
+  MU_RUN_TEST(test_from_instance);
+  MU_RUN_TEST(test_string_arrays);
+  MU_RUN_TEST(test_load_instance_borrowed);
+  MU_RUN_TEST(test_load_instance_borrowed_writable);
 }
 
 
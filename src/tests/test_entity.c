@@ -7,6 +7,7 @@
 #include "utils/integers.h"
 #include "utils/boolean.h"
 #include "utils/strutils.h"
+#include "utils/sync.h"
 #include "dlite.h"
 #include "dlite-macros.h"
 #include "dlite-entity.h"
@@ -80,6 +81,31 @@ MU_TEST(test_meta_create)
 #endif
 }
 
+MU_TEST(test_meta_propdims_error)
+{
+  char *shape[] = {"N/M"};
+  DLiteDimension dims[] = {
+    {"N", "Number of items."},
+    {"M", "Number of groups."}
+  };
+  DLiteProperty props[] = {
+    {"v", dliteInt, sizeof(int), NULL, 1, shape, "", "Values per group."}
+  };
+  size_t okdims[] = {4, 2}, baddims[] = {4, 0};
+  DLiteMeta *meta;
+  DLiteInstance *inst;
+  mu_check((meta = dlite_meta_create("http://onto-ns.com/meta/0.1/PerGroup",
+                                     "...", 2, dims, 1, props)));
+  mu_check((inst = dlite_instance_create(meta, okdims, NULL)));
+  mu_assert_int_eq(2, DLITE_PROP_DIM(inst, 0, 0));
+  dlite_instance_decref(inst);
+
+  /* Evaluation errors of compiled expressions are reported */
+  mu_check(!dlite_instance_create(meta, baddims, NULL));
+  dlite_errclr();
+  dlite_meta_decref(meta);
+}
+
 MU_TEST(test_instance_create)
 {
   size_t dims[]={3, 2};
@@ -154,6 +180,150 @@ MU_TEST(test_instance_copy)
 }
 
 
+MU_TEST(test_instance_arena)
+{
+  size_t dims[]={3, 2};
+  int newdims1[] = {-1, 4};
+  int newdims2[] = {2, 1};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  char *strarr[] = {"first string", "second string"};
+  char **sp;
+  int *ip;
+  DLiteInstance *inst;
+  size_t size = dlite_instance_size(entity, dims);
+
+  dlite_instance_set_use_arena(1);
+  mu_check((inst = dlite_instance_create(entity, dims, NULL)));
+  dlite_instance_set_use_arena(0);
+  mu_check(inst->_flags & dliteArena);
+
+  /* property arrays are located right after the header */
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_check((char *)ip > (char *)inst + size);
+  mu_check((char *)ip < (char *)inst + 2*size + sizeof(intarr) + 64);
+  mu_assert_int_eq(0, ip[5]);
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string-arr", strarr) == 0);
+
+  /* growing moves the array out of the arena, keeping its content */
+  mu_check(dlite_instance_set_dimension_sizes(inst, newdims1) == 0);
+  mu_check(dlite_instance_get_property(inst, "an-int-arr") != ip);
+  mu_assert_int_eq(5, ((int *)dlite_instance_get_property(inst,
+                                                          "an-int-arr"))[5]);
+  sp = dlite_instance_get_property(inst, "a-string-arr");
+  mu_assert_string_eq("second string", sp[1]);
+  mu_check(sp[3] == NULL);
+
+  /* shrinking keeps arrays in place */
+  ip = dlite_instance_get_property(inst, "a-string3-arr");
+  mu_check(dlite_instance_set_dimension_sizes(inst, newdims2) == 0);
+  mu_check(dlite_instance_get_property(inst, "a-string3-arr") == ip);
+  sp = dlite_instance_get_property(inst, "a-string-arr");
+  mu_assert_string_eq("first string", sp[0]);
+
+  dlite_instance_decref(inst);
+  mu_assert_int_eq(3, entity->_refcount);  /* refs: global+store+mydata */
+}
+
+
+MU_TEST(test_instance_append_rows)
+{
+  size_t dims[]={3, 2};
+  int newdims[] = {-1, 2};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  char *strarr[] = {"first string", "second string"};
+  char str3arr[3][3] = {"Al", "Mg", "Si"};
+  DLiteInstance *inst;
+  char **sp, *cp;
+  int *ip, *ip2, n, nmoves=0;
+
+  mu_check((inst = dlite_instance_create(entity, dims, NULL)));
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string-arr", strarr) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string3-arr", str3arr) == 0);
+
+  /* append along the first dimension of "an-int-arr" */
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "N", 1));
+  mu_assert_int_eq(3, dlite_instance_get_dimension_size(inst, "N"));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(5, ip[5]);
+  mu_assert_int_eq(0, ip[6]);
+  mu_assert_int_eq(0, ip[8]);
+  sp = dlite_instance_get_property(inst, "a-string-arr");
+  mu_assert_string_eq("second string", sp[1]);
+  mu_check(sp[2] == NULL);
+  ip[8] = 8;
+
+  /* append along the second dimension, which is laid out again */
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "M", 2));
+  mu_assert_int_eq(5, dlite_instance_get_dimension_size(inst, "M"));
+  mu_assert_int_eq(3, DLITE_PROP_DIM(inst, 2, 0));
+  mu_assert_int_eq(5, DLITE_PROP_DIM(inst, 2, 1));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(2, ip[2]);
+  mu_assert_int_eq(0, ip[3]);
+  mu_assert_int_eq(0, ip[4]);
+  mu_assert_int_eq(3, ip[5]);
+  mu_assert_int_eq(5, ip[7]);
+  mu_assert_int_eq(0, ip[9]);
+  mu_assert_int_eq(8, ip[12]);
+  mu_assert_int_eq(0, ip[14]);
+  cp = dlite_instance_get_property(inst, "a-string3-arr");
+  mu_assert_string_eq("Si", cp + 6);
+  mu_assert_string_eq("", cp + 12);
+
+  /* arrays grow geometrically... */
+  for (n=0; n < 100; n++) {
+    mu_assert_int_eq(0, dlite_instance_append_rows(inst, "N", 1));
+    ip2 = dlite_instance_get_property(inst, "an-int-arr");
+    if (ip2 != ip) nmoves++;
+    ip = ip2;
+    ip[(n+3)*5] = n;
+  }
+  mu_check(nmoves < 10);
+  mu_assert_int_eq(103, dlite_instance_get_dimension_size(inst, "N"));
+  mu_assert_int_eq(8, ip[12]);
+  mu_assert_int_eq(99, ip[102*5]);
+
+  /* ...and are not moved within the reserved capacity */
+  mu_assert_int_eq(0, dlite_instance_reserve_rows(inst, "N", 1000));
+  mu_assert_int_eq(103, dlite_instance_get_dimension_size(inst, "N"));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "N", 897));
+  mu_check(dlite_instance_get_property(inst, "an-int-arr") == ip);
+  mu_assert_int_eq(99, ip[102*5]);
+  mu_assert_int_eq(0, ip[999*5+4]);
+
+  /* snapshots are not affected */
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "M", 1));
+  mu_assert_int_eq(0, dlite_instance_verify_hash(inst, NULL, 1));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(8, ip[14]);
+
+  /* resizing drops the reserved capacity */
+  mu_check(dlite_instance_set_dimension_sizes(inst, newdims) == 0);
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "N", 1));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(0, ip[17]);
+
+  dlite_instance_decref(inst);
+
+  /* arrays in the arena are moved out */
+  dlite_instance_set_use_arena(1);
+  mu_check((inst = dlite_instance_create(entity, dims, NULL)));
+  dlite_instance_set_use_arena(0);
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr) == 0);
+  mu_assert_int_eq(0, dlite_instance_append_rows(inst, "M", 1));
+  ip = dlite_instance_get_property(inst, "an-int-arr");
+  mu_assert_int_eq(2, ip[2]);
+  mu_assert_int_eq(0, ip[3]);
+  mu_assert_int_eq(3, ip[4]);
+  dlite_instance_decref(inst);
+  mu_assert_int_eq(3, entity->_refcount);  /* refs: global+store+mydata */
+}
+
+
 MU_TEST(test_instance_print_property)
 {
   DLiteInstance *inst;
@@ -359,6 +529,49 @@ MU_TEST(test_instance_get)
 }
 
 
+#ifdef SYNC_PTHREADS
+/* Worker creating, looking up and releasing instances concurrently. */
+static void *concurrent_worker(void *arg)
+{
+  int i, *failures = arg;
+  size_t dims[] = {2, 3};
+  for (i=0; i<200; i++) {
+    DLiteMeta *meta = dlite_meta_get(uri);
+    DLiteInstance *inst = dlite_instance_create(meta, dims, NULL);
+    DLiteInstance *shared = dlite_instance_get("shared-instance");
+    DLiteInstance *inst2 = (inst) ? dlite_instance_get(inst->uuid) : NULL;
+    if (!meta || !inst || !shared || inst2 != inst) sync_add_int(failures, 1);
+    if (inst2) dlite_instance_decref(inst2);
+    if (inst) dlite_instance_decref(inst);
+    if (shared) dlite_instance_decref(shared);
+    if (meta) dlite_meta_decref(meta);
+  }
+  return NULL;
+}
+#endif
+
+MU_TEST(test_instance_concurrent)
+{
+#ifdef SYNC_PTHREADS
+  int i, failures=0, refcount=entity->_refcount;
+  pthread_t threads[8];
+  size_t dims[] = {2, 3};
+  DLiteInstance *shared = dlite_instance_create(entity, dims,
+                                                "shared-instance");
+  mu_check(shared);
+  for (i=0; i<8; i++)
+    mu_assert_int_eq(0, pthread_create(threads+i, NULL, concurrent_worker,
+                                       &failures));
+  for (i=0; i<8; i++)
+    pthread_join(threads[i], NULL);
+  mu_assert_int_eq(0, failures);
+  mu_assert_int_eq(1, shared->_refcount);
+  dlite_instance_decref(shared);
+  mu_assert_int_eq(refcount, entity->_refcount);
+#endif
+}
+
+
 MU_TEST(test_instance_get_hash)
 {
   char *hash;
@@ -389,6 +602,187 @@ MU_TEST(test_instance_get_hash)
 }
 
 
+MU_TEST(test_instance_hash_cache)
+{
+  size_t dims[] = {3, 2};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}}, *p, i;
+  float afloat = 2.5f;
+  uint8_t h1[32], h2[32], h3[32];
+  DLiteInstance *copy, *inst = dlite_instance_create(entity, dims, NULL);
+  mu_check(inst);
+  mu_check((i = dlite_meta_get_property_index(inst->meta, "a-float")) >= 0);
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "an-int-arr", intarr));
+
+  /* Without a hash cache, direct writes are seen */
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h1, sizeof(h1)));
+  *(float *)DLITE_PROP(inst, i) = 3.14f;
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  mu_assert_int_eq(0, dlite_instance_set_hash_cache(inst, 1));
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h1, sizeof(h1)));
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)) == 0);
+
+  /* With a hash cache, direct writes must be marked */
+  *(float *)DLITE_PROP(inst, i) = 1.5f;
+  dlite_instance_mark_modified(inst, i);
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  /* Assigned properties are rehashed */
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "a-float", &afloat));
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+  mu_check((copy = dlite_instance_copy(inst, NULL)));
+  mu_assert_int_eq(0, dlite_instance_set_hash_cache(copy, 1));
+  mu_assert_int_eq(0, dlite_instance_get_hash(copy, h3, sizeof(h3)));
+  mu_check(memcmp(h2, h3, sizeof(h2)) == 0);
+
+  /* So are properties modified through a pointer returned before the
+     hash was calculated */
+  mu_check((p = dlite_instance_get_property(inst, "an-int-arr")));
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h1, sizeof(h1)));
+  p[4] = 42;
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+  mu_assert_int_eq(0, dlite_instance_set_property(copy, "an-int-arr", p));
+  mu_assert_int_eq(0, dlite_instance_get_hash(copy, h3, sizeof(h3)));
+  mu_check(memcmp(h2, h3, sizeof(h2)) == 0);
+
+  /* ...and resized properties */
+  mu_assert_int_eq(0, dlite_instance_set_dimension_size(inst, "M", 4));
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h1, sizeof(h1)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  /* A pointer returned before the hash cache was enabled */
+  dlite_instance_decref(copy);
+  mu_check((copy = dlite_instance_create(entity, dims, NULL)));
+  mu_check((p = dlite_instance_get_property(copy, "an-int-arr")));
+  mu_assert_int_eq(0, dlite_instance_set_hash_cache(copy, 1));
+  mu_assert_int_eq(0, dlite_instance_get_hash(copy, h1, sizeof(h1)));
+  p[0] = 42;
+  mu_assert_int_eq(0, dlite_instance_get_hash(copy, h2, sizeof(h2)));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  dlite_instance_decref(copy);
+  dlite_instance_decref(inst);
+}
+
+
+MU_TEST(test_instance_hash_algorithm)
+{
+  size_t dims[] = {3, 2};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  float afloat = 2.5f;
+  uint8_t h1[32], h2[32], h3[32];
+  char *s;
+  DLiteInstance *copy, *inst2, *inst = dlite_instance_create(entity, dims, NULL);
+  mu_check(inst);
+  mu_assert_int_eq(dliteHashSha3, dlite_instance_hash_algorithm());
+  mu_assert_string_eq("fast", dlite_hash_algorithm_name(dliteHashFast));
+  mu_assert_int_eq(dliteHashFast, dlite_hash_algorithm_from_name("fast"));
+  mu_assert_int_eq(0, dlite_instance_set_hash_cache(inst, 1));
+
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "an-int-arr", intarr));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h1, sizeof(h1),
+                                                  dliteHashFast));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h2, sizeof(h2),
+                                                  dliteHashSha3));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  /* Switching algorithm does not confuse the hash cache */
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h3, sizeof(h3),
+                                                  dliteHashFast));
+  mu_check(memcmp(h1, h3, sizeof(h1)) == 0);
+
+  /* Modified properties are rehashed */
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "a-float", &afloat));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h2, sizeof(h2),
+                                                  dliteHashFast));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+  mu_check((copy = dlite_instance_copy(inst, NULL)));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(copy, h3, sizeof(h3),
+                                                  dliteHashFast));
+  mu_check(memcmp(h2, h3, sizeof(h2)) == 0);
+
+  /* The algorithm is recorded in transactions */
+  dlite_instance_set_hash_algorithm(dliteHashFast);
+  dlite_instance_freeze(copy);
+  mu_check((inst2 = dlite_instance_create(entity, dims, NULL)));
+  mu_assert_int_eq(0, dlite_instance_set_parent(inst2, copy));
+  mu_assert_int_eq(dliteHashFast, inst2->_parent->hashalg);
+  mu_check(memcmp(inst2->_parent->hash, h3, sizeof(h3)) == 0);
+  mu_check((s = dlite_json_aprint(inst2, 0, 0)));
+  mu_check(strstr(s, "\"hashalg\": \"fast\""));
+  free(s);
+
+  /* ...and remain verifiable after changing the algorithm */
+  dlite_instance_set_hash_algorithm(dliteHashSha3);
+  mu_assert_int_eq(0, dlite_instance_verify_transaction(inst2));
+
+  /* Tampering with the parent is detected */
+  afloat = 3.5f;
+  memcpy(dlite_instance_get_property(copy, "a-float"), &afloat, sizeof(float));
+  mu_check(dlite_instance_verify_transaction(inst2));
+  dlite_errclr();
+
+  dlite_instance_decref(inst2);
+  dlite_instance_decref(copy);
+  dlite_instance_decref(inst);
+}
+
+MU_TEST(test_instance_hash_sha3_tree)
+{
+  size_t dims[] = {3, 2};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  float afloat = 2.5f;
+  uint8_t h1[32], h2[32], h3[32];
+  char *s;
+  DLiteInstance *copy, *inst = dlite_instance_create(entity, dims, NULL);
+  mu_check(inst);
+  mu_assert_string_eq("sha3-tree",
+                      dlite_hash_algorithm_name(dliteHashSha3Tree));
+  mu_assert_int_eq(dliteHashSha3Tree,
+                   dlite_hash_algorithm_from_name("sha3-tree"));
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "an-int-arr", intarr));
+  mu_assert_int_eq(0, dlite_instance_set_hash_cache(inst, 1));
+
+  /* The tree hash differs from the sha3 hash */
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h1, sizeof(h1),
+                                                  dliteHashSha3Tree));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h2, sizeof(h2),
+                                                  dliteHashSha3));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+
+  /* Cached and uncached hashes agree after modifying a property */
+  mu_assert_int_eq(0, dlite_instance_set_property(inst, "a-float", &afloat));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(inst, h2, sizeof(h2),
+                                                  dliteHashSha3Tree));
+  mu_check(memcmp(h1, h2, sizeof(h1)));
+  mu_check((copy = dlite_instance_copy(inst, NULL)));
+  mu_assert_int_eq(0, dlite_instance_get_hash_alg(copy, h3, sizeof(h3),
+                                                  dliteHashSha3Tree));
+  mu_check(memcmp(h2, h3, sizeof(h2)) == 0);
+  dlite_instance_decref(copy);
+
+  /* Snapshots made with the tree hash are verifiable */
+  dlite_instance_set_hash_algorithm(dliteHashSha3Tree);
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  mu_assert_int_eq(dliteHashSha3Tree, inst->_parent->hashalg);
+  mu_check(memcmp(inst->_parent->hash, h2, sizeof(h2)) == 0);
+  mu_assert_int_eq(0, dlite_instance_get_hash(inst, h3, sizeof(h3)));
+  mu_check(memcmp(h2, h3, sizeof(h2)));
+  mu_check((s = dlite_json_aprint(inst, 0, 0)));
+  mu_check(strstr(s, "\"hashalg\": \"sha3-tree\""));
+  free(s);
+  dlite_instance_set_hash_algorithm(dliteHashSha3);
+  mu_assert_int_eq(0, dlite_instance_verify_transaction(inst));
+
+  dlite_instance_decref(inst);
+}
+
+
 MU_TEST(test_transactions)
 {
   int stat;
@@ -522,6 +916,128 @@ MU_TEST(test_snapshot)
 
 
 
+MU_TEST(test_snapshot_cow)
+{
+  size_t dims[]={3, 2};
+  int newdims[] = {-1, 4};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  int intarr2[2][3] = {{6, 7, 8}, {9, 10, 11}};
+  char str3arr[3][3] = {"Al", "Mg", "Si"};
+  const DLiteInstance *snap1, *snap2, *snap3;
+  DLiteInstance *inst;
+  char *cp;
+  int *ip;
+
+  mu_check((inst = dlite_instance_create(entity, dims, NULL)));
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string3-arr", str3arr) == 0);
+  mu_assert_int_eq(0, dlite_instance_set_shared_snapshots(inst, 1));
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  snap1 = dlite_instance_get_snapshot(inst, 1);
+  snap2 = dlite_instance_get_snapshot(inst, 2);
+
+  /* arrays of non-allocated types are shared with the snapshots */
+  ip = *(int **)DLITE_PROP(inst, 2);
+  cp = *(char **)DLITE_PROP(inst, 4);
+  mu_check(*(int **)DLITE_PROP(snap1, 2) == ip);
+  mu_check(*(int **)DLITE_PROP(snap2, 2) == ip);
+  mu_check(*(char **)DLITE_PROP(snap1, 4) == cp);
+  mu_check(*(char **)DLITE_PROP(snap1, 3) != *(char **)DLITE_PROP(inst, 3));
+
+  /* setting a property makes a private copy */
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr2) == 0);
+  mu_check(*(int **)DLITE_PROP(inst, 2) != ip);
+  mu_check(*(int **)DLITE_PROP(snap1, 2) == ip);
+  mu_assert_int_eq(5, ip[5]);
+  mu_assert_int_eq(11, (*(int **)DLITE_PROP(inst, 2))[5]);
+
+  /* obtaining a read-only pointer keeps the array shared... */
+  mu_check(dlite_instance_get_property_const(inst, "a-string3-arr") ==
+           *(char **)DLITE_PROP(snap1, 4));
+
+  /* ...but obtaining a writable pointer makes a private copy... */
+  mu_check((cp = dlite_instance_get_property(inst, "a-string3-arr")) !=
+           *(char **)DLITE_PROP(snap1, 4));
+  mu_assert_string_eq("Mg", cp + 3);
+  /* ...but not from the frozen snapshot */
+  mu_check(dlite_instance_get_property(snap1, "a-string3-arr") ==
+           *(char **)DLITE_PROP(snap2, 4));
+
+  /* exposed properties are copied to new snapshots */
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  snap3 = dlite_instance_get_snapshot(inst, 1);
+  mu_check(*(char **)DLITE_PROP(snap3, 4) != cp);
+  mu_check(*(int **)DLITE_PROP(snap3, 2) == *(int **)DLITE_PROP(inst, 2));
+
+  /* writing through a pointer obtained before the snapshot does not
+     change the snapshot */
+  cp[0] = 'X';
+  mu_assert_string_eq("Al", *(char **)DLITE_PROP(snap3, 4));
+  mu_assert_int_eq(0, dlite_instance_verify_transaction(inst));
+
+  /* resizing */
+  ip = *(int **)DLITE_PROP(inst, 2);
+  mu_check(dlite_instance_set_dimension_sizes(inst, newdims) == 0);
+  mu_check(*(int **)DLITE_PROP(inst, 2) != ip);
+  mu_assert_int_eq(11, ip[5]);
+  mu_assert_int_eq(11, (*(int **)DLITE_PROP(inst, 2))[5]);
+
+  /* the snapshots are unchanged */
+  mu_assert_int_eq(0, dlite_instance_verify_hash(inst, NULL, 1));
+
+  /* shared arrays survive the instance they were made from */
+  dlite_instance_incref((DLiteInstance *)snap2);
+  dlite_instance_decref(inst);
+  mu_assert_int_eq(5, (*(int **)DLITE_PROP(snap2, 2))[5]);
+  mu_assert_string_eq("Si", *(char **)DLITE_PROP(snap2, 4) + 6);
+  dlite_instance_decref((DLiteInstance *)snap2);
+}
+
+MU_TEST(test_snapshot_unshared)
+{
+  size_t dims[]={3, 2};
+  int intarr[2][3] = {{0, 1, 2}, {3, 4, 5}};
+  const DLiteInstance *snap;
+  DLiteInstance *inst;
+  int *ip;
+
+  mu_check((inst = dlite_instance_create(entity, dims, NULL)));
+  mu_check(dlite_instance_set_property(inst, "an-int-arr", intarr) == 0);
+
+  /* by default, arrays are copied to the snapshot... */
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  snap = dlite_instance_get_snapshot(inst, 1);
+  ip = *(int **)DLITE_PROP(inst, 2);
+  mu_check(*(int **)DLITE_PROP(snap, 2) != ip);
+
+  /* ...such that writing through DLITE_PROP() leaves it unchanged */
+  ip[5] = 42;
+  mu_assert_int_eq(5, (*(int **)DLITE_PROP(snap, 2))[5]);
+  mu_assert_int_eq(0, dlite_instance_verify_transaction(inst));
+
+  /* with sharing enabled, such writes are detected by verification */
+  mu_assert_int_eq(0, dlite_instance_set_shared_snapshots(inst, 1));
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  snap = dlite_instance_get_snapshot(inst, 1);
+  mu_check(*(int **)DLITE_PROP(snap, 2) == ip);
+  ip[5] = 43;
+  dlite_err_set_stream(NULL);
+  mu_check(dlite_instance_verify_transaction(inst));
+  dlite_err_set_stream(stderr);
+  dlite_errclr();
+
+  /* disabling sharing applies to new snapshots */
+  mu_assert_int_eq(0, dlite_instance_set_shared_snapshots(inst, 0));
+  mu_assert_int_eq(0, dlite_instance_snapshot(inst));
+  snap = dlite_instance_get_snapshot(inst, 1);
+  mu_check(*(int **)DLITE_PROP(snap, 2) != *(int **)DLITE_PROP(inst, 2));
+
+  dlite_instance_decref(inst);
+}
+
+
+
 MU_TEST(test_meta_save)
 {
   DLiteStorage *s;
@@ -587,11 +1103,14 @@ MU_TEST(test_meta_free)
 MU_TEST_SUITE(test_suite)
 {
   MU_RUN_TEST(test_meta_create);    /* setup */
+  MU_RUN_TEST(test_meta_propdims_error);
   MU_RUN_TEST(test_instance_create);
   MU_RUN_TEST(test_instance_set_property);
   MU_RUN_TEST(test_instance_get_dimension_size);
   MU_RUN_TEST(test_instance_set_dimension_sizes);
   MU_RUN_TEST(test_instance_copy);
+  MU_RUN_TEST(test_instance_arena);
+  MU_RUN_TEST(test_instance_append_rows);
   MU_RUN_TEST(test_instance_print_property);
   MU_RUN_TEST(test_instance_save);
   MU_RUN_TEST(test_instance_hdf5);
@@ -599,9 +1118,15 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_instance_load_url);
   MU_RUN_TEST(test_instance_snprint);
   MU_RUN_TEST(test_instance_get);
+  MU_RUN_TEST(test_instance_concurrent);
   MU_RUN_TEST(test_instance_get_hash);
+  MU_RUN_TEST(test_instance_hash_cache);
+  MU_RUN_TEST(test_instance_hash_algorithm);
+  MU_RUN_TEST(test_instance_hash_sha3_tree);
   MU_RUN_TEST(test_transactions);
   MU_RUN_TEST(test_snapshot);
+  MU_RUN_TEST(test_snapshot_cow);
+  MU_RUN_TEST(test_snapshot_unshared);
 
   MU_RUN_TEST(test_meta_save);
   MU_RUN_TEST(test_meta_load);
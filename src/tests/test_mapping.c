@@ -1,6 +1,8 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "minunit/minunit.h"
+#include "utils/sync.h"
 
 #include "dlite.h"
 #include "dlite-macros.h"
@@ -106,6 +108,150 @@ MU_TEST(test_get_casted)
 }
 
 
+MU_TEST(test_mapping_many)
+{
+  DLiteInstance *insts[3], **outputs;
+  DLiteMappingPlugin *api;
+  MapperMany map_many;
+  const char *output_uri = "http://onto-ns.com/meta/0.1/ent2";
+  int64_t a, *b;
+  int i, ncalls, *nmap_many;
+  for (i=0; i<3; i++) {
+    a = 10 * i;
+    mu_check((insts[i] =
+              dlite_instance_create_from_id("http://onto-ns.com/meta/0.1/ent1",
+                                            NULL, NULL)));
+    mu_check(dlite_instance_set_property(insts[i], "a", &a) == 0);
+  }
+
+  /* The plugin's map_many() is called once for all tuples */
+  mu_check((api = (DLiteMappingPlugin *)dlite_mapping_plugin_get("mapA")));
+  mu_assert_int_eq(DLITE_MAPPING_PLUGIN_API_VERSION,
+                   dlite_mapping_plugin_api_version(api));
+  nmap_many = api->data;
+  map_many = api->map_many;
+  ncalls = *nmap_many;
+  mu_check((outputs = dlite_mapping_many(output_uri,
+                                         (const DLiteInstance **)insts, 1, 3)));
+  mu_assert_int_eq(ncalls + 1, *nmap_many);
+  for (i=0; i<3; i++) {
+    mu_assert_string_eq(output_uri, outputs[i]->meta->uri);
+    b = dlite_instance_get_property(outputs[i], "b");
+    mu_assert_int_eq(10 * i + 1, *b);
+    mu_assert_int_eq(1, outputs[i]->_refcount);
+    dlite_instance_decref(outputs[i]);
+  }
+  free(outputs);
+
+  /* The input instances are borrowed by both map_many() and the
+     per-tuple fallback calling mapper() */
+  for (i=0; i<3; i++) mu_assert_int_eq(1, insts[i]->_refcount);
+  api->map_many = NULL;
+  mu_check((outputs = dlite_mapping_many(output_uri,
+                                         (const DLiteInstance **)insts, 1, 3)));
+  api->map_many = map_many;
+  mu_assert_int_eq(ncalls + 1, *nmap_many);
+  for (i=0; i<3; i++) {
+    b = dlite_instance_get_property(outputs[i], "b");
+    mu_assert_int_eq(10 * i + 1, *b);
+    mu_assert_int_eq(1, outputs[i]->_refcount);
+    mu_assert_int_eq(1, insts[i]->_refcount);
+    dlite_instance_decref(outputs[i]);
+  }
+  free(outputs);
+
+  /* Trivial mapping */
+  mu_check((outputs = dlite_mapping_many(insts[0]->meta->uri,
+                                         (const DLiteInstance **)insts, 1, 3)));
+  for (i=0; i<3; i++) {
+    mu_check(outputs[i] == insts[i]);
+    dlite_instance_decref(outputs[i]);
+  }
+  free(outputs);
+
+  for (i=0; i<3; i++) dlite_instance_decref(insts[i]);
+}
+
+
+/* Data for mapping_task(). */
+typedef struct {
+  DLiteInstance *insts[2];  /* The same input instance twice */
+  int failures;             /* Number of failed mappings */
+} MappingTaskData;
+
+/* Task for test_mapping_concurrent().  Maps the input instance, while
+   every fourth task clears the cache of mapping plans. */
+static void mapping_task(size_t i, void *data)
+{
+  MappingTaskData *d = data;
+  DLiteInstance *inst, **outputs;
+  const char *output_uri = "http://onto-ns.com/meta/0.1/ent2";
+  int j;
+  if (i % 4 == 0) {
+    dlite_mapping_cache_clear();
+  } else if (i % 4 == 1) {
+    if ((outputs = dlite_mapping_many(output_uri,
+                                      (const DLiteInstance **)d->insts, 1,
+                                      2))) {
+      for (j=0; j<2; j++) dlite_instance_decref(outputs[j]);
+      free(outputs);
+    } else {
+      sync_add_int(&d->failures, 1);
+    }
+  } else {
+    if ((inst = dlite_mapping(output_uri, (const DLiteInstance **)d->insts,
+                              1)))
+      dlite_instance_decref(inst);
+    else
+      sync_add_int(&d->failures, 1);
+  }
+}
+
+MU_TEST(test_mapping_concurrent)
+{
+  MappingTaskData d;
+  memset(&d, 0, sizeof(d));
+  mu_check((d.insts[0] =
+            dlite_instance_get("2daa6967-8ecd-4248-97b2-9ad6fefeac14")));
+  d.insts[1] = d.insts[0];
+
+  /* Plans in use must survive that another thread clears the cache */
+  sync_parallel_for(8, 2000, mapping_task, &d);
+  mu_assert_int_eq(0, d.failures);
+  dlite_instance_decref(d.insts[0]);
+}
+
+
+MU_TEST(test_mapping_cache)
+{
+  DLiteInstance *inst, *inst2, *inst3;
+  const char *output_uri = "http://onto-ns.com/meta/0.1/ent2";
+  uint64_t stamp;
+  mu_check((inst = dlite_instance_get("2daa6967-8ecd-4248-97b2-9ad6fefeac14")));
+
+  /* The second call reuses the cached plan */
+  mu_check((inst2 = dlite_mapping(output_uri, (const DLiteInstance **)&inst,
+                                  1)));
+  stamp = dlite_mapping_plugin_stamp();
+  mu_check((inst3 = dlite_mapping(output_uri, (const DLiteInstance **)&inst,
+                                  1)));
+  mu_check(dlite_mapping_plugin_stamp() == stamp);
+  dlite_instance_decref(inst2);
+  dlite_instance_decref(inst3);
+
+  /* Unloading the plugins invalidates the cache */
+  mu_check(dlite_mapping_plugin_unload_all() == 0);
+  mu_check(dlite_mapping_plugin_stamp() != stamp);
+  dlite_err_set_stream(NULL);
+  inst2 = dlite_mapping(output_uri, (const DLiteInstance **)&inst, 1);
+  dlite_err_set_stream(stderr);
+  mu_check(!inst2);
+  dlite_errclr();
+
+  dlite_instance_decref(inst);
+}
+
+
 /***********************************************************************/
 
 MU_TEST_SUITE(test_suite)
@@ -114,6 +260,9 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_create_from_id);
   MU_RUN_TEST(test_mapping);
   MU_RUN_TEST(test_get_casted);
+  MU_RUN_TEST(test_mapping_many);
+  MU_RUN_TEST(test_mapping_concurrent);
+  MU_RUN_TEST(test_mapping_cache);
 }
 
 
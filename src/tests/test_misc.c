@@ -175,6 +175,38 @@ MU_TEST(test_get_uuidn)
 }
 
 
+MU_TEST(test_get_uuid_cached)
+{
+  char buff[37];
+  int namespacedID = dlite_behavior_get("namespacedID");
+
+  /* Repeated lookups hit the cache */
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "http://ex.com/a/b"));
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "http://ex.com/a/b"));
+  mu_assert_string_eq("0e188d02-7327-5fa1-832f-78a53ed6e2a1", buff);
+
+  /* Cached names are invalidated when the behavior changes */
+  dlite_behavior_set("namespacedID", 1);
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "abc"));
+  mu_assert_string_eq("8c942973-6c8d-5d6d-8e4e-503ee50d7f84", buff);
+  dlite_behavior_set("namespacedID", 0);
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "abc"));
+  mu_assert_string_eq("6cb8e707-0fc5-5f55-88d4-d4fed43e64a8", buff);
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuidn(buff, "abcd", 3));
+  mu_assert_string_eq("6cb8e707-0fc5-5f55-88d4-d4fed43e64a8", buff);
+
+  /* URIs are independent of the behavior */
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "http://ex.com/a/b"));
+  mu_assert_string_eq("0e188d02-7327-5fa1-832f-78a53ed6e2a1", buff);
+
+  dlite_uuid_cache_clear();
+  mu_assert_int_eq(dliteIdHash, dlite_get_uuid(buff, "abc"));
+  mu_assert_string_eq("6cb8e707-0fc5-5f55-88d4-d4fed43e64a8", buff);
+
+  dlite_behavior_set("namespacedID", namespacedID);
+}
+
+
 MU_TEST(test_join_split_metadata)
 {
   char *uri = "http://www.sintef.no/meta/dlite/0.1/testdata";
@@ -308,6 +340,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_normalise_idn);
   MU_RUN_TEST(test_get_uuid);
   MU_RUN_TEST(test_get_uuidn);
+  MU_RUN_TEST(test_get_uuid_cached);
   MU_RUN_TEST(test_join_split_metadata);
   MU_RUN_TEST(test_option_parse);
   MU_RUN_TEST(test_join_url);
@@ -1,5 +1,6 @@
 #include "config.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -289,6 +290,57 @@ MU_TEST(test_scan_arr) {
 }
 
 
+MU_TEST(test_scan_numbers) {
+  int n;
+  DLiteProperty prop;
+  memset(&prop, 0, sizeof(prop));
+  size_t shape[] = {6};
+  char *dimexpr[] = {"N"};
+  prop.ndims = 1;
+  prop.shape = dimexpr;
+
+  /* Numbers that are not plain decimal numbers are scanned as before */
+  int16_t iarr[6];
+  prop.type = dliteInt;
+  prop.size = sizeof(int16_t);
+  n = dlite_property_scan("[-32768, 0x1f, 010, 7, -0, 32767]",
+                          iarr, &prop, shape, 0);
+  mu_assert_int_eq(33, n);
+  mu_assert_int_eq(-32768, iarr[0]);
+  mu_assert_int_eq(31, iarr[1]);
+  mu_assert_int_eq(8, iarr[2]);
+  mu_assert_int_eq(7, iarr[3]);
+  mu_assert_int_eq(0, iarr[4]);
+  mu_assert_int_eq(32767, iarr[5]);
+
+  double darr[6];
+  prop.type = dliteFloat;
+  prop.size = sizeof(double);
+  n = dlite_property_scan("[1.5, -2e-3, 0.1, 1.7976931348623157e308, "
+                          "nan, 12345678901234567890]",
+                          darr, &prop, shape, 0);
+  mu_assert_int_eq(68, n);
+  mu_assert_double_eq(1.5, darr[0]);
+  mu_check(darr[1] == -2e-3);
+  mu_check(darr[2] == 0.1);
+  mu_check(darr[3] == 1.7976931348623157e308);
+  mu_check(isnan(darr[4]));
+  mu_check(darr[5] == 12345678901234567890.0);
+
+  float farr[6];
+  prop.size = sizeof(float);
+  n = dlite_property_scan("[0.1, 3.14, -1e-7, 16777217, 1e39, 2.5]",
+                          farr, &prop, shape, 0);
+  mu_assert_int_eq(39, n);
+  mu_check(farr[0] == 0.1f);
+  mu_check(farr[1] == 3.14f);
+  mu_check(farr[2] == -1e-7f);
+  mu_check(farr[3] == 16777216.0f);
+  mu_check(isinf(farr[4]));
+  mu_check(farr[5] == 2.5f);
+}
+
+
 
 /***********************************************************************/
 
@@ -298,6 +350,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_print_arr);
   MU_RUN_TEST(test_scan);
   MU_RUN_TEST(test_scan_arr);
+  MU_RUN_TEST(test_scan_numbers);
 }
 
 
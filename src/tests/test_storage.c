@@ -1,7 +1,10 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "minunit/minunit.h"
+#include "utils/compat.h"
+#include "utils/sync.h"
 
 #include "dlite.h"
 #include "dlite-macros.h"
@@ -49,6 +52,12 @@ MU_TEST(test_get_driver)
   mu_assert_string_eq("json", driver);
 }
 
+MU_TEST(test_api_version)
+{
+  mu_assert_int_eq(DLITE_STORAGE_PLUGIN_API_VERSION,
+                   dlite_storage_plugin_api_version(s->api));
+}
+
 MU_TEST(test_storage_iter)
 {
   /* Iterate over UUIDs of all instances in the storage */
@@ -128,6 +137,116 @@ MU_TEST(test_load_all)
 }
 
 
+MU_TEST(test_pool)
+{
+  char *path = STRINGIFY(dlite_SOURCE_DIR) "/src/tests/test-data.json";
+  char *id = "204b05b2-4c89-43f4-93db-fd1cb70f54ef";
+  char *newid = "http://onto-ns.com/data/storage-pool-copy";
+  DLiteInstance *inst, *copy;
+  DLiteStorage *s1, *s2, *s3, *ws;
+
+  dlite_storage_paths_append(STRINGIFY(dlite_SOURCE_DIR)
+                             "/src/tests/test-entity.json");
+  mu_check((inst = dlite_instance_load_loc("json", path, NULL, id)));
+  mu_check((ws = dlite_storage_open("json", "storage_pool.json", "mode=w")));
+  mu_assert_int_eq(0, dlite_instance_save(ws, inst));
+  mu_assert_int_eq(0, dlite_storage_close(ws));
+
+  /* Released handles are reused and opened read-only */
+  mu_check((s1 = dlite_storage_pool_open("json", "storage_pool.json", NULL)));
+  mu_assert_int_eq(0, dlite_storage_is_writable(s1));
+  mu_assert_int_eq(0, dlite_storage_pool_release(s1));
+  mu_check((s2 = dlite_storage_pool_open(NULL, "storage_pool.json", NULL)));
+  mu_check(s1 == s2);
+
+  /* Handles in use are not shared */
+  mu_check((s3 = dlite_storage_pool_open("json", "storage_pool.json", NULL)));
+  mu_check(s2 != s3);
+  mu_assert_int_eq(0, dlite_storage_is_writable(s3));
+  mu_assert_int_eq(0, dlite_storage_pool_release(s3));
+  mu_assert_int_eq(0, dlite_storage_pool_release(s2));
+
+  /* Modifying the file invalidates the pooled handle */
+  mu_check((copy = dlite_instance_copy(inst, newid)));
+  mu_check((ws = dlite_storage_open("json", "storage_pool.json", "mode=a")));
+  mu_assert_int_eq(0, dlite_instance_save(ws, copy));
+  mu_assert_int_eq(0, dlite_storage_close(ws));
+  dlite_instance_decref(copy);
+  mu_check((s1 = dlite_storage_pool_open("json", "storage_pool.json", NULL)));
+  mu_check((copy = dlite_instance_load(s1, newid)));
+  mu_assert_int_eq(0, dlite_storage_pool_release(s1));
+  dlite_instance_decref(copy);
+
+  /* A non-positive timeout disables the pool */
+  dlite_storage_pool_set_timeout(0);
+  mu_check((s1 = dlite_storage_pool_open("json", "storage_pool.json", NULL)));
+  mu_assert_int_eq(1, dlite_storage_is_writable(s1));
+  mu_assert_int_eq(0, dlite_storage_pool_release(s1));
+  dlite_storage_pool_set_timeout(30);
+  dlite_storage_pool_clear();
+
+  dlite_instance_decref(inst);
+}
+
+
+/* Data for pool_load_task(). */
+typedef struct {
+  DLiteInstance *insts[8];  /* Loaded instances */
+  int failures;             /* Number of failed loads */
+} PoolTaskData;
+
+/* Task for test_pool_concurrent().  Loads instance `i` via the pool. */
+static void pool_load_task(size_t i, void *data)
+{
+  PoolTaskData *d = data;
+  char *path = STRINGIFY(dlite_SOURCE_DIR) "/src/tests/test-data.json";
+  char *id = "204b05b2-4c89-43f4-93db-fd1cb70f54ef";
+  if (!(d->insts[i] = dlite_instance_load_loc("json", path, NULL, id)))
+    sync_add_int(&d->failures, 1);
+}
+
+MU_TEST(test_pool_concurrent)
+{
+  char *uri = "http://onto-ns.com/meta/0.1/test-entity";
+  DLiteInstance *meta;
+  PoolTaskData d;
+  int round, i;
+  memset(&d, 0, sizeof(d));
+  mu_check((meta = dlite_instance_get(uri)));
+
+  /* Concurrent loads of the same instance from the same location.  The
+     instance is released after each round, such that it is loaded from
+     storage again. */
+  for (round=0; round<50; round++) {
+    sync_parallel_for(8, 8, pool_load_task, &d);
+    mu_assert_int_eq(0, d.failures);
+    for (i=0; i<8; i++) mu_check(d.insts[i] == d.insts[0]);
+    for (i=0; i<8; i++) dlite_instance_decref(d.insts[i]);
+  }
+  dlite_instance_decref(meta);
+  dlite_storage_pool_clear();
+}
+
+
+/* A plugin that fails to load when the plugin manifest is written should
+   still be found when it becomes loadable later */
+MU_TEST(test_late_plugin)
+{
+  char *path = STRINGIFY(dlite_BINARY_DIR) "/src/tests/storage-plugins";
+  mu_check(dlite_storage_plugin_path_append(path) >= 0);
+
+  /* The first lookup writes a manifest listing the plugin library without
+     any api, the second lookup finds `late` missing in a valid manifest */
+  mu_check(!dlite_storage_plugin_get("late"));
+  mu_check(!dlite_storage_plugin_get("late"));
+
+  setenv("DLITE_TEST_LATE_PLUGIN", "1", 1);
+  mu_check(dlite_storage_plugin_get("late"));
+
+  mu_assert_int_eq(0, dlite_storage_plugin_path_remove(path));
+}
+
+
 MU_TEST(test_close)
 {
   mu_assert_int_eq(0, dlite_storage_close(s));
@@ -145,11 +264,15 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_idflag);
   MU_RUN_TEST(test_uuids);
   MU_RUN_TEST(test_get_driver);
+  MU_RUN_TEST(test_api_version);
   MU_RUN_TEST(test_storage_iter);
   MU_RUN_TEST(test_storage_iter_pattern);
   MU_RUN_TEST(test_storage_iter_bad_pattern);
   MU_RUN_TEST(test_plugin_iter);
   MU_RUN_TEST(test_load_all);
+  MU_RUN_TEST(test_pool);
+  MU_RUN_TEST(test_pool_concurrent);
+  MU_RUN_TEST(test_late_plugin);
 
   MU_RUN_TEST(test_close);  /* teardown */
 }
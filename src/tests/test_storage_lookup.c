@@ -30,12 +30,105 @@ MU_TEST(test_storage_lookup)
 }
 
 
+MU_TEST(test_lookup_cache)
+{
+  DLiteInstance *inst, *inst2;
+  DLiteStorage *s;
+  DLiteLookupStats s0, s1;
+  char *id = "204b05b2-4c89-43f4-93db-fd1cb70f54ef";
+  char *newid = "http://onto-ns.com/data/storage-lookup-copy";
+
+  /* Looked up via the index built by the previous test */
+  dlite_storage_paths_lookup_stats(&s0);
+  mu_check((inst = dlite_instance_get(id)));
+  dlite_storage_paths_lookup_stats(&s1);
+  mu_assert_int_eq(s0.scans, s1.scans);
+  mu_assert_int_eq(s0.hits + 1, s1.hits);
+
+  /* The first miss searches, the second is served by the negative
+     cache */
+  mu_check(!dlite_instance_has("no-such-instance", 1));
+  dlite_storage_paths_lookup_stats(&s0);
+  mu_check(!dlite_instance_has("no-such-instance", 1));
+  dlite_storage_paths_lookup_stats(&s1);
+  mu_assert_int_eq(s0.scans, s1.scans);
+  mu_assert_int_eq(s0.searches, s1.searches);
+  mu_assert_int_eq(s0.misses + 1, s1.misses);
+
+  /* Save a copy to a file that is not yet in the storage paths */
+  mu_check((inst2 = dlite_instance_copy(inst, newid)));
+  mu_check((s = dlite_storage_open("json", "storage_lookup2.json",
+                                   "mode=w")));
+  mu_assert_int_eq(0, dlite_instance_save(s, inst2));
+  mu_assert_int_eq(0, dlite_storage_close(s));
+  dlite_instance_decref(inst2);
+  mu_check(!dlite_instance_has(newid, 1));
+
+  /* Changing the storage paths invalidates the cache */
+  mu_check(dlite_storage_paths_append("storage_lookup2.json") >= 0);
+  mu_check((inst2 = dlite_instance_get(newid)));
+  mu_assert_string_eq(newid, inst2->uri);
+  dlite_instance_decref(inst2);
+
+  /* ...and so does removing the path again */
+  mu_assert_int_eq(0, dlite_storage_paths_remove_index(-1));
+  mu_check(!dlite_instance_has(newid, 1));
+
+  dlite_instance_decref(inst);
+}
+
+
+MU_TEST(test_lookup_cache_modified)
+{
+  DLiteInstance *inst, *inst2;
+  DLiteStorage *s;
+  DLiteLookupStats s0, s1;
+  char *id = "204b05b2-4c89-43f4-93db-fd1cb70f54ef";
+  char *newid = "http://onto-ns.com/data/storage-lookup-added";
+
+  /* Start with a storage in the storage paths without `newid` */
+  mu_check((inst = dlite_instance_get(id)));
+  mu_check((s = dlite_storage_open("json", "storage_lookup3.json",
+                                   "mode=w")));
+  mu_assert_int_eq(0, dlite_instance_save(s, inst));
+  mu_assert_int_eq(0, dlite_storage_close(s));
+  mu_check(dlite_storage_paths_append("storage_lookup3.json") >= 0);
+
+  /* Cache the miss */
+  mu_check(!dlite_instance_has(newid, 1));
+  dlite_storage_paths_lookup_stats(&s0);
+  mu_check(!dlite_instance_has(newid, 1));
+  dlite_storage_paths_lookup_stats(&s1);
+  mu_assert_int_eq(s0.misses + 1, s1.misses);
+
+  /* Adding the instance to the file invalidates the negative cache */
+  mu_check((inst2 = dlite_instance_copy(inst, newid)));
+  mu_check((s = dlite_storage_open("json", "storage_lookup3.json",
+                                   "mode=a")));
+  mu_assert_int_eq(0, dlite_instance_save(s, inst2));
+  mu_assert_int_eq(0, dlite_storage_close(s));
+  dlite_instance_decref(inst2);
+
+  dlite_storage_paths_lookup_stats(&s0);
+  mu_check((inst2 = dlite_instance_get(newid)));
+  mu_assert_string_eq(newid, inst2->uri);
+  dlite_storage_paths_lookup_stats(&s1);
+  mu_assert_int_eq(s0.scans + 1, s1.scans);
+  mu_assert_int_eq(s0.misses, s1.misses);
+  dlite_instance_decref(inst2);
+
+  mu_assert_int_eq(0, dlite_storage_paths_remove_index(-1));
+  dlite_instance_decref(inst);
+}
+
 
 /***********************************************************************/
 
 MU_TEST_SUITE(test_suite)
 {
   MU_RUN_TEST(test_storage_lookup);
+  MU_RUN_TEST(test_lookup_cache);
+  MU_RUN_TEST(test_lookup_cache_modified);
 }
 
 
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "minunit/minunit.h"
+#include "utils/err.h"
 #include "dlite.h"
 #include "dlite-macros.h"
 #include "dlite-store.h"
@@ -126,6 +127,38 @@ MU_TEST(test_save_and_load)
 }
 
 
+MU_TEST(test_store_load)
+{
+  DLiteStorage *s;
+  DLiteStore *store2;
+  DLiteInstance *instances[2];
+  const char *ids[2] = {inst_id, "no-such-instance"};
+  char *path = STRINGIFY(dlite_SOURCE_DIR) "/src/tests/alloys.json";
+  mu_check((s = dlite_storage_open("json", path, "mode=r")));
+  mu_check((store2 = dlite_store_load(s)));
+  mu_assert_int_eq(1, count_uuids(store2));
+  mu_check(dlite_store_get(store2, inst_id) == inst);
+  mu_assert_int_eq(3, inst->_refcount);    /* global+store+store2 */
+  dlite_store_free(store2);
+  mu_assert_int_eq(2, inst->_refcount);    /* global+store */
+
+  /* bulk loading is all-or-nothing */
+  mu_assert_int_eq(0, dlite_instance_load_many(s, ids, 1, instances));
+  mu_check(instances[0] == inst);
+  dlite_instance_decref(instances[0]);
+  err_clear();
+  ErrTry:
+    mu_check(dlite_instance_load_many(s, ids, 2, instances));
+  ErrOther:
+    break;
+  ErrEnd;
+  mu_check(instances[0] == NULL);
+  mu_check(instances[1] == NULL);
+  mu_assert_int_eq(2, inst->_refcount);    /* global+store */
+  mu_assert_int_eq(0, dlite_storage_close(s));
+}
+
+
 MU_TEST(test_store_free)
 {
   mu_assert_int_eq(2, inst->_refcount);    /* global + store */
@@ -161,6 +194,7 @@ MU_TEST_SUITE(test_suite)
 
   MU_RUN_TEST(test_store);
   MU_RUN_TEST(test_save_and_load);
+  MU_RUN_TEST(test_store_load);
 
   MU_RUN_TEST(test_store_free);
   MU_RUN_TEST(test_instance_free);   /* tear down */
@@ -198,6 +198,79 @@ MU_TEST(test_clear)
 }
 
 
+MU_TEST(test_index)
+{
+  /* Exercise the indices with a larger store, including deferred
+     removals while iterating */
+  TripleStore *ts2 = triplestore_create();
+  TripleState state;
+  const Triple *t;
+  char s[32], o[32];
+  int i, n, N=3000;
+
+  for (i=0; i<N; i++) {
+    snprintf(s, sizeof(s), "s%d", i);
+    snprintf(o, sizeof(o), "o%d", i % 10);
+    mu_assert_int_eq(0, triplestore_add(ts2, s, "has", o, NULL));
+    mu_assert_int_eq(0, triplestore_add(ts2, s, (i%2) ? "odd" : "even",
+                                        "parity", NULL));
+  }
+  mu_assert_int_eq(2*N, triplestore_length(ts2));
+
+  t = triplestore_find_first(ts2, "s1234", "has", NULL, NULL);
+  mu_check(t);
+  mu_assert_string_eq("o4", t->o);
+  mu_check(triplestore_get(ts2, t->id) == t);
+  mu_check(!triplestore_find_first(ts2, "s1234", "has", "o5", NULL));
+  mu_check(!triplestore_find_first(ts2, "no-such-subject", NULL, NULL, NULL));
+
+  triplestore_init_state(ts2, &state);
+  n = 0;
+  while (triplestore_find(&state, NULL, "has", "o3", NULL)) n++;
+  mu_assert_int_eq(N/10, n);
+  triplestore_deinit_state(&state);
+
+  /* remove all odd subjects while iterating */
+  triplestore_init_state(ts2, &state);
+  n = 0;
+  while ((t = triplestore_find(&state, NULL, "odd", "parity", NULL))) {
+    mu_assert_int_eq(2, triplestore_remove(ts2, t->s, NULL, NULL, NULL));
+    n++;
+  }
+  mu_assert_int_eq(N/2, n);
+  mu_assert_int_eq(N, triplestore_length(ts2));
+  triplestore_deinit_state(&state);
+  mu_assert_int_eq(N, triplestore_length(ts2));
+
+  /* check that the indices are consistent after compaction */
+  mu_check(!triplestore_find_first(ts2, NULL, "odd", NULL, NULL));
+  triplestore_init_state(ts2, &state);
+  n = 0;
+  while ((t = triplestore_find(&state, NULL, NULL, "parity", NULL))) {
+    mu_assert_string_eq("even", t->p);
+    mu_check(triplestore_get(ts2, t->id) == t);
+    n++;
+  }
+  mu_assert_int_eq(N/2, n);
+  triplestore_deinit_state(&state);
+
+  /* immediate removal */
+  mu_assert_int_eq(N/10, triplestore_remove(ts2, NULL, "has", "o2", NULL));
+  mu_assert_int_eq(N - N/10, triplestore_length(ts2));
+  mu_check(!triplestore_find_first(ts2, NULL, NULL, "o2", NULL));
+  t = triplestore_find_first(ts2, "s1234", NULL, NULL, NULL);
+  mu_check(t);
+  mu_assert_int_eq(0, triplestore_remove_by_id(ts2, t->id));
+  t = triplestore_find_first(ts2, "s1234", NULL, NULL, NULL);
+  mu_check(t);
+  mu_assert_int_eq(0, triplestore_remove_by_id(ts2, t->id));
+  mu_check(!triplestore_find_first(ts2, "s1234", NULL, NULL, NULL));
+  mu_assert_int_eq(N - N/10 - 2, triplestore_length(ts2));
+
+  triplestore_free(ts2);
+}
+
+
 MU_TEST(test_free)
 {
   triplestore_free(ts);
@@ -219,6 +292,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_value);
   MU_RUN_TEST(test_remove);
   MU_RUN_TEST(test_clear);
+  MU_RUN_TEST(test_index);
   MU_RUN_TEST(test_free);
 }
 
@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include "config.h"
 
@@ -12,6 +13,7 @@
 #include "utils/err.h"
 #include "dlite.h"
 #include "dlite-errors.h"
+#include "dlite-macros.h"
 
 
 /***************************************************************
@@ -232,6 +234,44 @@ MU_TEST(test_print)
                                         sizeof(double), -1, -1, 0));
   mu_assert_string_eq("     3.14159", buf);
 
+  {
+    double d1=-42.0, d2=1e6, d3=-0.0;
+    int16_t i16=-32768;
+    uint64_t u64=18446744073709551615ULL;
+    bool b=1;
+    unsigned char blob[3] = {0x0a, 0xbc, 0xff};
+
+    mu_assert_int_eq(3, dlite_type_print(buf, sizeof(buf), &d1, dliteFloat,
+                                         sizeof(double), 0, -2, 0));
+    mu_assert_string_eq("-42", buf);
+    mu_assert_int_eq(5, dlite_type_print(buf, sizeof(buf), &d2, dliteFloat,
+                                         sizeof(double), 0, -2, 0));
+    mu_assert_string_eq("1e+06", buf);
+    mu_assert_int_eq(2, dlite_type_print(buf, sizeof(buf), &d3, dliteFloat,
+                                         sizeof(double), 0, -2, 0));
+    mu_assert_string_eq("-0", buf);
+    mu_assert_int_eq(6, dlite_type_print(buf, sizeof(buf), &i16, dliteInt,
+                                         sizeof(i16), 0, -2, 0));
+    mu_assert_string_eq("-32768", buf);
+    mu_assert_int_eq(20, dlite_type_print(buf, sizeof(buf), &u64, dliteUInt,
+                                          sizeof(u64), 0, -2, 0));
+    mu_assert_string_eq("18446744073709551615", buf);
+    mu_assert_int_eq(20, dlite_type_print(buf, 4, &u64, dliteUInt,
+                                          sizeof(u64), 0, -2, 0));
+    mu_assert_string_eq("184", buf);
+    mu_assert_int_eq(4, dlite_type_print(buf, sizeof(buf), &b, dliteBool,
+                                         sizeof(b), 0, -2, 0));
+    mu_assert_string_eq("true", buf);
+    mu_assert_int_eq(8, dlite_type_print(buf, sizeof(buf), blob, dliteBlob,
+                                         sizeof(blob), 0, -2,
+                                         dliteFlagQuoted));
+    mu_assert_string_eq("\"0abcff\"", buf);
+    mu_assert_int_eq(8, dlite_type_print(buf, 5, blob, dliteBlob,
+                                         sizeof(blob), 0, -2,
+                                         dliteFlagQuoted));
+    mu_assert_string_eq("\"0a", buf);
+  }
+
   mu_assert_int_eq(18, dlite_type_print(buf, sizeof(buf), &q, dliteStringPtr,
                                         sizeof(char *), -1, -1,
                                         dliteFlagQuoted));
@@ -273,6 +313,84 @@ MU_TEST(test_print)
   dlite_instance_decref(inst);
 }
 
+/* Compare printing of floats with the default format against "%g" */
+MU_TEST(test_print_float)
+{
+  char buf[64], expected[64];
+  double values[] = {
+    0.0, 1.0, -1.0, 0.5, 0.1, 3.141592653589793, 2.5e-300,
+    1.7976931348623157e308, 2.2250738585072014e-308, 2.2250738585072009e-308, 4.9406564584124654e-324,
+    1e-5, 1e-4, 9.99999e-5, 9.999995e-5, 9.9999949e-5, 0.0001, 0.000123456789,
+    99999.95, 999999.4, 999999.5, 1000000.5, 999999.49999, 1234565.0, 1234575.0,
+    1e5, 1e6, 1e7, 123456.5, 123457.5, 0.1234565, 1e21, 1e22, 1e23, 1e-100,
+    9.5, 0.95, 99.99995, 1.5e-7, 65536.25, 2.0/3.0, -2.0/3.0, 1e100, 1e-310,
+  };
+  float fvalues[] = {
+    0.1f, 1e-5f, 3.4028235e38f, 1.17549435e-38f, 1.4e-45f, 16777216.0f,
+    0.3333333f, 123456.7f, 9.999999e-5f,
+  };
+  uint64_t bits=0x9e3779b97f4a7c15ULL;
+  double special[4];
+  size_t i;
+
+  special[0] = -0.0;
+  special[1] = HUGE_VAL;
+  special[2] = -HUGE_VAL;
+  special[3] = NAN;
+
+  for (i=0; i<countof(values); i++) {
+    double v = values[i];
+    int k;
+    for (k=0; k<2; k++, v=-v) {
+      int m = dlite_type_print(buf, sizeof(buf), &v, dliteFloat, sizeof(v),
+                               0, -2, 0);
+      snprintf(expected, sizeof(expected), "%g", v);
+      mu_assert_string_eq(expected, buf);
+      mu_assert_int_eq((int)strlen(expected), m);
+    }
+  }
+  for (i=0; i<countof(special); i++) {
+    double v = special[i];
+    dlite_type_print(buf, sizeof(buf), &v, dliteFloat, sizeof(v), 0, -2, 0);
+    snprintf(expected, sizeof(expected), "%g", v);
+    mu_assert_string_eq(expected, buf);
+  }
+  for (i=0; i<countof(fvalues); i++) {
+    float v = fvalues[i];
+    dlite_type_print(buf, sizeof(buf), &v, dliteFloat, sizeof(v), 0, -2, 0);
+    snprintf(expected, sizeof(expected), "%g", v);
+    mu_assert_string_eq(expected, buf);
+  }
+
+  /* Pseudo-random bit patterns covering all exponents */
+  for (i=0; i<100000; i++) {
+    double v;
+    float f;
+    uint32_t fbits;
+    bits ^= bits << 13;
+    bits ^= bits >> 7;
+    bits ^= bits << 17;
+    memcpy(&v, &bits, sizeof(v));
+    dlite_type_print(buf, sizeof(buf), &v, dliteFloat, sizeof(v), 0, -2, 0);
+    snprintf(expected, sizeof(expected), "%g", v);
+    mu_assert_string_eq(expected, buf);
+
+    fbits = (uint32_t)(bits >> 32);
+    memcpy(&f, &fbits, sizeof(f));
+    dlite_type_print(buf, sizeof(buf), &f, dliteFloat, sizeof(f), 0, -2, 0);
+    snprintf(expected, sizeof(expected), "%g", f);
+    mu_assert_string_eq(expected, buf);
+  }
+
+  /* Truncation */
+  {
+    double v = 1.5e-7;
+    mu_assert_int_eq(7, dlite_type_print(buf, 4, &v, dliteFloat, sizeof(v),
+                                         0, -2, 0));
+    mu_assert_string_eq("1.5", buf);
+  }
+}
+
 MU_TEST(test_scan)
 {
   int n;
@@ -383,6 +501,15 @@ MU_TEST(test_scan)
   mu_assert_int_eq(7, n);
   mu_assert_double_eq(2.1e-2, float64);
 
+  /* no more than `len` characters are read */
+  n = dlite_type_scan("2.5e3", 3, &float64, dliteFloat, sizeof(float64), 0);
+  mu_assert_int_eq(3, n);
+  mu_assert_double_eq(2.5, float64);
+
+  n = dlite_type_scan("12345", 2, &int16, dliteInt, sizeof(int16), 0);
+  mu_assert_int_eq(2, n);
+  mu_assert_int_eq(12, int16);
+
   /* fixstring */
   n = dlite_type_scan(" 3.14 ", -1, buf, dliteFixString, sizeof(buf),
                       dliteFlagQuoted);
@@ -803,6 +930,96 @@ MU_TEST(test_type_ndcast)
   mu_assert_int_eq(11, d[11]);
 }
 
+/* Element-wise cast that bypasses the cast kernels in dlite_type_ndcast() */
+static int generic_cast(void *dest, DLiteType dest_type, size_t dest_size,
+                        const void *src, DLiteType src_type, size_t src_size)
+{
+  return dlite_type_copy_cast(dest, dest_type, dest_size,
+                              src, src_type, src_size);
+}
+
+MU_TEST(test_type_ndcast_kernels)
+{
+  size_t i, j, k, n, nfail=0, N=37*5*41;
+  size_t dims[] = {37, 5, 41};
+  size_t hdims[] = {37, 5, 20};
+  int fstrides[] = {8, 8*37, 8*37*5};     /* Fortran order, float64 */
+  int hstrides[] = {4*5*41, 4*41, 8};      /* every second, int32 */
+  int rstrides[] = {-4*5*41, 4*41, 4};     /* reversed first dim, int32 */
+  int32_t *s = malloc(N * sizeof(int32_t));
+  double *d1 = calloc(N, sizeof(double));
+  double *d2 = calloc(N, sizeof(double));
+  float *f1 = calloc(N, sizeof(float));
+  float *f2 = calloc(N, sizeof(float));
+  uint32_t *u = calloc(N, sizeof(uint32_t));
+  for (i=0; i<N; i++) s[i] = (int32_t)(i * 7919 % 10007) - 5000;
+
+  /* Contiguous int32 -> float64 */
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d1, dliteFloat, 8, dims, NULL,
+                                        s, dliteInt, 4, dims, NULL, NULL));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d2, dliteFloat, 8, dims, NULL,
+                                        s, dliteInt, 4, dims, NULL,
+                                        generic_cast));
+  mu_check(memcmp(d1, d2, N * sizeof(double)) == 0);
+
+  /* Contiguous float64 -> float32 */
+  for (i=0; i<N; i++) d1[i] = s[i] / 3.0;
+  mu_assert_int_eq(0, dlite_type_ndcast(3, f1, dliteFloat, 4, dims, NULL,
+                                        d1, dliteFloat, 8, dims, NULL, NULL));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, f2, dliteFloat, 4, dims, NULL,
+                                        d1, dliteFloat, 8, dims, NULL,
+                                        generic_cast));
+  mu_check(memcmp(f1, f2, N * sizeof(float)) == 0);
+
+  /* C -> Fortran order (blocked transpose) */
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d1, dliteFloat, 8, dims, fstrides,
+                                        s, dliteInt, 4, dims, NULL, NULL));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d2, dliteFloat, 8, dims, fstrides,
+                                        s, dliteInt, 4, dims, NULL,
+                                        generic_cast));
+  mu_check(memcmp(d1, d2, N * sizeof(double)) == 0);
+  for (i=0, n=0; i<37; i++)
+    for (j=0; j<5; j++)
+      for (k=0; k<41; k++)
+        if (d1[i + 37*j + 37*5*k] != s[n++]) nfail++;
+  mu_assert_int_eq(0, nfail);
+
+  /* Strided source */
+  memset(d1, 0, N * sizeof(double));
+  memset(d2, 0, N * sizeof(double));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d1, dliteFloat, 8, hdims, NULL,
+                                        s, dliteInt, 4, hdims, hstrides, NULL));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d2, dliteFloat, 8, hdims, NULL,
+                                        s, dliteInt, 4, hdims, hstrides,
+                                        generic_cast));
+  mu_check(memcmp(d1, d2, N * sizeof(double)) == 0);
+  mu_assert_double_eq(s[2], d1[1]);
+
+  /* Negative source strides */
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d1, dliteFloat, 8, dims, NULL,
+                                        s + 36*5*41, dliteInt, 4, dims,
+                                        rstrides, NULL));
+  mu_assert_int_eq(0, dlite_type_ndcast(3, d2, dliteFloat, 8, dims, NULL,
+                                        s + 36*5*41, dliteInt, 4, dims,
+                                        rstrides, generic_cast));
+  mu_check(memcmp(d1, d2, N * sizeof(double)) == 0);
+  mu_assert_double_eq(s[36*5*41], d1[0]);
+
+  /* Casting negative numbers to unsigned still fails */
+  dlite_err_set_stream(NULL);
+  mu_check(dlite_type_ndcast(3, u, dliteUInt, 4, dims, NULL,
+                             s, dliteInt, 4, dims, NULL, NULL));
+  dlite_err_set_stream(stderr);
+
+  free(s);
+  free(d1);
+  free(d2);
+  free(f1);
+  free(f2);
+  free(u);
+}
+
+
 
 /***********************************************************************/
 
@@ -819,6 +1036,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_copy);
   MU_RUN_TEST(test_clear);
   MU_RUN_TEST(test_print);
+  MU_RUN_TEST(test_print_float);
   MU_RUN_TEST(test_scan);
   MU_RUN_TEST(test_update_sha3);
   MU_RUN_TEST(test_get_alignment);
@@ -826,6 +1044,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_get_member_offset);
   MU_RUN_TEST(test_copy_cast);
   MU_RUN_TEST(test_type_ndcast);
+  MU_RUN_TEST(test_type_ndcast_kernels);
 }
 
 
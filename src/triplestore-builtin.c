@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "utils/err.h"
@@ -41,9 +42,35 @@
 /* Prototype for cleanup-function */
 typedef void (*Freer)(void *ptr);
 
+/* The role of a term in a triple. */
+enum { SUBJ=0, PRED=1, OBJ=2, NROLES=3 };
+
+/* An interned string.
+
+   For each role, `idx` lists the indices of the triples that refers
+   to this string in that role.  Together the lists for all terms
+   make up the subject (SPO), predicate (POS) and object (OSP) indices
+   of the store. */
+typedef struct {
+  char *str;              /*!< the interned string */
+  size_t refcount;        /*!< number of triple terms referring to `str` */
+  size_t *idx[NROLES];    /*!< triple indices, one list per role */
+  size_t len[NROLES];     /*!< number of indices in each list */
+  size_t size[NROLES];    /*!< allocated length of each list */
+} Term;
+
+/* Index information for a stored triple. */
+typedef struct {
+  Term *term[NROLES];     /*!< interned subject, predicate and object */
+  size_t pos[NROLES];     /*!< position of the triple in term[r]->idx[r] */
+} TripleIndex;
+
+typedef map_t(Term *) map_term_t;
+
 /* Triple store. */
 struct _TripleStore {
   Triple *triples;    /*!< array of triples */
+  TripleIndex *index; /*!< index information, parallel to `triples` */
   size_t length;      /*!< logically number of triples (excluding pending
                            removes */
   size_t true_length; /*!< number of triples (including pending removes) */
@@ -51,6 +78,7 @@ struct _TripleStore {
 
   map_int_t map;      /*!< a mapping from triple id to its corresponding
                            index in `triples` */
+  map_term_t terms;   /*!< a mapping from string to interned term */
   size_t niter;       /*!< counter for number of running iterators */
   int freed;          /*!< set to non-zero when this store is supposed to
                            be freed, but kept alive due to existing iterators */
@@ -58,6 +86,196 @@ struct _TripleStore {
 };
 
 
+/* Returns the interned term for `s` with its reference count increased
+   or NULL on error. */
+static Term *_term_intern(TripleStore *ts, const char *s)
+{
+  Term **p, *term;
+  if ((p = map_get_(&ts->terms.base, s))) {
+    (*p)->refcount++;
+    return *p;
+  }
+  if (!(term = calloc(1, sizeof(Term))))
+    return err(dliteMemoryError, "allocation failure"), NULL;
+  if (!(term->str = strdup(s)) || map_set(&ts->terms, s, term)) {
+    if (term->str) free(term->str);
+    free(term);
+    return err(dliteMemoryError, "allocation failure"), NULL;
+  }
+  term->refcount = 1;
+  return term;
+}
+
+/* Decrease the reference count of `term` and free it when it is no
+   longer referred to. */
+static void _term_release(TripleStore *ts, Term *term)
+{
+  int r;
+  assert(term->refcount > 0);
+  if (--term->refcount) return;
+  map_remove(&ts->terms, term->str);
+  for (r=0; r<NROLES; r++)
+    if (term->idx[r]) free(term->idx[r]);
+  free(term->str);
+  free(term);
+}
+
+/* Returns the interned term for `s` or NULL if `s` is not in the store. */
+static Term *_term_lookup(const TripleStore *ts, const char *s)
+{
+  Term **p = map_get_(&ts->terms.base, s);
+  return (p) ? *p : NULL;
+}
+
+/* Removes triple number `n` from the index list of role `r` of its
+   term and releases the term. */
+static void _index_unlink(TripleStore *ts, size_t n, int r)
+{
+  TripleIndex *ti = ts->index + n;
+  Term *term = ti->term[r];
+  size_t pos = ti->pos[r], last = term->idx[r][--term->len[r]];
+  if (pos < term->len[r]) {
+    term->idx[r][pos] = last;
+    ts->index[last].pos[r] = pos;
+  }
+  ti->term[r] = NULL;
+  _term_release(ts, term);
+}
+
+/* Interns `s`, `p` and `o` and adds triple number `n` to the indices.
+   On success, the s-p-o pointers of the triple are set to the interned
+   strings.  Returns non-zero on error. */
+static int _index_add(TripleStore *ts, size_t n, const char *s,
+                      const char *p, const char *o)
+{
+  const char *strs[NROLES] = {s, p, o};
+  TripleIndex *ti = ts->index + n;
+  Triple *t = ts->triples + n;
+  int r;
+  for (r=0; r<NROLES; r++) {
+    Term *term;
+    if (!(term = _term_intern(ts, strs[r]))) goto fail;
+    if (term->len[r] >= term->size[r]) {
+      size_t size = (term->size[r]) ? 2*term->size[r] : 4;
+      size_t *ptr = realloc(term->idx[r], size*sizeof(size_t));
+      if (!ptr) {
+        _term_release(ts, term);
+        err(dliteMemoryError, "allocation failure");
+        goto fail;
+      }
+      term->idx[r] = ptr;
+      term->size[r] = size;
+    }
+    ti->pos[r] = term->len[r];
+    term->idx[r][term->len[r]++] = n;
+    ti->term[r] = term;
+  }
+  t->s = ti->term[SUBJ]->str;
+  t->p = ti->term[PRED]->str;
+  t->o = ti->term[OBJ]->str;
+  return 0;
+ fail:
+  while (--r >= 0) _index_unlink(ts, n, r);
+  return 1;
+}
+
+/* Moves triple number `src` to the unused slot `dest`, keeping the id
+   map and the indices consistent. */
+static void _move(TripleStore *ts, size_t src, size_t dest)
+{
+  TripleIndex *ti = ts->index + dest;
+  int r;
+  memcpy(ts->triples + dest, ts->triples + src, sizeof(Triple));
+  memcpy(ti, ts->index + src, sizeof(TripleIndex));
+  for (r=0; r<NROLES; r++)
+    ti->term[r]->idx[r][ti->pos[r]] = dest;
+  if (ts->triples[dest].id) map_set(&ts->map, ts->triples[dest].id, dest);
+}
+
+/* Releases triple number `n` and fills the hole with the last triple.
+   The id of the triple must already have been removed from the id map. */
+static void _discard(TripleStore *ts, size_t n)
+{
+  Triple *t = ts->triples + n;
+  size_t last = ts->true_length - 1;
+  int r;
+  assert(n < ts->true_length);
+  for (r=0; r<NROLES; r++) _index_unlink(ts, n, r);
+  if (t->d) free(t->d);
+  if (t->id) free(t->id);
+  if (n < last) _move(ts, last, n);
+  memset(ts->triples + last, 0, sizeof(Triple));
+  memset(ts->index + last, 0, sizeof(TripleIndex));
+  ts->true_length--;
+}
+
+/* Reallocates the triples and index arrays to `size`.
+
+   Both arrays are allocated before any of them is replaced, such that
+   `ts` is left unchanged on allocation failure.
+   Returns non-zero on error. */
+static int _resize(TripleStore *ts, size_t size)
+{
+  Triple *triples;
+  TripleIndex *index;
+  assert(size >= ts->true_length);
+  if (!(triples = calloc(size, sizeof(Triple))))
+    return err(dliteMemoryError, "allocation failure");
+  if (!(index = calloc(size, sizeof(TripleIndex)))) {
+    free(triples);
+    return err(dliteMemoryError, "allocation failure");
+  }
+  if (ts->true_length) {
+    memcpy(triples, ts->triples, ts->true_length*sizeof(Triple));
+    memcpy(index, ts->index, ts->true_length*sizeof(TripleIndex));
+  }
+  if (ts->triples) free(ts->triples);
+  if (ts->index) free(ts->index);
+  ts->triples = triples;
+  ts->index = index;
+  ts->size = size;
+  return 0;
+}
+
+/* Looks up the interned terms for `s`, `p` and `o` and stores them in
+   `terms`.  NULL strings gives NULL terms.
+
+   Returns the role of the bound term with the shortest index list,
+   NROLES if no terms are bound or -1 if any of the bound strings is
+   not in the store (i.e. nothing can match). */
+static int _lookup(const TripleStore *ts, const char *s, const char *p,
+                   const char *o, Term **terms)
+{
+  const char *strs[NROLES] = {s, p, o};
+  int r, role=NROLES;
+  for (r=0; r<NROLES; r++) {
+    terms[r] = NULL;
+    if (!strs[r]) continue;
+    if (!(terms[r] = _term_lookup(ts, strs[r]))) return -1;
+    if (role == NROLES || terms[r]->len[r] < terms[role]->len[role])
+      role = r;
+  }
+  return role;
+}
+
+/* Returns non-zero if triple number `n` is not removed and matches
+   `terms` and datatype `d`.  If `iri` is non-zero, an empty `d` matches
+   non-literal objects. */
+static int _match(const TripleStore *ts, size_t n, Term **terms,
+                  const char *d, int iri)
+{
+  const Triple *t = ts->triples + n;
+  const TripleIndex *ti = ts->index + n;
+  int r;
+  if (!t->id) return 0;
+  for (r=0; r<NROLES; r++)
+    if (terms[r] && terms[r] != ti->term[r]) return 0;
+  if (!d) return 1;
+  if (iri && !d[0]) return !t->d;
+  return t->d && strcmp(d, t->d) == 0;
+}
+
+
 /*
   Returns a new empty triplestore or NULL on error.
  */
@@ -132,20 +350,13 @@ int triplestore_add_triples(TripleStore *ts, const Triple *triples,
   /* make space for new triples */
   if (ts->size < ts->true_length + n) {
     size_t m = (ts->true_length + n - ts->size) / TRIPLESTORE_CHUNKSIZE;
-    size_t size = ts->size + (m + 1) * TRIPLESTORE_CHUNKSIZE;
-    void *ptr;
-    assert(size >= ts->true_length + n);
-    if (!(ptr = realloc(ts->triples, size * sizeof(Triple))))
-      return err(dliteMemoryError, "allocation failure");
-    ts->triples = ptr;
-    ts->size = size;
-    memset(ts->triples + ts->true_length, 0,
-           (ts->size - ts->true_length)*sizeof(Triple));
+    if (_resize(ts, ts->size + (m + 1) * TRIPLESTORE_CHUNKSIZE)) return 1;
   }
 
   /* append triples (avoid duplicates) */
   for (i=0; i<n; i++) {
-    Triple *t = ts->triples + ts->true_length;
+    size_t k = ts->true_length;
+    Triple *t = ts->triples + k;
     char *id;
     if (triples[i].id) {
       if (!(id = strdup(triples[i].id))) return err(1, "allocation error");
@@ -155,18 +366,29 @@ int triplestore_add_triples(TripleStore *ts, const Triple *triples,
 
         return 1;
     }
-    if (!map_get(&ts->map, id)) {
-      if (!(t->s = strdup(triples[i].s))) return err(1, "allocation error");
-      if (!(t->p = strdup(triples[i].p))) return err(1, "allocation error");
-      if (!(t->o = strdup(triples[i].o))) return err(1, "allocation error");
-      t->d = (triples[i].d) ? strdup(triples[i].d) : NULL;
+    if (map_get(&ts->map, id)) {
+      free(id);
+      continue;
+    }
+    if (triples[i].d && !(t->d = strdup(triples[i].d))) {
+      free(id);
+      return err(1, "allocation error");
+    }
+    if (_index_add(ts, k, triples[i].s, triples[i].p, triples[i].o)) {
+      if (t->d) free(t->d);
+      memset(t, 0, sizeof(Triple));
+      free(id);
+      return 1;
+    }
+    if (map_set(&ts->map, id, k)) {
       t->id = id;
-      ts->length++;
       ts->true_length++;
-      map_set(&ts->map, id, i);
-    } else {
-      free(id);
+      _discard(ts, k);
+      return err(1, "cannot add triple to store");
     }
+    t->id = id;
+    ts->length++;
+    ts->true_length++;
   }
 
   return 0;
@@ -184,18 +406,17 @@ static int _remove_by_index(TripleStore *ts, size_t n)
   map_remove(&ts->map, t->id);
 
   if (ts->niter) {
-    /* running iterator, mark triple for deletion by setting id to NULL */
+    /* running iterator, mark triple for deletion by setting id to NULL.
+       It is kept in the indices until triplestore_deinit_state()
+       compacts the store. */
     free(t->id);
     t->id = NULL;
     ts->length--;
   } else {
     /* no running iterators, remove triple */
     assert(ts->length == ts->true_length);
-    triple_clean(t);
+    _discard(ts, n);
     ts->length--;
-    if (t < ts->triples + ts->length)
-      memcpy(t, &ts->triples[ts->length], sizeof(Triple));
-    ts->true_length = ts->length;
   }
   return 0;
 }
@@ -221,16 +442,25 @@ int triplestore_remove_by_id(TripleStore *ts, const char *id)
 int triplestore_remove(TripleStore *ts, const char *s, const char *p,
                        const char *o, const char *d)
 {
-  int i=ts->true_length, n=0;
-  while (--i >= 0) {
-    const Triple *t = ts->triples + i;
-    if (!t->id) continue;
-    if ((!s || strcmp(s, t->s) == 0) &&
-        (!p || strcmp(p, t->p) == 0) &&
-        (!o || strcmp(o, t->o) == 0) &&
-        (!d || (t->d && strcmp(d, t->d) == 0))) {
-      if (_remove_by_index(ts, i) == 0) n++;
+  Term *terms[NROLES];
+  int n=0, role=_lookup(ts, s, p, o, terms);
+  if (role < 0) return 0;
+  if (role == NROLES) {
+    size_t i = ts->true_length;
+    while (i-- > 0)
+      if (_match(ts, i, terms, d, 0) && _remove_by_index(ts, i) == 0) n++;
+  } else {
+    /* Iterate backward over the index list, such that entries moved
+       into the hole of a removed entry already have been visited.
+       Hold a reference to the term to keep it alive while iterating. */
+    Term *term = terms[role];
+    size_t k = term->len[role];
+    term->refcount++;
+    while (k-- > 0) {
+      size_t i = term->idx[role][k];
+      if (_match(ts, i, terms, d, 0) && _remove_by_index(ts, i) == 0) n++;
     }
+    _term_release(ts, term);
   }
   return n;
 }
@@ -242,15 +472,30 @@ int triplestore_remove(TripleStore *ts, const char *s, const char *p,
  */
 void triplestore_clear(TripleStore *ts)
 {
-  int n=ts->true_length;
-  int niter=ts->niter;
-  while (--n >= 0)
-    if (ts->triples[n].id) _remove_by_index(ts, n);
+  size_t i, niter=ts->niter;
+  const char *key;
+  map_iter_t iter;
+  for (i=0; i<ts->true_length; i++) {
+    Triple *t = ts->triples + i;
+    if (t->d) free(t->d);
+    if (t->id) free(t->id);
+  }
+  iter = map_iter(&ts->terms);
+  while ((key = map_next(&ts->terms, &iter))) {
+    Term *term = *(Term **)map_get_(&ts->terms.base, key);
+    int r;
+    for (r=0; r<NROLES; r++)
+      if (term->idx[r]) free(term->idx[r]);
+    free(term->str);
+    free(term);
+  }
   if (ts->triples) free(ts->triples);
+  if (ts->index) free(ts->index);
   map_deinit(&ts->map);
+  map_deinit(&ts->terms);
+  if (ts->ns) free((char *)ts->ns);
   memset(ts, 0, sizeof(TripleStore));
   ts->niter = niter;
-  if (ts->ns) free((char *)ts->ns);
 }
 
 
@@ -276,15 +521,18 @@ const Triple *triplestore_find_first(const TripleStore *ts, const char *s,
                                      const char *p, const char *o,
                                      const char *d)
 {
+  Term *terms[NROLES];
+  int role = _lookup(ts, s, p, o, terms);
   size_t i;
-  for (i=0; i<ts->true_length; i++) {
-    const Triple *t = ts->triples + i;
-    if (t->id &&
-        (!s || strcmp(s, t->s) == 0) &&
-        (!p || strcmp(p, t->p) == 0) &&
-        (!o || strcmp(o, t->o) == 0) &&
-        (!d || (t->d && strcmp(d, t->d) == 0)))
-      return t;
+  if (role < 0) return NULL;
+  if (role == NROLES) {
+    for (i=0; i<ts->true_length; i++)
+      if (_match(ts, i, terms, d, 0)) return ts->triples + i;
+  } else {
+    const Term *term = terms[role];
+    for (i=0; i<term->len[role]; i++)
+      if (_match(ts, term->idx[role][i], terms, d, 0))
+        return ts->triples + term->idx[role][i];
   }
   return NULL;
 }
@@ -299,6 +547,7 @@ void triplestore_init_state(TripleStore *ts, TripleState *state)
   state->ts = ts;
   ts->niter++;
   state->pos = 0;
+  state->data = NULL;
 }
 
 
@@ -308,7 +557,7 @@ void triplestore_init_state(TripleStore *ts, TripleState *state)
 void triplestore_deinit_state(TripleState *state)
 {
   TripleStore *ts = state->ts;
-  int i;
+  size_t i;
   assert(ts->niter > 0 /* must match triplestore_init_state() */);
   ts->niter--;
 
@@ -318,23 +567,17 @@ void triplestore_deinit_state(TripleState *state)
     return;
   }
 
+  /* Compact the store by discarding triples marked for deletion.
+     Iterate backward, such that triples moved into the holes already
+     have been visited. */
   if (ts->niter == 0 && ts->true_length > ts->length) {
-    for (i=ts->true_length-1; i>=0 && !ts->triples[i].id; i--)
-      ts->true_length--;
-    for (i=ts->true_length-1; i>=0; i--) {
-      Triple *t = ts->triples + i;
-      if (!t->id) {
-        Triple *tt = ts->triples + (--ts->true_length);
-        assert(t < tt);
-        triple_clean(t);
-        memcpy(t, tt, sizeof(Triple));
-      }
-    }
+    i = ts->true_length;
+    while (i-- > 0)
+      if (!ts->triples[i].id) _discard(ts, i);
     assert(ts->true_length == ts->length);
-    if (ts->size > ts->length + TRIPLESTORE_CHUNKSIZE) {
-      ts->size = ts->length + ts->length % TRIPLESTORE_CHUNKSIZE;
-      ts->triples = realloc(ts->triples, ts->size*sizeof(Triple));
-    }
+    if (ts->size > ts->length + TRIPLESTORE_CHUNKSIZE)
+      _resize(ts, (ts->length / TRIPLESTORE_CHUNKSIZE + 1) *
+              TRIPLESTORE_CHUNKSIZE);
   }
 }
 
@@ -345,6 +588,7 @@ void triplestore_deinit_state(TripleState *state)
 void triplestore_reset_state(TripleState *state)
 {
   state->pos = 0;
+  state->data = NULL;
 }
 
 
@@ -403,14 +647,28 @@ const Triple *triplestore_find(TripleState *state,
                                const char *d)
 {
   TripleStore *ts = state->ts;
-  while (state->pos < ts->true_length) {
-    const Triple *t = ts->triples + state->pos++;
-    if (t->id &&
-        (!s || strcmp(s, t->s) == 0) &&
-        (!p || strcmp(p, t->p) == 0) &&
-        (!o || strcmp(o, t->o) == 0) &&
-        (!d || (!d[0] && !t->d) || (t->d && strcmp(d, t->d) == 0)))
-      return t;
+  Term *terms[NROLES], *term;
+  int role = _lookup(ts, s, p, o, terms);
+  if (role < 0) return NULL;
+
+  /* The role of the index list to iterate over is chosen at the first
+     call and stored (plus one) in `state->data`, such that `state->pos`
+     stays valid if the lengths of the lists change between calls. */
+  if (state->data)
+    role = (int)(intptr_t)state->data - 1;
+  else
+    state->data = (void *)(intptr_t)(role + 1);
+
+  if (role == NROLES) {
+    while (state->pos < ts->true_length) {
+      size_t i = state->pos++;
+      if (_match(ts, i, terms, d, 1)) return ts->triples + i;
+    }
+  } else if ((term = terms[role])) {
+    while (state->pos < term->len[role]) {
+      size_t i = term->idx[role][state->pos++];
+      if (_match(ts, i, terms, d, 1)) return ts->triples + i;
+    }
   }
   return NULL;
 }
@@ -1,5 +1,6 @@
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "err.h"
@@ -401,9 +402,9 @@ int bson_end_subdoc(unsigned char *doc, int bufsize, BsonType type)
 int bson_begin_binary(unsigned char *doc, int bufsize, const char *ename,
                       unsigned char **subdoc)
 {
-  int docsize=bson_docsize(doc), elen=strlen(ename), esize=elen+6;
-  if ((docsize) < 0) return docsize;
+  int docsize, elen=strlen(ename), esize=elen+6;
   if (bufsize < esize) return esize;
+  if ((docsize = bson_docsize(doc)) < 0) return docsize;
   if (doc[docsize-1]) return errx(bsonInconsistentDataError,
                                   "expect BSON document to end with NUL");
 
@@ -474,6 +475,304 @@ int bson_end_binary(unsigned char *doc, int bufsize)
 }
 
 
+/********************************************************************
+ * Single-pass writer
+ ********************************************************************/
+
+/* Initialise writer `w` that writes to memory. */
+void bson_writer_init(BsonWriter *w)
+{
+  memset(w, 0, sizeof(BsonWriter));
+}
+
+/* Initialise writer `w` that writes completed documents to `fp`. */
+void bson_writer_init_stream(BsonWriter *w, FILE *fp)
+{
+  bson_writer_init(w);
+  w->fp = fp;
+}
+
+/* Initialise writer `w` that passes completed documents to `fun`. */
+void bson_writer_init_callback(BsonWriter *w, BsonWriteFun fun, void *ctx)
+{
+  bson_writer_init(w);
+  w->fun = fun;
+  w->ctx = ctx;
+}
+
+/* Free internal buffer of writer `w`. */
+void bson_writer_deinit(BsonWriter *w)
+{
+  if (w->buf) free(w->buf);
+  memset(w, 0, sizeof(BsonWriter));
+}
+
+/* Like bson_writer_deinit(), but returns the internal buffer. */
+unsigned char *bson_writer_steal(BsonWriter *w, size_t *size)
+{
+  unsigned char *buf = w->buf;
+  if (size) *size = w->pos;
+  memset(w, 0, sizeof(BsonWriter));
+  return buf;
+}
+
+/* Return a pointer to the content of the internal buffer. */
+const unsigned char *bson_writer_get(const BsonWriter *w, size_t *size)
+{
+  if (size) *size = w->pos;
+  return w->buf;
+}
+
+/* Make room for `n` more bytes in the buffer of `w`.
+   Returns non-zero on error. */
+static int writer_reserve(BsonWriter *w, size_t n)
+{
+  if (w->pos + n > w->size) {
+    size_t size = (w->size) ? w->size : 256;
+    unsigned char *buf;
+    while (size < w->pos + n) size *= 2;
+    if (!(buf = realloc(w->buf, size)))
+      return errx(bsonMemoryError, "allocation failure");
+    w->buf = buf;
+    w->size = size;
+  }
+  return 0;
+}
+
+/* Ensure that at least `n` more bytes can be written to `w`. */
+int bson_writer_reserve(BsonWriter *w, size_t n)
+{
+  if (w->pos + n > w->size) {
+    unsigned char *buf;
+    if (!(buf = realloc(w->buf, w->pos + n)))
+      return errx(bsonMemoryError, "allocation failure");
+    w->buf = buf;
+    w->size = w->pos + n;
+  }
+  return 0;
+}
+
+/* Write int32 `v` in little endian at position `pos`. */
+static void writer_put_int32(BsonWriter *w, size_t pos, int32_t v)
+{
+  uint32_t le = htole32((uint32_t)v);
+  memcpy(w->buf + pos, &le, 4);
+}
+
+/* Write element type and name.  `datasize` is the number of bytes that
+   will follow.  Returns non-zero on error. */
+static int writer_head(BsonWriter *w, BsonType type, const char *ename,
+                       size_t datasize)
+{
+  size_t elen = strlen(ename);
+  int stat;
+  if (w->depth < 1)
+    return errx(bsonValueError, "no open bson document");
+  if (w->binpos)
+    return errx(bsonValueError, "bson binary element is not ended");
+  if ((stat = writer_reserve(w, 1 + elen + 1 + datasize))) return stat;
+  w->buf[w->pos++] = type;
+  memcpy(w->buf + w->pos, ename, elen + 1);
+  w->pos += elen + 1;
+  return 0;
+}
+
+/* Push a new document to `w`. */
+static int writer_push(BsonWriter *w)
+{
+  int stat;
+  if (w->depth >= BSON_WRITER_MAXDEPTH)
+    return errx(bsonValueError, "bson documents nested deeper than %d",
+                BSON_WRITER_MAXDEPTH);
+  if ((stat = writer_reserve(w, 5))) return stat;
+  w->stack[w->depth++] = w->pos;
+  w->pos += 4;
+  return 0;
+}
+
+/* Terminate the innermost document of `w` and write its size. */
+static int writer_pop(BsonWriter *w)
+{
+  size_t start, docsize;
+  int stat;
+  if (w->binpos)
+    return errx(bsonValueError, "bson binary element is not ended");
+  if ((stat = writer_reserve(w, 1))) return stat;
+  w->buf[w->pos++] = '\x00';
+  start = w->stack[--w->depth];
+  docsize = w->pos - start;
+  if (docsize > INT32_MAX)
+    return errx(bsonOverflowError, "bson document exceeds 2 GB: %lu bytes",
+                (unsigned long)docsize);
+  writer_put_int32(w, start, (int32_t)docsize);
+  return 0;
+}
+
+/* Begin a new top-level document. */
+int bson_writer_begin_document(BsonWriter *w)
+{
+  if (w->depth)
+    return errx(bsonValueError,
+                "cannot begin new bson document before the current is ended");
+  return writer_push(w);
+}
+
+/* End top-level document. */
+int bson_writer_end_document(BsonWriter *w)
+{
+  int stat;
+  if (w->depth != 1)
+    return errx(bsonValueError, "expected %d more call(s) to "
+                "bson_writer_end_subdoc()", w->depth - 1);
+  if ((stat = writer_pop(w))) return stat;
+
+  if (w->fp) {
+    if (fwrite(w->buf, 1, w->pos, w->fp) != w->pos)
+      return errx(bsonIOError, "error writing bson document to stream");
+  } else if (w->fun) {
+    if (w->fun(w->buf, w->pos, w->ctx))
+      return errx(bsonIOError, "error writing bson document to callback");
+  } else {
+    return 0;
+  }
+  w->nwritten += w->pos;
+  w->pos = 0;
+  return 0;
+}
+
+/* Appends an element to the current document. */
+int bson_writer_append(BsonWriter *w, BsonType type, const char *ename,
+                       int64_t size, const void *data)
+{
+  int stat, expected_size = bson_datasize(type);
+  if (size < 0)
+    size = (type == bsonString) ? (int64_t)strlen(data) : expected_size;
+  if (size < 0)
+    return errx(bsonValueError,
+                "positive `size` must be provided for bson type '%s'",
+                bson_typename(type));
+  if (expected_size >= 0 && size != expected_size)
+    return errx(bsonValueError,
+                "expected bson type %c to be %d bytes, got %d",
+                type, expected_size, (int)size);
+  if (size > INT32_MAX - 6)
+    return errx(bsonOverflowError, "bson element '%s' exceeds 2 GB", ename);
+  if ((stat = writer_head(w, type, ename, (size_t)size + 6))) return stat;
+
+  switch (type) {
+  case bsonInt32:
+    {
+      uint32_t v = htole32(*((const uint32_t *)data));
+      memcpy(w->buf + w->pos, &v, 4);
+    }
+    break;
+#ifdef HAVE_INT64
+  case bsonUInt64:
+  case bsonInt64:
+#endif
+  case bsonDouble:
+    {
+      uint64_t v;
+      memcpy(&v, data, 8);
+      v = htole64(v);
+      memcpy(w->buf + w->pos, &v, 8);
+    }
+    break;
+#if defined(HAVE_FLOAT128) && defined(HAVE_BSWAP128)
+  case bsonDecimal128:
+    {
+      uint128_t v;
+      memcpy(&v, data, 16);
+      v = htole128(v);
+      memcpy(w->buf + w->pos, &v, 16);
+    }
+    break;
+#endif
+  case bsonDocument:
+  case bsonArray:
+    if (size) memcpy(w->buf + w->pos, data, size);
+    break;
+  case bsonString:
+    writer_put_int32(w, w->pos, (int32_t)size + 1);
+    w->pos += 4;
+    memcpy(w->buf + w->pos, data, size);
+    w->buf[w->pos + size] = '\x00';
+    w->pos++;
+    break;
+  case bsonBinary:
+    writer_put_int32(w, w->pos, (int32_t)size);
+    w->pos += 4;
+    w->buf[w->pos++] = '\x00';  /* subtype */
+    if (size) memcpy(w->buf + w->pos, data, size);
+    break;
+  case bsonBool:
+    w->buf[w->pos] = (*((const bool *)data)) ? '\x01' : '\x00';
+    break;
+  default:
+    break;
+  }
+  w->pos += size;
+  return 0;
+}
+
+/* Begin a sub-document or array. */
+int bson_writer_begin_subdoc(BsonWriter *w, const char *ename,
+                             BsonType type)
+{
+  int stat;
+  if (type != bsonDocument && type != bsonArray)
+    return errx(bsonValueError, "sub-document type must be bsonDocument "
+                "or bsonArray: %d", type);
+  if ((stat = writer_head(w, type, ename, 5))) return stat;
+  return writer_push(w);
+}
+
+/* End sub-document started with bson_writer_begin_subdoc(). */
+int bson_writer_end_subdoc(BsonWriter *w)
+{
+  if (w->depth < 2)
+    return errx(bsonValueError, "no open bson sub-document");
+  return writer_pop(w);
+}
+
+/* Begin binary element. */
+int bson_writer_begin_binary(BsonWriter *w, const char *ename)
+{
+  int stat;
+  if ((stat = writer_head(w, bsonBinary, ename, 5))) return stat;
+  w->binpos = w->pos;
+  w->pos += 4;
+  w->buf[w->pos++] = '\x00';  /* subtype */
+  return 0;
+}
+
+/* Append data to binary element started with bson_writer_begin_binary(). */
+int bson_writer_append_binary(BsonWriter *w, size_t size, const void *data)
+{
+  int stat;
+  if (!w->binpos)
+    return errx(bsonValueError, "no open bson binary element");
+  if ((stat = writer_reserve(w, size))) return stat;
+  memcpy(w->buf + w->pos, data, size);
+  w->pos += size;
+  return 0;
+}
+
+/* End binary element started with bson_writer_begin_binary(). */
+int bson_writer_end_binary(BsonWriter *w)
+{
+  size_t size;
+  if (!w->binpos)
+    return errx(bsonValueError, "no open bson binary element");
+  size = w->pos - w->binpos - 5;
+  if (size > INT32_MAX)
+    return errx(bsonOverflowError, "bson binary element exceeds 2 GB");
+  writer_put_int32(w, w->binpos, (int32_t)size);
+  w->binpos = 0;
+  return 0;
+}
+
+
 /*
   Parses next element in a BSON document.
 
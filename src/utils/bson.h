@@ -7,6 +7,8 @@
 
   Currently, this only implements a subset of BSON.
 */
+#include <stdio.h>
+
 #include "boolean.h"
 #include "integers.h"
 #include "floats.h"
@@ -33,8 +35,11 @@ typedef enum {
 
 /** Error codes (matching dlite) */
 typedef enum {
+  bsonIOError=-2,                /*!< File input/output error */
   bsonTypeError=-5,              /*!< Inappropriate argument or function type */
+  bsonOverflowError=-7,          /*!< Document too large */
   bsonValueError=-9,             /*!< Inappropriate argument value */
+  bsonMemoryError=-12,           /*!< Out of memory */
   bsonKeyError=-14,              /*!< BSON key (ename) not found */
   bsonParseError=-15,            /*!< Cannot parse input */
   bsonInconsistentDataError=-18  /*!< Inconsistent data */
@@ -235,6 +240,161 @@ int bson_end_binary(unsigned char *doc, int bufsize);
 
 
 
+/** @} */
+/**
+ * @name Single-pass writer
+ *
+ * The functions above work on a fixed-size buffer and must be called
+ * twice if the size of the document is not known in advance; first
+ * to compute the size and then to write the document.  The writer
+ * below builds the document in a single pass in a growable buffer.
+ *
+ * Since BSON starts each (sub-)document with its size, a document is
+ * always completed in the buffer.  A writer created with
+ * bson_writer_init_stream() or bson_writer_init_callback() passes
+ * each top-level document on to the stream or callback when it is
+ * ended and reuses the buffer, so memory usage is bounded by the
+ * largest document written.
+ *
+ * Example:
+ *
+ *     BsonWriter w;
+ *     bson_writer_init(&w);
+ *     bson_writer_begin_document(&w);
+ *     bson_writer_append(&w, bsonString, "hello", -1, "world");
+ *     bson_writer_begin_subdoc(&w, "subdoc", bsonDocument);
+ *     ...
+ *     bson_writer_end_subdoc(&w);
+ *     bson_writer_end_document(&w);
+ *     doc = bson_writer_steal(&w, &size);
+ */
+/** @{ */
+
+/** Maximum nesting depth of documents created with BsonWriter. */
+#define BSON_WRITER_MAXDEPTH 32
+
+/**
+  Callback used by BsonWriter to write `size` bytes of `data`.
+  `ctx` is the context given to bson_writer_init_callback().
+  Should return non-zero on error.
+*/
+typedef int (*BsonWriteFun)(const unsigned char *data, size_t size,
+                            void *ctx);
+
+/** Single-pass BSON writer. */
+typedef struct _BsonWriter {
+  unsigned char *buf;   /*!< output buffer */
+  size_t size;          /*!< allocated size of buffer */
+  size_t pos;           /*!< current position */
+  size_t nwritten;      /*!< number of bytes passed to stream or callback */
+  size_t stack[BSON_WRITER_MAXDEPTH];  /*!< start of open documents */
+  int depth;            /*!< number of open documents */
+  size_t binpos;        /*!< start of open binary element, or zero */
+  FILE *fp;             /*!< output stream or NULL */
+  BsonWriteFun fun;     /*!< output callback or NULL */
+  void *ctx;            /*!< context passed to `fun` */
+} BsonWriter;
+
+
+/** Initialise writer `w` that writes to memory. */
+void bson_writer_init(BsonWriter *w);
+
+/** Initialise writer `w` that writes completed documents to `fp`. */
+void bson_writer_init_stream(BsonWriter *w, FILE *fp);
+
+/** Initialise writer `w` that passes completed documents to `fun`. */
+void bson_writer_init_callback(BsonWriter *w, BsonWriteFun fun, void *ctx);
+
+/** Free internal buffer of writer `w`. */
+void bson_writer_deinit(BsonWriter *w);
+
+/**
+  Like bson_writer_deinit(), but instead of freeing the internal
+  buffer, it is returned.  If `size` is not NULL, it is assigned to
+  the number of bytes in the returned buffer.  The caller becomes
+  the owner of the returned buffer.
+*/
+unsigned char *bson_writer_steal(BsonWriter *w, size_t *size);
+
+/**
+  Return a pointer to the content of the internal buffer.  If `size`
+  is not NULL, it is assigned to the number of bytes in the buffer.
+*/
+const unsigned char *bson_writer_get(const BsonWriter *w, size_t *size);
+
+/**
+  Ensure that at least `n` more bytes can be written to `w` without
+  reallocating its buffer.  Use this if the size of the document can
+  be estimated in advance.
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_reserve(BsonWriter *w, size_t n);
+
+/**
+  Begin a new top-level document.
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_begin_document(BsonWriter *w);
+
+/**
+  End top-level document.  For a writer initialised with
+  bson_writer_init_stream() or bson_writer_init_callback(), the
+  document is written to the stream or callback.
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_end_document(BsonWriter *w);
+
+/**
+  Appends an element to the current document.
+
+  Arguments:
+    - w: BSON writer.
+    - type: BSON type of data to append.
+    - ename: Element name (NUL-terminated string).
+    - size: Size of data to append (in bytes).  May be negative for
+        fixed-sized types and strings.
+    - data: Pointer to data to append.
+
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_append(BsonWriter *w, BsonType type, const char *ename,
+                       int64_t size, const void *data);
+
+/**
+  Begin a sub-document or array (if `type` is `bsonArray`) with name
+  `ename` in the current document.
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_begin_subdoc(BsonWriter *w, const char *ename,
+                             BsonType type);
+
+/**
+  End sub-document started with bson_writer_begin_subdoc().
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_end_subdoc(BsonWriter *w);
+
+/**
+  Begin binary element with name `ename`.  Its content is added
+  with bson_writer_append_binary().
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_begin_binary(BsonWriter *w, const char *ename);
+
+/**
+  Append `size` bytes of `data` to the binary element started with
+  bson_writer_begin_binary().
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_append_binary(BsonWriter *w, size_t size, const void *data);
+
+/**
+  End binary element started with bson_writer_begin_binary().
+  Returns zero on success or a negative error code on error.
+*/
+int bson_writer_end_binary(BsonWriter *w);
+
+
 /** @} */
 /**
  * @name Basic parsing a BSON document
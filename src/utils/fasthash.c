@@ -0,0 +1,191 @@
+/* fasthash.c -- fast non-cryptographic streaming hash
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#include <string.h>
+
+#include "byteorder.h"
+#include "fasthash.h"
+
+/* Number of stripes in a block.  The accumulators are scrambled
+   after each block. */
+#define NSTRIPES 16
+
+#define GOLDEN  0x9E3779B97F4A7C15ULL
+#define PRIME32 0x9E3779B1ULL
+#define PRIME64 0x165667919E3779F9ULL
+
+/* Lane keys.  The fractional parts of the square roots of the first
+   eight primes (the SHA-512 initial hash values). */
+static const uint64_t keys[8] = {
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+  0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+  0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+
+/* Returns 64-bit little-endian word at `p`. */
+static uint64_t _read64(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return le64toh(v);
+}
+
+/* Accumulates one stripe at `p`.  `k` is the stripe key offset. */
+static void _accumulate(uint64_t *acc, const unsigned char *p, uint64_t k)
+{
+  int j;
+  for (j=0; j<8; j++) {
+    uint64_t w = _read64(p + 8*j);
+    uint64_t d = w ^ (keys[j] + k);
+    acc[j ^ 1] += w;
+    acc[j] += (d & 0xffffffff) * (d >> 32);
+  }
+}
+
+/* Scrambles the accumulators at the end of a block. */
+static void _scramble(uint64_t *acc)
+{
+  int j;
+  for (j=0; j<8; j++) {
+    uint64_t a = acc[j];
+    a ^= a >> 47;
+    a ^= keys[(j + 3) & 7];
+    acc[j] = a * PRIME32;
+  }
+}
+
+/* Returns the stripe key offset of stripe number `n` within a block. */
+static uint64_t _stripe_key(const FastHash *h, unsigned n)
+{
+  return h->seed + n * GOLDEN;
+}
+
+/* Consumes the stripe at `p`. */
+static void _stripe(FastHash *h, const unsigned char *p)
+{
+  _accumulate(h->acc, p, _stripe_key(h, h->nstripes));
+  if (++h->nstripes == NSTRIPES) {
+    _scramble(h->acc);
+    h->nstripes = 0;
+  }
+}
+
+/* Returns the 128-bit product of `a` and `b` folded to 64 bits. */
+static uint64_t _mulfold(uint64_t a, uint64_t b)
+{
+  uint64_t alo = a & 0xffffffff, ahi = a >> 32;
+  uint64_t blo = b & 0xffffffff, bhi = b >> 32;
+  uint64_t lolo = alo * blo, hilo = ahi * blo;
+  uint64_t lohi = alo * bhi, hihi = ahi * bhi;
+  uint64_t cross = (lolo >> 32) + (hilo & 0xffffffff) + lohi;
+  uint64_t hi = (hilo >> 32) + (cross >> 32) + hihi;
+  uint64_t lo = (cross << 32) | (lolo & 0xffffffff);
+  return lo ^ hi;
+}
+
+/* Final mixing of a 64-bit word. */
+static uint64_t _avalanche(uint64_t h)
+{
+  h ^= h >> 37;
+  h *= PRIME64;
+  h ^= h >> 32;
+  return h;
+}
+
+
+/* Initialise hash state `h` with the given seed. */
+void fasthash_init(FastHash *h, uint64_t seed)
+{
+  int j;
+  memset(h, 0, sizeof(FastHash));
+  h->seed = seed;
+  for (j=0; j<8; j++) h->acc[j] = keys[7 - j] ^ seed;
+}
+
+/* Updates hash state `h` with `len` bytes from `data`. */
+void fasthash_update(FastHash *h, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+  h->total += len;
+
+  if (h->nbuf) {
+    size_t m = FASTHASH_STRIPE - h->nbuf;
+    if (len < m) {
+      memcpy(h->buf + h->nbuf, p, len);
+      h->nbuf += (unsigned)len;
+      return;
+    }
+    memcpy(h->buf + h->nbuf, p, m);
+    _stripe(h, h->buf);
+    h->nbuf = 0;
+    p += m;
+    len -= m;
+  }
+
+  /* Consume whole blocks without checking the stripe counter */
+  while (h->nstripes == 0 && len >= NSTRIPES*FASTHASH_STRIPE) {
+    unsigned n;
+    for (n=0; n<NSTRIPES; n++, p+=FASTHASH_STRIPE)
+      _accumulate(h->acc, p, _stripe_key(h, n));
+    _scramble(h->acc);
+    len -= NSTRIPES*FASTHASH_STRIPE;
+  }
+  for (; len >= FASTHASH_STRIPE; p+=FASTHASH_STRIPE, len-=FASTHASH_STRIPE)
+    _stripe(h, p);
+
+  if (len) {
+    memcpy(h->buf, p, len);
+    h->nbuf = (unsigned)len;
+  }
+}
+
+/*
+  Writes a digest of `size` bytes to `out`.  `size` should not exceed
+  FASTHASH_MAXSIZE; it is truncated otherwise.
+
+  The state `h` is not modified, so further updates may follow.
+*/
+void fasthash_final(const FastHash *h, void *out, size_t size)
+{
+  uint64_t acc[8];
+  unsigned char *q = out;
+  size_t m;
+  int j;
+
+  memcpy(acc, h->acc, sizeof(acc));
+  if (h->nbuf) {
+    unsigned char buf[FASTHASH_STRIPE];
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, h->buf, h->nbuf);
+    _accumulate(acc, buf, _stripe_key(h, h->nstripes));
+  }
+  _scramble(acc);
+
+  if (size > FASTHASH_MAXSIZE) size = FASTHASH_MAXSIZE;
+  for (m=0; m*8 < size; m++) {
+    uint64_t x = h->total * PRIME64 + h->seed + m * GOLDEN;
+    unsigned char word[8];
+    size_t n = (size - m*8 < 8) ? size - m*8 : 8;
+    for (j=0; j<4; j++)
+      x += _mulfold(acc[2*j] ^ keys[(2*j + m) & 7],
+                    acc[2*j+1] ^ keys[(2*j + 1 + m) & 7]);
+    x = htole64(_avalanche(x));
+    memcpy(word, &x, 8);
+    memcpy(q + m*8, word, n);
+  }
+}
+
+/* Convenience function writing a `size`-byte digest of `data` to `out`. */
+void fasthash(const void *data, size_t len, uint64_t seed,
+              void *out, size_t size)
+{
+  FastHash h;
+  fasthash_init(&h, seed);
+  fasthash_update(&h, data, len);
+  fasthash_final(&h, out, size);
+}
@@ -0,0 +1,74 @@
+/* fasthash.h -- fast non-cryptographic streaming hash
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#ifndef _FASTHASH_H
+#define _FASTHASH_H
+
+/**
+  @file
+  @brief Fast non-cryptographic streaming hash.
+
+  A multiply-accumulate hash in the spirit of XXH3.  The input is
+  consumed in 64-byte stripes by eight independent 64-bit lanes.
+  Each lane only uses 32x32->64 bit multiplications and additions,
+  such that the inner loop is easily vectorised by the compiler.
+  The stripe keys depend on the position of the stripe within a
+  block of 16 stripes and the accumulators are scrambled after each
+  block, such that the hash depends on the order of the input.
+
+  The digest may be 1 to FASTHASH_MAXSIZE bytes long.  The typical
+  size is FASTHASH_SIZE, i.e. 128 bits.
+
+  Input words are read in little-endian byte order, such that the
+  digest of a given byte sequence is platform independent.
+
+  This hash is suitable for change detection and deduplication.  It
+  must not be used where resistance against deliberate collisions is
+  needed.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Typical digest size in bytes. */
+#define FASTHASH_SIZE 16
+
+/** Maximum digest size in bytes. */
+#define FASTHASH_MAXSIZE 64
+
+/** Number of bytes consumed by the lanes in each round. */
+#define FASTHASH_STRIPE 64
+
+/** Hash state. */
+typedef struct _FastHash {
+  uint64_t acc[8];                      /*!< Lane accumulators */
+  uint64_t seed;                        /*!< Seed */
+  uint64_t total;                       /*!< Number of bytes consumed */
+  unsigned char buf[FASTHASH_STRIPE];   /*!< Buffer for partial stripes */
+  unsigned nbuf;                        /*!< Number of bytes in `buf` */
+  unsigned nstripes;                    /*!< Stripes in current block */
+} FastHash;
+
+
+/** Initialise hash state `h` with the given seed. */
+void fasthash_init(FastHash *h, uint64_t seed);
+
+/** Updates hash state `h` with `len` bytes from `data`. */
+void fasthash_update(FastHash *h, const void *data, size_t len);
+
+/**
+  Writes a digest of `size` bytes to `out`.  `size` should not exceed
+  FASTHASH_MAXSIZE; it is truncated otherwise.
+
+  The state `h` is not modified, so further updates may follow.
+*/
+void fasthash_final(const FastHash *h, void *out, size_t size);
+
+/** Convenience function writing a `size`-byte digest of `data` to `out`. */
+void fasthash(const void *data, size_t len, uint64_t seed,
+              void *out, size_t size);
+
+#endif  /* _FASTHASH_H */
@@ -102,3 +102,36 @@ int fileinfo_isreadable(const char *path)
   errno = errno_orig;
   return readable;
 }
+
+/* Stores the modification time and size of `path` in `stamp`.
+   Returns non-zero if `path` does not exist. */
+int fileinfo_stamp(const char *path, FileStamp *stamp)
+{
+#if defined(POSIX)
+  struct stat statbuf;
+  if (stat(path, &statbuf)) return 1;
+#if defined(__linux__)
+  stamp->mtime = (long long)statbuf.st_mtim.tv_sec * 1000000000LL +
+    statbuf.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+  stamp->mtime = (long long)statbuf.st_mtimespec.tv_sec * 1000000000LL +
+    statbuf.st_mtimespec.tv_nsec;
+#else
+  stamp->mtime = (long long)statbuf.st_mtime;
+#endif
+  stamp->size = (long long)statbuf.st_size;
+#elif defined(WINDOWS)
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!GetFileAttributesEx(path, GetFileExInfoStandard, &data)) return 1;
+  stamp->mtime = ((long long)data.ftLastWriteTime.dwHighDateTime << 32) |
+    data.ftLastWriteTime.dwLowDateTime;
+  stamp->size = ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#endif
+  return 0;
+}
+
+/* Returns non-zero if stamps `a` and `b` are equal. */
+int fileinfo_stamp_equal(const FileStamp *a, const FileStamp *b)
+{
+  return a->mtime == b->mtime && a->size == b->size;
+}
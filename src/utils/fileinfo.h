@@ -7,6 +7,13 @@
 #ifndef _FILEINFO_H
 #define _FILEINFO_H
 
+/** Modification stamp of a file.  Two stamps of the same file are
+    equal if the file has not been modified in between. */
+typedef struct {
+  long long mtime;  /*!< modification time (in platform-dependent units) */
+  long long size;   /*!< file size in bytes */
+} FileStamp;
+
 /** Returns non-zero if `path` exists. */
 int fileinfo_exists(const char *path);
 
@@ -19,4 +26,11 @@ int fileinfo_isnormal(const char *path);
 /** Returns non-zero if `path` is a normal file and readable. */
 int fileinfo_isreadable(const char *path);
 
+/** Stores the modification time and size of `path` in `stamp`.
+    Returns non-zero if `path` does not exist. */
+int fileinfo_stamp(const char *path, FileStamp *stamp);
+
+/** Returns non-zero if stamps `a` and `b` are equal. */
+int fileinfo_stamp_equal(const FileStamp *a, const FileStamp *b);
+
 #endif  /* _FILEINFO_H */
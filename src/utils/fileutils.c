@@ -32,6 +32,10 @@
 #ifdef HAVE__ACCESS
 #include <io.h>
 #endif
+#ifndef WINDOWS
+#include <errno.h>
+#include <sys/stat.h>
+#endif
 
 #include "compat.h"
 #include "err.h"
@@ -641,6 +645,20 @@ int fu_exists(const char *path)
 }
 
 
+/* Creates directory `path` unless it already exists.  Does not report
+   any error.  Returns non-zero on error. */
+int fu_mkdir(const char *path)
+{
+#ifdef WINDOWS
+  if (CreateDirectory(path, NULL)) return 0;
+  return (GetLastError() == ERROR_ALREADY_EXISTS) ? 0 : 1;
+#else
+  if (mkdir(path, 0777) == 0) return 0;
+  return (errno == EEXIST) ? 0 : 1;
+#endif
+}
+
+
 /*
   Returns the canonicalized absolute pathname for `path`.  Resolves
   symbolic links and references to '/./', '/../' and extra '/'.  Note
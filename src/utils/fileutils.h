@@ -301,6 +301,10 @@ char *fu_nativepath(const char *path, char *dest, size_t size,
 /** Returns zero if path exists. */
 int fu_exists(const char *path);
 
+/** Creates directory `path` unless it already exists.  Does not report
+    any error.  Returns non-zero on error. */
+int fu_mkdir(const char *path);
+
 /**
   Returns the canonicalized absolute pathname for `path`.  Resolves
   symbolic links and references to '/./', '/../' and extra '/'.  Note
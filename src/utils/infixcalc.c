@@ -83,8 +83,33 @@ typedef struct {
     int val;       /* Value for numbers and variables */
     int op;        /* Operator */
   } u;
+  int ivar;        /* Index of variable or -1 if not a variable */
 } TokenValue;
 
+/* Instruction codes in compiled expressions that are not operators */
+enum {
+  instrNumber,     /* Push number */
+  instrVariable    /* Push value of variable */
+};
+
+/* Instruction in compiled expression */
+typedef struct {
+  int code;        /* Operator or instruction code */
+  int arg;         /* Number or variable index */
+} Instr;
+
+/* Compiled expression.  The instructions are stored in reverse Polish
+   notation. */
+struct _InfixCalcExpr {
+  size_t ninstr;   /* Number of instructions */
+  size_t nvars;    /* Number of variables that must be provided */
+  size_t depth;    /* Maximum depth of the value stack */
+  Instr *instr;    /* Array of instructions, allocated with this struct */
+};
+
+/* Max value stack depth to evaluate without heap allocation */
+#define MAXDEPTH 32
+
 /* Stack */
 typedef struct {
   size_t len;   /* number of items in the stack */
@@ -219,6 +244,7 @@ static int parse_token(const char *str, TokenValue *val,
   const InfixCalcVariable *var;
   if (!str || !str[0]) return -1;
 
+  val->ivar = -1;
   if (isdigit(str[0])) {
     char *endptr;
     val->type = typeVal;
@@ -233,6 +259,7 @@ static int parse_token(const char *str, TokenValue *val,
   } else if ((var = get_variable(str, vars, nvars))) {
     val->type = typeVal;
     val->u.val = var->value;
+    val->ivar = (int)(var - vars);
     return (int)strlen(var->name);
   }
 
@@ -254,6 +281,10 @@ static int eval(Operator op, Stack *vstack, char *err, size_t errlen)
   if (opinfo->nargs == 2) {
     int arg2 = pop(vstack);
     int arg1 = pop(vstack);
+    if ((op == '/' || op == '%') && arg2 == 0) {
+      snprintf(err, errlen, "division by zero");
+      return -1;
+    }
     value = binary_eval(op, arg1, arg2);
   } else {
     snprintf(err, errlen, "%lu-ary operators are not implemented",
@@ -358,6 +389,217 @@ int infixcalc(const char *expr, const InfixCalcVariable *vars, size_t nvars,
 
 
 
+/* Appends instruction to `instr`, which has length `*n` and allocated
+   size `*size`.  Returns non-zero on allocation error. */
+static int emit(Instr **instr, size_t *n, size_t *size, int code, int arg)
+{
+  if (*n >= *size) {
+    Instr *q;
+    *size += CHUNKSIZE;
+    if (!(q = realloc(*instr, *size*sizeof(Instr)))) return 1;
+    *instr = q;
+  }
+  (*instr)[*n].code = code;
+  (*instr)[*n].arg = arg;
+  (*n)++;
+  return 0;
+}
+
+/* Emits operator `op` and updates the value stack depth `*depth`.
+   Returns non-zero on error and write an message to `err`. */
+static int emit_op(Operator op, Instr **instr, size_t *n, size_t *size,
+                   size_t *depth, char *err, size_t errlen)
+{
+  const OpInfo *opinfo = get_opinfo(op);
+  if (opinfo->nargs != 2) {
+    if (op == '(')
+      snprintf(err, errlen, "missing end parenthesis");
+    else
+      snprintf(err, errlen, "%lu-ary operators are not implemented",
+               (unsigned long)opinfo->nargs);
+    return -1;
+  }
+  if (*depth < opinfo->nargs) {
+    snprintf(err, errlen, "too few arguments for operator '%c'", op);
+    return -1;
+  }
+  if (emit(instr, n, size, op, 0)) {
+    snprintf(err, errlen, "allocation failure");
+    return -1;
+  }
+  *depth -= opinfo->nargs - 1;
+  return 0;
+}
+
+
+/*
+  Compiles the infix expression `expr` and returns a new compiled
+  expression that can be evaluated with infixcalc_eval().
+
+  The algorithm is the same as for infixcalc(), but instead of
+  evaluating the operators, they are emitted in reverse Polish
+  notation.
+*/
+InfixCalcExpr *infixcalc_compile(const char *expr,
+                                 const InfixCalcVariable *vars, size_t nvars,
+                                 char *err, size_t errlen)
+{
+  Stack ostack;
+  const char *p=expr;
+  const OpInfo *opinfo;
+  TokenValue token;
+  Operator op;
+  Instr *instr=NULL;
+  size_t n=0, size=0, depth=0, maxdepth=0, maxvar=0;
+  InfixCalcExpr *cexpr;
+
+  if (err && errlen) err[0] = '\0';
+  memset(&ostack, 0, sizeof(ostack));
+
+  while (isspace(*p)) p++;
+
+  while (*p) {
+    int len;
+    if ((len = parse_token(p, &token, vars, nvars)) < 0) {
+      snprintf(err, errlen, "invalid token at position %d in expression \"%s\"",
+               (int)(p - expr), expr);
+      goto fail;
+    }
+    switch (token.type) {
+    case typeVal:
+      if (token.ivar >= 0) {
+        if (emit(&instr, &n, &size, instrVariable, token.ivar)) goto allocfail;
+        if ((size_t)token.ivar >= maxvar) maxvar = token.ivar + 1;
+      } else {
+        if (emit(&instr, &n, &size, instrNumber, token.u.val)) goto allocfail;
+      }
+      if (++depth > maxdepth) maxdepth = depth;
+      break;
+
+    case typeOp:
+      switch (token.u.op) {
+      case '(':
+        push(&ostack, token.u.op);
+        break;
+      case ')':
+        for (;;) {
+          if (!ostack.len) {
+            snprintf(err, errlen,
+                     "missing start parenthesis in expression \"%s\"", expr);
+            goto fail;
+          }
+          if ((op = pop(&ostack)) == '(') break;
+          if (emit_op(op, &instr, &n, &size, &depth, err, errlen)) goto fail;
+        }
+        break;
+      default:
+        opinfo = get_opinfo(token.u.op);
+        while (ostack.len) {
+          const OpInfo *opinfo2 = get_opinfo(poll(&ostack));
+          if (opinfo2->precedence < opinfo->precedence) break;
+          op = pop(&ostack);
+          if (emit_op(op, &instr, &n, &size, &depth, err, errlen)) goto fail;
+        }
+        push(&ostack, token.u.op);
+        break;
+      }
+    }
+    p += len;
+    while (isspace(*p)) p++;
+  }
+
+  while (ostack.len) {
+    op = pop(&ostack);
+    if (emit_op(op, &instr, &n, &size, &depth, err, errlen)) goto fail;
+  }
+
+  if (depth > 1) {
+    snprintf(err, errlen, "missing operator in expression \"%s\"", expr);
+    goto fail;
+  } else  if (depth < 1) {
+    snprintf(err, errlen, "missing operands in expression \"%s\"", expr);
+    goto fail;
+  }
+
+  if (!(cexpr = malloc(sizeof(InfixCalcExpr) + n*sizeof(Instr))))
+    goto allocfail;
+  cexpr->ninstr = n;
+  cexpr->nvars = maxvar;
+  cexpr->depth = maxdepth;
+  cexpr->instr = (Instr *)(cexpr + 1);
+  memcpy(cexpr->instr, instr, n*sizeof(Instr));
+  free(instr);
+  if (ostack.size) free(ostack.items);
+  return cexpr;
+
+ allocfail:
+  snprintf(err, errlen, "allocation failure");
+ fail:
+  if (instr) free(instr);
+  if (ostack.size) free(ostack.items);
+  return NULL;
+}
+
+
+/*
+  Evaluates compiled expression `cexpr` and returns the result.
+
+  On error INT_MIN is returned and a message will be written to `err`.
+*/
+int infixcalc_eval(const InfixCalcExpr *cexpr,
+                   const InfixCalcVariable *vars, size_t nvars,
+                   char *err, size_t errlen)
+{
+  int buf[MAXDEPTH], *stack=buf, result;
+  size_t i, n=0;
+
+  if (err && errlen) err[0] = '\0';
+  if (nvars < cexpr->nvars) {
+    snprintf(err, errlen, "expected %lu variables, got %lu",
+             (unsigned long)cexpr->nvars, (unsigned long)nvars);
+    return INT_MIN;
+  }
+  if (cexpr->depth > MAXDEPTH &&
+      !(stack = malloc(cexpr->depth*sizeof(int)))) {
+    snprintf(err, errlen, "allocation failure");
+    return INT_MIN;
+  }
+  for (i=0; i<cexpr->ninstr; i++) {
+    const Instr *in = cexpr->instr + i;
+    switch (in->code) {
+    case instrNumber:
+      stack[n++] = in->arg;
+      break;
+    case instrVariable:
+      stack[n++] = vars[in->arg].value;
+      break;
+    default:
+      n--;
+      if ((in->code == '/' || in->code == '%') && stack[n] == 0) {
+        snprintf(err, errlen, "division by zero");
+        if (stack != buf) free(stack);
+        return INT_MIN;
+      }
+      stack[n-1] = binary_eval(in->code, stack[n-1], stack[n]);
+      break;
+    }
+  }
+  assert(n == 1);
+  result = stack[0];
+  if (stack != buf) free(stack);
+  return result;
+}
+
+
+/*
+  Frees compiled expression `cexpr`.
+*/
+void infixcalc_free(InfixCalcExpr *cexpr)
+{
+  free(cexpr);
+}
+
+
 /*
   Returns non-zero if variable `varname` is in expression `expr`.
  */
@@ -38,6 +38,9 @@ typedef struct {
   int value;         /*!< value */
 } InfixCalcVariable;
 
+/** Opaque type for a compiled expression */
+typedef struct _InfixCalcExpr InfixCalcExpr;
+
 
 /**
   Parses the infix expression `expr` and returns the evaluated result.
@@ -54,6 +57,41 @@ int infixcalc(const char *expr, const InfixCalcVariable *vars, size_t nvars,
               char *err, size_t errlen);
 
 
+/**
+  Compiles the infix expression `expr` and returns a new compiled
+  expression that can be evaluated with infixcalc_eval().  This is
+  useful if the same expression is evaluated many times.
+
+  The array `vars` lists available variables and should have length
+  `nvars`.  Only the variable names are used.  Variables are referred
+  to by their position in `vars`, so infixcalc_eval() must be called
+  with an array with the same order.
+
+  On error NULL is returned and a message will be written to `err`
+  (see infixcalc()).
+*/
+InfixCalcExpr *infixcalc_compile(const char *expr,
+                                 const InfixCalcVariable *vars, size_t nvars,
+                                 char *err, size_t errlen);
+
+/**
+  Evaluates compiled expression `cexpr` and returns the result.
+
+  The variable values are taken from `vars`, which should have the
+  same order as the array passed to infixcalc_compile().
+
+  On error INT_MIN is returned and a message will be written to `err`.
+*/
+int infixcalc_eval(const InfixCalcExpr *cexpr,
+                   const InfixCalcVariable *vars, size_t nvars,
+                   char *err, size_t errlen);
+
+/**
+  Frees compiled expression `cexpr`.
+*/
+void infixcalc_free(InfixCalcExpr *cexpr);
+
+
 /**
   Returns non-zero if variable `varname` is in expression `expr`.
  */
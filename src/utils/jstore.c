@@ -8,15 +8,34 @@
 #include "compat.h"
 #include "jstore.h"
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 #define FAIL(msg) do {                          \
     err(1, msg); goto fail; } while (0)
 
 
+/* Reference to a value in the attached source */
+typedef struct {
+  const char *value;     // pointer into the attached source
+  size_t len;            // length of value
+} JStoreRef;
+
+typedef map_t(JStoreRef) map_ref_t;
+
 /* JSON store */
 struct _JStore {
   map_str_t store;       // maps keys to json content
   map_str_t labels;      // maps keys to associated label
+  map_ref_t refs;        // maps keys to values not yet copied from `src`
+  char *src;             // attached source, see jstore_attach_file()
+  size_t srclen;         // length of `src`
+  int mapped;            // whether `src` is memory mapped
 };
 
 
@@ -102,6 +121,7 @@ JStore *jstore_open(void)
   if (!js) return err(1, "allocation failure"), NULL;
   map_init(&js->store);
   map_init(&js->labels);
+  map_init(&js->refs);
   return js;
 }
 
@@ -125,11 +145,61 @@ int jstore_close(JStore *js)
     free(*val);
   }
   map_deinit(&js->labels);
+  map_deinit(&js->refs);
+
+  if (js->src) {
+#ifdef HAVE_MMAP
+    if (js->mapped)
+      munmap(js->src, js->srclen);
+    else
+#endif
+      free(js->src);
+  }
 
   free(js);
   return 0;
 }
 
+/* Attach the content of `filename` to the store, such that values can
+   be added by reference with jstore_addref().  The file is memory mapped
+   if supported by the system.  Otherwise it is read into memory.
+   The attached source is released when the store is closed.
+
+   Returns a pointer to the attached source or NULL on error.  If `len`
+   is not NULL, the length of the source is returned via it.  The
+   returned source is always NUL-terminated. */
+const char *jstore_attach_file(JStore *js, const char *filename, size_t *len)
+{
+  if (js->src) return errx(1, "JSON store has already an attached source"),
+                 NULL;
+#ifdef HAVE_MMAP
+  {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return err(1, "cannot open file: \"%s\"", filename), NULL;
+    /* The bytes after the end of the file in the last page are
+       zero-filled, which NUL-terminates the mapped source.  Files
+       whose size is a multiple of the page size are read instead. */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        st.st_size % sysconf(_SC_PAGESIZE)) {
+      void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        js->src = p;
+        js->srclen = st.st_size;
+        js->mapped = 1;
+      }
+    }
+    close(fd);
+  }
+#endif
+  if (!js->src) {
+    if (!(js->src = jstore_readfile(filename))) return NULL;
+    js->srclen = strlen(js->src);
+  }
+  if (len) *len = js->srclen;
+  return js->src;
+}
+
 /* Add JSON value to store with given key.
    If key already exists, it is replaced.
    Returns non-zero on error. */
@@ -169,17 +239,70 @@ int jstore_addstolen(JStore *js, const char *key, const char *value)
 {
   char **v;
   if ((v = map_get(&js->store, key))) free(*v);  // free existing value
+  map_remove(&js->refs, key);
   if (map_set(&js->store, key, (char *)value))
     return err(1, "error adding key \"%s\" to JSON store", key);
   return 0;
 }
 
+/* Add a reference to a JSON value in the source attached with
+   jstore_attach_file().  `value` must point into the attached source
+   and `vlen` is its length.  The value is only copied when it is
+   requested with jstore_get().
+   If key already exists, it is replaced.
+   Returns non-zero on error. */
+int jstore_addref(JStore *js, const char *key, size_t klen,
+                  const char *value, size_t vlen)
+{
+  char *k=(char *)key, **v;
+  JStoreRef ref = {value, vlen};
+  int stat=1;
+  if (!js->src || value < js->src || value + vlen > js->src + js->srclen)
+    return errx(1, "value must refer to the source attached to JSON store");
+  if (klen && !(k = strndup(key, klen))) FAIL("allocation failure");
+  if ((v = map_get(&js->store, k))) free(*v);  // free existing value
+  if (map_set(&js->store, k, NULL) || map_set(&js->refs, k, ref))
+    FAIL("error adding reference to JSON store");
+  stat = 0;
+ fail:
+  if (klen && k) free(k);
+  return stat;
+}
+
 /* Returns JSON value for given key or NULL if the key isn't in the store.
    This function can also be used to check if a key exists in the store. */
 const char *jstore_get(JStore *js, const char *key)
 {
   char **p = map_get(&js->store, key);
-  return (p) ? *p : NULL;
+  if (!p) return NULL;
+  if (!*p) {
+    /* copy referred value from the attached source */
+    JStoreRef *ref = map_get(&js->refs, key);
+    assert(ref);
+    if (!(*p = strndup(ref->value, ref->len)))
+      return err(1, "allocation failure"), NULL;
+    map_remove(&js->refs, key);
+  }
+  return *p;
+}
+
+/* Like jstore_get(), but does not copy values referring to the attached
+   source.  The length of the value is returned via `len`.  Note that
+   the returned value is not NUL-terminated in this case.
+   Returns NULL if the key isn't in the store. */
+const char *jstore_getn(JStore *js, const char *key, size_t *len)
+{
+  char **p = map_get(&js->store, key);
+  JStoreRef *ref;
+  if (!p) return NULL;
+  if (*p) {
+    if (len) *len = strlen(*p);
+    return *p;
+  }
+  ref = map_get(&js->refs, key);
+  assert(ref);
+  if (len) *len = ref->len;
+  return ref->value;
 }
 
 /* Removes item corresponding to given key from JSON store.
@@ -190,6 +313,7 @@ int jstore_remove(JStore *js, const char *key)
   if ((v = map_get(&js->store, key))) {
     free(*v);
     map_remove(&js->store, key);
+    map_remove(&js->refs, key);
     return 0;
   }
   return 1;
@@ -202,9 +326,10 @@ int jstore_update(JStore *js, JStore *other)
   const char *key;
   jstore_iter_init(other, &iter);
   while ((key = jstore_iter_next(&iter))) {
-    const char *val = jstore_get(other, key);
+    size_t len;
+    const char *val = jstore_getn(other, key, &len);
     assert(val);
-    if (jstore_add(js, key, val)) return 1;
+    if (jstore_addn(js, key, 0, val, len)) return 1;
   }
   return 0;
 }
@@ -287,10 +412,11 @@ char *jstore_to_string(JStore *js)
   if ((m = asnpprintf(&buf, &size, n, "{")) < 0) goto fail;
   n += m;
   while ((key = map_next(&js->store, &iter))) {
-    char **q, *sep = (count++ > 0) ? "," : "";
-    if (!(q = map_get(&js->store, key))) goto fail;
-    if ((m = asnpprintf(&buf, &size, n, "%s\n  \"%s\": %s",
-                        sep, key, *q)) < 0) goto fail;
+    const char *q, *sep = (count++ > 0) ? "," : "";
+    size_t len;
+    if (!(q = jstore_getn(js, key, &len))) goto fail;
+    if ((m = asnpprintf(&buf, &size, n, "%s\n  \"%s\": %.*s",
+                        sep, key, (int)len, q)) < 0) goto fail;
     n += m;
   }
   if ((m = asnpprintf(&buf, &size, n, "\n}\n")) < 0) goto fail;
@@ -304,18 +430,41 @@ char *jstore_to_string(JStore *js)
    Returns non-zero on error. */
 int jstore_to_file(JStore *js, const char *filename)
 {
-  char *buf = jstore_to_string(js);
+  map_iter_t iter = map_iter(&js->store);
+  const char *key, *val;
+  char *buf=NULL;
+  size_t len;
+  int count=0, stat=0;
   FILE *fp;
-  size_t n;
-  if (!buf) return 1;
+
+  /* Values referring to the attached source must be read before `filename`
+     is truncated, since it may be the attached file */
+  if (js->refs.base.nnodes && !(buf = jstore_to_string(js))) return 1;
+
   if (!(fp = fopen(filename, "w"))) {
-    free(buf);
+    if (buf) free(buf);
     return err(1, "cannot write JSON store to file \"%s\"", filename);
   }
-  n = fwrite(buf, strlen(buf), 1, fp);
+  if (buf) {
+    fputs(buf, fp);
+    free(buf);
+  } else {
+    /* Stream the values directly to file */
+    fputc('{', fp);
+    while ((key = map_next(&js->store, &iter))) {
+      if (!(val = jstore_getn(js, key, &len))) {
+        stat = 1;
+        break;
+      }
+      fprintf(fp, "%s\n  \"%s\": ", (count++ > 0) ? "," : "", key);
+      fwrite(val, 1, len, fp);
+    }
+    fputs("\n}\n", fp);
+  }
+  if (ferror(fp))
+    stat = err(1, "error writing JSON store to file \"%s\"", filename);
   fclose(fp);
-  free(buf);
-  return (n == 1) ? 0 : 1;
+  return stat;
 }
 
 /* Return number of elements in the store. */
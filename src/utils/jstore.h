@@ -68,6 +68,16 @@ JStore *jstore_open(void);
 /** Close JSON store.  Returns non-zero on error. */
 int jstore_close(JStore *js);
 
+/** Attach the content of `filename` to the store, such that values can
+    be added by reference with jstore_addref().  The file is memory mapped
+    if supported by the system.  Otherwise it is read into memory.
+    The attached source is released when the store is closed.
+
+    Returns a pointer to the attached source or NULL on error.  If `len`
+    is not NULL, the length of the source is returned via it.  The
+    returned source is always NUL-terminated. */
+const char *jstore_attach_file(JStore *js, const char *filename, size_t *len);
+
 /** Add JSON value to store with given key.
     If key already exists, it is replaced.
     Returns non-zero on error. */
@@ -88,10 +98,25 @@ int jstore_addn(JStore *js, const char *key, size_t klen,
     Returns non-zero on error. */
 int jstore_addstolen(JStore *js, const char *key, const char *value);
 
+/** Add a reference to a JSON value in the source attached with
+    jstore_attach_file().  `value` must point into the attached source
+    and `vlen` is its length.  The value is only copied when it is
+    requested with jstore_get().
+    If key already exists, it is replaced.
+    Returns non-zero on error. */
+int jstore_addref(JStore *js, const char *key, size_t klen,
+                  const char *value, size_t vlen);
+
 /** Returns JSON value for given key or NULL if the key isn't in the store.
     This function can also be used to check if a key exists in the store. */
 const char *jstore_get(JStore *js, const char *key);
 
+/** Like jstore_get(), but does not copy values referring to the attached
+    source.  The length of the value is returned via `len`.  Note that
+    the returned value is not NUL-terminated in this case.
+    Returns NULL if the key isn't in the store. */
+const char *jstore_getn(JStore *js, const char *key, size_t *len);
+
 /** Removes item corresponding to given key from JSON store. */
 int jstore_remove(JStore *js, const char *key);
 
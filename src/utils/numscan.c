@@ -0,0 +1,197 @@
+/* numscan.c -- fast scanning of decimal numbers
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numscan.h"
+
+/* Maximum number of significant digits kept in the mantissa.
+   10^19 - 1 fits in 64 bits. */
+#define MAXDIGITS 19
+
+/* Exact floating point arithmetics is needed for the fast paths.  This
+   is not the case if intermediate results are evaluated with a wider
+   type, like on x87. */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define HAVE_EXACT_FLOAT 1
+#else
+#define HAVE_EXACT_FLOAT 0
+#endif
+
+#define ISDIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/* A scanned decimal number: (-1)^neg * mant * 10^exp10 */
+typedef struct {
+  uint64_t mant;  /* significant digits */
+  int exp10;      /* decimal exponent */
+  int neg;        /* whether the number is negative */
+  int inexact;    /* whether digits were dropped from `mant` */
+} Decimal;
+
+/* Powers of ten that are exactly representable as double. */
+static const double pow10d[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Powers of ten that are exactly representable as float. */
+static const float pow10f[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+
+/*
+  Scans a decimal number with optional sign, fraction and exponent from
+  the first `len` characters of `s` into `*d`.
+
+  Returns number of characters consumed or zero if `s` does not start
+  with a number.
+*/
+static int _scan_decimal(const char *s, size_t len, Decimal *d)
+{
+  const char *p=s, *end=s+len;
+  int ndigits=0, nsig=0;
+
+  memset(d, 0, sizeof(Decimal));
+  if (p < end && (*p == '-' || *p == '+')) d->neg = (*p++ == '-');
+
+  for (; p < end && ISDIGIT(*p); p++, ndigits++) {
+    if (nsig < MAXDIGITS) {
+      d->mant = d->mant * 10 + (*p - '0');
+      if (d->mant) nsig++;
+    } else {
+      d->exp10++;
+      if (*p != '0') d->inexact = 1;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && ISDIGIT(*p); p++, ndigits++) {
+      if (nsig < MAXDIGITS) {
+        d->mant = d->mant * 10 + (*p - '0');
+        d->exp10--;
+        if (d->mant) nsig++;
+      } else if (*p != '0') {
+        d->inexact = 1;
+      }
+    }
+  }
+  if (!ndigits) return 0;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    int e=0, eneg=0;
+    if (q < end && (*q == '-' || *q == '+')) eneg = (*q++ == '-');
+    if (q < end && ISDIGIT(*q)) {
+      for (; q < end && ISDIGIT(*q); q++)
+        if (e < 100000) e = e * 10 + (*q - '0');
+      d->exp10 += (eneg) ? -e : e;
+      p = q;
+    }
+  }
+  return (int)(p - s);
+}
+
+/*
+  Converts the `n` first characters of `s` using strtod() (if `single`
+  is zero) or strtof().  Returns non-zero if strtod() does not consume
+  exactly `n` characters.
+*/
+static int _strtod(const char *s, int n, int single, double *dv, float *fv)
+{
+  char buf[64], *str=buf, *endptr;
+  int retval;
+  if (n >= (int)sizeof(buf) && !(str = malloc(n + 1))) return 1;
+  memcpy(str, s, n);
+  str[n] = '\0';
+  if (single)
+    *fv = strtof(str, &endptr);
+  else
+    *dv = strtod(str, &endptr);
+  retval = (endptr != str + n);
+  if (str != buf) free(str);
+  return retval;
+}
+
+
+/* Scans a signed decimal integer from `s` and writes it to `*v`. */
+int numscan_int64(const char *s, size_t len, int64_t *v)
+{
+  const char *p=s, *end=s+len;
+  uint64_t u=0, max=INT64_MAX;
+  int neg=0;
+
+  if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+  if (neg) max = (uint64_t)INT64_MAX + 1;
+  if (p >= end || !ISDIGIT(*p)) return 0;
+  if (*p == '0' && p+1 < end && (ISDIGIT(p[1]) || p[1] == 'x' ||
+                                 p[1] == 'X')) return 0;
+  for (; p < end && ISDIGIT(*p); p++) {
+    unsigned digit = *p - '0';
+    if (u > (max - digit) / 10) return 0;
+    u = u * 10 + digit;
+  }
+  *v = (neg) ? (int64_t)(0 - u) : (int64_t)u;
+  return (int)(p - s);
+}
+
+/* Scans an unsigned decimal integer from `s` and writes it to `*v`. */
+int numscan_uint64(const char *s, size_t len, uint64_t *v)
+{
+  const char *p=s, *end=s+len;
+  uint64_t u=0;
+
+  if (p < end && *p == '+') p++;
+  if (p >= end || !ISDIGIT(*p)) return 0;
+  if (*p == '0' && p+1 < end && (ISDIGIT(p[1]) || p[1] == 'x' ||
+                                 p[1] == 'X')) return 0;
+  for (; p < end && ISDIGIT(*p); p++) {
+    unsigned digit = *p - '0';
+    if (u > (UINT64_MAX - digit) / 10) return 0;
+    u = u * 10 + digit;
+  }
+  *v = u;
+  return (int)(p - s);
+}
+
+/* Scans a decimal floating point number from `s` and writes it to `*v`. */
+int numscan_double(const char *s, size_t len, double *v)
+{
+  Decimal d;
+  int n = _scan_decimal(s, len, &d);
+  if (n <= 0) return 0;
+
+  /* Both the mantissa and the power of ten are exact doubles, so a
+     single multiplication or division is correctly rounded */
+  if (HAVE_EXACT_FLOAT && !d.inexact && d.mant <= ((uint64_t)1 << 53) &&
+      d.exp10 >= -22 && d.exp10 <= 22) {
+    double x = (double)d.mant;
+    x = (d.exp10 < 0) ? x / pow10d[-d.exp10] : x * pow10d[d.exp10];
+    *v = (d.neg) ? -x : x;
+    return n;
+  }
+  if (_strtod(s, n, 0, v, NULL)) return 0;
+  return n;
+}
+
+/* Like numscan_double(), but rounds correctly to single precision. */
+int numscan_float(const char *s, size_t len, float *v)
+{
+  Decimal d;
+  int n = _scan_decimal(s, len, &d);
+  if (n <= 0) return 0;
+
+  if (HAVE_EXACT_FLOAT && !d.inexact && d.mant <= ((uint64_t)1 << 24) &&
+      d.exp10 >= -10 && d.exp10 <= 10) {
+    float x = (float)d.mant;
+    x = (d.exp10 < 0) ? x / pow10f[-d.exp10] : x * pow10f[d.exp10];
+    *v = (d.neg) ? -x : x;
+    return n;
+  }
+  if (_strtod(s, n, 1, NULL, v)) return 0;
+  return n;
+}
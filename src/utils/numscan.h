@@ -0,0 +1,54 @@
+/* numscan.h -- fast scanning of decimal numbers
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#ifndef _NUMSCAN_H
+#define _NUMSCAN_H
+
+/**
+  @file
+  @brief Fast scanning of decimal numbers.
+
+  Functions for scanning plain decimal numbers, like the numbers in a
+  JSON document, from strings that need not be NUL-terminated.
+
+  In contrast to sscanf(), which may call strlen() on its input, the
+  time these functions take only depends on the length of the number.
+  This makes a large difference when scanning many numbers from a long
+  document.
+
+  Integers must be in decimal notation with an optional sign.
+  Hexadecimal numbers and integers with leading zeros (which sscanf()
+  would interpret as octal) are not accepted.  Floating point numbers
+  are converted with correct rounding, using exact floating point
+  arithmetics when the number of significant digits and the exponent
+  are small and falling back to strtod() or strtof() otherwise.  Special
+  values like "nan" and "inf" are not accepted.
+
+  All functions scan at most `len` characters from `s` and return the
+  number of characters consumed.  Zero is returned if `s` does not
+  start with a number or if the number does not fit in the requested
+  type.  Callers that require the whole string to be a number should
+  compare the return value with `len`.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Scans a signed decimal integer from `s` and writes it to `*v`. */
+int numscan_int64(const char *s, size_t len, int64_t *v);
+
+/** Scans an unsigned decimal integer from `s` and writes it to `*v`. */
+int numscan_uint64(const char *s, size_t len, uint64_t *v);
+
+/** Scans a decimal floating point number from `s` and writes it to `*v`. */
+int numscan_double(const char *s, size_t len, double *v);
+
+/** Like numscan_double(), but rounds correctly to single precision. */
+int numscan_float(const char *s, size_t len, float *v);
+
+
+#endif  /* _NUMSCAN_H */
@@ -14,6 +14,7 @@
 
 #include "err.h"
 #include "fileutils.h"
+#include "fileinfo.h"
 #include "dsl.h"
 #include "uuid4.h"
 #include "plugin.h"
@@ -74,11 +75,13 @@ PluginInfo *plugin_info_create(const char *kind, const char *symbol,
   info->symbol = strdup(symbol);
   info->envvar = (envvar) ? strdup(envvar) : NULL;
   info->state = state;
+  info->api_version = 1;
   fu_paths_init(&info->paths, envvar);
 
   map_init(&info->plugins);
   map_init(&info->pluginpaths);
   map_init(&info->apis);
+  map_init(&info->versions);
 
   return info;
 }
@@ -113,18 +116,59 @@ void plugin_info_free(PluginInfo *info)
   map_deinit(&info->plugins);
   map_deinit(&info->pluginpaths);
   map_deinit(&info->apis);
+  map_deinit(&info->versions);
   free(info);
 }
 
 
+/*
+  Sets the current version of the plugin api to `version`.  Plugins
+  will be looked up with the versioned function names `symbol_v<n>`
+  for `n` from `version` down to 2, before falling back to `symbol`.
+
+  Returns non-zero on error.
+ */
+int plugin_info_set_api_version(PluginInfo *info, int version)
+{
+  if (version < 1) return errx(1, "invalid api version: %d", version);
+  info->api_version = version;
+  return 0;
+}
+
+
+/*
+  Help function for plugin_load().  Returns the function with the
+  highest api version that the plugin with `handle` provides and
+  assigns `*version` to its version.  Returns NULL if the plugin
+  provides none of them.
+ */
+static void *lookup_symbol(const PluginInfo *info, dsl_handle handle,
+                           int *version)
+{
+  char symbol[256];
+  void *sym;
+  int n;
+  for (n=info->api_version; n > 1; n--) {
+    snprintf(symbol, sizeof(symbol), "%s_v%d", info->symbol, n);
+    if ((sym = dsl_sym(handle, symbol))) {
+      *version = n;
+      return sym;
+    }
+  }
+  *version = 1;
+  return dsl_sym(handle, info->symbol);
+}
+
+
 /*
   Help function for plugin_load().  Registers a plugin with given
-  `path`, `api` and dsl `handle` into `info`.
+  `path`, `api` and dsl `handle` into `info`.  `version` is the api
+  version that `api` implements.
 
   Returns non-zero on error.
  */
 static int register_plugin(PluginInfo *info, const PluginAPI *api,
-			   const char *path, dsl_handle handle)
+			   const char *path, dsl_handle handle, int version)
 {
   char *name = api->name;
   Plugin *plugin = NULL;
@@ -156,6 +200,9 @@ static int register_plugin(PluginInfo *info, const PluginAPI *api,
 
   if (map_set(&info->apis, name, (PluginAPI *)api))
     fatal(1, "failed to register api: %s", name);
+  if (map_set(&info->versions, name, version))
+    fatal(1, "failed to register api version: %s", name);
+  info->generation++;
 
   return 0;
  fail:
@@ -195,6 +242,7 @@ const PluginAPI *plugin_load(PluginInfo *info, const char *name,
   PluginFunc func;
   PluginAPI *api=NULL, **apiptr;
   const void *loaded_api=NULL, *registered_api=NULL, *retval=NULL;
+  int version;
 
   if (!(iter = fu_startmatch(pattern, &info->paths))) goto fail;
 
@@ -212,7 +260,7 @@ const PluginAPI *plugin_load(PluginInfo *info, const char *name,
       continue;
     }
 
-    if (!(sym = dsl_sym(handle, info->symbol))) {
+    if (!(sym = lookup_symbol(info, handle, &version))) {
       warn("dsl_sym: %s", dsl_error());
       (void)dsl_close(handle);
       continue;
@@ -229,10 +277,11 @@ const PluginAPI *plugin_load(PluginInfo *info, const char *name,
       if (!map_get(&info->apis, api->name)) {  /* no plugin with this name */
         loaded_api = api;
         if (!name) {
-          if (!register_plugin(info, api, filepath, handle))
+          if (!register_plugin(info, api, filepath, handle, version))
             registered_api = api;
         } else if (strcmp(api->name, name) == 0) {
-          if (register_plugin(info, api, filepath, handle)) goto fail;
+          if (register_plugin(info, api, filepath, handle, version))
+            goto fail;
           registered_api = api;
           fu_endmatch(iter);
           return api;
@@ -274,12 +323,16 @@ const PluginAPI *plugin_load(PluginInfo *info, const char *name,
 
   This function may e.g. be useful for registering plugins written in
   dynamic interpreted languages, like Python.
+
+  The api is assumed to implement the current api version.
  */
 int plugin_register_api(PluginInfo *info, const PluginAPI *api)
 {
   if (map_get(&info->apis, api->name))
     return errx(1, "api already registered: %s", api->name);
   map_set(&info->apis, api->name, (PluginAPI *)api);
+  map_set(&info->versions, api->name, info->api_version);
+  info->generation++;
   return 0;
 }
 
@@ -289,7 +342,20 @@ int plugin_register_api(PluginInfo *info, const PluginAPI *api)
  */
 int plugin_has_api(PluginInfo *info, const char *name)
 {
-  return (map_get(&info->apis, name)) ? 1 : 0;
+  /* Use map_get_() since map_get() writes to the map */
+  return (map_get_(&info->apis.base, name)) ? 1 : 0;
+}
+
+
+/*
+  Returns the api version implemented by the registered plugin api
+  `name` or zero if no such api is registered.
+ */
+int plugin_api_version(const PluginInfo *info, const char *name)
+{
+  /* Use map_get_() since map_get() writes to the map */
+  const int *p = map_get_(&info->versions.base, name);
+  return (p) ? *p : 0;
 }
 
 
@@ -353,6 +419,190 @@ void plugin_load_all(PluginInfo *info)
 }
 
 
+/*
+  Plugin manifests
+
+  A manifest is a text file listing all shared libraries in the plugin
+  search path together with their modification stamp and the names of
+  the plugin APIs they provide.  It allows to load a named plugin
+  without opening all shared libraries in the search path.
+
+  The first line is a header of the form
+
+      PLUGIN_MANIFEST_HEADER <TAB> kind <TAB> key
+
+  followed by one line per shared library
+
+      path <TAB> mtime <TAB> size [<TAB> name]...
+
+  where `path` is the full path to the shared library, `mtime` and
+  `size` its modification stamp and `name` are the names of the APIs
+  it provides.
+*/
+#define PLUGIN_MANIFEST_HEADER "plugin-manifest-1"
+
+/*
+  Writes a manifest of the shared libraries in the plugin search path
+  and the currently registered plugin APIs they provide to `filename`.
+  Should be called after plugin_load_all().
+
+  `key` is an arbitrary string (without tabs and newlines) identifying
+  the search path, that is validated by plugin_manifest_get_api().
+
+  The manifest is first written to a temporary file that is renamed
+  to `filename`, such that concurrent readers never see a partly
+  written manifest.
+
+  Returns non-zero on error.
+ */
+int plugin_manifest_write(PluginInfo *info, const char *filename,
+                          const char *key)
+{
+  FUIter *iter=NULL;
+  FILE *fp=NULL;
+  FileStamp stamp;
+  map_iter_t miter;
+  const char *path, *name;
+  char *tmpname=NULL, uuid[37];
+  size_t len = strlen(filename);
+  int retval=1;
+
+  if (uuid4_generate(uuid)) FAIL("cannot generate UUID");
+  if (!(tmpname = malloc(len + sizeof(uuid) + 1)))
+    FAIL("allocation failure");
+  memcpy(tmpname, filename, len);
+  tmpname[len] = '.';
+  memcpy(tmpname + len + 1, uuid, sizeof(uuid));
+
+  if (!(fp = fopen(tmpname, "w"))) FAIL1("cannot write: %s", tmpname);
+  fprintf(fp, "%s\t%s\t%s\n", PLUGIN_MANIFEST_HEADER, info->kind, key);
+  if (!(iter = fu_startmatch("*" DSL_EXT, &info->paths))) goto fail;
+  while ((path = fu_nextmatch(iter))) {
+    if (fileinfo_stamp(path, &stamp)) continue;
+    fprintf(fp, "%s\t%lld\t%lld", path, stamp.mtime, stamp.size);
+    miter = map_iter(&info->pluginpaths);
+    while ((name = map_next(&info->pluginpaths, &miter))) {
+      char **p = map_get(&info->pluginpaths, name);
+      if (p && strcmp(*p, path) == 0) fprintf(fp, "\t%s", name);
+    }
+    fprintf(fp, "\n");
+  }
+  if (fclose(fp)) {
+    fp = NULL;
+    FAIL1("error writing: %s", tmpname);
+  }
+  fp = NULL;
+#ifdef _WIN32
+  remove(filename);
+#endif
+  if (rename(tmpname, filename))
+    FAIL2("cannot rename \"%s\" to \"%s\"", tmpname, filename);
+  retval = 0;
+ fail:
+  if (iter) fu_endmatch(iter);
+  if (fp) fclose(fp);
+  if (retval && tmpname) remove(tmpname);
+  if (tmpname) free(tmpname);
+  return retval;
+}
+
+
+/*
+  Help function for plugin_manifest_get_api().  Returns the next
+  tab-separated field in `*s` and updates `*s` to point to the field
+  after it.  Returns NULL if there are no more fields.
+ */
+static char *nextfield(char **s)
+{
+  char *field = *s, *p;
+  if (!field) return NULL;
+  if ((p = strchr(field, '\t'))) {
+    *p = '\0';
+    *s = p + 1;
+  } else {
+    *s = NULL;
+  }
+  return field;
+}
+
+/*
+  Looks up plugin `name` in the manifest `filename` written by
+  plugin_manifest_write().
+
+  The manifest is valid if it exists, its kind and `key` matches and
+  none of the listed shared libraries have been modified.  If it is
+  valid and lists a shared library providing `name`, only that
+  library is loaded and the plugin API is registered and returned.
+
+  If `valid` is not NULL, it is assigned to non-zero if the manifest
+  is valid.  A valid manifest that does not list `name` only means
+  that no shared library provided it when the manifest was written.
+  Libraries that failed to load at that time are listed without any
+  names, so callers should fall back to plugin_load_all() before
+  concluding that `name` is not available.
+
+  Returns NULL if `name` cannot be loaded from the manifest.  No
+  error is reported in that case.
+ */
+const PluginAPI *plugin_manifest_get_api(PluginInfo *info,
+                                         const char *filename,
+                                         const char *key, const char *name,
+                                         int *valid)
+{
+  FILE *fp;
+  FileStamp stamp, s;
+  char *buf=NULL, *line, *next, *field, *rest, *path, *found=NULL;
+  const PluginAPI *api=NULL;
+  PluginAPI **p;
+  int ok=0;
+
+  if (valid) *valid = 0;
+  if ((p = map_get(&info->apis, name))) return *p;
+
+  if (!(fp = fopen(filename, "rb"))) return NULL;
+  buf = fu_readfile(fp);
+  fclose(fp);
+  if (!buf) return NULL;
+
+  /* Check header */
+  if (!(next = strchr(buf, '\n'))) goto done;
+  *(next++) = '\0';
+  rest = buf;
+  if (!(field = nextfield(&rest)) || strcmp(field, PLUGIN_MANIFEST_HEADER) ||
+      !(field = nextfield(&rest)) || strcmp(field, info->kind) ||
+      !(field = nextfield(&rest)) || strcmp(field, key)) goto done;
+
+  /* Check stamps and look for `name` */
+  while ((line = next) && *line) {
+    if ((next = strchr(line, '\n'))) *(next++) = '\0';
+    rest = line;
+    if (!(path = nextfield(&rest))) goto done;
+    if (!(field = nextfield(&rest))) goto done;
+    s.mtime = strtoll(field, NULL, 10);
+    if (!(field = nextfield(&rest))) goto done;
+    s.size = strtoll(field, NULL, 10);
+    if (fileinfo_stamp(path, &stamp) || !fileinfo_stamp_equal(&stamp, &s))
+      goto done;
+    while ((field = nextfield(&rest)))
+      if (!found && strcmp(field, name) == 0) found = path;
+  }
+  ok = 1;
+
+  if (found) {
+    char *pattern = fu_basename(found);
+    if (pattern) {
+      api = plugin_load(info, name, pattern, 0);
+      free(pattern);
+    }
+  }
+
+ done:
+  if (valid) *valid = ok;
+  free(buf);
+  return api;
+}
+
+
 /*
   Unloads and unregisters plugin with the given name.
   Returns non-zero on error.
@@ -381,6 +631,8 @@ int plugin_unload(PluginInfo *info, const char *name)
   }
   map_remove(&info->pluginpaths, pname);
   map_remove(&info->apis, pname);
+  map_remove(&info->versions, pname);
+  info->generation++;
   retval = 0;
  fail:
   free(pname);
@@ -438,7 +690,9 @@ const PluginAPI *plugin_api_iter_next(PluginIter *iter)
   PluginInfo *info = (PluginInfo *)iter->info;
   const char *name = map_next(&info->apis, &iter->miter);
   if (!name) return NULL;
-  if (!(p = map_get(&info->apis, name)) || !(api = *p))
+  /* Use map_get_() since map_get() writes to the map, which would race
+     with concurrent iterators */
+  if (!(p = map_get_(&info->apis.base, name)) || !(api = *p))
     fatal(1, "failed to get api: %s", name);
   return (const void *)api;
 }
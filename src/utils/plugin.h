@@ -35,6 +35,15 @@
   A new plugin kind, with its own API, can be created with
   plugin_info_create().
 
+  Plugin APIs may be extended by appending new fields to the end of
+  the API struct.  Since plugins compiled against the old struct
+  don't have these fields, the version of the API is increased with
+  plugin_info_set_api_version() and plugins implementing version `n`
+  > 1 should name the function `symbol_v<n>` instead of `symbol`
+  (e.g. "get_testapi_v2").  The version a loaded plugin implements is
+  returned by plugin_api_version() and should be checked before
+  accessing the new fields.
+
   @see http://gernotklingler.com/blog/creating-using-shared-libraries-different-compilers-different-operating-systems/
  */
 
@@ -85,6 +94,11 @@ typedef struct _PluginInfo {
   map_plg_t plugins;     /*!< Maps plugin paths to loaded plugins */
   map_str_t pluginpaths; /*!< Maps api names to plugin path names */
   map_api_t apis;        /*!< Maps api names to plugin apis */
+  map_int_t versions;    /*!< Maps api names to the api version they
+                              implement */
+  int api_version;       /*!< Current version of the plugin api */
+  unsigned long generation;  /*!< Incremented whenever an api is
+                                  registered or unloaded */
 } PluginInfo;
 
 
@@ -113,12 +127,23 @@ PluginInfo *plugin_info_create(const char *kind, const char *symbol,
  */
 void plugin_info_free(PluginInfo *info);
 
+/**
+  Sets the current version of the plugin api to `version`.  Plugins
+  will be looked up with the versioned function names `symbol_v<n>`
+  for `n` from `version` down to 2, before falling back to `symbol`.
+
+  Returns non-zero on error.
+ */
+int plugin_info_set_api_version(PluginInfo *info, int version);
+
 
 /**
   Register a plugin `api` not associated to a dynamic loadable library.
 
   This function may e.g. be useful for registering plugins written in
   dynamic interpreted languages, like Python.
+
+  The api is assumed to implement the current api version.
  */
 int plugin_register_api(PluginInfo *info, const PluginAPI *api);
 
@@ -128,6 +153,12 @@ int plugin_register_api(PluginInfo *info, const PluginAPI *api);
  */
 int plugin_has_api(PluginInfo *info, const char *name);
 
+/**
+  Returns the api version implemented by the registered plugin api
+  `name` or zero if no such api is registered.
+ */
+int plugin_api_version(const PluginInfo *info, const char *name);
+
 /**
   Returns pointer to plugin api.
 
@@ -156,6 +187,44 @@ const PluginAPI *plugin_get_api(PluginInfo *info, const char *name, int errcode)
 void plugin_load_all(PluginInfo *info);
 
 
+/**
+  Writes a manifest of the shared libraries in the plugin search path
+  and the currently registered plugin APIs they provide to `filename`.
+  Should be called after plugin_load_all().
+
+  The manifest lists the modification stamp of each shared library.
+  `key` is an arbitrary string (without tabs and newlines) identifying
+  the search path, that is validated by plugin_manifest_get_api().
+
+  Returns non-zero on error.
+ */
+int plugin_manifest_write(PluginInfo *info, const char *filename,
+                          const char *key);
+
+/**
+  Looks up plugin `name` in the manifest `filename` written by
+  plugin_manifest_write().
+
+  The manifest is valid if it exists, its kind and `key` matches and
+  none of the listed shared libraries have been modified.  If it is
+  valid and lists a shared library providing `name`, only that
+  library is loaded and the plugin API is registered and returned.
+
+  If `valid` is not NULL, it is assigned to non-zero if the manifest
+  is valid.  A valid manifest that does not list `name` only means
+  that no shared library provided it when the manifest was written.
+  Libraries that failed to load at that time are listed without any
+  names, so callers should fall back to plugin_load_all() before
+  concluding that `name` is not available.
+
+  Returns NULL if `name` cannot be loaded from the manifest.  No
+  error is reported in that case.
+ */
+const PluginAPI *plugin_manifest_get_api(PluginInfo *info,
+                                         const char *filename,
+                                         const char *key, const char *name,
+                                         int *valid);
+
 /**
   Initiates a plugin iterator.
 */
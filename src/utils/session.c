@@ -218,7 +218,9 @@ int session_remove_state(Session *s, const char *name)
  */
 void *session_get_state(Session *s, const char *name)
 {
-  State *st = map_get(&s->states, name);
+  /* Call map_get_() directly, since the map_get() macro modifies the
+     map and would make concurrent lookups unsafe. */
+  State *st = map_get_(&s->states.base, name);
   return (st) ? st->ptr : NULL;
 }
 
@@ -427,14 +427,15 @@ int strnput_unquote(char **destp, size_t *sizep, size_t pos, const char *s,
 int strhex_encode(char *hex, size_t hexsize, const unsigned char *data,
                   size_t size)
 {
-  int n, m=0;
-  size_t i;
-  for (i=0; i<size; i++) {
-    if ((n = snprintf(hex+m, PDIFF(hexsize, m), "%02x", data[i])) < 0) return n;
-    if (n == 2 && m == (int)hexsize-2) hex[m] = '\0';
-    m += n;
+  static const char digits[] = "0123456789abcdef";
+  size_t i, n = (hexsize) ? (hexsize - 1) / 2 : 0;  // whole bytes that fit
+  if (n > size) n = size;
+  for (i=0; i<n; i++) {
+    hex[2*i]   = digits[data[i] >> 4];
+    hex[2*i+1] = digits[data[i] & 0x0f];
   }
-  return m;
+  if (hexsize) hex[2*n] = '\0';
+  return 2*size;
 }
 
 
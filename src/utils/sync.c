@@ -0,0 +1,323 @@
+/* sync.c -- portable mutexes, read-write locks, atomic counters and threads
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+# include <windows.h>
+#elif defined(HAVE_UNISTD_H)
+# include <unistd.h>
+#endif
+
+#include "sync.h"
+
+#ifdef SYNC_WIN32
+# define SRW(x) ((PSRWLOCK)(x))
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+# define SYNC_GNUC_ATOMICS
+#endif
+
+
+/* Mutexes */
+
+int mutex_init(Mutex *m)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_mutex_init(m, NULL);
+#elif defined(SYNC_WIN32)
+  InitializeSRWLock(SRW(m));
+  return 0;
+#else
+  *m = 0;
+  return 0;
+#endif
+}
+
+int mutex_lock(Mutex *m)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_mutex_lock(m);
+#elif defined(SYNC_WIN32)
+  AcquireSRWLockExclusive(SRW(m));
+  return 0;
+#else
+  (void)m;
+  return 0;
+#endif
+}
+
+int mutex_unlock(Mutex *m)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_mutex_unlock(m);
+#elif defined(SYNC_WIN32)
+  ReleaseSRWLockExclusive(SRW(m));
+  return 0;
+#else
+  (void)m;
+  return 0;
+#endif
+}
+
+void mutex_destroy(Mutex *m)
+{
+#if defined(SYNC_PTHREADS)
+  pthread_mutex_destroy(m);
+#else
+  (void)m;
+#endif
+}
+
+
+/* Read-write locks */
+
+int rwlock_init(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_rwlock_init(l, NULL);
+#elif defined(SYNC_WIN32)
+  InitializeSRWLock(SRW(l));
+  return 0;
+#else
+  *l = 0;
+  return 0;
+#endif
+}
+
+int rwlock_rdlock(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_rwlock_rdlock(l);
+#elif defined(SYNC_WIN32)
+  AcquireSRWLockShared(SRW(l));
+  return 0;
+#else
+  (void)l;
+  return 0;
+#endif
+}
+
+int rwlock_rdunlock(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_rwlock_unlock(l);
+#elif defined(SYNC_WIN32)
+  ReleaseSRWLockShared(SRW(l));
+  return 0;
+#else
+  (void)l;
+  return 0;
+#endif
+}
+
+int rwlock_wrlock(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_rwlock_wrlock(l);
+#elif defined(SYNC_WIN32)
+  AcquireSRWLockExclusive(SRW(l));
+  return 0;
+#else
+  (void)l;
+  return 0;
+#endif
+}
+
+int rwlock_wrunlock(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  return pthread_rwlock_unlock(l);
+#elif defined(SYNC_WIN32)
+  ReleaseSRWLockExclusive(SRW(l));
+  return 0;
+#else
+  (void)l;
+  return 0;
+#endif
+}
+
+void rwlock_destroy(RWLock *l)
+{
+#if defined(SYNC_PTHREADS)
+  pthread_rwlock_destroy(l);
+#else
+  (void)l;
+#endif
+}
+
+
+/* Atomic operations */
+
+int sync_add_int(int *p, int n)
+{
+#if defined(SYNC_GNUC_ATOMICS)
+  return __atomic_add_fetch(p, n, __ATOMIC_SEQ_CST);
+#elif defined(SYNC_WIN32)
+  return InterlockedExchangeAdd((volatile LONG *)p, n) + n;
+#else
+  return *p += n;
+#endif
+}
+
+int sync_cas_int(int *p, int oldval, int newval)
+{
+#if defined(SYNC_GNUC_ATOMICS)
+  return __atomic_compare_exchange_n(p, &oldval, newval, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#elif defined(SYNC_WIN32)
+  return InterlockedCompareExchange((volatile LONG *)p, newval, oldval) ==
+    oldval;
+#else
+  if (*p != oldval) return 0;
+  *p = newval;
+  return 1;
+#endif
+}
+
+int sync_load_int(const int *p)
+{
+#if defined(SYNC_GNUC_ATOMICS)
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#elif defined(SYNC_WIN32)
+  return InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+#else
+  return *p;
+#endif
+}
+
+void *sync_load_ptr(void *const *p)
+{
+#if defined(SYNC_GNUC_ATOMICS)
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#elif defined(SYNC_WIN32)
+  return InterlockedCompareExchangePointer((PVOID volatile *)p, NULL, NULL);
+#else
+  return *p;
+#endif
+}
+
+void sync_store_ptr(void **p, void *value)
+{
+#if defined(SYNC_GNUC_ATOMICS)
+  __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+#elif defined(SYNC_WIN32)
+  InterlockedExchangePointer((PVOID volatile *)p, value);
+#else
+  *p = value;
+#endif
+}
+
+
+/* Parallel for-loop */
+
+/* Shared state of the workers in sync_parallel_for(). */
+typedef struct {
+  Mutex lock;
+  size_t next;     /* next index to hand out, protected by `lock` */
+  size_t n;
+  SyncTask task;
+  void *data;
+} ParallelFor;
+
+/* Runs tasks until all indices have been handed out. */
+static void parallel_for_worker(ParallelFor *pf)
+{
+  size_t i;
+  while (1) {
+    mutex_lock(&pf->lock);
+    i = pf->next;
+    if (i < pf->n) pf->next++;
+    mutex_unlock(&pf->lock);
+    if (i >= pf->n) break;
+    pf->task(i, pf->data);
+  }
+}
+
+#if defined(SYNC_PTHREADS)
+static void *parallel_for_thread(void *arg)
+{
+  parallel_for_worker(arg);
+  return NULL;
+}
+#elif defined(SYNC_WIN32)
+static DWORD WINAPI parallel_for_thread(LPVOID arg)
+{
+  parallel_for_worker(arg);
+  return 0;
+}
+#endif
+
+int sync_nprocessors(void)
+{
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+void sync_parallel_for(int nworkers, size_t n, SyncTask task, void *data)
+{
+  ParallelFor pf;
+#if defined(SYNC_PTHREADS)
+  pthread_t *threads=NULL;
+#elif defined(SYNC_WIN32)
+  HANDLE *threads=NULL;
+#endif
+  int i, nthreads=0;
+
+  if (nworkers <= 0) nworkers = sync_nprocessors();
+  if ((size_t)nworkers > n) nworkers = (int)n;
+  if (nworkers <= 1) {
+    size_t j;
+    for (j=0; j<n; j++) task(j, data);
+    return;
+  }
+
+  mutex_init(&pf.lock);
+  pf.next = 0;
+  pf.n = n;
+  pf.task = task;
+  pf.data = data;
+
+#if defined(SYNC_PTHREADS)
+  if ((threads = malloc((nworkers-1) * sizeof(pthread_t))))
+    for (i=0; i<nworkers-1; i++, nthreads++)
+      if (pthread_create(threads+i, NULL, parallel_for_thread, &pf)) break;
+#elif defined(SYNC_WIN32)
+  if ((threads = malloc((nworkers-1) * sizeof(HANDLE))))
+    for (i=0; i<nworkers-1; i++, nthreads++)
+      if (!(threads[i] = CreateThread(NULL, 0, parallel_for_thread, &pf, 0,
+                                      NULL))) break;
+#endif
+
+  /* The calling thread is also a worker */
+  parallel_for_worker(&pf);
+
+  for (i=0; i<nthreads; i++) {
+#if defined(SYNC_PTHREADS)
+    pthread_join(threads[i], NULL);
+#elif defined(SYNC_WIN32)
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#endif
+  }
+#if defined(SYNC_PTHREADS) || defined(SYNC_WIN32)
+  if (threads) free(threads);
+#endif
+  mutex_destroy(&pf.lock);
+}
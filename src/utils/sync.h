@@ -0,0 +1,158 @@
+/* sync.h -- portable mutexes, read-write locks, atomic counters and threads
+ *
+ * Copyright (C) 2024 SINTEF
+ *
+ * Distributed under terms of the MIT license.
+ */
+#ifndef _SYNC_H
+#define _SYNC_H
+
+/**
+  @file
+  @brief Portable mutexes, read-write locks, atomic counters and a
+  simple parallel for-loop.
+
+  Thin wrappers around POSIX threads or Windows slim reader/writer
+  locks.  If the library is compiled without thread support, all
+  lock functions are no-ops and the atomic functions fall back to
+  plain memory operations.
+
+  Both mutexes and read-write locks may be statically initialised
+  with MUTEX_INITIALIZER and RWLOCK_INITIALIZER, respectively, which
+  makes them suitable for protecting lazily initialised global state.
+*/
+
+#include <stddef.h>
+
+#include "config.h"
+
+#if defined(HAVE_THREADS) && defined(HAVE_PTHREAD_H)
+# include <pthread.h>
+# define SYNC_PTHREADS
+typedef pthread_mutex_t Mutex;
+typedef pthread_rwlock_t RWLock;
+# define MUTEX_INITIALIZER  PTHREAD_MUTEX_INITIALIZER
+# define RWLOCK_INITIALIZER PTHREAD_RWLOCK_INITIALIZER
+
+#elif defined(HAVE_THREADS) && defined(_WIN32)
+# define SYNC_WIN32
+/* Binary compatible with SRWLOCK, which is a pointer-sized opaque type */
+typedef struct { void *ptr; } Mutex;
+typedef struct { void *ptr; } RWLock;
+# define MUTEX_INITIALIZER  {0}
+# define RWLOCK_INITIALIZER {0}
+
+#else
+typedef int Mutex;
+typedef int RWLock;
+# define MUTEX_INITIALIZER  0
+# define RWLOCK_INITIALIZER 0
+#endif
+
+
+/**
+  @name Mutexes
+  @{
+ */
+
+/** Initialise mutex `m`.  Returns non-zero on error. */
+int mutex_init(Mutex *m);
+
+/** Lock mutex `m`.  Returns non-zero on error. */
+int mutex_lock(Mutex *m);
+
+/** Unlock mutex `m`.  Returns non-zero on error. */
+int mutex_unlock(Mutex *m);
+
+/** Release resources associated with mutex `m`. */
+void mutex_destroy(Mutex *m);
+
+/** @} */
+
+
+/**
+  @name Read-write locks
+  Any number of readers may hold the lock at the same time, but a
+  writer has exclusive access.
+  @{
+ */
+
+/** Initialise read-write lock `l`.  Returns non-zero on error. */
+int rwlock_init(RWLock *l);
+
+/** Acquire `l` for reading.  Returns non-zero on error. */
+int rwlock_rdlock(RWLock *l);
+
+/** Release `l` after rwlock_rdlock().  Returns non-zero on error. */
+int rwlock_rdunlock(RWLock *l);
+
+/** Acquire `l` for writing.  Returns non-zero on error. */
+int rwlock_wrlock(RWLock *l);
+
+/** Release `l` after rwlock_wrlock().  Returns non-zero on error. */
+int rwlock_wrunlock(RWLock *l);
+
+/** Release resources associated with read-write lock `l`. */
+void rwlock_destroy(RWLock *l);
+
+/** @} */
+
+
+/**
+  @name Atomic operations
+  All operations are sequentially consistent.
+  @{
+ */
+
+/** Atomically adds `n` to `*p` and returns the new value. */
+int sync_add_int(int *p, int n);
+
+/** Atomically replace `*p` with `newval` if it is equal to `oldval`.
+    Returns non-zero if the value was replaced. */
+int sync_cas_int(int *p, int oldval, int newval);
+
+/** Atomically read `*p`. */
+int sync_load_int(const int *p);
+
+/** Atomically read pointer `*p`. */
+void *sync_load_ptr(void *const *p);
+
+/** Atomically assign `*p` to `value`. */
+void sync_store_ptr(void **p, void *value);
+
+/** @} */
+
+
+/**
+  @name Parallel for-loop
+  @{
+ */
+
+/** Task called by sync_parallel_for() for index `i`.  `data` is the
+    pointer passed to sync_parallel_for(). */
+typedef void (*SyncTask)(size_t i, void *data);
+
+/** Returns the number of online processors or 1 if it cannot be
+    determined. */
+int sync_nprocessors(void);
+
+/**
+  Calls `task(i, data)` for `i` in the range [0, `n`) using up to
+  `nworkers` threads, including the calling thread.  If `nworkers` is
+  zero or negative, the number of processors is used.
+
+  The indices are handed out to the workers in increasing order, but
+  the tasks may complete in any order.  Hence, `task` must be safe to
+  call concurrently for different indices.  The function returns when
+  all tasks have completed.
+
+  If the library is compiled without thread support or new threads
+  cannot be created, the remaining tasks are run by the calling
+  thread.
+ */
+void sync_parallel_for(int nworkers, size_t n, SyncTask task, void *data);
+
+/** @} */
+
+
+#endif  /* _SYNC_H */
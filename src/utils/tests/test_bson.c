@@ -222,6 +222,87 @@ MU_TEST(test_append_binary)
 
 
 
+MU_TEST(test_begin_binary_size)
+{
+  unsigned char doc[8];
+
+  /* With a too small buffer, the required size must be returned without
+     accessing the (here uninitialised) document */
+  memset(doc, 255, sizeof(doc));
+  mu_assert_int_eq(6+6, bson_begin_binary(doc, 0, "binary", NULL));
+  mu_assert_int_eq(6+6, bson_begin_binary(doc, sizeof(doc), "binary", NULL));
+  mu_assert_int_eq(1, bson_end_binary(doc, 0));
+}
+
+
+/* Callback for test_writer() */
+static int write_callback(const unsigned char *data, size_t size, void *ctx)
+{
+  size_t *count = ctx;
+  if (bson_docsize(data) != (int)size) return 1;
+  *count += size;
+  return 0;
+}
+
+MU_TEST(test_writer)
+{
+  unsigned char *doc, expected[] =
+    "\x31\x00\x00\x00"
+    "\x04" "BSON\x00"
+    "\x26\x00\x00\x00"
+    "\x02\x30\x00\x08\x00\x00\x00" "awesome\x00"
+    "\x01\x31\x00\x33\x33\x33\x33\x33\x33\x14\x40"
+    "\x10\x32\x00\xc2\x07\x00\x00"
+    "\x00";
+  double v1 = 5.05;
+  int32_t v2 = 1986;
+  size_t size, count=0;
+  int i;
+  BsonWriter w;
+
+  /* Same document as in test_subdoc(), but written to a growable buffer */
+  bson_writer_init(&w);
+  mu_assert_int_eq(0, bson_writer_begin_document(&w));
+  mu_assert_int_eq(0, bson_writer_begin_subdoc(&w, "BSON", bsonArray));
+  mu_assert_int_eq(0, bson_writer_append(&w, bsonString, "0", 7, "awesome"));
+  mu_assert_int_eq(0, bson_writer_append(&w, bsonDouble, "1", -1, &v1));
+  mu_assert_int_eq(0, bson_writer_append(&w, bsonInt32, "2", -1, &v2));
+  mu_check(bson_writer_end_document(&w) < 0);  /* subdoc not ended */
+  mu_assert_int_eq(0, bson_writer_end_subdoc(&w));
+  mu_assert_int_eq(0, bson_writer_end_document(&w));
+  doc = bson_writer_steal(&w, &size);
+  mu_assert_int_eq(0x31, size);
+  mu_check(memcmp(expected, doc, size) == 0);
+  free(doc);
+
+  /* Partially built binary element, growing the buffer several times */
+  bson_writer_init(&w);
+  mu_assert_int_eq(0, bson_writer_begin_document(&w));
+  mu_assert_int_eq(0, bson_writer_begin_binary(&w, "binary"));
+  for (i=0; i<1000; i++)
+    mu_assert_int_eq(0, bson_writer_append_binary(&w, 5, "4444"));
+  mu_assert_int_eq(0, bson_writer_end_binary(&w));
+  mu_assert_int_eq(0, bson_writer_end_document(&w));
+  doc = (unsigned char *)bson_writer_get(&w, &size);
+  mu_assert_int_eq(4 + 1 + 7 + 4 + 1 + 5000 + 1, size);
+  mu_assert_int_eq(size, bson_docsize(doc));
+  mu_assert_int_eq(1, bson_nelements(doc));
+  bson_writer_deinit(&w);
+
+  /* Each top-level document is passed to the callback when ended */
+  bson_writer_init_callback(&w, write_callback, &count);
+  for (i=0; i<3; i++) {
+    mu_assert_int_eq(0, bson_writer_begin_document(&w));
+    mu_assert_int_eq(0, bson_writer_append(&w, bsonInt32, "i", -1, &i));
+    mu_assert_int_eq(0, bson_writer_end_document(&w));
+    mu_assert_int_eq(0, w.pos);
+  }
+  mu_assert_int_eq(3 * 12, count);
+  mu_assert_int_eq(3 * 12, w.nwritten);
+  bson_writer_deinit(&w);
+}
+
+
 MU_TEST(test_parse)
 {
   unsigned char doc[1024], doc2[128], arr[128], *endptr;
@@ -434,6 +515,8 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_example2);
   MU_RUN_TEST(test_subdoc);
   MU_RUN_TEST(test_append_binary);
+  MU_RUN_TEST(test_begin_binary_size);
+  MU_RUN_TEST(test_writer);
   MU_RUN_TEST(test_parse);
   MU_RUN_TEST(test_issue556);
 }
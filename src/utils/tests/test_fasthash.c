@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fasthash.h"
+#include "strutils.h"
+
+#include "minunit/minunit.h"
+
+
+const char *testhash(const void *data, size_t n, uint64_t seed, size_t size)
+{
+  static char buf[2*FASTHASH_MAXSIZE+1];
+  unsigned char hash[FASTHASH_MAXSIZE];
+  fasthash(data, n, seed, hash, size);
+  strhex_encode(buf, sizeof(buf), hash, size);
+  return buf;
+}
+
+
+MU_TEST(test_vectors)
+{
+  /* Regression values - the digests must never change, since they may
+     be stored, e.g. as hashes of transaction parents */
+  mu_assert_string_eq("2d7fe02d10110db47fa03a2ae9546be3",
+                      testhash("", 0, 0, 16));
+  mu_assert_string_eq("1ccd023cd43d65e7f47d2eacf207c5fc",
+                      testhash("abc", 3, 0, 16));
+}
+
+
+MU_TEST(test_chunks)
+{
+  size_t i, n=5000;
+  unsigned char *data = malloc(n);
+  unsigned char h1[32], h2[32];
+  FastHash h;
+  for (i=0; i<n; i++) data[i] = (unsigned char)(i * 7 + (i >> 8));
+
+  /* The digest is independent of how the input is split up */
+  fasthash(data, n, 3, h1, sizeof(h1));
+  fasthash_init(&h, 3);
+  for (i=0; i<n; ) {
+    size_t m = (i % 13) * 11 + 1;
+    if (i + m > n) m = n - i;
+    fasthash_update(&h, data + i, m);
+    i += m;
+  }
+  fasthash_final(&h, h2, sizeof(h2));
+  mu_check(memcmp(h1, h2, sizeof(h1)) == 0);
+
+  /* Finalising does not modify the state */
+  fasthash_final(&h, h2, sizeof(h2));
+  mu_check(memcmp(h1, h2, sizeof(h1)) == 0);
+
+  /* Shorter digests are prefixes of longer */
+  fasthash(data, n, 3, h2, 10);
+  mu_check(memcmp(h1, h2, 10) == 0);
+
+  free(data);
+}
+
+
+MU_TEST(test_sensitivity)
+{
+  unsigned char a[1024], b[1024];
+  unsigned char h1[16], h2[16];
+  memset(a, 0, sizeof(a));
+
+  /* Seed */
+  fasthash(a, sizeof(a), 0, h1, 16);
+  fasthash(a, sizeof(a), 1, h2, 16);
+  mu_check(memcmp(h1, h2, 16));
+
+  /* Length of zero-padded input */
+  fasthash(a, 100, 0, h1, 16);
+  fasthash(a, 101, 0, h2, 16);
+  mu_check(memcmp(h1, h2, 16));
+
+  /* Order of stripes */
+  memcpy(b, a, sizeof(b));
+  a[0] = 1;
+  b[64] = 1;
+  fasthash(a, sizeof(a), 0, h1, 16);
+  fasthash(b, sizeof(b), 0, h2, 16);
+  mu_check(memcmp(h1, h2, 16));
+
+  /* Single bit in the last block */
+  memcpy(b, a, sizeof(b));
+  b[1000] ^= 0x10;
+  fasthash(a, sizeof(a), 0, h1, 16);
+  fasthash(b, sizeof(b), 0, h2, 16);
+  mu_check(memcmp(h1, h2, 16));
+}
+
+
+/***********************************************************************/
+
+MU_TEST_SUITE(test_suite)
+{
+  MU_RUN_TEST(test_vectors);
+  MU_RUN_TEST(test_chunks);
+  MU_RUN_TEST(test_sensitivity);
+}
+
+
+
+int main()
+{
+  MU_RUN_SUITE(test_suite);
+  MU_REPORT();
+  return (minunit_fail) ? 1 : 0;
+}
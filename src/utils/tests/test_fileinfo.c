@@ -69,6 +69,18 @@ MU_TEST(test_isreadable)
   mu_check( fileinfo_isreadable(abs_file));
 }
 
+MU_TEST(test_stamp)
+{
+  FileStamp a, b;
+  mu_check(fileinfo_stamp("...", &a));
+  mu_check(!fileinfo_stamp(abs_file, &a));
+  mu_check(a.size > 0);
+  mu_check(!fileinfo_stamp(abs_file, &b));
+  mu_check(fileinfo_stamp_equal(&a, &b));
+  mu_check(!fileinfo_stamp(abs_dir, &b));
+  mu_check(!fileinfo_stamp_equal(&a, &b));
+}
+
 
 /***********************************************************************/
 
@@ -78,6 +90,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_isdir);
   MU_RUN_TEST(test_isnormal);
   MU_RUN_TEST(test_isreadable);
+  MU_RUN_TEST(test_stamp);
 }
 
 
@@ -93,6 +93,8 @@ MU_TEST(test_infixcalc)
   mu_assert_int_eq(INT_MIN, calc("(*)", NULL, 0));
   mu_assert_int_eq(INT_MIN, calc("", NULL, 0));
   mu_assert_int_eq(INT_MIN, calc(" ", NULL, 0));
+  mu_assert_int_eq(INT_MIN, calc("5 / 0", NULL, 0));
+  mu_assert_int_eq(INT_MIN, calc("5 % (2-2)", NULL, 0));
 
   /* Test variables */
   mu_assert_int_eq(0,  calc("zero", vars, nvars));
@@ -106,11 +108,64 @@ MU_TEST(test_infixcalc)
   mu_assert_int_eq(50, calc("ten*(M+N)", vars, nvars));
 }
 
+
+MU_TEST(test_infixcalc_compile)
+{
+  InfixCalcVariable vars[] = {
+    {"N", 3},
+    {"M", 2},
+    {"ten", 10},
+    {"zero", 0},
+    {"m", -1}
+  };
+  size_t nvars = sizeof(vars)/sizeof(InfixCalcVariable);
+  char *exprs[] = {
+    "2+2", "5/2", "5%2", "3^2", " 2 + 2 ", "2 + 3 * 4", "2 * (3 + 4)",
+    "2 * ((3^2 + 4) - 3)", "1", "0 | 10", "1 & 0", "5 ! 6", "5 < 6", "(2)",
+    "2 - 3 - 4", "(N+zero)*m", "N+zero*m", "ten*(M+N)", "2^M^N", "m",
+    "-1", "1--1", "+", "a", "5 / pi", "0.5", "1 1", "3 +", "3 + ( 4",
+    "3 + )4 * 5)", "3 + 4) * 5", "( )", "(*)", "", " ", NULL
+  };
+  char **p, err[256];
+  InfixCalcExpr *cexpr;
+
+  for (p=exprs; *p; p++) {
+    int expected = infixcalc(*p, vars, nvars, NULL, 0);
+    if (expected == INT_MIN) {
+      mu_check(!infixcalc_compile(*p, vars, nvars, err, sizeof(err)));
+      mu_check(err[0]);
+    } else {
+      mu_check((cexpr = infixcalc_compile(*p, vars, nvars, err, sizeof(err))));
+      mu_assert_int_eq(expected, infixcalc_eval(cexpr, vars, nvars, NULL, 0));
+      infixcalc_free(cexpr);
+    }
+  }
+
+  /* infixcalc() cannot handle this, but the compiler should */
+  mu_check(!infixcalc_compile(")", vars, nvars, err, sizeof(err)));
+
+  /* variables are looked up by position when evaluating */
+  mu_check((cexpr = infixcalc_compile("M*N + 1", vars, 2, NULL, 0)));
+  mu_assert_int_eq(7, infixcalc_eval(cexpr, vars, nvars, NULL, 0));
+  vars[0].value = 5;
+  mu_assert_int_eq(11, infixcalc_eval(cexpr, vars, nvars, NULL, 0));
+  mu_assert_int_eq(INT_MIN, infixcalc_eval(cexpr, vars, 1, err, sizeof(err)));
+  infixcalc_free(cexpr);
+
+  /* division by zero is an evaluation error */
+  mu_check((cexpr = infixcalc_compile("N / zero", vars, nvars, NULL, 0)));
+  mu_assert_int_eq(INT_MIN, infixcalc_eval(cexpr, vars, nvars,
+                                           err, sizeof(err)));
+  mu_assert_string_eq("division by zero", err);
+  infixcalc_free(cexpr);
+}
+
 /***********************************************************************/
 
 MU_TEST_SUITE(test_suite)
 {
   MU_RUN_TEST(test_infixcalc);
+  MU_RUN_TEST(test_infixcalc_compile);
 }
 
 
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -140,6 +141,32 @@ MU_TEST(test_label)
   mu_assert_string_eq(NULL, label);
 }
 
+MU_TEST(test_attach_file)
+{
+  /* The attached source is NUL-terminated, also when the file size is
+     a multiple of the page size */
+  size_t sizes[] = {10, 4096, 8192}, i, len;
+  for (i=0; i<sizeof(sizes)/sizeof(sizes[0]); i++) {
+    JStore *js2 = jstore_open();
+    const char *src;
+    FILE *fp = fopen("jstore-attach.json", "wb");
+    size_t j;
+    mu_check(fp);
+    fputc('"', fp);
+    for (j=2; j<sizes[i]; j++) fputc('a' + j % 26, fp);
+    fputc('"', fp);
+    fclose(fp);
+
+    src = jstore_attach_file(js2, "jstore-attach.json", &len);
+    mu_check(src);
+    mu_assert_int_eq(sizes[i], len);
+    mu_assert_int_eq('"', src[len-1]);
+    mu_assert_int_eq('\0', src[len]);
+    jstore_close(js2);
+  }
+  remove("jstore-attach.json");
+}
+
 MU_TEST(test_close)
 {
   jstore_close(js);
@@ -164,6 +191,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_update_file);
   MU_RUN_TEST(test_iter);
   MU_RUN_TEST(test_label);
+  MU_RUN_TEST(test_attach_file);
   MU_RUN_TEST(test_close);
 }
 
@@ -0,0 +1,131 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numscan.h"
+
+#include "minunit/minunit.h"
+
+
+MU_TEST(test_int64)
+{
+  int64_t v;
+  mu_assert_int_eq(3, numscan_int64("123", 3, &v));
+  mu_check(v == 123);
+  mu_assert_int_eq(2, numscan_int64("-7,", 3, &v));
+  mu_check(v == -7);
+  mu_assert_int_eq(2, numscan_int64("4567", 2, &v));
+  mu_check(v == 45);
+  mu_assert_int_eq(19, numscan_int64("9223372036854775807", 19, &v));
+  mu_check(v == INT64_MAX);
+  mu_assert_int_eq(20, numscan_int64("-9223372036854775808", 20, &v));
+  mu_check(v == INT64_MIN);
+
+  /* Not handled */
+  mu_assert_int_eq(0, numscan_int64("9223372036854775808", 19, &v));
+  mu_assert_int_eq(0, numscan_int64("0x1f", 4, &v));
+  mu_assert_int_eq(0, numscan_int64("017", 3, &v));
+  mu_assert_int_eq(0, numscan_int64("-", 1, &v));
+  mu_assert_int_eq(0, numscan_int64("abc", 3, &v));
+  mu_assert_int_eq(0, numscan_int64("1", 0, &v));
+}
+
+MU_TEST(test_uint64)
+{
+  uint64_t v;
+  mu_assert_int_eq(1, numscan_uint64("0", 1, &v));
+  mu_check(v == 0);
+  mu_assert_int_eq(20, numscan_uint64("18446744073709551615", 20, &v));
+  mu_check(v == UINT64_MAX);
+
+  mu_assert_int_eq(0, numscan_uint64("18446744073709551616", 20, &v));
+  mu_assert_int_eq(0, numscan_uint64("-1", 2, &v));
+  mu_assert_int_eq(0, numscan_uint64("0x10", 4, &v));
+}
+
+MU_TEST(test_double)
+{
+  double v;
+  mu_assert_int_eq(3, numscan_double("1.5", 3, &v));
+  mu_assert_double_eq(1.5, v);
+  mu_assert_int_eq(7, numscan_double("-2.5e-3", 7, &v));
+  mu_check(v == -2.5e-3);
+  mu_assert_int_eq(2, numscan_double("-0", 2, &v));
+  mu_check(v == 0.0 && signbit(v));
+  mu_assert_int_eq(4, numscan_double("1E10", 4, &v));
+  mu_check(v == 1e10);
+  mu_assert_int_eq(2, numscan_double("3.", 2, &v));
+  mu_check(v == 3.0);
+
+  /* A dangling exponent is not consumed */
+  mu_assert_int_eq(1, numscan_double("1e", 2, &v));
+  mu_check(v == 1.0);
+
+  /* Only `len` characters are consumed */
+  mu_assert_int_eq(3, numscan_double("1.25", 3, &v));
+  mu_check(v == 1.2);
+
+  /* Slow path */
+  mu_assert_int_eq(23, numscan_double("2.2250738585072014e-308", 23, &v));
+  mu_check(v == 2.2250738585072014e-308);
+  mu_assert_int_eq(20, numscan_double("0.100000000000000005", 20, &v));
+  mu_check(v == 0.1);
+  mu_assert_int_eq(5, numscan_double("1e400]", 6, &v));
+  mu_check(isinf(v));
+
+  mu_assert_int_eq(0, numscan_double("nan", 3, &v));
+  mu_assert_int_eq(0, numscan_double(".", 1, &v));
+  mu_assert_int_eq(0, numscan_double("-e3", 3, &v));
+}
+
+MU_TEST(test_float)
+{
+  float v;
+  mu_assert_int_eq(3, numscan_float("0.1f", 4, &v));
+  mu_check(v == 0.1f);
+  mu_assert_int_eq(12, numscan_float("3.4028235e38", 12, &v));
+  mu_check(v == 3.4028235e38f);
+  mu_assert_int_eq(0, numscan_float("inf", 3, &v));
+}
+
+/* Compare with strtod() for numbers printed with different precisions */
+MU_TEST(test_roundtrip)
+{
+  char buf[64];
+  int i, prec, n, nfail=0;
+  srand(1);
+  for (i=0; i<20000; i++) {
+    double x = ldexp((double)rand() / RAND_MAX, rand() % 200 - 100);
+    if (i % 2) x = -x;
+    for (prec=1; prec<=17; prec+=4) {
+      double v;
+      float f;
+      n = snprintf(buf, sizeof(buf), "%.*g", prec, x);
+      if (numscan_double(buf, n, &v) != n || v != strtod(buf, NULL)) nfail++;
+      if (numscan_float(buf, n, &f) != n || f != strtof(buf, NULL)) nfail++;
+    }
+  }
+  mu_assert_int_eq(0, nfail);
+}
+
+
+/***********************************************************************/
+
+MU_TEST_SUITE(test_suite)
+{
+  MU_RUN_TEST(test_int64);
+  MU_RUN_TEST(test_uint64);
+  MU_RUN_TEST(test_double);
+  MU_RUN_TEST(test_float);
+  MU_RUN_TEST(test_roundtrip);
+}
+
+
+
+int main()
+{
+  MU_RUN_SUITE(test_suite);
+  MU_REPORT();
+  return (minunit_fail) ? 1 : 0;
+}
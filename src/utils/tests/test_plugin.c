@@ -20,6 +20,7 @@ MU_TEST(test_info_create)
   mu_check((info = plugin_info_create("TestPlugin", "get_testapi", NULL, NULL)));
             //"TEST_PLUGIN_PATH")));
   mu_assert_int_eq(0, plugin_path_append(info, path));
+  mu_assert_int_eq(0, plugin_info_set_api_version(info, 2));
 }
 
 
@@ -30,6 +31,10 @@ MU_TEST(test_get_api)
   mu_assert_string_eq("testapi", api->name);
   mu_assert_int_eq(4, api->fun1(1, 3));
   mu_assert_double_eq(6.28, api->fun2(3.14));
+
+  /* The test plugin only provides the unversioned get_testapi() */
+  mu_assert_int_eq(1, plugin_api_version(info, "testapi"));
+  mu_assert_int_eq(0, plugin_api_version(info, "xxx"));
 }
 
 
@@ -49,6 +54,35 @@ MU_TEST(test_iter)
 }
 
 
+MU_TEST(test_manifest)
+{
+  const TestAPI *api;
+  char *manifest = STRINGIFY(BINDIR) "/test_plugin.manifest";
+  int valid;
+  plugin_load_all(info);
+  mu_assert_int_eq(0, plugin_manifest_write(info, manifest, "key1"));
+  mu_assert_int_eq(0, plugin_unload(info, "testapi"));
+  mu_check(!plugin_has_api(info, "testapi"));
+
+  /* Wrong key */
+  mu_check(!plugin_manifest_get_api(info, manifest, "key2", "testapi",
+                                    &valid));
+  mu_assert_int_eq(0, valid);
+
+  /* Not provided by any plugin */
+  mu_check(!plugin_manifest_get_api(info, manifest, "key1", "xxx", &valid));
+  mu_assert_int_eq(1, valid);
+
+  mu_check((api = (const TestAPI *)
+            plugin_manifest_get_api(info, manifest, "key1", "testapi",
+                                    &valid)));
+  mu_assert_int_eq(1, valid);
+  mu_assert_string_eq("testapi", api->name);
+  mu_assert_int_eq(4, api->fun1(1, 3));
+  remove(manifest);
+}
+
+
 MU_TEST(test_unload)
 {
  ErrTry:
@@ -73,6 +107,7 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_info_create);       /* setup */
   MU_RUN_TEST(test_get_api);
   MU_RUN_TEST(test_iter);
+  MU_RUN_TEST(test_manifest);
   MU_RUN_TEST(test_unload);
   MU_RUN_TEST(test_info_free);         /* tear down */
 }
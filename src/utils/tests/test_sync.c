@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "sync.h"
+
+#include "minunit/minunit.h"
+
+#define NTHREADS 8
+#define NITER 10000
+
+static Mutex mutex = MUTEX_INITIALIZER;
+static RWLock rwlock = RWLOCK_INITIALIZER;
+static int counter = 0;     /* protected by `mutex` */
+static int atomic_counter = 0;
+
+
+static void *worker(void *arg)
+{
+  int i;
+  (void)arg;
+  for (i=0; i<NITER; i++) {
+    mutex_lock(&mutex);
+    counter++;
+    mutex_unlock(&mutex);
+    sync_add_int(&atomic_counter, 1);
+
+    rwlock_rdlock(&rwlock);
+    rwlock_rdunlock(&rwlock);
+  }
+  return NULL;
+}
+
+
+MU_TEST(test_mutex)
+{
+  Mutex m;
+  mu_assert_int_eq(0, mutex_init(&m));
+  mu_assert_int_eq(0, mutex_lock(&m));
+  mu_assert_int_eq(0, mutex_unlock(&m));
+  mutex_destroy(&m);
+}
+
+MU_TEST(test_rwlock)
+{
+  RWLock l;
+  mu_assert_int_eq(0, rwlock_init(&l));
+  mu_assert_int_eq(0, rwlock_rdlock(&l));
+  mu_assert_int_eq(0, rwlock_rdlock(&l));
+  mu_assert_int_eq(0, rwlock_rdunlock(&l));
+  mu_assert_int_eq(0, rwlock_rdunlock(&l));
+  mu_assert_int_eq(0, rwlock_wrlock(&l));
+  mu_assert_int_eq(0, rwlock_wrunlock(&l));
+  rwlock_destroy(&l);
+}
+
+MU_TEST(test_atomic)
+{
+  int n = 5;
+  void *p = NULL;
+  mu_assert_int_eq(6, sync_add_int(&n, 1));
+  mu_assert_int_eq(4, sync_add_int(&n, -2));
+  mu_assert_int_eq(0, sync_cas_int(&n, 3, 10));
+  mu_assert_int_eq(4, sync_load_int(&n));
+  mu_assert_int_eq(1, sync_cas_int(&n, 4, 10));
+  mu_assert_int_eq(10, sync_load_int(&n));
+
+  mu_check(sync_load_ptr(&p) == NULL);
+  sync_store_ptr(&p, &n);
+  mu_check(sync_load_ptr(&p) == &n);
+}
+
+MU_TEST(test_threads)
+{
+#ifdef SYNC_PTHREADS
+  int i;
+  pthread_t threads[NTHREADS];
+  for (i=0; i<NTHREADS; i++)
+    mu_assert_int_eq(0, pthread_create(threads+i, NULL, worker, NULL));
+  for (i=0; i<NTHREADS; i++)
+    pthread_join(threads[i], NULL);
+  mu_assert_int_eq(NTHREADS*NITER, counter);
+  mu_assert_int_eq(NTHREADS*NITER, atomic_counter);
+#else
+  worker(NULL);
+  mu_assert_int_eq(NITER, counter);
+  mu_assert_int_eq(NITER, atomic_counter);
+#endif
+}
+
+
+#define NTASKS 1000
+
+static void square(size_t i, void *data)
+{
+  int *values = data;
+  values[i] = (int)(i*i);
+  sync_add_int(&values[NTASKS], 1);
+}
+
+MU_TEST(test_parallel_for)
+{
+  int values[NTASKS+1];
+  size_t i;
+  mu_check(sync_nprocessors() >= 1);
+
+  memset(values, 0, sizeof(values));
+  sync_parallel_for(4, NTASKS, square, values);
+  for (i=0; i<NTASKS; i++) mu_assert_int_eq((int)(i*i), values[i]);
+  mu_assert_int_eq(NTASKS, values[NTASKS]);
+
+  /* Serial and default number of workers */
+  values[NTASKS] = 0;
+  sync_parallel_for(1, NTASKS, square, values);
+  sync_parallel_for(0, NTASKS, square, values);
+  mu_assert_int_eq(2*NTASKS, values[NTASKS]);
+
+  sync_parallel_for(4, 0, square, values);
+  mu_assert_int_eq(2*NTASKS, values[NTASKS]);
+}
+
+
+/***********************************************************************/
+
+MU_TEST_SUITE(test_suite)
+{
+  MU_RUN_TEST(test_mutex);
+  MU_RUN_TEST(test_rwlock);
+  MU_RUN_TEST(test_atomic);
+  MU_RUN_TEST(test_threads);
+  MU_RUN_TEST(test_parallel_for);
+}
+
+
+
+int main()
+{
+  MU_RUN_SUITE(test_suite);
+  MU_REPORT();
+  return (minunit_fail) ? 1 : 0;
+}
@@ -5,6 +5,10 @@
  * under the terms of the MIT license. See LICENSE for details.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
 #include <time.h>
 
@@ -26,20 +30,22 @@
 int uuid4_generate(char *dst) {
   static const char *template = "xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx";
   static const char *chars = "0123456789abcdef";
-  static int seeded = 0;
+  /* Thread local state, such that threads never share random sequence */
+  static _thread_local MSWS64State state;
+  static _thread_local int seeded = 0;
   union { unsigned char b[16]; uint64_t word[2]; } s;
   const char *p;
   int i, n;
 
   /* seed? */
   if (!seeded) {
-    srand_msws64(0);
+    srand_msws64_r(&state, 0);
     seeded = 1;
   }
 
   /* get random */
-  s.word[0] = rand_msws64();
-  s.word[1] = rand_msws64();
+  s.word[0] = rand_msws64_r(&state);
+  s.word[1] = rand_msws64_r(&state);
 
   /* build string */
   p = template;
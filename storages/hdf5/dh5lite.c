@@ -11,6 +11,7 @@
 
 #include "boolean.h"
 #include "utils/err.h"
+#include "utils/strtob.h"
 
 #include "dlite.h"
 #include "dlite-datamodel.h"
@@ -20,11 +21,17 @@
 /* Macro for getting rid of unused parameter warnings... */
 #define UNUSED(x) (void)(x)
 
+/* Default chunk size in bytes when compression is enabled */
+#define DH5_DEFAULT_CHUNKSIZE 1048576
+
 
 /* Storage for hdf5 backend. */
 typedef struct {
   DLiteStorage_HEAD
   hid_t root;       /* h5 file identifier to root */
+  size_t chunksize; /* target size of dataset chunks in bytes, 0: contiguous */
+  int compression;  /* deflate compression level, 0: no compression */
+  int shuffle;      /* whether to apply the shuffle filter */
 } DH5Storage;
 
 
@@ -107,18 +114,22 @@ static hid_t get_memtype(DLiteType type, size_t size)
 
 /* Returns the HDF5 data space identifier corresponding to `ndims` and `shape`.
    If ` shape` is NULL, length of all dimensions are assumed to be one.
+   If `unlimited` is non-zero, the maximum size of all dimensions are
+   unlimited, which allows chunked datasets to be resized.
    Returns -1 on error.
 
    On success, the returned identifier should be closed with H5Sclose(). */
-static hid_t get_space(size_t ndims, const size_t *shape)
+static hid_t get_space(size_t ndims, const size_t *shape, int unlimited)
 {
   hid_t space=-1;
-  hsize_t *hdims=NULL;
+  hsize_t *hdims=NULL, *maxdims=NULL;
   size_t i;
-  if (!(hdims = calloc(ndims, sizeof(hsize_t))))
+  if (!(hdims = calloc(2*ndims + 1, sizeof(hsize_t))))
     return err(dliteMemoryError, "allocation failure");
+  if (unlimited) maxdims = hdims + ndims;
   for (i=0; i<ndims; i++) hdims[i] = (shape) ? shape[i] : 1;
-  if ((space = H5Screate_simple(ndims, hdims, NULL)) < 0)
+  for (i=0; maxdims && i<ndims; i++) maxdims[i] = H5S_UNLIMITED;
+  if ((space = H5Screate_simple(ndims, hdims, maxdims)) < 0)
     space = errx(dliteIOError, "cannot create hdf5 data space");
  /* fail: */
   if (hdims) free(hdims);
@@ -126,6 +137,52 @@ static hid_t get_space(size_t ndims, const size_t *shape)
 }
 
 
+/* Returns a dataset creation property list for a dataset with `ndims`
+   dimensions, shape `shape` and elements of `size` bytes.  The chunk shape
+   is derived from the chunk size of storage `s` by repeatedly halving the
+   largest dimension until a chunk fits.  The deflate and shuffle filters
+   are added if requested.
+
+   Returns H5P_DEFAULT for contiguous datasets and -1 on error.  Other
+   returned identifiers should be closed with H5Pclose(). */
+static hid_t get_dcpl(const DH5Storage *s, size_t ndims, const size_t *shape,
+                      size_t size)
+{
+  hid_t dcpl=-1;
+  hsize_t *chunk=NULL;
+  size_t i, j, nbytes, chunksize=s->chunksize;
+
+  if (!ndims || (!chunksize && !s->compression)) return H5P_DEFAULT;
+  if (!chunksize) chunksize = DH5_DEFAULT_CHUNKSIZE;
+
+  if (!(chunk = calloc(ndims, sizeof(hsize_t))))
+    return err(dliteMemoryError, "allocation failure");
+  for (i=0; i<ndims; i++) chunk[i] = (shape && shape[i]) ? shape[i] : 1;
+  while (1) {
+    for (nbytes=size, i=0; i<ndims; i++) nbytes *= chunk[i];
+    if (nbytes <= chunksize) break;
+    for (j=0, i=1; i<ndims; i++) if (chunk[i] > chunk[j]) j = i;
+    if (chunk[j] == 1) break;
+    chunk[j] = (chunk[j] + 1) / 2;
+  }
+
+  if ((dcpl = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+    FAILCODE(dliteIOError, "cannot create hdf5 dataset creation properties");
+  if (H5Pset_chunk(dcpl, ndims, chunk) < 0)
+    FAILCODE(dliteIOError, "cannot set hdf5 chunk shape");
+  if (s->shuffle && H5Pset_shuffle(dcpl) < 0)
+    FAILCODE(dliteIOError, "cannot add hdf5 shuffle filter");
+  if (s->compression && H5Pset_deflate(dcpl, s->compression) < 0)
+    FAILCODE(dliteIOError, "cannot add hdf5 deflate filter");
+  free(chunk);
+  return dcpl;
+ fail:
+  if (dcpl > 0) H5Pclose(dcpl);
+  free(chunk);
+  return -1;
+}
+
+
 /* Returns DLiteType corresponding to hdf5 dtype.
 
    Note: bool is returned ad int (since we store it as int). */
@@ -163,14 +220,20 @@ static DLiteType get_type(hid_t dtype)
    data element, `ndims` is the number of dimensions and ` shape` is an
    array of dimension sizes.
 
+   If `start` is not NULL, only the hyperslab starting at index `start`
+   with extent `shape` is read.  `start` must then have `ndims` elements
+   and the dataset must have `ndims` dimensions.
+
    Returns non-zero on error.
  */
 static int get_data(const DLiteDataModel *d, hid_t group,
                     const char *name, void *ptr,
                     DLiteType type, size_t size,
-                    size_t ndims, const size_t *shape)
+                    size_t ndims, const size_t *shape,
+                    const size_t *start)
 {
   hid_t memtype=0, space=0, dspace=0, dset=0, dtype=0;
+  hid_t memspace=H5S_ALL, filespace=H5S_ALL;
   htri_t isvariable;
   herr_t stat;
   hsize_t *ddims=NULL;
@@ -181,7 +244,7 @@ static int get_data(const DLiteDataModel *d, hid_t group,
 
   errno=0;
   if ((memtype = get_memtype(type, size)) < 0) goto fail;
-  if ((space = get_space(ndims, shape)) < 0) goto fail;
+  if ((space = get_space(ndims, shape, 0)) < 0) goto fail;
 
   /* Get: dset, dtype, dsize, dspace, dndims, ddims, */
   if ((dset = H5Dopen2(group, name, H5P_DEFAULT)) < 0)
@@ -194,13 +257,38 @@ static int get_data(const DLiteDataModel *d, hid_t group,
     DFAIL1(dliteStorageLoadError, d, "cannot get data space of '%s'", name);
   if ((dndims = H5Sget_simple_extent_ndims(dspace)) < 0)
     DFAIL1(dliteStorageLoadError, d, "cannot get number of dimimensions of '%s'", name);
-  if (!(ddims = calloc(dndims, sizeof(hsize_t))))
+  if (!(ddims = calloc(3*dndims + 1, sizeof(hsize_t))))
     FAILCODE(dliteMemoryError, "allocation failure");
   if ((stat = H5Sget_simple_extent_dims(dspace, ddims, NULL)) < 0)
     DFAIL1(dliteStorageLoadError, d, "cannot get shape of '%s'", name);
 
+  /* Select hyperslab */
+  if (start) {
+    hsize_t *hstart=ddims+dndims, *hcount=ddims+2*dndims;
+    if (dndims != (int)ndims || !ndims)
+      DFAIL3(dliteIndexError, d,
+             "trying to read slab of '%s' with ndims=%d, but ndims=%d",
+             name, (int)ndims, dndims);
+    for (i=0; i<ndims; i++) {
+      if (start[i] > ddims[i] || shape[i] > ddims[i] - start[i])
+        DFAIL4(dliteIndexError, d,
+               "slab of '%s' exceeds dimension %d: start=%d, count=%d",
+               name, (int)i, (int)start[i], (int)shape[i]);
+      hstart[i] = start[i];
+      hcount[i] = shape[i];
+    }
+    if (H5Sselect_hyperslab(dspace, H5S_SELECT_SET, hstart, NULL,
+                            hcount, NULL) < 0)
+      DFAIL1(dliteStorageLoadError, d, "cannot select hyperslab of '%s'",
+             name);
+    memspace = space;
+    filespace = dspace;
+  }
+
   /* Check that dimensions matches */
-  if (dndims == 0 && ndims == 1)
+  if (start)
+    ;  /* checked above */
+  else if (dndims == 0 && ndims == 1)
     dndims++;
   else if (dndims != (int)ndims) {
     DFAIL3(dliteIndexError, d, "trying to read '%s' with ndims=%d, but ndims=%d",
@@ -243,7 +331,8 @@ static int get_data(const DLiteDataModel *d, hid_t group,
            dlite_type_get_dtypename(savedtype));
   }
 
-  if ((stat = H5Dread(dset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buff)) < 0)
+  if ((stat = H5Dread(dset, memtype, memspace, filespace, H5P_DEFAULT,
+                      buff)) < 0)
     DFAIL1(dliteStorageLoadError, d, "cannot read dataset '%s'", name);
 
 #if _WIN32
@@ -298,45 +387,105 @@ static int get_data(const DLiteDataModel *d, hid_t group,
    data element, `ndims` is the number of dimensions and ` shape` is an
    array of dimension sizes.
 
+   An existing dataset with the same type and number of dimensions is
+   overwritten in place.  If its shape differs, it is resized if it is
+   chunked and recreated otherwise.  New datasets are created with the
+   chunking and filters configured for storage `s`.
+
    Returns non-zero on error.
  */
-static int set_data(DLiteDataModel *d, hid_t group,
-                    const char *name, const void *ptr,
-                    DLiteType type, size_t size,
-                    size_t ndims, const size_t *shape)
+static int write_data(const DH5Storage *s, hid_t group,
+                      const char *name, const void *ptr,
+                      DLiteType type, size_t size,
+                      size_t ndims, const size_t *shape)
 {
-  hid_t memtype=0, space=0, dset=0;
-  herr_t stat;
+  hid_t memtype=0, space=0, dspace=0, dset=0, dtype=0, dcpl=H5P_DEFAULT;
+  hsize_t *ddims=NULL, *dmax=NULL;
   htri_t exists;
+  size_t i;
   int retval=-1;
 
   errno=0;
+  if ((memtype = get_memtype(type, size)) < 0) goto fail;
   if ((exists = H5Lexists(group, name, H5P_DEFAULT)) < 0)
-    DFAIL1(dliteAttributeError, d, "cannot determine if dataset '%s' already exists", name);
-
-  /* Delete dataset if it already exists */
-  if (exists && H5Ldelete(group, name, H5P_DEFAULT) < 0)
-    DFAIL1(dliteIOError, d, "cannot delete dataset '%s' for overwrite", name);
+    FAILCODE2(dliteAttributeError,
+              "cannot determine if dataset '%s' already exists in %s",
+              name, s->location);
 
-  if ((memtype = get_memtype(type, size)) < 0) goto fail;
-  if ((space = get_space(ndims, shape)) < 0) goto fail;
+  /* Try to reuse existing dataset */
+  if (exists) {
+    int reuse=0;
+    if ((dset = H5Dopen2(group, name, H5P_DEFAULT)) < 0 ||
+        (dtype = H5Dget_type(dset)) < 0 ||
+        (dspace = H5Dget_space(dset)) < 0)
+      FAILCODE2(dliteIOError, "cannot open dataset '%s' in %s",
+                name, s->location);
+    if (H5Tequal(dtype, memtype) > 0 &&
+        H5Sget_simple_extent_ndims(dspace) == (int)ndims) {
+      if (!(ddims = calloc(2*ndims + 1, sizeof(hsize_t))))
+        FAILCODE(dliteMemoryError, "allocation failure");
+      dmax = ddims + ndims;
+      if (H5Sget_simple_extent_dims(dspace, ddims, dmax) < 0)
+        FAILCODE2(dliteIOError, "cannot get shape of '%s' in %s",
+                  name, s->location);
+      reuse = 1;
+      for (i=0; i<ndims; i++)
+        if (ddims[i] != (hsize_t)((shape) ? shape[i] : 1)) break;
+      if (i < ndims) {
+        for (i=0; i<ndims; i++) {
+          ddims[i] = (shape) ? shape[i] : 1;
+          if (dmax[i] != H5S_UNLIMITED && ddims[i] > dmax[i]) reuse = 0;
+        }
+        if (reuse && H5Dset_extent(dset, ddims) < 0) reuse = 0;
+      }
+    }
+    if (!reuse) {
+      H5Dclose(dset);
+      dset = 0;
+      if (H5Ldelete(group, name, H5P_DEFAULT) < 0)
+        FAILCODE2(dliteIOError, "cannot delete dataset '%s' in %s for "
+                  "overwrite", name, s->location);
+    }
+  }
 
-  if ((dset = H5Dcreate(group, name, memtype, space,
-                        H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT)) < 0)
-    DFAIL1(dliteIOError, d, "cannot create dataset '%s'", name);
+  if (!dset) {
+    if ((dcpl = get_dcpl(s, ndims, shape, size)) < 0) goto fail;
+    if ((space = get_space(ndims, shape, dcpl != H5P_DEFAULT)) < 0)
+      goto fail;
+    if ((dset = H5Dcreate(group, name, memtype, space,
+                          H5P_DEFAULT, dcpl, H5P_DEFAULT)) < 0)
+      FAILCODE2(dliteIOError, "cannot create dataset '%s' in %s",
+                name, s->location);
+  }
 
-  if ((stat = H5Dwrite(dset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, ptr)) < 0)
-    DFAIL1(dliteIOError, d, "cannot write dataset '%s'", name);
+  if (H5Dwrite(dset, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, ptr) < 0)
+    FAILCODE2(dliteIOError, "cannot write dataset '%s' in %s",
+              name, s->location);
 
   retval = 0;
  fail:
   if (dset > 0) H5Dclose(dset);
+  if (dtype > 0) H5Tclose(dtype);
+  if (dspace > 0) H5Sclose(dspace);
   if (space > 0) H5Sclose(space);
+  if (dcpl > 0 && dcpl != H5P_DEFAULT) H5Pclose(dcpl);
   if (memtype > 0) H5Tclose(memtype);
+  if (ddims) free(ddims);
   return retval;
 }
 
 
+/* Like write_data(), but for the datamodel api. */
+static int set_data(DLiteDataModel *d, hid_t group,
+                    const char *name, const void *ptr,
+                    DLiteType type, size_t size,
+                    size_t ndims, const size_t *shape)
+{
+  return write_data((DH5Storage *)d->s, group, name, ptr, type, size,
+                    ndims, shape);
+}
+
+
 #if 0
 /* Deletes dataset `name` from group `group`. Returns -1 on error. */
 static int delete_data(DLiteDataModel *d, hid_t group, const char *name)
@@ -418,6 +567,19 @@ static void entrylist_free(EntryList *e)
     a    Append: open existing file for read and write
     w    Write: truncate existing file or create new file
 
+  - chunk-size : int
+      Target size in bytes of each chunk of new array datasets.  The
+      chunk shape is derived from the shape of the property.  Arrays
+      are stored contiguous if neither `chunk-size` nor `compression`
+      is given.
+  - compression : 0-9
+      Deflate compression level for new array datasets.  Zero means no
+      compression.  Implies chunking, with a default chunk size of 1 MiB.
+  - shuffle : yes | no
+      Whether to apply the shuffle filter before compression.
+
+  Existing datasets are overwritten in place when possible and keep
+  their original chunking and filters.
  */
 DLiteStorage *
 dh5_open(const DLiteStoragePlugin *api, const char *uri, const char *options)
@@ -429,19 +591,39 @@ dh5_open(const DLiteStoragePlugin *api, const char *uri, const char *options)
     "\"r\" (read-only); "
     "\"w\" (truncate existing storage or create a new one)";
   DLiteOpt opts[] = {
-    {'m', "mode",    "append", mode_descr},
+    {'m', "mode",        "append", mode_descr},
+    {'c', "chunk-size",  "0",      "Target chunk size in bytes"},
+    {'z', "compression", "0",      "Deflate compression level (0-9)"},
+    {'s', "shuffle",     "false",  "Whether to apply the shuffle filter"},
     {0, NULL, NULL, NULL}
   };
   char *optcopy = (options) ? strdup(options) : NULL;
   const char **mode = &opts[0].value;
+  char *endptr;
+  long chunksize, compression;
+  int shuffle;
   UNUSED(api);
 
   if (dlite_option_parse(optcopy, opts, 0)) goto fail;
 
+  chunksize = strtol(opts[1].value, &endptr, 10);
+  if (*endptr || chunksize < 0)
+    FAILCODE1(dliteOptionError, "invalid `chunk-size=%s`", opts[1].value);
+  compression = strtol(opts[2].value, &endptr, 10);
+  if (*endptr || compression < 0 || compression > 9)
+    FAILCODE1(dliteOptionError, "`compression` must be in range 0-9: %s",
+              opts[2].value);
+  if ((shuffle = atob(opts[3].value)) < 0)
+    FAILCODE1(dliteOptionError, "invalid boolean value for `shuffle=%s`",
+              opts[3].value);
+
   H5open();  /* Opens hdf5 library */
 
   if (!(s = calloc(1, sizeof(DH5Storage))))
    FAILCODE(dliteMemoryError, "allocation failure");
+  s->chunksize = chunksize;
+  s->compression = compression;
+  s->shuffle = shuffle;
 
   s->flags |= dliteGeneric;
   if (strcmp(*mode, "append") == 0) {  /* default */
@@ -579,11 +761,11 @@ char *dh5_get_meta_uri(const DLiteDataModel *d)
   char *name=NULL, *version=NULL, *namespace=NULL, *uri=NULL;
 
   if (get_data(d, dh5->meta, "name", &name, dliteStringPtr,
-               sizeof(char *), 1, NULL) < 0) goto fail;
+               sizeof(char *), 1, NULL, NULL) < 0) goto fail;
   if (get_data(d, dh5->meta, "version", &version, dliteStringPtr,
-               sizeof(char *), 1, NULL) < 0) goto fail;
+               sizeof(char *), 1, NULL, NULL) < 0) goto fail;
   if (get_data(d, dh5->meta, "namespace", &namespace, dliteStringPtr,
-               sizeof(char *), 1,NULL) < 0) goto fail;
+               sizeof(char *), 1,NULL, NULL) < 0) goto fail;
 
   /* combine to name, version and namespace to an uri */
   uri = dlite_join_meta_uri(name, version, namespace);
@@ -604,7 +786,7 @@ int dh5_get_dimension_size(const DLiteDataModel *d, const char *name)
   DH5DataModel *dh5 = (DH5DataModel *)d;
   int dimsize;
   if (get_data(d, dh5->dimensions, name, (void *)&dimsize, dliteInt,
-               sizeof(dimsize), 1, NULL) < 0)
+               sizeof(dimsize), 1, NULL, NULL) < 0)
     return err(dliteIOError, "cannot get size of dimension '%s'", name);
   return dimsize;
 }
@@ -619,7 +801,8 @@ int dh5_get_property(const DLiteDataModel *d, const char *name, void *ptr,
                      size_t ndims, const size_t *shape)
 {
   DH5DataModel *dh5 = (DH5DataModel *)d;
-  return get_data(d, dh5->properties, name, ptr, type, size, ndims, shape);
+  return get_data(d, dh5->properties, name, ptr, type, size, ndims, shape,
+                  NULL);
 }
 
 
@@ -752,7 +935,7 @@ char *dh5_get_dataname(const DLiteDataModel *d)
   DH5DataModel *dh5 = (DH5DataModel *)d;
   char *s=NULL;
   if (get_data(d, dh5->instance, "dataname", &s,
-               dliteStringPtr, sizeof(char *), 1, NULL)) return NULL;
+               dliteStringPtr, sizeof(char *), 1, NULL, NULL)) return NULL;
   return s;
 }
 
@@ -770,6 +953,216 @@ int dh5_set_dataname(DLiteDataModel *d, const char *name)
 
 
 
+/********************************************************************
+ * Instance api
+ ********************************************************************/
+
+/* Returns a new datamodel for instance `uuid` in storage `s`, with the
+   common fields initialised.  The groups are created if they don't exist
+   and `s` is writable.  Returns NULL on error. */
+static DH5DataModel *open_instance(const DLiteStorage *s, const char *uuid)
+{
+  DH5DataModel *d;
+  if (!(d = (DH5DataModel *)dh5_datamodel(s, uuid))) return NULL;
+  d->api = s->api;
+  d->s = (DLiteStorage *)s;
+  memcpy(d->uuid, uuid, sizeof(d->uuid));
+  return d;
+}
+
+/* Closes and frees datamodel returned by open_instance(). */
+static void close_instance(DH5DataModel *d)
+{
+  dh5_datamodel_free((DLiteDataModel *)d);
+  free(d);
+}
+
+
+/**
+  Loads instance `id` from storage `s`.  If `id` is NULL, the storage
+  must contain exactly one instance.  Returns the instance or NULL on
+  error.
+ */
+DLiteInstance *dh5_load(const DLiteStorage *s, const char *id)
+{
+  DH5Storage *sh5 = (DH5Storage *)s;
+  DH5DataModel *d=NULL;
+  DLiteMeta *meta=NULL;
+  DLiteInstance *inst=NULL, *retval=NULL;
+  char uuid[DLITE_UUID_LENGTH+1], **uuids=NULL, *uri=NULL;
+  size_t i, *dims=NULL;
+  htri_t exists;
+
+  if (!id || !*id) {
+    int n=0;
+    if (!(uuids = dh5_get_uuids(s))) goto fail;
+    while (uuids[n]) n++;
+    if (n != 1)
+      FAILCODE2(dliteStorageLoadError,
+                "`id` required to load from storage \"%s\" with %d instances",
+                s->location, n);
+    id = uuids[0];
+  }
+  if (dlite_get_uuid(uuid, id) < 0) goto fail;
+  if ((exists = H5Lexists(sh5->root, uuid, H5P_DEFAULT)) < 0)
+    FAILCODE2(dliteIOError, "cannot determine if '%s' exists in %s",
+              uuid, s->location);
+  if (!exists)
+    FAILCODE2(dliteStorageLoadError, "no instance with id '%s' in %s",
+              id, s->location);
+  if (!(d = open_instance(s, uuid))) goto fail;
+
+  /* Get metadata, either from cache or from this storage */
+  if (!(uri = dh5_get_meta_uri((DLiteDataModel *)d))) goto fail;
+  if (!(meta = dlite_meta_get(uri))) {
+    char metauuid[DLITE_UUID_LENGTH+1];
+    if (dlite_get_uuid(metauuid, uri) < 0) goto fail;
+    meta = dlite_meta_load(s, metauuid);
+  }
+  if (!meta) FAILCODE1(dliteMissingMetadataError,
+                       "cannot load metadata: %s", uri);
+
+  /* Create instance */
+  if (!(dims = calloc(meta->_ndimensions + 1, sizeof(size_t))))
+    FAILCODE(dliteMemoryError, "allocation failure");
+  for (i=0; i<meta->_ndimensions; i++) {
+    int n = dh5_get_dimension_size((DLiteDataModel *)d,
+                                   meta->_dimensions[i].name);
+    if (n < 0) goto fail;
+    dims[i] = n;
+  }
+  if (!(inst = dlite_instance_create(meta, dims, id))) goto fail;
+
+  /* Read properties directly into the new instance.  Its memory is
+     accessed with DLITE_PROP(), since a writable pointer returned by
+     dlite_instance_get_property_by_index() would be recorded as
+     exposed. */
+  for (i=0; i<meta->_nproperties; i++) {
+    DLiteProperty *p = meta->_properties + i;
+    void *ptr = (p->ndims > 0) ? *(void **)DLITE_PROP(inst, i) :
+      DLITE_PROP(inst, i);
+    size_t *pdims = DLITE_PROP_DIMS(inst, i);
+    if (get_data((DLiteDataModel *)d, d->properties, p->name, ptr, p->type,
+                 p->size, p->ndims, pdims, NULL)) {
+      dlite_type_clear(ptr, p->type, p->size);
+      goto fail;
+    }
+  }
+  if (!inst->uri && !(inst->uri = dlite_instance_default_uri(inst)))
+    goto fail;
+
+  retval = inst;
+ fail:
+  if (!retval && inst) dlite_instance_decref(inst);
+  if (meta) dlite_meta_decref(meta);
+  if (d) close_instance(d);
+  if (dims) free(dims);
+  if (uri) free(uri);
+  if (uuids) {
+    for (i=0; uuids[i]; i++) free(uuids[i]);
+    free(uuids);
+  }
+  return retval;
+}
+
+
+/**
+  Saves instance `inst` to storage `s`.  Existing datasets are
+  overwritten in place when possible.  Returns non-zero on error.
+ */
+int dh5_save(DLiteStorage *s, const DLiteInstance *inst)
+{
+  DH5Storage *sh5 = (DH5Storage *)s;
+  DH5DataModel *d=NULL;
+  const DLiteMeta *meta = inst->meta;
+  size_t i, shape[1]={1};
+  char *name=NULL, *version=NULL, *namespace=NULL;
+  int retval=1;
+
+  if (!(s->flags & dliteWritable))
+    FAILCODE1(dliteStorageSaveError, "storage is not writable: %s",
+              s->location);
+  if (!(d = open_instance(s, inst->uuid))) goto fail;
+
+  if (dlite_split_meta_uri(meta->uri, &name, &version, &namespace))
+    goto fail;
+  if (write_data(sh5, d->meta, "name", name, dliteFixString,
+                 strlen(name), 1, shape) ||
+      write_data(sh5, d->meta, "version", version, dliteFixString,
+                 strlen(version), 1, shape) ||
+      write_data(sh5, d->meta, "namespace", namespace, dliteFixString,
+                 strlen(namespace), 1, shape))
+    goto fail;
+
+  for (i=0; i<meta->_ndimensions; i++) {
+    int64_t dimsize = DLITE_DIM(inst, i);
+    if (write_data(sh5, d->dimensions, meta->_dimensions[i].name, &dimsize,
+                   dliteInt, sizeof(int64_t), 1, shape)) goto fail;
+  }
+
+  for (i=0; i<meta->_nproperties; i++) {
+    DLiteProperty *p = meta->_properties + i;
+    const void *ptr = dlite_instance_get_property_const_by_index(inst, i);
+    size_t *pdims = DLITE_PROP_DIMS(inst, i);
+    if (write_data(sh5, d->properties, p->name, ptr, p->type, p->size,
+                   p->ndims, pdims)) goto fail;
+  }
+  retval = 0;
+ fail:
+  if (d) close_instance(d);
+  if (name) free(name);
+  if (version) free(version);
+  if (namespace) free(namespace);
+  return retval;
+}
+
+
+/**
+  Reads a hyperslab of array property `name` of instance `id` from
+  storage `s` into `ptr`.  The slab starts at index `start` and has
+  extent `count` along each dimension of the property.  Returns
+  non-zero on error.
+ */
+int dh5_load_slab(const DLiteStorage *s, const char *id, const char *name,
+                  const size_t *start, const size_t *count, void *ptr)
+{
+  DH5Storage *sh5 = (DH5Storage *)s;
+  DH5DataModel *d=NULL;
+  DLiteMeta *meta=NULL;
+  const DLiteProperty *p;
+  char uuid[DLITE_UUID_LENGTH+1], *uri=NULL;
+  htri_t exists;
+  int retval=1;
+
+  if (dlite_get_uuid(uuid, id) < 0) goto fail;
+  if ((exists = H5Lexists(sh5->root, uuid, H5P_DEFAULT)) < 0)
+    FAILCODE2(dliteIOError, "cannot determine if '%s' exists in %s",
+              uuid, s->location);
+  if (!exists)
+    FAILCODE2(dliteStorageLoadError, "no instance with id '%s' in %s",
+              id, s->location);
+  if (!(d = open_instance(s, uuid))) goto fail;
+
+  if (!(uri = dh5_get_meta_uri((DLiteDataModel *)d))) goto fail;
+  if (!(meta = dlite_meta_get(uri))) {
+    char metauuid[DLITE_UUID_LENGTH+1];
+    if (dlite_get_uuid(metauuid, uri) < 0) goto fail;
+    meta = dlite_meta_load(s, metauuid);
+  }
+  if (!meta) FAILCODE1(dliteMissingMetadataError,
+                       "cannot load metadata: %s", uri);
+  if (!(p = dlite_meta_get_property(meta, name))) goto fail;
+  if (get_data((DLiteDataModel *)d, d->properties, p->name, ptr, p->type,
+               p->size, p->ndims, count, start)) goto fail;
+  retval = 0;
+ fail:
+  if (meta) dlite_meta_decref(meta);
+  if (d) close_instance(d);
+  if (uri) free(uri);
+  return retval;
+}
+
+
 static DLiteStoragePlugin h5_plugin = {
   "hdf5",
   NULL,
@@ -786,8 +1179,8 @@ static DLiteStoragePlugin h5_plugin = {
   NULL,                                // iterFree
 
   /* direct api */
-  NULL,                                // loadInstance
-  NULL,                                // saveInstance
+  dh5_load,                            // loadInstance
+  dh5_save,                            // saveInstance
   NULL,                                // deleteInstance
 
   /* In-memory api */
@@ -818,12 +1211,19 @@ static DLiteStoragePlugin h5_plugin = {
   dh5_set_dataname,
 
   /* internal data */
-  NULL
+  NULL,
+
+  /* batched api */
+  NULL,                                // loadInstances
+  NULL,                                // saveInstances
+
+  /* partial api */
+  dh5_load_slab,                       // loadSlab
 };
 
 
 DSL_EXPORT const DLiteStoragePlugin *
-get_dlite_storage_plugin_api(void *state, int *iter)
+get_dlite_storage_plugin_api_v2(void *state, int *iter)
 {
   UNUSED(iter);
   dlite_globals_set(state);
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+
+#include <hdf5.h>
+
+#include "minunit/minunit.h"
+#include "dlite.h"
+#include "dlite-macros.h"
+
+
+char *uri = "http://www.sintef.no/meta/dlite/0.1/MyHdf5Entity";
+char *datafile = "myentity-chunked.h5";
+DLiteMeta *entity=NULL;
+
+
+
+MU_TEST(test_meta_create)
+{
+  char *shape0[] = {"N", "M"};
+  char *shape1[] = {"N"};
+  char *shape2[] = {"M"};
+  DLiteDimension dimensions[] = {
+    {"M", "Length of dimension M."},
+    {"N", "Length of dimension N."}
+  };
+  DLiteProperty properties[] = {
+    /* name          type            size           ref ndims shape  unit descr*/
+    {"a-string",     dliteStringPtr, sizeof(char *),NULL, 0, NULL,  "",  "..."},
+    {"a-float",      dliteFloat,     sizeof(float), NULL, 0, NULL,  "m", ""},
+    {"an-int-arr",   dliteInt,       sizeof(int),   NULL, 2, shape0, "#", "..."},
+    {"a-string-arr", dliteStringPtr, sizeof(char *),NULL, 1, shape1, "",  "..."},
+    {"a-string3-arr",dliteFixString, 3,             NULL, 1, shape2, "",  "..."}
+  };
+
+  mu_check((entity = dlite_meta_create(uri, "My HDF5 test entity.",
+                                       2, dimensions, 5, properties)));
+}
+
+
+MU_TEST(test_save_chunked)
+{
+  DLiteStorage *s;
+  DLiteInstance *inst;
+  size_t dims[]={3, 2};
+  int newdims[]={5, 4};
+  char *astring="chunked", *strarr[]={"a", "b"}, str3arr[3][3]={"Al","Mg","Si"};
+  char *opts="mode=w;compression=4;shuffle=true;chunk-size=16";
+  int *intarr;
+
+  mu_check((inst = dlite_instance_create(entity, dims, "chunked")));
+  mu_check(dlite_instance_set_property(inst, "a-string", &astring) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string-arr", strarr) == 0);
+  mu_check(dlite_instance_set_property(inst, "a-string3-arr", str3arr) == 0);
+  intarr = dlite_instance_get_property(inst, "an-int-arr");
+  intarr[5] = 42;
+  mu_check((s = dlite_storage_open("hdf5", datafile, opts)));
+  mu_check(dlite_instance_save(s, inst) == 0);
+  mu_check(dlite_storage_close(s) == 0);
+
+  /* Resave with other dimensions - chunked datasets are resized in place */
+  mu_check(dlite_instance_set_dimension_sizes(inst, newdims) == 0);
+  intarr = dlite_instance_get_property(inst, "an-int-arr");
+  intarr[19] = 7;
+  mu_check((s = dlite_storage_open("hdf5", datafile, "mode=append")));
+  mu_check(dlite_instance_save(s, inst) == 0);
+  mu_check(dlite_storage_close(s) == 0);
+  mu_assert_int_eq(0, dlite_instance_decref(inst));
+}
+
+
+/* Check the dataset layout written by the hdf5 plugin directly with the
+   hdf5 library, since the chunking and the filters are invisible via the
+   DLite API. */
+MU_TEST(test_chunked_layout)
+{
+  char uuid[DLITE_UUID_LENGTH+1], path[DLITE_UUID_LENGTH+32];
+  hid_t file, dset, dcpl;
+  hsize_t chunk[2]={0, 0};
+
+  mu_check(dlite_get_uuid(uuid, "chunked") >= 0);
+  snprintf(path, sizeof(path), "/%s/properties/an-int-arr", uuid);
+  mu_check((file = H5Fopen(datafile, H5F_ACC_RDONLY, H5P_DEFAULT)) >= 0);
+  mu_check((dset = H5Dopen(file, path, H5P_DEFAULT)) >= 0);
+  mu_check((dcpl = H5Dget_create_plist(dset)) >= 0);
+  mu_assert_int_eq(H5D_CHUNKED, H5Pget_layout(dcpl));
+  mu_assert_int_eq(2, H5Pget_chunk(dcpl, 2, chunk));
+  mu_assert_int_eq(2, (int)chunk[0]);
+  mu_assert_int_eq(2, (int)chunk[1]);
+  mu_assert_int_eq(2, H5Pget_nfilters(dcpl));  /* shuffle + deflate */
+  H5Pclose(dcpl);
+  H5Dclose(dset);
+  H5Fclose(file);
+}
+
+
+MU_TEST(test_load_chunked)
+{
+  DLiteStorage *s;
+  DLiteInstance *inst;
+  const int *intarr;
+
+  mu_check((s = dlite_storage_open("hdf5", datafile, "mode=r")));
+  mu_check((inst = dlite_instance_load(s, "chunked")));
+  mu_check(dlite_storage_close(s) == 0);
+  mu_assert_int_eq(5, dlite_instance_get_dimension_size(inst, "M"));
+  mu_assert_int_eq(4, dlite_instance_get_dimension_size(inst, "N"));
+  intarr = dlite_instance_get_property_const(inst, "an-int-arr");
+  mu_assert_int_eq(42, intarr[5]);
+  mu_assert_int_eq(7, intarr[19]);
+  mu_assert_string_eq("chunked", *(char *const *)
+                      dlite_instance_get_property_const(inst, "a-string"));
+  mu_assert_int_eq(0, dlite_instance_decref(inst));
+}
+
+
+MU_TEST(test_load_slab)
+{
+  DLiteStorage *s;
+  int slab[15];
+  char *strslab[1], str3slab[2][3];
+  size_t start[]={1, 0}, count[]={3, 5}, start1[]={1}, count2[]={2};
+  size_t count1[]={1}, bigcount[]={4, 5};
+
+  mu_check((s = dlite_storage_open("hdf5", datafile, "mode=r")));
+  mu_assert_int_eq(0, dlite_storage_load_slab(s, "chunked", "an-int-arr",
+                                              start, count, slab));
+  mu_assert_int_eq(42, slab[0]);
+  mu_assert_int_eq(7, slab[14]);
+  mu_assert_int_eq(0, dlite_storage_load_slab(s, "chunked", "a-string-arr",
+                                              start1, count1, strslab));
+  mu_assert_string_eq("b", strslab[0]);
+  free(strslab[0]);
+  mu_assert_int_eq(0, dlite_storage_load_slab(s, "chunked", "a-string3-arr",
+                                              start1, count2, str3slab));
+  mu_assert_string_eq("Mg", str3slab[0]);
+  mu_assert_string_eq("Si", str3slab[1]);
+
+  /* Out of bounds */
+  mu_check(dlite_storage_load_slab(s, "chunked", "an-int-arr",
+                                   start, bigcount, slab));
+  mu_check(dlite_storage_close(s) == 0);
+}
+
+
+MU_TEST(test_free)
+{
+  dlite_meta_decref(entity);
+}
+
+
+/***********************************************************************/
+
+MU_TEST_SUITE(test_suite)
+{
+  MU_RUN_TEST(test_meta_create);    /* setup */
+  MU_RUN_TEST(test_save_chunked);
+  MU_RUN_TEST(test_chunked_layout);
+  MU_RUN_TEST(test_load_chunked);
+  MU_RUN_TEST(test_load_slab);
+  MU_RUN_TEST(test_free);           /* tear down */
+}
+
+
+
+int main()
+{
+  MU_RUN_SUITE(test_suite);
+  MU_REPORT();
+  return (minunit_fail) ? 1 : 0;
+}
@@ -11,6 +11,7 @@
 #include "utils/strtob.h"
 #include "utils/jstore.h"
 #include "utils/map.h"
+#include "utils/sync.h"
 #include "dlite.h"
 #include "dlite-storage-plugins.h"
 #include "dlite-macros.h"
@@ -26,6 +27,7 @@ typedef struct {
   int fmt_given;        /* whether single/multi entity format is given */
   int changed;          /* whether the storage is changed */
   map_uuid_t ids;       /* maps uuids to ids */
+  Mutex lock;           /* protects `jstore` and `changed` */
 } DLiteJsonStorage;
 
 
@@ -77,6 +79,8 @@ DLiteStorage *json_loader(const DLiteStoragePlugin *api, const char *uri,
     {'d', "as-data",   "false", "Alias for `single=false` (deprecated)"},
     {'c', "compact",   "false", "Alias for `single` (deprecated)"},
     {'U', "useid",     "",      "Unused (deprecated)"},
+    {'l', "lazy",      "false", "Whether to parse instances on demand in "
+                                "read-only mode"},
     {0, NULL, NULL, NULL}
   };
   int load;  // whether to load uri
@@ -91,6 +95,7 @@ DLiteStorage *json_loader(const DLiteStoragePlugin *api, const char *uri,
   int withuuid = atob(opts[3].value);
   int withmeta = atob(opts[4].value);
   int arrays = atob(opts[5].value);
+  int lazy = atob(opts[9].value);
 
   /* deprecated options */
   if (atob(opts[6].value) > 0) single = (warn("`asdata` is deprecated"), 0);
@@ -113,14 +118,18 @@ DLiteStorage *json_loader(const DLiteStoragePlugin *api, const char *uri,
   if (arrays < 0) FAILCODE1(dliteOptionError,
                             "invalid boolean value for `arrays=%s`.",
                             opts[5].value);
+  if (lazy < 0) FAILCODE1(dliteOptionError,
+                          "invalid boolean value for `lazy=%s`.",
+                          opts[9].value);
 
   if (!(s = calloc(1, sizeof(DLiteJsonStorage))))
    FAILCODE(dliteMemoryError, "allocation failure");
   s->api = api;
+  mutex_init(&s->lock);
 
   if (!mode)
     mode = default_mode(uri, buf, size);
-  s->flags |= dliteGeneric;
+  s->flags |= dliteGeneric | dliteThreadSafe;
   switch (mode) {
   case 'r':
     load = 1;
@@ -156,7 +165,9 @@ DLiteStorage *json_loader(const DLiteStoragePlugin *api, const char *uri,
   if (load) {
     DLiteJsonFormat fmt;
     if (!(s->jstore = jstore_open())) goto fail;
-    if (uri)
+    if (uri && lazy && mode == 'r')
+      fmt = dlite_jstore_loadf_lazy(s->jstore, uri);
+    else if (uri)
       fmt = dlite_jstore_loadf(s->jstore, uri);
     else
       fmt = dlite_jstore_loads(s->jstore, (const char *)buf, size);
@@ -202,6 +213,10 @@ DLiteStorage *json_loader(const DLiteStoragePlugin *api, const char *uri,
       Whether to write output in compact format. Alias for `as-data`
   - useid: translate | require | keep (deprecated)
       How to use the ID.
+  - lazy : yes | no
+      Whether to memory map the file and only parse instances when they
+      are loaded.  Reduces memory usage and opening time for large
+      storages.  Only used in read-only mode.
  */
 DLiteStorage *json_open(const DLiteStoragePlugin *api, const char *uri,
                         const char *options)
@@ -222,56 +237,94 @@ int json_close(DLiteStorage *s)
       stat = jstore_to_file(js->jstore, js->location);
     stat |= jstore_close(js->jstore);
   }
+  mutex_destroy(&js->lock);
   return stat;
 }
 
 
-/**
-  Load instance `id` from storage `s` and return it.
-  NULL is returned on error.
+/*
+  Help function for json_load() and json_load_many().
+
+  Looks up instance `id` in storage `s` and assigns `*value` to a newly
+  allocated copy of its JSON representation of length `*len` and
+  `*scanid` to a newly allocated copy of the id to parse it with.  The
+  copies are needed, since a concurrent json_save() may free the
+  values in the store as soon as the lock is released.
+
+  Must be called with the lock held.  Returns zero on success, 1 if
+  `id` is not in the store (no error is reported in that case) and
+  another non-zero value on error.
  */
-DLiteInstance *json_load(const DLiteStorage *s, const char *id)
+static int lookup_instance(const DLiteStorage *s, const char *id,
+                           char **value, size_t *len, char **scanid)
 {
   DLiteJsonStorage *js = (DLiteJsonStorage *)s;
-  const char *buf=NULL, *scanid;
+  const char *buf=NULL, *label;
   DLiteIdType idtype;
   char uuid[DLITE_UUID_LENGTH+1];
 
+  *value = *scanid = NULL;
   if (!js->jstore) {
     if (s->location)
-      FAILCODE1(dliteStorageLoadError,
-                "cannot load JSON file: \"%s\"", s->location);
+      return errx(dliteStorageLoadError,
+                  "cannot load JSON file: \"%s\"", s->location);
     else
-      FAILCODE(dliteStorageLoadError, "cannot load JSON buffer");
+      return errx(dliteStorageLoadError, "cannot load JSON buffer");
   }
 
   if (!id || !*id) {
     JStoreIter iter;
-    if (jstore_iter_init(js->jstore, &iter)) goto fail;
+    if (jstore_iter_init(js->jstore, &iter)) return -1;
     if (!(id = jstore_iter_next(&iter)))
-      FAILCODE1(dliteStorageLoadError,
-            "cannot load instance from empty storage \"%s\"", s->location);
-    if (jstore_iter_next(&iter)) {
-      FAILCODE1(dliteStorageLoadError,
-            "id is required when loading from storage with more "
-            "than one instance: %s", s->location);
-    }
-    if (jstore_iter_deinit(&iter)) goto fail;
+      return errx(dliteStorageLoadError,
+                  "cannot load instance from empty storage \"%s\"",
+                  s->location);
+    if (jstore_iter_next(&iter))
+      return errx(dliteStorageLoadError,
+                  "id is required when loading from storage with more "
+                  "than one instance: %s", s->location);
+    if (jstore_iter_deinit(&iter)) return -1;
   } else if ((idtype = dlite_get_uuid(uuid, id)) && idtype != dliteIdRandom) {
-    buf = jstore_get(js->jstore, uuid);
+    buf = jstore_getn(js->jstore, uuid, len);
   }
-  if (!buf && !(buf = jstore_get(js->jstore, id)))
-      goto fail;
-  if (dlite_isuuid(id)) {
-    /* the provided id is an uuid - check if a human readable id has been
-       assoicated with `id` as a label */
-    if (!(scanid = jstore_get_label(js->jstore, id))) scanid = id;
-  } else {
-    scanid = id;
+  if (!buf && !(buf = jstore_getn(js->jstore, id, len)))
+    return 1;
+  /* if the provided id is an uuid - check if a human readable id has been
+     assoicated with `id` as a label */
+  if (dlite_isuuid(id) && (label = jstore_get_label(js->jstore, id)))
+    id = label;
+  if (!(*value = strndup(buf, *len)) || !(*scanid = strdup(id))) {
+    free(*value);
+    *value = NULL;
+    return err(dliteMemoryError, "allocation failure");
   }
-  return dlite_json_sscan(buf, scanid, NULL);
- fail:
-  return NULL;
+  return 0;
+}
+
+
+/**
+  Load instance `id` from storage `s` and return it.
+  NULL is returned on error.
+ */
+DLiteInstance *json_load(const DLiteStorage *s, const char *id)
+{
+  DLiteJsonStorage *js = (DLiteJsonStorage *)s;
+  DLiteInstance *inst;
+  char *value, *scanid;
+  size_t len=0;
+  int stat;
+
+  /* Only the lookup in the store is protected by the lock, such that
+     instances can be parsed concurrently */
+  mutex_lock(&js->lock);
+  stat = lookup_instance(s, id, &value, &len, &scanid);
+  mutex_unlock(&js->lock);
+  if (stat) return NULL;
+
+  inst = dlite_json_sscann(value, len, scanid, NULL);
+  free(value);
+  free(scanid);
+  return inst;
 }
 
 
@@ -293,22 +346,144 @@ int json_save(DLiteStorage *s, const DLiteInstance *inst)
     jflags |= dliteJsonSingle;
 
   if (jflags & dliteJsonSingle) {
-    if (js->changed)
+    mutex_lock(&js->lock);
+    if (js->changed) {
+      mutex_unlock(&js->lock);
       FAILCODE1(dliteStorageSaveError,
                 "Trying to save more than once in single-entity format: %s",
                 s->location);
+    }
     int n = dlite_json_printfile(s->location, inst, jflags);
     stat = (n > 0) ? 0 : 1;
+    js->changed = 1;
+    mutex_unlock(&js->lock);
   } else {
-    if (!js->jstore && !(js->jstore = jstore_open())) goto fail;
-    stat = dlite_jstore_add(js->jstore, inst, jflags);
+    /* Serialise outside the lock, such that instances can be saved
+       concurrently */
+    char *buf = dlite_json_aprint(inst, 2, jflags | dliteJsonSingle);
+    if (!buf) goto fail;
+    mutex_lock(&js->lock);
+    if (!js->jstore && !(js->jstore = jstore_open())) {
+      mutex_unlock(&js->lock);
+      free(buf);
+      goto fail;
+    }
+    stat = jstore_addstolen(js->jstore, inst->uuid, buf);
+    js->changed = 1;
+    mutex_unlock(&js->lock);
   }
-  js->changed = 1;
  fail:
   return stat;
 }
 
 
+/**
+  Loads the `n` instances with the given `ids` from storage `s` and
+  stores new references to them in `instances`.
+
+  All instances are looked up in the json store with a single
+  acquisition of the lock, such that a missing id fails before any
+  instance is parsed.  Returns non-zero on error.
+*/
+int json_load_many(const DLiteStorage *s, const char **ids, size_t n,
+                   DLiteInstance **instances)
+{
+  DLiteJsonStorage *js = (DLiteJsonStorage *)s;
+  char **values=NULL, **scanids;
+  size_t i, *lens=NULL;
+  int stat=1, found=0;
+
+  if (!n) return 0;
+  if (!(values = calloc(2*n, sizeof(char *))) ||
+      !(lens = calloc(n, sizeof(size_t)))) {
+    free(values);
+    return err(dliteMemoryError, "allocation failure");
+  }
+  scanids = values + n;
+
+  mutex_lock(&js->lock);
+  for (i=0; i<n; i++)
+    if ((found = lookup_instance(s, ids[i], values+i, lens+i, scanids+i)))
+      break;
+  mutex_unlock(&js->lock);
+  if (found == 1)
+    FAILCODE2(dliteStorageLoadError, "no such instance in \"%s\": %s",
+              s->location, ids[i]);
+  if (found) goto fail;
+
+  for (i=0; i<n; i++) {
+    if (!(instances[i] = dlite_json_sscann(values[i], lens[i], scanids[i],
+                                           NULL))) {
+      while (i--) dlite_instance_decref(instances[i]);
+      goto fail;
+    }
+  }
+  stat = 0;
+ fail:
+  for (i=0; i<2*n; i++) free(values[i]);
+  free(values);
+  free(lens);
+  return stat;
+}
+
+
+/**
+  Saves the `n` instances in `instances` to storage `s`.
+
+  All instances are serialised before they are added to the json store
+  with a single acquisition of the lock.  Returns non-zero on error.
+*/
+int json_save_many(DLiteStorage *s, const DLiteInstance **instances, size_t n)
+{
+  DLiteJsonStorage *js = (DLiteJsonStorage *)s;
+  DLiteJsonFlag jflags = js->jflags;
+  char **bufs=NULL;
+  size_t i;
+  int stat=0;
+
+  if (!(s->flags & dliteWritable))
+    return errx(dliteStorageSaveError,
+                "storage \"%s\" is not writable", s->location);
+
+  /* The single-entity format is written directly to file by json_save(),
+     which also reports an error if more than one instance is saved */
+  for (i=0; i<n; i++)
+    if ((jflags & dliteJsonSingle) ||
+        (!js->fmt_given && dlite_instance_is_meta(instances[i])))
+      break;
+  if (i < n) {
+    for (i=0; i<n; i++) stat |= json_save(s, instances[i]);
+    return stat;
+  }
+
+  if (!n) return 0;
+  if (!(bufs = calloc(n, sizeof(char *))))
+    return err(dliteMemoryError, "allocation failure");
+  for (i=0; i<n; i++)
+    if (!(bufs[i] = dlite_json_aprint(instances[i], 2,
+                                      jflags | dliteJsonSingle)))
+      goto fail;
+
+  mutex_lock(&js->lock);
+  if (!js->jstore && !(js->jstore = jstore_open())) {
+    mutex_unlock(&js->lock);
+    goto fail;
+  }
+  for (i=0; i<n; i++) {
+    stat |= jstore_addstolen(js->jstore, instances[i]->uuid, bufs[i]);
+    bufs[i] = NULL;
+  }
+  js->changed = 1;
+  mutex_unlock(&js->lock);
+  free(bufs);
+  return stat;
+ fail:
+  for (i=0; i<n; i++) free(bufs[i]);
+  free(bufs);
+  return 1;
+}
+
+
 /**
   Load instance `id` from buffer `buf` of size `size`.
   Returns NULL on error.
@@ -463,12 +638,19 @@ static DLiteStoragePlugin dlite_json_plugin = {
   NULL,                     /* setDataName, obsolute */
 
   /* internal data */
-  NULL                      /* data */
+  NULL,                     /* data */
+
+  /* batched api */
+  json_load_many,           /* loadInstances */
+  json_save_many,           /* saveInstances */
+
+  /* partial api */
+  NULL,                     /* loadSlab */
 };
 
 
 DSL_EXPORT const DLiteStoragePlugin *
-get_dlite_storage_plugin_api(void *globals, int *iter)
+get_dlite_storage_plugin_api_v2(void *globals, int *iter)
 {
   UNUSED(iter);
   dlite_globals_set(globals);
@@ -6,6 +6,7 @@
 #include "minunit/minunit.h"
 #include "utils/integers.h"
 #include "utils/boolean.h"
+#include "utils/sync.h"
 #include "dlite.h"
 #include "dlite-macros.h"
 #include "dlite-datamodel.h"
@@ -209,6 +210,49 @@ MU_TEST(test_append)
 }
 
 
+/* Shared data for test_concurrent() */
+typedef struct {
+  DLiteStorage *s;
+  const DLiteInstance *inst;
+  int failures;
+} ConcurrentData;
+
+/* Task for test_concurrent().  Odd tasks replace the stored instance
+   while even tasks load it. */
+static void concurrent_task(size_t i, void *data)
+{
+  ConcurrentData *d = data;
+  DLiteInstance *inst;
+  if (i % 2) {
+    if (json_save(d->s, d->inst)) sync_add_int(&d->failures, 1);
+  } else {
+    if ((inst = json_load(d->s, d->inst->uuid)))
+      dlite_instance_decref(inst);
+    else
+      sync_add_int(&d->failures, 1);
+  }
+}
+
+MU_TEST(test_concurrent)
+{
+  char *url = "json://" STRINGIFY(DLITE_ROOT) "/src/tests/test-read-data.json#http://data.org/data3";
+  ConcurrentData d;
+  DLiteInstance *inst;
+  printf("\n--- test_concurrent ---\n");
+
+  memset(&d, 0, sizeof(d));
+  mu_check((inst = dlite_instance_load_url(url)));
+  mu_check((d.s = dlite_storage_open("json", "test-json-concurrent.json",
+                                     "mode=w")));
+  d.inst = inst;
+  mu_assert_int_eq(0, json_save(d.s, inst));
+  sync_parallel_for(8, 400, concurrent_task, &d);
+  mu_assert_int_eq(0, d.failures);
+  mu_assert_int_eq(0, dlite_storage_close(d.s));
+  dlite_instance_decref(inst);
+}
+
+
 MU_TEST(test_iter)
 {
   char *filename = STRINGIFY(DLITE_ROOT) "/src/tests/test-read-data.json";
@@ -241,6 +285,40 @@ MU_TEST(test_iter)
 }
 
 
+MU_TEST(test_lazy)
+{
+  char *filename = STRINGIFY(DLITE_ROOT) "/src/tests/test-read-data.json";
+  DLiteStorage *s=NULL;
+  DLiteInstance *inst2;
+  void *iter;
+  char uuid[DLITE_UUID_LENGTH+1];
+  int r, n=0;
+  printf("\n--- test_lazy ---\n");
+
+  s = dlite_storage_open("json", filename, "mode=r;lazy=true");
+  mu_check(s);
+
+  inst2 = json_load(s, "http://data.org/data3");
+  mu_check(inst2);
+  mu_assert_string_eq("http://data.org/data3", inst2->uri);
+  dlite_instance_decref(inst2);
+
+  iter = json_iter_create(s, NULL);
+  while ((r = json_iter_next(iter, uuid)) == 0) {
+    inst2 = json_load(s, uuid);
+    mu_check(inst2);
+    dlite_instance_decref(inst2);
+    n++;
+  }
+  mu_assert_int_eq(1, r);
+  mu_assert_int_eq(6, n);
+  json_iter_free(iter);
+
+  r = dlite_storage_close(s);
+  mu_assert_int_eq(0, r);
+}
+
+
 
 
 
@@ -257,7 +335,9 @@ MU_TEST_SUITE(test_suite)
   MU_RUN_TEST(test_load_data3);
   MU_RUN_TEST(test_write);
   MU_RUN_TEST(test_append);
+  MU_RUN_TEST(test_concurrent);
   MU_RUN_TEST(test_iter);
+  MU_RUN_TEST(test_lazy);
 }
 
 
@@ -322,6 +322,100 @@ int saver(DLiteStorage *s, const DLiteInstance *inst)
 }
 
 
+/*
+  Loads the `n` instances with the given `ids` from storage `s` by
+  calling the load_many() method of the Python plugin with a list of
+  the ids.  New references are stored in `instances`.
+
+  Returns non-zero on error.
+ */
+int many_loader(const DLiteStorage *s, const char **ids, size_t n,
+                DLiteInstance **instances)
+{
+  DLitePythonStorage *sp = (DLitePythonStorage *)s;
+  PyObject *pyids=NULL, *v=NULL, *seq=NULL;
+  int retval = 1;
+  size_t i, m=0;
+  PyObject *class = (PyObject *)s->api->data;
+  const char *classname;
+
+  dlite_errclr();
+  if (!(classname = dlite_pyembed_classname(class)))
+    dlite_warnx("cannot get class name for storage plugin '%s'", s->api->name);
+  if (!(pyids = PyList_New(n))) goto fail;
+  for (i=0; i<n; i++) {
+    PyObject *pyid;
+    if (ids[i]) {
+      pyid = PyUnicode_FromString(ids[i]);
+    } else {
+      Py_INCREF(Py_None);
+      pyid = Py_None;
+    }
+    if (!pyid) goto fail;
+    PyList_SET_ITEM(pyids, i, pyid);
+  }
+  v = PyObject_CallMethod(sp->obj, "load_many", "O", pyids);
+  if (dlite_pyembed_err_check("calling load_many() in Python plugin '%s'%s",
+                              classname, failmsg()))
+    goto fail;
+  if (!(seq = PySequence_Fast(v, "load_many() must return a sequence")))
+    goto fail;
+  if ((size_t)PySequence_Fast_GET_SIZE(seq) != n)
+    FAIL2("load_many() in Python plugin '%s' returned %d instances",
+          classname, (int)PySequence_Fast_GET_SIZE(seq));
+  for (m=0; m<n; m++) {
+    PyObject *item = PySequence_Fast_GET_ITEM(seq, m);
+    if (!(instances[m] = dlite_pyembed_get_instance(item))) goto fail;
+  }
+  retval = 0;
+ fail:
+  if (retval) {
+    dlite_pyembed_err_check("in load_many() in Python plugin '%s'",
+                            classname);
+    while (m--) dlite_instance_decref(instances[m]);
+  }
+  Py_XDECREF(seq);
+  Py_XDECREF(v);
+  Py_XDECREF(pyids);
+  return retval;
+}
+
+
+/*
+  Stores the `n` instances in `instances` to storage `s` by calling
+  the save_many() method of the Python plugin with a list of the
+  instances.  Returns non-zero on error.
+*/
+int many_saver(DLiteStorage *s, const DLiteInstance **instances, size_t n)
+{
+  DLitePythonStorage *sp = (DLitePythonStorage *)s;
+  PyObject *pyinsts=NULL, *v=NULL;
+  int retval = 1;
+  size_t i;
+  PyObject *class = (PyObject *)s->api->data;
+  const char *classname;
+
+  dlite_errclr();
+  if (!(classname = dlite_pyembed_classname(class)))
+    dlite_warnx("cannot get class name for storage plugin '%s'", s->api->name);
+  if (!(pyinsts = PyList_New(n))) goto fail;
+  for (i=0; i<n; i++) {
+    PyObject *pyinst = dlite_pyembed_from_instance(instances[i]->uuid);
+    if (!pyinst) goto fail;
+    PyList_SET_ITEM(pyinsts, i, pyinst);
+  }
+  v = PyObject_CallMethod(sp->obj, "save_many", "O", pyinsts);
+  if (dlite_pyembed_err_check("calling save_many() in Python plugin '%s'%s",
+                              classname, failmsg()))
+    goto fail;
+  retval = 0;
+ fail:
+  Py_XDECREF(pyinsts);
+  Py_XDECREF(v);
+  return retval;
+}
+
+
 /*
   Stores instance `inst` to storage `s`.  Returns non-zero on error.
 */
@@ -541,13 +635,14 @@ int iterNext(void *iter, char *buf)
   Returns API provided by storage plugin `name` implemented in Python.
 */
 DSL_EXPORT const DLiteStoragePlugin *
-get_dlite_storage_plugin_api(void *state, int *iter)
+get_dlite_storage_plugin_api_v2(void *state, int *iter)
 {
   int n;
   DLiteStoragePlugin *api=NULL, *retval=NULL;
   PyObject *storages=NULL, *cls=NULL, *name=NULL;
   PyObject *open=NULL, *close=NULL, *query=NULL, *load=NULL, *save=NULL,
-    *flush=NULL, *delete=NULL, *memload=NULL, *memsave=NULL;
+    *flush=NULL, *delete=NULL, *memload=NULL, *memsave=NULL,
+    *load_many=NULL, *save_many=NULL;
   const char *classname=NULL;
 
   dlite_globals_set(state);
@@ -613,6 +708,18 @@ get_dlite_storage_plugin_api(void *state, int *iter)
       FAIL1("attribute 'delete' of '%s' is not callable", classname);
   }
 
+  if (PyObject_HasAttrString(cls, "load_many")) {
+    load_many = PyObject_GetAttrString(cls, "load_many");
+    if (!PyCallable_Check(load_many))
+      FAIL1("attribute 'load_many' of '%s' is not callable", classname);
+  }
+
+  if (PyObject_HasAttrString(cls, "save_many")) {
+    save_many = PyObject_GetAttrString(cls, "save_many");
+    if (!PyCallable_Check(save_many))
+      FAIL1("attribute 'save_many' of '%s' is not callable", classname);
+  }
+
   if (PyObject_HasAttrString(cls, "from_bytes")) {
     memload = PyObject_GetAttrString(cls, "from_bytes");
     if (!PyCallable_Check(memload))
@@ -652,6 +759,8 @@ get_dlite_storage_plugin_api(void *state, int *iter)
   api->loadInstance = loader;
   api->saveInstance = saver;
   api->deleteInstance = deleter;
+  if (load_many) api->loadInstances = many_loader;
+  if (save_many) api->saveInstances = many_saver;
 
   api->memLoadInstance = memloader;
   api->memSaveInstance = memsaver;
@@ -671,6 +780,8 @@ get_dlite_storage_plugin_api(void *state, int *iter)
   Py_XDECREF(delete);
   Py_XDECREF(memload);
   Py_XDECREF(memsave);
+  Py_XDECREF(load_many);
+  Py_XDECREF(save_many);
   Py_XDECREF(query);
 
   return retval;
@@ -0,0 +1,48 @@
+"""DLite storage plugin for testing the batched api of Python storages."""
+import json
+
+import dlite
+from dlite.options import Options
+
+
+class manyjson(dlite.DLiteStorageBase):
+    """Storage plugin storing instances in a JSON file.
+
+    Only load_many() and save_many() are implemented, such that all
+    instances must be loaded and saved via the batched api.
+    """
+
+    def open(self, location, options=None):
+        """Opens `location`.
+
+        Arguments:
+            location: Path to JSON file.
+            options: Supported options:
+            - `mode`: Mode for opening.  Valid values are:
+                - `a`: Open for writing, add to existing `location` (default).
+                - `r`: Open existing `location` for reading.
+                - `w`: Open for writing. If `location` exists, it is truncated.
+        """
+        self.options = Options(options, defaults="mode=a")
+        mode = self.options.mode
+        self.writable = "w" in mode or "a" in mode
+        self.location = location
+        self._store = dlite.JStore()
+        if "r" in mode or "a" in mode:
+            with open(location, "r") as f:
+                self._store.load_dict(json.load(f))
+
+    def close(self):
+        """Writes all instances to `location` if the storage is writable."""
+        if self.writable:
+            with open(self.location, "w") as f:
+                json.dump(self._store.get_dict(), f, indent=2)
+
+    def load_many(self, ids):
+        """Returns a list with the instances with the given `ids`."""
+        return [self._store.get(id) for id in ids]
+
+    def save_many(self, instances):
+        """Stores all `instances` in the storage."""
+        for inst in instances:
+            self._store.add(inst)
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "minunit/minunit.h"
+
+#include "dlite.h"
+#include "dlite-macros.h"
+#include "dlite-storage-plugins.h"
+#include "pyembed/dlite-python-storage.h"
+
+
+#define NINST 3
+
+char *metaid = "http://onto-ns.com/meta/0.1/Person";
+char *location = STRINGIFY(CURRENT_BINARY_DIR) "/many-output.json";
+const char *ids[NINST] = {"person0", "person1", "person2"};
+
+
+/* Save and load several instances via the batched api of a Python
+   storage plugin that only implements load_many() and save_many() */
+MU_TEST(test_save_many)
+{
+  DLiteStorage *s;
+  DLiteInstance *instances[NINST];
+  size_t i, dims[] = {1};
+  char *skills[] = {"testing"};
+  char *plugindir = STRINGIFY(CURRENT_SOURCE_DIR) "/python-storage-plugins";
+
+  mu_check(dlite_python_storage_paths_append(plugindir) >= 0);
+
+  for (i=0; i<NINST; i++) {
+    double age = 20.0 + i;
+    char *name = (char *)ids[i];
+    mu_check((instances[i] = dlite_instance_create_from_id(metaid, dims,
+                                                           ids[i])));
+    mu_assert_int_eq(0, dlite_instance_set_property(instances[i], "name",
+                                                    &name));
+    mu_assert_int_eq(0, dlite_instance_set_property(instances[i], "age",
+                                                    &age));
+    mu_assert_int_eq(0, dlite_instance_set_property(instances[i], "skills",
+                                                    skills));
+  }
+
+  mu_check((s = dlite_storage_open("manyjson", location, "mode=w")));
+  mu_check(s->api->saveInstances);
+  mu_assert_int_eq(0, dlite_instance_save_many(s, (const DLiteInstance **)
+                                               instances, NINST));
+  mu_assert_int_eq(0, dlite_storage_close(s));
+
+  for (i=0; i<NINST; i++) dlite_instance_decref(instances[i]);
+}
+
+
+MU_TEST(test_load_many)
+{
+  DLiteStorage *s;
+  DLiteInstance *instances[NINST];
+  size_t i;
+
+  mu_check((s = dlite_storage_open("manyjson", location, "mode=r")));
+  mu_check(s->api->loadInstances);
+  mu_assert_int_eq(0, dlite_instance_load_many(s, ids, NINST, instances));
+  mu_assert_int_eq(0, dlite_storage_close(s));
+
+  for (i=0; i<NINST; i++) {
+    mu_check(instances[i]);
+    mu_assert_string_eq(ids[i], instances[i]->uri);
+    mu_assert_string_eq(ids[i], *(char **)
+                        dlite_instance_get_property(instances[i], "name"));
+    mu_assert_double_eq(20.0 + i, *(double *)
+                        dlite_instance_get_property(instances[i], "age"));
+    mu_assert_int_eq(1, dlite_instance_get_dimension_size(instances[i], "N"));
+    dlite_instance_decref(instances[i]);
+  }
+}
+
+
+/***********************************************************************/
+
+
+MU_TEST_SUITE(test_suite)
+{
+  MU_RUN_TEST(test_save_many);
+  MU_RUN_TEST(test_load_many);
+}
+
+int main()
+{
+  MU_RUN_SUITE(test_suite);
+  MU_REPORT();
+  return (minunit_fail) ? 1 : 0;
+}
@@ -577,7 +577,8 @@ int rdf_save_instance(DLiteStorage *storage, const DLiteInstance *inst)
 
   /* Describe metadata with spesialised properties */
   if (meta && s->fmtflags & fmtMetaAnnot) {
-    const char **descr = dlite_instance_get_property(inst, "description");
+    const char *const *descr =
+      dlite_instance_get_property_const(inst, "description");
     if (descr)
       triplestore_add_en(ts, inst->uuid, _P ":hasDescription", *descr);
 
@@ -649,7 +650,7 @@ int rdf_save_instance(DLiteStorage *storage, const DLiteInstance *inst)
     /* Property values */
     for (i=0; i < inst->meta->_nproperties; i++) {
       const DLiteProperty *p = dlite_meta_get_property_by_index(inst->meta, i);
-      const void *ptr = dlite_instance_get_property_by_index(inst, i);
+      const void *ptr = dlite_instance_get_property_const_by_index(inst, i);
       const char *name = inst->meta->_properties[i].name;
       const size_t *shape = DLITE_PROP_DIMS(inst, i);
       asnprintf(&buf, &bufsize, "%s/val_%s", inst->uuid, name);
@@ -776,12 +777,19 @@ static DLiteStoragePlugin rdf_plugin = {
   NULL,                                 /* setDataName */
 
   /* internal data */
-  NULL                                  /* data */
+  NULL,                                 /* data */
+
+  /* batched api */
+  NULL,                                 /* loadInstances */
+  NULL,                                 /* saveInstances */
+
+  /* partial api */
+  NULL,                                 /* loadSlab */
 };
 
 
 DSL_EXPORT const DLiteStoragePlugin *
-get_dlite_storage_plugin_api(void *state, int *iter)
+get_dlite_storage_plugin_api_v2(void *state, int *iter)
 {
   UNUSED(iter);
   dlite_globals_set(state);